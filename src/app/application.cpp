@@ -59,7 +59,7 @@ static void APIENTRY gl_callback(GLenum source, GLenum type, GLuint id, GLenum s
     }
 }
 
-bool initialize(Context* ctx, size_t width, size_t height, str_t title) {
+bool initialize(Context* ctx, size_t width, size_t height, str_t title, bool hidden) {
     if (!glfwInit()) {
         // TODO Throw critical error
         MD_LOG_ERROR("Error while initializing glfw.");
@@ -84,6 +84,9 @@ bool initialize(Context* ctx, size_t width, size_t height, str_t title) {
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+    if (hidden) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
     // Zero terminated
     str_t ztitle = str_copy(title, md_get_temp_allocator());
     GLFWwindow* window = glfwCreateWindow((int)width, (int)height, ztitle.ptr, NULL, NULL);
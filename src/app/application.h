@@ -43,7 +43,8 @@ struct Context {
 };
 
 // Context
-bool initialize(Context* ctx, size_t width, size_t height, str_t title);
+// A hidden window still provides a context, which allows rendering offscreen without presenting anything
+bool initialize(Context* ctx, size_t width, size_t height, str_t title, bool hidden = false);
 void shutdown(Context* ctx);
 void update(Context* ctx);
 void render_imgui(Context* ctx);
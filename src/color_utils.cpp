@@ -1,17 +1,28 @@
 #include "color_utils.h"
 
+#include <task_system.h>
+
 #include <core/md_hash.h>
+#include <core/md_allocator.h>
 #include <md_molecule.h>
 #include <md_util.h>
 
+#include <string.h>
+
+// Kernels over more elements than this are distributed over the task pool in chunks
+#define COLOR_PARALLEL_THRESHOLD (64 * 1024)
+#define COLOR_CHUNK_SIZE (16 * 1024)
+
 static void set_colors(uint32_t* colors, size_t count, uint32_t color) {
-    if (color == 0xFFFFFFFFU) {
-        MEMSET(colors, 0xFF, sizeof(uint32_t) * count);
-    } else {
-        for (size_t i = 0; i < count; ++i) {
-            colors[i] = color;
+    task_system::parallel_for(STR_LIT("##Color Atoms"), count, COLOR_CHUNK_SIZE, [colors, color](size_t beg, size_t end) {
+        if (color == 0xFFFFFFFFU) {
+            MEMSET(colors + beg, 0xFF, sizeof(uint32_t) * (end - beg));
+        } else {
+            for (size_t i = beg; i < end; ++i) {
+                colors[i] = color;
+            }
         }
-    }
+    }, COLOR_PARALLEL_THRESHOLD);
 }
 
 static float u32_to_hue(uint32_t u32) {
@@ -43,73 +54,165 @@ void color_atoms_uniform(uint32_t* colors, size_t count, vec4_t color, const md_
 const float chroma = 0.9f;
 const float luminance = 1.0f;
 
+// Direct mapped cache of colors keyed by hash, the colors are expensive to compute (HCL) but the number of unique keys is typically small
+struct ColorCache {
+    uint32_t key[256];
+    uint32_t color[256];
+    bool     valid[256];
+
+    uint32_t get(uint32_t hash) {
+        const uint32_t slot = (hash ^ (hash >> 8) ^ (hash >> 16)) & 255;
+        if (!valid[slot] || key[slot] != hash) {
+            key[slot]   = hash;
+            color[slot] = u32_to_color(hash);
+            valid[slot] = true;
+        }
+        return color[slot];
+    }
+};
+
+struct ColorRange {
+    md_range_t range;
+    uint32_t color;
+};
+
+// Fills ranges of atoms with colors, the ranges are sorted and non overlapping (e.g. chains)
+// The work is distributed over chunks of atoms, such that a few large ranges are filled in parallel as well
+static void fill_color_ranges(uint32_t* colors, size_t count, const ColorRange* ranges, size_t num_ranges) {
+    task_system::parallel_for(STR_LIT("##Color Atoms"), count, COLOR_CHUNK_SIZE, [colors, ranges, num_ranges](size_t beg, size_t end) {
+        // Find the first range which ends after the beginning of the chunk
+        size_t lo = 0, hi = num_ranges;
+        while (lo < hi) {
+            const size_t mid = (lo + hi) / 2;
+            if ((size_t)ranges[mid].range.end <= beg) lo = mid + 1;
+            else hi = mid;
+        }
+        for (size_t i = lo; i < num_ranges && (size_t)ranges[i].range.beg < end; ++i) {
+            const size_t b = MAX((size_t)ranges[i].range.beg, beg);
+            const size_t e = MIN((size_t)ranges[i].range.end, end);
+            for (size_t j = b; j < e; ++j) {
+                colors[j] = ranges[i].color;
+            }
+        }
+    }, COLOR_PARALLEL_THRESHOLD);
+}
+
+static const uint32_t* cpk_lut() {
+    static const struct Lut {
+        uint32_t color[256];
+        Lut() {
+            for (int i = 0; i < 256; ++i) {
+                color[i] = i <= 118 ? md_util_element_cpk_color((md_element_t)i) : 0xFFFFFFFFU;
+            }
+        }
+    } lut;
+    return lut.color;
+}
+
 void color_atoms_cpk(uint32_t* colors, size_t count, const md_molecule_t& mol) {
-    for (size_t i = 0; i < count; i++) {
-        colors[i] = mol.atom.element ? md_util_element_cpk_color(mol.atom.element[i]) : 0xFFFFFFFFU;
+    if (!mol.atom.element) {
+        set_colors(colors, count, 0xFFFFFFFFU);
+        return;
     }
+    const uint32_t* lut = cpk_lut();
+    const md_element_t* element = mol.atom.element;
+    task_system::parallel_for(STR_LIT("##Color Atoms"), count, COLOR_CHUNK_SIZE, [colors, lut, element](size_t beg, size_t end) {
+        for (size_t i = beg; i < end; i++) {
+            colors[i] = lut[element[i]];
+        }
+    }, COLOR_PARALLEL_THRESHOLD);
 }
 
 void color_atoms_type(uint32_t* colors, size_t count, const md_molecule_t& mol) {
-    for (size_t i = 0; i < count; ++i) {
-        const uint32_t u32 = md_hash32(mol.atom.type[i].buf, mol.atom.type[i].len, 0);
-        colors[i] = u32_to_color(u32);
-    }
+    task_system::parallel_for(STR_LIT("##Color Atoms"), count, COLOR_CHUNK_SIZE, [colors, &mol](size_t beg, size_t end) {
+        ColorCache cache = {};
+        for (size_t i = beg; i < end; ++i) {
+            const uint32_t u32 = md_hash32(mol.atom.type[i].buf, mol.atom.type[i].len, 0);
+            colors[i] = cache.get(u32);
+        }
+    }, COLOR_PARALLEL_THRESHOLD);
 }
 
 void color_atoms_idx(uint32_t* colors, size_t count, const md_molecule_t&) {
-    for (size_t i = 0; i < count; ++i) {
-        colors[i] = u32_to_color((uint32_t)i);
-    }
+    task_system::parallel_for(STR_LIT("##Color Atoms"), count, COLOR_CHUNK_SIZE, [colors](size_t beg, size_t end) {
+        for (size_t i = beg; i < end; ++i) {
+            colors[i] = u32_to_color((uint32_t)i);
+        }
+    }, COLOR_PARALLEL_THRESHOLD);
 }
 
+#define RESIDUE_CHUNK_SIZE 1024
+
 void color_atoms_res_name(uint32_t* colors, size_t count, const md_molecule_t& mol) {
     set_colors(colors, count, 0xFFFFFFFFU);
-    for (size_t i = 0; i < mol.residue.count; i++) {
-        str_t str = mol.residue.name[i];
-        const uint32_t u32 = md_hash32(str.ptr, str.len, 0);
-        const uint32_t color = u32_to_color(u32);
-        md_range_t range = md_residue_atom_range(mol.residue, i);
-        set_colors(colors + range.beg, range.end - range.beg, color);
-    }
+    task_system::parallel_for(STR_LIT("##Color Atoms"), mol.residue.count, RESIDUE_CHUNK_SIZE, [colors, &mol](size_t beg, size_t end) {
+        ColorCache cache = {};
+        for (size_t i = beg; i < end; i++) {
+            str_t str = mol.residue.name[i];
+            const uint32_t color = cache.get(md_hash32(str.ptr, str.len, 0));
+            md_range_t range = md_residue_atom_range(mol.residue, i);
+            for (int32_t j = range.beg; j < range.end; ++j) {
+                colors[j] = color;
+            }
+        }
+    }, COLOR_PARALLEL_THRESHOLD);
 }
 
 void color_atoms_res_id(uint32_t* colors, size_t count, const md_molecule_t& mol) {
     set_colors(colors, count, 0xFFFFFFFFU);
-    for (size_t i = 0; i < mol.residue.count; i++) {
-        const uint32_t color = u32_to_color(mol.residue.id[i]);
-        md_range_t range = md_residue_atom_range(mol.residue, i);
-        set_colors(colors + range.beg, range.end - range.beg, color);
-    }
+    task_system::parallel_for(STR_LIT("##Color Atoms"), mol.residue.count, RESIDUE_CHUNK_SIZE, [colors, &mol](size_t beg, size_t end) {
+        for (size_t i = beg; i < end; i++) {
+            const uint32_t color = u32_to_color(mol.residue.id[i]);
+            md_range_t range = md_residue_atom_range(mol.residue, i);
+            for (int32_t j = range.beg; j < range.end; ++j) {
+                colors[j] = color;
+            }
+        }
+    }, COLOR_PARALLEL_THRESHOLD);
 }
+
 void color_atoms_res_idx(uint32_t* colors, size_t count, const md_molecule_t& mol) {
     set_colors(colors, count, 0xFFFFFFFFU);
-    for (size_t i = 0; i < mol.residue.count; i++) {
-        const uint32_t color = u32_to_color((uint32_t)i);
-        md_range_t range = md_residue_atom_range(mol.residue, i);
-        set_colors(colors + range.beg, range.end - range.beg, color);
-    }
+    task_system::parallel_for(STR_LIT("##Color Atoms"), mol.residue.count, RESIDUE_CHUNK_SIZE, [colors, &mol](size_t beg, size_t end) {
+        for (size_t i = beg; i < end; i++) {
+            const uint32_t color = u32_to_color((uint32_t)i);
+            md_range_t range = md_residue_atom_range(mol.residue, i);
+            for (int32_t j = range.beg; j < range.end; ++j) {
+                colors[j] = color;
+            }
+        }
+    }, COLOR_PARALLEL_THRESHOLD);
 }
 
 void color_atoms_chain_id(uint32_t* colors, size_t count, const md_molecule_t& mol) {
     set_colors(colors, count, 0xFFFFFFFFU);
+    if (mol.chain.count == 0) return;
+
+    md_allocator_i* alloc = md_get_heap_allocator();
+    ColorRange* ranges = (ColorRange*)md_alloc(alloc, mol.chain.count * sizeof(ColorRange));
+    defer { md_free(alloc, ranges, mol.chain.count * sizeof(ColorRange)); };
     for (size_t i = 0; i < mol.chain.count; i++) {
         str_t str = mol.chain.id[i];
         uint32_t u32 = 0;
         for (size_t j = 0; j < str.len; ++j) {
             u32 += str.ptr[j];
         }
-        const uint32_t color = u32_to_color(u32);
-        md_range_t range = md_chain_atom_range(mol.chain, i);
-        set_colors(colors + range.beg, range.end - range.beg, color);
+        ranges[i] = {md_chain_atom_range(mol.chain, i), u32_to_color(u32)};
     }
+    fill_color_ranges(colors, count, ranges, mol.chain.count);
 }
+
 void color_atoms_chain_idx(uint32_t* colors, size_t count, const md_molecule_t& mol) {
     set_colors(colors, count, 0xFFFFFFFFU);
+    if (mol.chain.count == 0) return;
+
+    md_allocator_i* alloc = md_get_heap_allocator();
+    ColorRange* ranges = (ColorRange*)md_alloc(alloc, mol.chain.count * sizeof(ColorRange));
+    defer { md_free(alloc, ranges, mol.chain.count * sizeof(ColorRange)); };
     for (size_t i = 0; i < mol.chain.count; i++) {
-        const uint32_t color = u32_to_color((uint32_t)i);
-        md_range_t range = md_chain_atom_range(mol.chain, i);
-        set_colors(colors + range.beg, range.end - range.beg, color);
+        ranges[i] = {md_chain_atom_range(mol.chain, i), u32_to_color((uint32_t)i)};
     }
+    fill_color_ranges(colors, count, ranges, mol.chain.count);
 }
 
 void color_atoms_sec_str(uint32_t* colors, size_t count, const md_molecule_t& mol) {
@@ -131,16 +234,38 @@ void color_atoms_sec_str(uint32_t* colors, size_t count, const md_molecule_t& mo
     }
 }
 
+void color_atoms_scalar(uint32_t* colors, size_t count, const uint8_t* scalars, const uint32_t table[256]) {
+    task_system::parallel_for(STR_LIT("##Color Atoms"), count, COLOR_CHUNK_SIZE, [colors, scalars, table](size_t beg, size_t end) {
+        for (size_t i = beg; i < end; ++i) {
+            colors[i] = table[scalars[i]];
+        }
+    }, COLOR_PARALLEL_THRESHOLD);
+}
+
 void filter_colors(uint32_t* colors, size_t num_colors, const md_bitfield_t* mask) {
-    for (size_t i = 0; i < num_colors; ++i) {
-        colors[i] &= 0x00FFFFFFU;
-    }
+    // The alpha of each chunk is cleared and then set for the atoms within the mask, while the chunk is in cache
+    task_system::parallel_for(STR_LIT("##Color Atoms"), num_colors, COLOR_CHUNK_SIZE, [colors, mask](size_t beg, size_t end) {
+        for (size_t i = beg; i < end; ++i) {
+            colors[i] &= 0x00FFFFFFU;
+        }
+        uint64_t bit = beg;
+        while ((bit = md_bitfield_scan(mask, bit, end)) != 0) {
+            colors[bit - 1] |= 0xFF000000U;
+        }
+    }, COLOR_PARALLEL_THRESHOLD);
+}
 
-    md_bitfield_iter_t it = md_bitfield_iter_create(mask);
-    while (md_bitfield_iter_next(&it)) {
-        uint64_t idx = md_bitfield_iter_idx(&it);
-        colors[idx] = 0xFF000000U | (colors[idx] & 0x00FFFFFFU);
-    }
+// Scaling the saturation in HSV, while keeping the hue and value, corresponds to scaling the distance of each channel to the value (max channel):
+// c' = V - s * (V - c). This avoids the round trip through HSV and is branchless, which lets the compiler vectorize it.
+static inline uint32_t scale_color_saturation(uint32_t rgba, float scale) {
+    const float r = (float)((rgba >>  0) & 0xFF);
+    const float g = (float)((rgba >>  8) & 0xFF);
+    const float b = (float)((rgba >> 16) & 0xFF);
+    const float v = MAX(r, MAX(g, b));
+    const float r2 = CLAMP(v - scale * (v - r), 0.0f, 255.0f);
+    const float g2 = CLAMP(v - scale * (v - g), 0.0f, 255.0f);
+    const float b2 = CLAMP(v - scale * (v - b), 0.0f, 255.0f);
+    return (rgba & 0xFF000000U) | ((uint32_t)(r2 + 0.5f) << 0) | ((uint32_t)(g2 + 0.5f) << 8) | ((uint32_t)(b2 + 0.5f) << 16);
 }
 
 void scale_saturation(uint32_t* colors, const md_bitfield_t* mask, float scale) {
@@ -148,20 +273,14 @@ void scale_saturation(uint32_t* colors, const md_bitfield_t* mask, float scale)
     int64_t end_bit = mask->end_bit;
     while ((beg_bit = md_bitfield_scan(mask, beg_bit, end_bit)) != 0) {
         int64_t i = beg_bit - 1;
-        vec4_t rgba = convert_color(colors[i]);
-        vec3_t hsv = rgb_to_hsv(vec3_from_vec4(rgba));
-        hsv.y *= scale;
-        rgba = vec4_from_vec3(hsv_to_rgb(hsv), rgba.w);
-        colors[i] = convert_color(rgba);
+        colors[i] = scale_color_saturation(colors[i], scale);
     }
 }
 
 void scale_saturation(uint32_t* colors, size_t count, float scale) {
-    for (size_t i = 0; i < count; ++i) {
-        vec4_t rgba = convert_color(colors[i]);
-        vec3_t hsv = rgb_to_hsv(vec3_from_vec4(rgba));
-        hsv.y *= scale;
-        rgba = vec4_from_vec3(hsv_to_rgb(hsv), rgba.w);
-        colors[i] = convert_color(rgba);
-    }
+    task_system::parallel_for(STR_LIT("##Color Atoms"), count, COLOR_CHUNK_SIZE, [colors, scale](size_t beg, size_t end) {
+        for (size_t i = beg; i < end; ++i) {
+            colors[i] = scale_color_saturation(colors[i], scale);
+        }
+    }, COLOR_PARALLEL_THRESHOLD);
 }
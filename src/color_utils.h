@@ -179,6 +179,9 @@ void color_atoms_chain_id   (uint32_t* colors, size_t count, const md_molecule_t
 void color_atoms_chain_idx  (uint32_t* colors, size_t count, const md_molecule_t& mol);
 void color_atoms_sec_str    (uint32_t* colors, size_t count, const md_molecule_t& mol);
 
+// Maps quantized scalars through a table of 256 colors
+void color_atoms_scalar     (uint32_t* colors, size_t count, const uint8_t* scalars, const uint32_t table[256]);
+
 void filter_colors(uint32_t* colors, size_t num_colors, const md_bitfield_t* mask);
 void scale_saturation(uint32_t* colors, const md_bitfield_t* mask, float scale);
 void scale_saturation(uint32_t* colors, size_t count, float scale);
@@ -45,7 +45,7 @@ struct ShapeSpace : viamd::EventHandler {
     float marker_size = 1.5f;
     bool  use_mass = true;
 
-    task_system::ID evaluate_task = 0;
+    sweep::ID evaluate_task = 0;
 
     ApplicationState* app_state = 0;
 
@@ -63,7 +63,7 @@ struct ShapeSpace : viamd::EventHandler {
                 break;
             }
             case viamd::EventType_ViamdShutdown:
-                task_system::task_interrupt_and_wait_for(evaluate_task);
+                sweep::consumer_interrupt_and_wait_for(evaluate_task);
                 md_arena_allocator_destroy(arena);
                 break;
             case viamd::EventType_ViamdFrameTick:
@@ -306,8 +306,8 @@ struct ShapeSpace : viamd::EventHandler {
         // Create a hash from everything which dictates the app_state of an evaluation to compare against
         uint64_t hash = md_hash64(input, sizeof(input), app_state->script.ir_fingerprint ^ (1ULL << (uint64_t)use_mass));
         if (hash != eval_hash) {
-            if (task_system::task_is_running(evaluate_task)) {
-                task_system::task_interrupt (evaluate_task);
+            if (sweep::consumer_is_running(evaluate_task)) {
+                sweep::consumer_interrupt(evaluate_task);
             } else {
                 bitfields = 0;
                 weights = 0;
@@ -341,53 +341,40 @@ struct ShapeSpace : viamd::EventHandler {
                     md_array_resize(coords,  num_frames * num_structures, arena);
                     MEMSET(weights, 0, md_array_bytes(weights));
                     MEMSET(coords,  0, md_array_bytes(coords));
-                    evaluate_task = task_system::create_pool_task(STR_LIT("Eval Shape Space"), 0, (uint32_t)num_frames, [](uint32_t range_beg, uint32_t range_end, void* user_data, uint32_t thread_num) {
-                        (void)thread_num;
+                    // Evaluated as part of a trajectory sweep, which shares the loaded frames with other consumers
+                    evaluate_task = sweep::submit(STR_LIT("Eval Shape Space"), 0, (uint32_t)num_frames, [](uint32_t frame_idx, const md_trajectory_frame_header_t* header, const float* x, const float* y, const float* z, void* user_data) {
+                        (void)header;
                         ShapeSpace* shape_space = (ShapeSpace*)user_data;
                         ApplicationState* app_state = shape_space->app_state;
-                        const size_t stride = ALIGN_TO(app_state->mold.mol.atom.count, 8);
-                        const size_t bytes = stride * 3 * sizeof(float);
-                        float* coords = (float*)md_alloc(md_get_heap_allocator(), bytes);
-                        defer { md_free(md_get_heap_allocator(), coords, bytes); };
-                        float* x = coords + stride * 0;
-                        float* y = coords + stride * 1;
-                        float* z = coords + stride * 2;
                         const float* w = shape_space->use_mass ? app_state->mold.mol.atom.mass : 0;
 
                         const vec2_t p[3] = {{0.0f, 0.0f}, {1.0f, 0.0f}, {0.5f, 0.86602540378f}};
 
                         md_array(vec4_t) xyzw = 0;
-                        for (uint32_t frame_idx = range_beg; frame_idx < range_end; ++frame_idx) {
-                            md_trajectory_frame_header_t header;
-                            md_trajectory_load_frame(app_state->mold.traj, frame_idx, &header, x, y, z);
-
-                            for (size_t i = 0; i < md_array_size(shape_space->bitfields); ++i) {
-                                const md_bitfield_t* bf = &shape_space->bitfields[i];
-                                size_t count = md_bitfield_popcount(bf);
-                                md_array_resize(xyzw, count, md_get_heap_allocator());
-
-                                md_bitfield_iter_t iter = md_bitfield_iter_create(bf);
-                                size_t dst_idx = 0;
-                                while (md_bitfield_iter_next(&iter)) {
-                                    const size_t src_idx = md_bitfield_iter_idx(&iter);
-                                    xyzw[dst_idx++] = vec4_set(x[src_idx], y[src_idx], z[src_idx], w ? w[src_idx] : 1.0f);
-                                }
+                        for (size_t i = 0; i < md_array_size(shape_space->bitfields); ++i) {
+                            const md_bitfield_t* bf = &shape_space->bitfields[i];
+                            size_t count = md_bitfield_popcount(bf);
+                            md_array_resize(xyzw, count, md_get_heap_allocator());
+
+                            md_bitfield_iter_t iter = md_bitfield_iter_create(bf);
+                            size_t dst_idx = 0;
+                            while (md_bitfield_iter_next(&iter)) {
+                                const size_t src_idx = md_bitfield_iter_idx(&iter);
+                                xyzw[dst_idx++] = vec4_set(x[src_idx], y[src_idx], z[src_idx], w ? w[src_idx] : 1.0f);
+                            }
 
-                                vec3_t com = md_util_com_compute_vec4(xyzw, 0, count, &app_state->mold.mol.unit_cell);
-                                md_util_deperiodize_vec4(xyzw, count, com, &app_state->mold.mol.unit_cell);
+                            vec3_t com = md_util_com_compute_vec4(xyzw, 0, count, &app_state->mold.mol.unit_cell);
+                            md_util_deperiodize_vec4(xyzw, count, com, &app_state->mold.mol.unit_cell);
 
-                                const mat3_t M = mat3_covariance_matrix_vec4(xyzw, 0, count, com);
-                                const vec3_t weights = md_util_shape_weights(&M);
+                            const mat3_t M = mat3_covariance_matrix_vec4(xyzw, 0, count, com);
+                            const vec3_t weights = md_util_shape_weights(&M);
 
-                                dst_idx = shape_space->num_frames * i + frame_idx;
-                                shape_space->weights[dst_idx] = weights;
-                                shape_space->coords[dst_idx] = p[0] * weights[0] + p[1] * weights[1] + p[2] * weights[2];
-                            }
+                            dst_idx = shape_space->num_frames * i + frame_idx;
+                            shape_space->weights[dst_idx] = weights;
+                            shape_space->coords[dst_idx] = p[0] * weights[0] + p[1] * weights[1] + p[2] * weights[2];
                         }
                         md_array_free(xyzw, md_get_heap_allocator());
                     }, this);
-
-                    task_system::enqueue_task(evaluate_task);
                 }
             }
         }
@@ -62,6 +62,7 @@ struct VeloxChem : viamd::EventHandler {
         vec3_t step_size = {};
         vec3_t extent = {};
         uint32_t tex_id = 0;
+        uint32_t macro_cell_tex = 0;
     };
 
     struct Scf {
@@ -258,7 +259,7 @@ struct VeloxChem : viamd::EventHandler {
                     if (data.type == OrbitalType::PsiSquared) {
                        mode = MD_GTO_EVAL_MODE_PSI_SQUARED;
                     }
-                    task_system::ID id = compute_mo(&data.tex_mat, &data.voxel_spacing, data.dst_texture, data.orbital_idx, mode, data.samples_per_angstrom);
+                    task_system::ID id = compute_mo(&data.tex_mat, &data.voxel_spacing, data.dst_texture, data.dst_macro_cell_texture, data.orbital_idx, mode, data.samples_per_angstrom);
                     data.output_written = (id != task_system::INVALID_ID);
                 }
 
@@ -396,7 +397,7 @@ struct VeloxChem : viamd::EventHandler {
         *out_ext_in_angstrom = vec3_from_vec4(extent);
     }
 
-    task_system::ID compute_nto(mat4_t* out_tex_mat, vec3_t* out_voxel_spacing, uint32_t* in_out_vol_tex, size_t nto_idx, size_t lambda_idx, md_vlx_nto_type_t type, md_gto_eval_mode_t mode, float samples_per_angstrom = 8.0f) {
+    task_system::ID compute_nto(mat4_t* out_tex_mat, vec3_t* out_voxel_spacing, uint32_t* in_out_vol_tex, uint32_t* in_out_macro_cell_tex, size_t nto_idx, size_t lambda_idx, md_vlx_nto_type_t type, md_gto_eval_mode_t mode, float samples_per_angstrom = 8.0f) {
         size_t num_pgtos = md_vlx_nto_pgto_count(&vlx);
         md_gto_t* pgtos  = (md_gto_t*)md_alloc(md_get_heap_allocator(), sizeof(md_gto_t) * num_pgtos);
 
@@ -432,10 +433,10 @@ struct VeloxChem : viamd::EventHandler {
         *out_tex_mat = tex_mat;
         *out_voxel_spacing = step_size;
 
-        return async_evaluate_orbital_on_grid(in_out_vol_tex, step_size.elem, dim, pgtos, num_pgtos, mode);
+        return async_evaluate_orbital_on_grid(in_out_vol_tex, in_out_macro_cell_tex, step_size.elem, dim, pgtos, num_pgtos, mode);
     }
 
-    task_system::ID compute_mo(mat4_t* out_tex_mat, vec3_t* out_voxel_spacing, uint32_t* in_out_vol_tex, size_t mo_idx, md_gto_eval_mode_t mode, float samples_per_angstrom = 8.0f) {
+    task_system::ID compute_mo(mat4_t* out_tex_mat, vec3_t* out_voxel_spacing, uint32_t* in_out_vol_tex, uint32_t* in_out_macro_cell_tex, size_t mo_idx, md_gto_eval_mode_t mode, float samples_per_angstrom = 8.0f) {
         size_t num_pgtos = md_vlx_mol_pgto_count(&vlx);
         md_gto_t* pgtos  = (md_gto_t*)md_alloc(md_get_heap_allocator(), sizeof(md_gto_t) * num_pgtos);
 
@@ -476,11 +477,12 @@ struct VeloxChem : viamd::EventHandler {
         *out_tex_mat = tex_mat;
         *out_voxel_spacing = step_size;
 
-        return async_evaluate_orbital_on_grid(in_out_vol_tex, step_size.elem, dim, pgtos, num_pgtos, mode);
+        return async_evaluate_orbital_on_grid(in_out_vol_tex, in_out_macro_cell_tex, step_size.elem, dim, pgtos, num_pgtos, mode);
     }
 
     // This is a bit quirky, this will take ownership of pgtos and will free them after the evaluation is complete
-    task_system::ID async_evaluate_orbital_on_grid(uint32_t* tex_ptr, const float step_size[3], const int dim[3], md_gto_t* pgtos, size_t num_pgtos, md_gto_eval_mode_t mode) {
+    // The macro cells of the volume (for empty space skipping) are removed during the evaluation and recomputed once the volume is updated
+    task_system::ID async_evaluate_orbital_on_grid(uint32_t* tex_ptr, uint32_t* macro_cell_tex_ptr, const float step_size[3], const int dim[3], md_gto_t* pgtos, size_t num_pgtos, md_gto_eval_mode_t mode) {
         struct Payload {
             size_t bytes;
             size_t num_pgtos;
@@ -489,9 +491,14 @@ struct VeloxChem : viamd::EventHandler {
             int    vol_dim[3];
             float  step_size[3];
             uint32_t* tex_ptr;
+            uint32_t* macro_cell_tex_ptr;
             md_gto_eval_mode_t mode;
         };
 
+        if (macro_cell_tex_ptr && *macro_cell_tex_ptr) {
+            gl::free_texture(macro_cell_tex_ptr);
+        }
+
         size_t num_vol_bytes = dim[0] * dim[1] * dim[2] * sizeof(float);
         size_t num_bytes = sizeof(Payload) + num_vol_bytes;
         void* mem = md_alloc(md_get_heap_allocator(), num_bytes);
@@ -504,6 +511,7 @@ struct VeloxChem : viamd::EventHandler {
         MEMCPY(payload->vol_dim, dim, sizeof(payload->vol_dim));
         MEMCPY(payload->step_size, step_size, sizeof(payload->step_size));
         payload->tex_ptr    = tex_ptr;
+        payload->macro_cell_tex_ptr = macro_cell_tex_ptr;
         payload->mode       = mode;
 
         // We evaluate the in parallel over smaller NxNxN blocks
@@ -569,6 +577,9 @@ struct VeloxChem : viamd::EventHandler {
             // The init here is just to ensure that the volume has not changed its dimensions during the async evaluation
             gl::init_texture_3D(data->tex_ptr, data->vol_dim[0], data->vol_dim[1], data->vol_dim[2], GL_R16F);
             gl::set_texture_3D_data(*data->tex_ptr, data->vol_data, GL_R32F);
+            if (data->macro_cell_tex_ptr) {
+                volume::compute_macro_cell_texture(data->macro_cell_tex_ptr, *data->tex_ptr);
+            }
 
             md_free(md_get_heap_allocator(), data->pgtos, data->num_pgtos * sizeof(md_gto_t));
             md_free(md_get_heap_allocator(), data, data->bytes);
@@ -1274,7 +1285,7 @@ struct VeloxChem : viamd::EventHandler {
                         if (task_system::task_is_running(orb.vol_task[slot_idx])) {
                             task_system::task_interrupt(orb.vol_task[slot_idx]);
                         }
-                        orb.vol_task[slot_idx] = compute_mo(&orb.vol[slot_idx].tex_to_world, &orb.vol[slot_idx].step_size, &orb.vol[slot_idx].tex_id, mo_idx, MD_GTO_EVAL_MODE_PSI, samples_per_angstrom);
+                        orb.vol_task[slot_idx] = compute_mo(&orb.vol[slot_idx].tex_to_world, &orb.vol[slot_idx].step_size, &orb.vol[slot_idx].tex_id, &orb.vol[slot_idx].macro_cell_tex, mo_idx, MD_GTO_EVAL_MODE_PSI, samples_per_angstrom);
                     }
                 }
             }
@@ -1523,6 +1534,7 @@ struct VeloxChem : viamd::EventHandler {
                                 },
                                 .texture = {
                                     .volume = orb.vol[i].tex_id,
+                                    .macro_cells = orb.vol[i].macro_cell_tex,
                                 },
                                 .matrix = {
                                     .model = orb.vol[i].tex_to_world,
@@ -1690,8 +1702,8 @@ struct VeloxChem : viamd::EventHandler {
                             task_system::task_interrupt(nto.vol_task[hi]);
                         }
 
-                        nto.vol_task[pi] = compute_nto(&nto.vol[pi].tex_to_world, &nto.vol[pi].step_size, &nto.vol[pi].tex_id, nto_idx, lambda_idx, MD_VLX_NTO_TYPE_PARTICLE, MD_GTO_EVAL_MODE_PSI, samples_per_angstrom);
-                        nto.vol_task[hi] = compute_nto(&nto.vol[hi].tex_to_world, &nto.vol[hi].step_size, &nto.vol[hi].tex_id, nto_idx, lambda_idx, MD_VLX_NTO_TYPE_HOLE,     MD_GTO_EVAL_MODE_PSI, samples_per_angstrom);
+                        nto.vol_task[pi] = compute_nto(&nto.vol[pi].tex_to_world, &nto.vol[pi].step_size, &nto.vol[pi].tex_id, &nto.vol[pi].macro_cell_tex, nto_idx, lambda_idx, MD_VLX_NTO_TYPE_PARTICLE, MD_GTO_EVAL_MODE_PSI, samples_per_angstrom);
+                        nto.vol_task[hi] = compute_nto(&nto.vol[hi].tex_to_world, &nto.vol[hi].step_size, &nto.vol[hi].tex_id, &nto.vol[hi].macro_cell_tex, nto_idx, lambda_idx, MD_VLX_NTO_TYPE_HOLE,     MD_GTO_EVAL_MODE_PSI, samples_per_angstrom);
                     }
                 }
             }
@@ -2102,6 +2114,7 @@ struct VeloxChem : viamd::EventHandler {
                             },
                             .texture = {
                                 .volume = nto.vol[i].tex_id,
+                                .macro_cells = nto.vol[i].macro_cell_tex,
                             },
                             .matrix = {
                                 .model = nto.vol[i].tex_to_world,
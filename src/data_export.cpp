@@ -0,0 +1,528 @@
+#include <data_export.h>
+
+#include <task_system.h>
+
+#include <core/md_common.h>
+#include <core/md_array.h>
+#include <core/md_allocator.h>
+#include <core/md_arena_allocator.h>
+#include <core/md_str_builder.h>
+#include <core/md_log.h>
+#include <core/md_os.h>
+#include <md_xvg.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Target size of the buffer for a chunk of formatted data
+#define CHUNK_BYTES (512 * 1024)
+
+// Upper bound of the number of characters required to print a single value (including separator)
+#define MAX_CHARS_PER_VALUE 64
+
+// Number of uncompressed values per zlib compressed volume chunk
+#define VOLUME_CHUNK_VALUES (256 * 1024)
+
+// Compression level passed to the deflate implementation (same as the default of the PNG writer)
+#define VOLUME_COMPRESSION_LEVEL 8
+
+// Implemented by stb_image_write (see image.cpp), but not exposed through its header
+extern "C" unsigned char* stbi_zlib_compress(unsigned char* data, int data_len, int* out_len, int quality);
+
+namespace viamd {
+
+// Formats the chunk with index chunk_idx into buf and returns the number of bytes written (at most cap)
+// SIZE_MAX signals a failure
+typedef size_t (*ChunkFunc)(char* buf, size_t cap, size_t chunk_idx, void* user_data);
+
+// A batch of consecutive chunks which are formatted in parallel
+struct Batch {
+    ChunkFunc func;
+    void*     user_data;
+
+    size_t chunk_cap;       // Maximum number of bytes for a formatted chunk
+    size_t chunk_beg;
+    size_t num_chunks;
+
+    char*   buf;            // [chunks_per_batch * chunk_cap]
+    size_t* len;            // [chunks_per_batch] number of bytes written to each chunk
+
+    task_system::ID task;
+};
+
+static void format_chunk_range(uint32_t range_beg, uint32_t range_end, void* user_data, uint32_t thread_num) {
+    (void)thread_num;
+    Batch* batch = (Batch*)user_data;
+
+    for (uint32_t i = range_beg; i < range_end; ++i) {
+        batch->len[i] = batch->func(batch->buf + i * batch->chunk_cap, batch->chunk_cap, batch->chunk_beg + i, batch->user_data);
+    }
+}
+
+static void launch_batch(Batch* batch, size_t chunk_beg, size_t chunk_end) {
+    batch->chunk_beg = chunk_beg;
+    batch->num_chunks = chunk_end - chunk_beg;
+    if (task_system::pool_num_threads() > 0) {
+        batch->task = task_system::create_pool_task(STR_LIT("##Format Chunks"), 0, (uint32_t)batch->num_chunks, format_chunk_range, batch);
+        task_system::enqueue_task(batch->task);
+    } else {
+        format_chunk_range(0, (uint32_t)batch->num_chunks, batch, 0);
+    }
+}
+
+// Formats the chunks in parallel and writes them in order.
+// Two batches are used in tandem, such that the next batch is formatted while the current one is written.
+static bool write_chunks(md_file_o* file, size_t num_chunks, size_t chunk_cap, ChunkFunc func, void* user_data) {
+    if (num_chunks == 0) return true;
+
+    const size_t chunks_per_batch = MIN(MAX(task_system::pool_num_threads(), (size_t)1) * 2, num_chunks);
+
+    md_allocator_i* alloc = md_get_heap_allocator();
+    const size_t buf_bytes = chunks_per_batch * chunk_cap;
+
+    Batch batch[2] = {};
+    for (int i = 0; i < 2; ++i) {
+        batch[i].func = func;
+        batch[i].user_data = user_data;
+        batch[i].chunk_cap = chunk_cap;
+        batch[i].buf = (char*)md_alloc(alloc, buf_bytes);
+        batch[i].len = (size_t*)md_alloc(alloc, chunks_per_batch * sizeof(size_t));
+    }
+    defer {
+        for (int i = 0; i < 2; ++i) {
+            if (batch[i].task) task_system::task_wait_for(batch[i].task);
+            md_free(alloc, batch[i].buf, buf_bytes);
+            md_free(alloc, batch[i].len, chunks_per_batch * sizeof(size_t));
+        }
+    };
+
+    size_t chunk_beg = 0;
+    int cur = 0;
+    launch_batch(&batch[cur], chunk_beg, MIN(chunk_beg + chunks_per_batch, num_chunks));
+
+    while (chunk_beg < num_chunks) {
+        Batch& b = batch[cur];
+        task_system::task_wait_for(b.task);
+
+        const size_t next_beg = chunk_beg + b.num_chunks;
+        if (next_beg < num_chunks) {
+            launch_batch(&batch[cur ^ 1], next_beg, MIN(next_beg + chunks_per_batch, num_chunks));
+        }
+
+        for (size_t i = 0; i < b.num_chunks; ++i) {
+            if (b.len[i] > chunk_cap) {
+                MD_LOG_ERROR("Failed to format data chunk");
+                return false;
+            }
+            if (md_file_write(file, b.buf + i * chunk_cap, b.len[i]) != b.len[i]) {
+                MD_LOG_ERROR("Failed to write data to file");
+                return false;
+            }
+        }
+
+        chunk_beg = next_beg;
+        cur ^= 1;
+    }
+
+    return true;
+}
+
+enum RowFormat {
+    RowFormat_Xvg,
+    RowFormat_Csv,
+    RowFormat_Float32,
+};
+
+struct RowChunks {
+    const table_column_t* columns;
+    size_t num_columns;
+    size_t num_rows;
+    size_t rows_per_chunk;
+    RowFormat format;
+};
+
+static inline float column_value(const table_column_t& col, size_t row) {
+    return col.data[row * (col.stride ? col.stride : 1)];
+}
+
+static size_t format_row_chunk(char* buf, size_t cap, size_t chunk_idx, void* user_data) {
+    const RowChunks* rows = (const RowChunks*)user_data;
+    const table_column_t* cols = rows->columns;
+    const size_t num_cols = rows->num_columns;
+    const size_t row_beg = chunk_idx * rows->rows_per_chunk;
+    const size_t row_end = MIN(row_beg + rows->rows_per_chunk, rows->num_rows);
+    size_t len = 0;
+
+    switch (rows->format) {
+    case RowFormat_Xvg:
+        for (size_t i = row_beg; i < row_end; ++i) {
+            for (size_t j = 0; j < num_cols; ++j) {
+                int res = snprintf(buf + len, cap - len, "%12.6f ", column_value(cols[j], i));
+                len += CLAMP(res, 0, (int)(cap - len - 1));
+            }
+            buf[len++] = '\n';
+        }
+        break;
+    case RowFormat_Csv:
+        for (size_t i = row_beg; i < row_end; ++i) {
+            for (size_t j = 0; j < num_cols; ++j) {
+                int res = snprintf(buf + len, cap - len, j + 1 < num_cols ? "%.6g," : "%.6g", column_value(cols[j], i));
+                len += CLAMP(res, 0, (int)(cap - len - 1));
+            }
+            buf[len++] = '\n';
+        }
+        break;
+    case RowFormat_Float32:
+        // @NOTE: This assumes a little-endian host, which holds for all the platforms we target
+        for (size_t i = row_beg; i < row_end; ++i) {
+            float* dst = (float*)(buf + len);
+            for (size_t j = 0; j < num_cols; ++j) {
+                dst[j] = column_value(cols[j], i);
+            }
+            len += num_cols * sizeof(float);
+        }
+        break;
+    default:
+        ASSERT(false);
+    }
+
+    ASSERT(len <= cap);
+    return len;
+}
+
+static bool write_rows(md_file_o* file, const table_column_t columns[], size_t num_columns, size_t num_rows, RowFormat format) {
+    if (num_rows == 0 || num_columns == 0) return true;
+
+    const size_t row_cap = (format == RowFormat_Float32) ? num_columns * sizeof(float) : num_columns * MAX_CHARS_PER_VALUE + 1;
+    const size_t rows_per_chunk = CLAMP(CHUNK_BYTES / row_cap, (size_t)1, num_rows);
+    const size_t num_chunks = (num_rows + rows_per_chunk - 1) / rows_per_chunk;
+
+    RowChunks rows = {
+        .columns = columns,
+        .num_columns = num_columns,
+        .num_rows = num_rows,
+        .rows_per_chunk = rows_per_chunk,
+        .format = format,
+    };
+
+    return write_chunks(file, num_chunks, rows_per_chunk * row_cap, format_row_chunk, &rows);
+}
+
+static md_file_o* open_file(str_t filename) {
+    md_file_o* file = md_file_open(filename, MD_FILE_WRITE | MD_FILE_BINARY);
+    if (!file) {
+        MD_LOG_ERROR("Failed to open file '" STR_FMT "' to write data.", STR_ARG(filename));
+    }
+    return file;
+}
+
+static void write_json_str(md_strb_t* sb, str_t str) {
+    md_strb_push_char(sb, '"');
+    for (size_t i = 0; i < str.len; ++i) {
+        const char c = str.ptr[i];
+        if (c == '"' || c == '\\') {
+            md_strb_push_char(sb, '\\');
+            md_strb_push_char(sb, c);
+        } else if ((unsigned char)c < 0x20) {
+            md_strb_fmt(sb, "\\u%04x", (unsigned char)c);
+        } else {
+            md_strb_push_char(sb, c);
+        }
+    }
+    md_strb_push_char(sb, '"');
+}
+
+bool export_table_xvg(str_t filename, str_t title, str_t x_label, str_t y_label, const table_column_t columns[], size_t num_columns, size_t num_rows) {
+    ASSERT(columns || num_columns == 0);
+
+    md_file_o* file = open_file(filename);
+    if (!file) return false;
+    defer { md_file_close(file); };
+
+    md_allocator_i* arena = md_arena_allocator_create(md_get_heap_allocator(), MEGABYTES(1));
+    defer { md_arena_allocator_destroy(arena); };
+
+    // Legends are only given if there are multiple y-columns
+    md_array(str_t) legends = 0;
+    if (num_columns > 2) {
+        for (size_t i = 1; i < num_columns; ++i) {
+            md_array_push(legends, columns[i].label, arena);
+        }
+    }
+
+    str_t header = md_xvg_format_header(title, x_label, y_label, md_array_size(legends), legends, arena);
+    if (md_file_write(file, header.ptr, header.len) != header.len) {
+        MD_LOG_ERROR("Failed to write data to file");
+        return false;
+    }
+
+    return write_rows(file, columns, num_columns, num_rows, RowFormat_Xvg);
+}
+
+bool export_table_csv(str_t filename, const table_column_t columns[], size_t num_columns, size_t num_rows) {
+    ASSERT(columns || num_columns == 0);
+
+    md_file_o* file = open_file(filename);
+    if (!file) return false;
+    defer { md_file_close(file); };
+
+    md_strb_t sb = md_strb_create(md_get_heap_allocator());
+    defer { md_strb_free(&sb); };
+
+    for (size_t i = 0; i < num_columns; ++i) {
+        md_strb_push_str(&sb, columns[i].label);
+        md_strb_push_char(&sb, i + 1 < num_columns ? ',' : '\n');
+    }
+
+    str_t header = md_strb_to_str(sb);
+    if (md_file_write(file, header.ptr, header.len) != header.len) {
+        MD_LOG_ERROR("Failed to write data to file");
+        return false;
+    }
+
+    return write_rows(file, columns, num_columns, num_rows, RowFormat_Csv);
+}
+
+// Completes a single line JSON header which has been started in sb by appending the data offset and padding
+// the header such that the data begins at a 64-byte aligned offset, then writes it to the file
+static bool write_raw_header(md_file_o* file, md_strb_t* sb) {
+    md_strb_push_str(sb, STR_LIT("\"data_offset\": "));
+
+    // Reserve space for the offset digits, closing brace and newline, then align
+    const size_t data_offset = ALIGN_TO(md_strb_to_str(*sb).len + 24, 64);
+    md_strb_fmt(sb, "%zu}", data_offset);
+    while (md_strb_to_str(*sb).len < data_offset - 1) {
+        md_strb_push_char(sb, ' ');
+    }
+    md_strb_push_char(sb, '\n');
+
+    str_t header = md_strb_to_str(*sb);
+    ASSERT(header.len == data_offset);
+    if (md_file_write(file, header.ptr, header.len) != header.len) {
+        MD_LOG_ERROR("Failed to write data to file");
+        return false;
+    }
+    return true;
+}
+
+// https://numpy.org/doc/stable/reference/generated/numpy.lib.format.html
+// The total size of magic string, version, header length and header should be divisible by 64 and the header is terminated by a newline
+static bool write_npy_header(md_file_o* file, const size_t shape[], size_t ndim) {
+    char header[256];
+    const size_t preamble = 10;
+    int len = snprintf(header + preamble, sizeof(header) - preamble, "{'descr': '<f4', 'fortran_order': False, 'shape': (");
+    for (size_t i = 0; i < ndim; ++i) {
+        len += snprintf(header + preamble + len, sizeof(header) - preamble - len, "%zu, ", shape[i]);
+    }
+    len += snprintf(header + preamble + len, sizeof(header) - preamble - len, "), }");
+    if (len < 0 || preamble + len + 1 > sizeof(header)) return false;
+
+    const size_t total = ALIGN_TO(preamble + len + 1, 64);
+    ASSERT(total <= sizeof(header));
+    MEMSET(header + preamble + len, ' ', total - preamble - len - 1);
+    header[total - 1] = '\n';
+
+    const uint16_t header_len = (uint16_t)(total - preamble);
+    MEMCPY(header, "\x93NUMPY", 6);
+    header[6] = 1;
+    header[7] = 0;
+    header[8] = (char)(header_len & 0xFF);
+    header[9] = (char)(header_len >> 8);
+
+    if (md_file_write(file, header, total) != total) {
+        MD_LOG_ERROR("Failed to write data to file");
+        return false;
+    }
+    return true;
+}
+
+bool export_table_raw(str_t filename, str_t title, const table_column_t columns[], size_t num_columns, size_t num_rows) {
+    ASSERT(columns || num_columns == 0);
+
+    md_file_o* file = open_file(filename);
+    if (!file) return false;
+    defer { md_file_close(file); };
+
+    md_strb_t sb = md_strb_create(md_get_heap_allocator());
+    defer { md_strb_free(&sb); };
+
+    md_strb_push_str(&sb, STR_LIT("{\"title\": "));
+    write_json_str(&sb, title);
+    md_strb_fmt(&sb, ", \"dtype\": \"<f4\", \"order\": \"C\", \"shape\": [%zu, %zu], \"columns\": [", num_rows, num_columns);
+    for (size_t i = 0; i < num_columns; ++i) {
+        if (i > 0) md_strb_push_str(&sb, STR_LIT(", "));
+        write_json_str(&sb, columns[i].label);
+    }
+    md_strb_push_str(&sb, STR_LIT("], "));
+
+    if (!write_raw_header(file, &sb)) return false;
+
+    return write_rows(file, columns, num_columns, num_rows, RowFormat_Float32);
+}
+
+bool export_table_npy(str_t filename, const table_column_t columns[], size_t num_columns, size_t num_rows) {
+    ASSERT(columns || num_columns == 0);
+
+    md_file_o* file = open_file(filename);
+    if (!file) return false;
+    defer { md_file_close(file); };
+
+    const size_t shape[2] = {num_rows, num_columns};
+    if (!write_npy_header(file, shape, 2)) return false;
+
+    return write_rows(file, columns, num_columns, num_rows, RowFormat_Float32);
+}
+
+struct CubeChunks {
+    const float* values;
+    size_t dim[3];
+    size_t values_per_chunk;
+};
+
+// The cube format stores the values with x as the outer and z as the inner loop, while the volume is stored with x as the fastest varying index.
+// Each chunk covers a range of the output sequence, which is a multiple of 6 values, such that the line breaks fall on the same positions as if written sequentially.
+static size_t format_cube_chunk(char* buf, size_t cap, size_t chunk_idx, void* user_data) {
+    const CubeChunks* cube = (const CubeChunks*)user_data;
+    const size_t nx = cube->dim[0];
+    const size_t ny = cube->dim[1];
+    const size_t nz = cube->dim[2];
+    const size_t count = nx * ny * nz;
+
+    const size_t beg = chunk_idx * cube->values_per_chunk;
+    const size_t end = MIN(beg + cube->values_per_chunk, count);
+
+    size_t x = beg / (ny * nz);
+    size_t y = (beg / nz) % ny;
+    size_t z = beg % nz;
+    size_t len = 0;
+
+    for (size_t n = beg; n < end; ++n) {
+        const float val = cube->values[z * nx * ny + y * nx + x];
+        int res = snprintf(buf + len, cap - len, " %12.6E", val);
+        len += CLAMP(res, 0, (int)(cap - len - 1));
+        if ((n + 1) % 6 == 0) buf[len++] = '\n';
+
+        if (++z == nz) {
+            z = 0;
+            if (++y == ny) {
+                y = 0;
+                ++x;
+            }
+        }
+    }
+
+    ASSERT(len <= cap);
+    return len;
+}
+
+bool write_cube_voxels(md_file_o* file, const float* values, const int dim[3]) {
+    ASSERT(file);
+    ASSERT(values);
+    ASSERT(dim);
+
+    const size_t count = (size_t)dim[0] * (size_t)dim[1] * (size_t)dim[2];
+    if (count == 0) return true;
+
+    CubeChunks cube = {
+        .values = values,
+        .dim = {(size_t)dim[0], (size_t)dim[1], (size_t)dim[2]},
+        .values_per_chunk = MAX(CHUNK_BYTES / MAX_CHARS_PER_VALUE / 6 * 6, (size_t)6),
+    };
+
+    const size_t num_chunks = (count + cube.values_per_chunk - 1) / cube.values_per_chunk;
+    const size_t chunk_cap = cube.values_per_chunk * MAX_CHARS_PER_VALUE + cube.values_per_chunk / 6 + 1;
+    return write_chunks(file, num_chunks, chunk_cap, format_cube_chunk, &cube);
+}
+
+struct ZlibChunks {
+    const float* values;
+    size_t count;
+};
+
+// Each chunk is stored as its compressed size in bytes (uint32) followed by the zlib stream
+static size_t compress_volume_chunk(char* buf, size_t cap, size_t chunk_idx, void* user_data) {
+    const ZlibChunks* zc = (const ZlibChunks*)user_data;
+    const size_t beg = chunk_idx * VOLUME_CHUNK_VALUES;
+    const size_t end = MIN(beg + VOLUME_CHUNK_VALUES, zc->count);
+
+    int out_len = 0;
+    unsigned char* out = stbi_zlib_compress((unsigned char*)(zc->values + beg), (int)((end - beg) * sizeof(float)), &out_len, VOLUME_COMPRESSION_LEVEL);
+    if (!out) return SIZE_MAX;
+    defer { free(out); };
+
+    if (out_len < 0 || sizeof(uint32_t) + (size_t)out_len > cap) return SIZE_MAX;
+
+    const uint32_t size = (uint32_t)out_len;
+    MEMCPY(buf, &size, sizeof(size));
+    MEMCPY(buf + sizeof(size), out, out_len);
+    return sizeof(size) + out_len;
+}
+
+bool export_volume_raw(str_t filename, str_t title, const float* values, const int dim[3], const float voxel_size[3], VolumeCompression compression) {
+    ASSERT(values);
+    ASSERT(dim);
+    ASSERT(voxel_size);
+
+    md_file_o* file = open_file(filename);
+    if (!file) return false;
+    defer { md_file_close(file); };
+
+    const size_t count = (size_t)dim[0] * (size_t)dim[1] * (size_t)dim[2];
+
+    md_strb_t sb = md_strb_create(md_get_heap_allocator());
+    defer { md_strb_free(&sb); };
+
+    md_strb_push_str(&sb, STR_LIT("{\"title\": "));
+    write_json_str(&sb, title);
+    md_strb_fmt(&sb, ", \"dtype\": \"<f4\", \"order\": \"C\", \"shape\": [%i, %i, %i], \"axes\": [\"z\", \"y\", \"x\"], ", dim[2], dim[1], dim[0]);
+    md_strb_fmt(&sb, "\"voxel_size\": [%g, %g, %g], \"length_unit\": \"angstrom\", ", voxel_size[0], voxel_size[1], voxel_size[2]);
+    if (compression == VolumeCompression_Zlib) {
+        md_strb_fmt(&sb, "\"compression\": \"zlib\", \"chunk_values\": %i, ", VOLUME_CHUNK_VALUES);
+    } else {
+        md_strb_push_str(&sb, STR_LIT("\"compression\": \"none\", "));
+    }
+
+    if (!write_raw_header(file, &sb)) return false;
+
+    if (compression == VolumeCompression_Zlib) {
+        ZlibChunks zc = {
+            .values = values,
+            .count = count,
+        };
+        // The deflate implementation only emits fixed huffman codes, which never expand the data with more than 9/8 (+ stream overhead)
+        const size_t raw_bytes = VOLUME_CHUNK_VALUES * sizeof(float);
+        const size_t chunk_cap = sizeof(uint32_t) + raw_bytes + raw_bytes / 4 + 1024;
+        const size_t num_chunks = (count + VOLUME_CHUNK_VALUES - 1) / VOLUME_CHUNK_VALUES;
+        return write_chunks(file, num_chunks, chunk_cap, compress_volume_chunk, &zc);
+    }
+
+    // The volume is already stored in C-order (z, y, x) so it can be written as is
+    const size_t bytes = count * sizeof(float);
+    if (md_file_write(file, values, bytes) != bytes) {
+        MD_LOG_ERROR("Failed to write data to file");
+        return false;
+    }
+    return true;
+}
+
+bool export_volume_npy(str_t filename, const float* values, const int dim[3]) {
+    ASSERT(values);
+    ASSERT(dim);
+
+    md_file_o* file = open_file(filename);
+    if (!file) return false;
+    defer { md_file_close(file); };
+
+    const size_t shape[3] = {(size_t)dim[2], (size_t)dim[1], (size_t)dim[0]};
+    if (!write_npy_header(file, shape, 3)) return false;
+
+    const size_t bytes = shape[0] * shape[1] * shape[2] * sizeof(float);
+    if (md_file_write(file, values, bytes) != bytes) {
+        MD_LOG_ERROR("Failed to write data to file");
+        return false;
+    }
+    return true;
+}
+
+}  // namespace viamd
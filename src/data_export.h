@@ -0,0 +1,53 @@
+#pragma once
+
+#include <core/md_str.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Streaming exporters for tabular data (rows x columns of floats) and volumes.
+// The data is formatted in parallel chunks on the task pool and written sequentially to the file,
+// which means that the full formatted output is never materialized in memory.
+
+struct md_file_o;
+
+namespace viamd {
+
+struct table_column_t {
+    str_t        label;
+    const float* data;
+    size_t       stride; // Number of elements between two consecutive rows, 0 is interpreted as 1
+};
+
+bool export_table_xvg(str_t filename, str_t title, str_t x_label, str_t y_label, const table_column_t columns[], size_t num_columns, size_t num_rows);
+bool export_table_csv(str_t filename, const table_column_t columns[], size_t num_columns, size_t num_rows);
+
+// Raw little-endian float32 values in row major order, preceded by a single line JSON header.
+// The header is padded such that the data begins at a 64-byte aligned offset, which is stored in the header (data_offset).
+// This allows the data to be memory mapped directly, e.g. numpy.memmap(filename, dtype='<f4', offset=data_offset, shape=shape)
+bool export_table_raw(str_t filename, str_t title, const table_column_t columns[], size_t num_columns, size_t num_rows);
+
+// NumPy .npy (version 1.0) of float32 values with shape (num_rows, num_columns)
+bool export_table_npy(str_t filename, const table_column_t columns[], size_t num_columns, size_t num_rows);
+
+// Volumes are given as float32 values with dimensions dim (x, y, z) where x is the fastest varying index,
+// i.e. they are in C-order with shape (dim[2], dim[1], dim[0]).
+
+enum VolumeCompression {
+    VolumeCompression_None,
+    // The values are split into chunks which are compressed independently as zlib streams.
+    // Each chunk is stored as its compressed size (uint32) followed by the stream, the number of values per chunk is given in the header (chunk_values).
+    VolumeCompression_Zlib,
+};
+
+// Writes the voxel values in the order of the Gaussian cube format (x outer, z inner loop) with 6 values per line
+// The header is expected to have been written to the file prior to the call
+bool write_cube_voxels(md_file_o* file, const float* values, const int dim[3]);
+
+// Raw float32 volume preceded by a single line JSON header, analogous to export_table_raw. The voxel size is given in Ångström.
+bool export_volume_raw(str_t filename, str_t title, const float* values, const int dim[3], const float voxel_size[3], VolumeCompression compression = VolumeCompression_None);
+
+// NumPy .npy (version 1.0) of float32 values with shape (dim[2], dim[1], dim[0])
+bool export_volume_npy(str_t filename, const float* values, const int dim[3]);
+
+}  // namespace viamd
@@ -0,0 +1,449 @@
+#include <gfx/culling_utils.h>
+
+#include <gfx/gl.h>
+#include <gfx/gl_utils.h>
+#include <gfx/profiler.h>
+#include <task_system.h>
+
+#include <core/md_common.h>
+#include <core/md_str.h>
+#include <core/md_allocator.h>
+#include <core/md_bitfield.h>
+#include <core/md_hash.h>
+#include <core/md_log.h>
+
+#include <math.h>
+#include <float.h>
+
+// Each texel of the read back depth covers a block of HIZ_BLOCK x HIZ_BLOCK pixels
+#define HIZ_BLOCK 8
+
+// The lowest number of atoms kept of a chunk with reduced level of detail
+#define LOD_MIN_ATOMS 8
+
+#define CULL_CHUNK_BATCH 256
+
+static constexpr str_t v_shader_src = STR_LIT(
+R"(
+#version 150 core
+
+void main() {
+	uint idx = uint(gl_VertexID) % 3U;
+	gl_Position = vec4(
+		(float( idx     &1U)) * 4.0 - 1.0,
+		(float((idx>>1U)&1U)) * 4.0 - 1.0,
+		0, 1.0);
+}
+)");
+
+static constexpr str_t f_shader_src = STR_LIT(
+R"(
+#version 150 core
+
+uniform sampler2D u_tex_depth;
+uniform int u_block;
+
+out vec4 out_frag;
+
+void main() {
+    ivec2 size = textureSize(u_tex_depth, 0);
+    ivec2 beg  = ivec2(gl_FragCoord.xy) * u_block;
+    ivec2 end  = min(beg + u_block, size);
+    float d = 0.0;
+    for (int y = beg.y; y < end.y; ++y) {
+        for (int x = beg.x; x < end.x; ++x) {
+            d = max(d, texelFetch(u_tex_depth, ivec2(x, y), 0).r);
+        }
+    }
+    out_frag = vec4(d);
+}
+)");
+
+namespace culling {
+
+static GLuint program = 0;
+
+void initialize() {
+    GLuint v_shader = gl::compile_shader_from_source(v_shader_src, GL_VERTEX_SHADER);
+    GLuint f_shader = gl::compile_shader_from_source(f_shader_src, GL_FRAGMENT_SHADER);
+    defer {
+        glDeleteShader(v_shader);
+        glDeleteShader(f_shader);
+    };
+
+    if (v_shader == 0 || f_shader == 0) {
+        MD_LOG_ERROR("shader compilation failed, shader program for depth reduction will not be updated");
+        return;
+    }
+
+    if (!program) program = glCreateProgram();
+    const GLuint shaders[] = {v_shader, f_shader};
+    gl::attach_link_detach(program, shaders, (int)ARRAY_SIZE(shaders));
+}
+
+void shutdown() {
+    if (program) {
+        glDeleteProgram(program);
+        program = 0;
+    }
+}
+
+void init_chunks(Culler* culler, const uint32_t* chunk_offsets, size_t num_chunks, md_allocator_i* alloc) {
+    ASSERT(culler);
+    ASSERT(alloc);
+
+    md_array_free(culler->chunk_offset, alloc);
+    md_array_free(culler->aabb,  alloc);
+    md_array_free(culler->state, alloc);
+    md_array_free(culler->keep,  alloc);
+    culler->alloc = alloc;
+    culler->num_chunks = num_chunks;
+    culler->stats = {};
+    if (num_chunks == 0) return;
+
+    ASSERT(chunk_offsets);
+    md_array_resize(culler->chunk_offset, num_chunks + 1, alloc);
+    MEMCPY(culler->chunk_offset, chunk_offsets, (num_chunks + 1) * sizeof(uint32_t));
+
+    md_array_resize(culler->aabb, num_chunks * 6, alloc);
+    md_array_resize(culler->state, num_chunks, alloc);
+    md_array_resize(culler->keep,  num_chunks, alloc);
+    MEMSET(culler->aabb,  0, md_array_bytes(culler->aabb));
+    MEMSET(culler->state, 0, md_array_bytes(culler->state));
+    for (size_t i = 0; i < num_chunks; ++i) {
+        culler->keep[i] = chunk_offsets[i + 1] - chunk_offsets[i];
+    }
+}
+
+void destroy(Culler* culler) {
+    ASSERT(culler);
+    if (culler->alloc) {
+        md_array_free(culler->chunk_offset, culler->alloc);
+        md_array_free(culler->aabb,  culler->alloc);
+        md_array_free(culler->state, culler->alloc);
+        md_array_free(culler->keep,  culler->alloc);
+        md_array_free(culler->hiz.data, culler->alloc);
+    }
+    if (culler->readback.fence) glDeleteSync((GLsync)culler->readback.fence);
+    if (culler->readback.fbo) glDeleteFramebuffers(1, &culler->readback.fbo);
+    if (culler->readback.tex) glDeleteTextures(1, &culler->readback.tex);
+    if (culler->readback.pbo) glDeleteBuffers(1, &culler->readback.pbo);
+    *culler = {};
+}
+
+void update_bounds(Culler* culler, const float* x, const float* y, const float* z, const float* radius, float radius_scale) {
+    ASSERT(culler);
+    if (culler->num_chunks == 0) return;
+    ASSERT(x && y && z);
+
+    task_system::parallel_for(STR_LIT("##Cull Chunks"), culler->num_chunks, CULL_CHUNK_BATCH, [&](size_t beg, size_t end) {
+        for (size_t i = beg; i < end; ++i) {
+            float min_box[3] = { FLT_MAX,  FLT_MAX,  FLT_MAX};
+            float max_box[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+            for (uint32_t j = culler->chunk_offset[i]; j < culler->chunk_offset[i + 1]; ++j) {
+                const float r = radius ? radius[j] * radius_scale : 0.0f;
+                min_box[0] = MIN(min_box[0], x[j] - r);
+                min_box[1] = MIN(min_box[1], y[j] - r);
+                min_box[2] = MIN(min_box[2], z[j] - r);
+                max_box[0] = MAX(max_box[0], x[j] + r);
+                max_box[1] = MAX(max_box[1], y[j] + r);
+                max_box[2] = MAX(max_box[2], z[j] + r);
+            }
+            float* box = culler->aabb + i * 6;
+            MEMCPY(box + 0, min_box, sizeof(min_box));
+            MEMCPY(box + 3, max_box, sizeof(max_box));
+        }
+    });
+}
+
+struct ScreenRect {
+    float x0, y0, x1, y1;   // Normalized [0,1] window coordinates
+    float min_depth;        // [0,1] window depth of the closest corner
+};
+
+// Projects the corners of the box, returns false if any corner lies behind the eye, in which case the projection is meaningless
+static bool project_box(ScreenRect* rect, const mat4_t& M, const float min_box[3], const float max_box[3]) {
+    rect->x0 = rect->y0 = rect->min_depth =  FLT_MAX;
+    rect->x1 = rect->y1 = -FLT_MAX;
+    for (int i = 0; i < 8; ++i) {
+        const vec4_t p = {
+            (i & 1) ? max_box[0] : min_box[0],
+            (i & 2) ? max_box[1] : min_box[1],
+            (i & 4) ? max_box[2] : min_box[2],
+            1.0f,
+        };
+        const vec4_t c = mat4_mul_vec4(M, p);
+        if (c.w <= 1.0e-5f) return false;
+        const float inv_w = 1.0f / c.w;
+        const float sx = c.x * inv_w * 0.5f + 0.5f;
+        const float sy = c.y * inv_w * 0.5f + 0.5f;
+        const float sz = c.z * inv_w * 0.5f + 0.5f;
+        rect->x0 = MIN(rect->x0, sx);
+        rect->y0 = MIN(rect->y0, sy);
+        rect->x1 = MAX(rect->x1, sx);
+        rect->y1 = MAX(rect->y1, sy);
+        rect->min_depth = MIN(rect->min_depth, sz);
+    }
+    return true;
+}
+
+// Tests the box against the planes of the clip volume (Gribb-Hartmann), using the corner which lies furthest along each plane normal
+static bool box_in_frustum(const vec4_t planes[6], const float min_box[3], const float max_box[3]) {
+    for (int i = 0; i < 6; ++i) {
+        const vec4_t& p = planes[i];
+        const float x = p.x >= 0.0f ? max_box[0] : min_box[0];
+        const float y = p.y >= 0.0f ? max_box[1] : min_box[1];
+        const float z = p.z >= 0.0f ? max_box[2] : min_box[2];
+        if (p.x * x + p.y * y + p.z * z + p.w < 0.0f) return false;
+    }
+    return true;
+}
+
+static bool rect_is_occluded(const Culler* culler, const ScreenRect& rect) {
+    const auto& hiz = culler->hiz;
+    const int w = hiz.dim[0][0];
+    const int h = hiz.dim[0][1];
+
+    // Parts outside of the captured view are unknown
+    if (rect.x0 < 0.0f || rect.y0 < 0.0f || rect.x1 > 1.0f || rect.y1 > 1.0f) return false;
+
+    int x0 = CLAMP((int)(rect.x0 * w), 0, w - 1);
+    int y0 = CLAMP((int)(rect.y0 * h), 0, h - 1);
+    int x1 = CLAMP((int)(rect.x1 * w), 0, w - 1);
+    int y1 = CLAMP((int)(rect.y1 * h), 0, h - 1);
+
+    // Pick the level where the rect covers at most 3x3 texels
+    int level = 0;
+    while (level + 1 < hiz.num_levels && MAX(x1 - x0, y1 - y0) > 2) {
+        x0 >>= 1; y0 >>= 1; x1 >>= 1; y1 >>= 1;
+        level += 1;
+    }
+
+    const int lw = hiz.dim[level][0];
+    const int lh = hiz.dim[level][1];
+    const float* data = hiz.data + hiz.offset[level];
+    float max_depth = 0.0f;
+    for (int y = y0; y <= MIN(y1, lh - 1); ++y) {
+        for (int x = x0; x <= MIN(x1, lw - 1); ++x) {
+            max_depth = MAX(max_depth, data[y * lw + x]);
+        }
+    }
+    return rect.min_depth > max_depth;
+}
+
+uint64_t cull(Culler* culler, const CullDesc& desc) {
+    ASSERT(culler);
+    if (culler->num_chunks == 0) return 0;
+
+    const mat4_t& M = desc.view_proj;
+    vec4_t planes[6];
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            planes[i * 2 + 0].elem[j] = M.elem[j][3] + M.elem[j][i];
+            planes[i * 2 + 1].elem[j] = M.elem[j][3] - M.elem[j][i];
+        }
+    }
+
+    // The Hi-Z is only conservative for the view and the scene it was captured from, anything which has moved since may be disoccluded
+    const bool occlusion = desc.occlusion && culler->hiz.valid && culler->hiz.scene_key == desc.scene_key;
+    // The projection may differ from the captured one by the sub-pixel jitter, which the rects are dilated by
+    const float jitter_x = desc.viewport_width  > 0 ? 1.0f / desc.viewport_width  : 0.0f;
+    const float jitter_y = desc.viewport_height > 0 ? 1.0f / desc.viewport_height : 0.0f;
+    const float viewport_ext = (float)MAX(desc.viewport_width, desc.viewport_height);
+
+    task_system::parallel_for(STR_LIT("##Cull Chunks"), culler->num_chunks, CULL_CHUNK_BATCH, [&](size_t beg, size_t end) {
+        for (size_t i = beg; i < end; ++i) {
+            const uint32_t count = culler->chunk_offset[i + 1] - culler->chunk_offset[i];
+            const float* box = culler->aabb + i * 6;
+            const float min_box[3] = {box[0] - desc.padding, box[1] - desc.padding, box[2] - desc.padding};
+            const float max_box[3] = {box[3] + desc.padding, box[4] + desc.padding, box[5] + desc.padding};
+
+            if (!box_in_frustum(planes, min_box, max_box)) {
+                culler->state[i] = ChunkState_Frustum;
+                culler->keep[i]  = 0;
+                continue;
+            }
+
+            ScreenRect rect;
+            if (occlusion && project_box(&rect, culler->hiz.view_proj, min_box, max_box)) {
+                rect.x0 -= jitter_x;
+                rect.y0 -= jitter_y;
+                rect.x1 += jitter_x;
+                rect.y1 += jitter_y;
+                if (rect_is_occluded(culler, rect)) {
+                    culler->state[i] = ChunkState_Occluded;
+                    culler->keep[i]  = 0;
+                    continue;
+                }
+            }
+
+            uint32_t keep = count;
+            if (desc.lod_pixel_size > 0.0f && project_box(&rect, M, min_box, max_box)) {
+                const float ext = MAX(rect.x1 - rect.x0, rect.y1 - rect.y0) * viewport_ext;
+                if (ext < desc.lod_pixel_size) {
+                    const float t = ext / desc.lod_pixel_size;
+                    keep = CLAMP((uint32_t)ceilf(count * t * t), MIN((uint32_t)LOD_MIN_ATOMS, count), count);
+                }
+            }
+            culler->state[i] = (keep < count) ? ChunkState_Detail : ChunkState_Visible;
+            culler->keep[i]  = keep;
+        }
+    });
+
+    culler->stats = {};
+    for (size_t i = 0; i < culler->num_chunks; ++i) {
+        culler->stats.chunks[culler->state[i]] += 1;
+        culler->stats.atoms += culler->keep[i];
+    }
+
+    return md_hash64(culler->keep, md_array_bytes(culler->keep), 0);
+}
+
+void write_atom_mask(md_bitfield_t* mask, const Culler* culler) {
+    ASSERT(mask);
+    ASSERT(culler);
+    md_bitfield_clear(mask);
+    for (size_t i = 0; i < culler->num_chunks; ++i) {
+        const uint32_t beg   = culler->chunk_offset[i];
+        const uint32_t count = culler->chunk_offset[i + 1] - beg;
+        const uint32_t keep  = culler->keep[i];
+        if (keep == count) {
+            md_bitfield_set_range(mask, beg, beg + count);
+        } else if (keep > 0) {
+            // Atoms are picked evenly over the chunk
+            for (uint32_t j = 0; j < keep; ++j) {
+                md_bitfield_set_bit(mask, beg + (uint32_t)(((uint64_t)j * count) / keep));
+            }
+        }
+    }
+}
+
+void capture_depth(Culler* culler, uint32_t depth_tex, int width, int height, const mat4_t& view_proj, uint64_t scene_key) {
+    ASSERT(culler);
+    if (!program || !depth_tex || width <= 0 || height <= 0) return;
+
+    // Only a single readback is in flight
+    if (culler->readback.pending) return;
+
+    auto& rb = culler->readback;
+    const int w = (width  + HIZ_BLOCK - 1) / HIZ_BLOCK;
+    const int h = (height + HIZ_BLOCK - 1) / HIZ_BLOCK;
+
+    if (!rb.fbo) glGenFramebuffers(1, &rb.fbo);
+    if (!rb.pbo) glGenBuffers(1, &rb.pbo);
+    if (!rb.tex || rb.dim[0] != w || rb.dim[1] != h) {
+        gl::init_texture_2D(&rb.tex, w, h, GL_R32F);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, rb.fbo);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, rb.tex, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)w * h * sizeof(float), NULL, GL_STREAM_READ);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        rb.dim[0] = w;
+        rb.dim[1] = h;
+    }
+
+    PUSH_GPU_SECTION("Capture Hi-Z")
+
+    static GLuint vao = 0;
+    if (!vao) glGenVertexArrays(1, &vao);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, rb.fbo);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glViewport(0, 0, w, h);
+    glDisable(GL_DEPTH_TEST);
+
+    glUseProgram(program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, depth_tex);
+    glUniform1i(glGetUniformLocation(program, "u_tex_depth"), 0);
+    glUniform1i(glGetUniformLocation(program, "u_block"), HIZ_BLOCK);
+
+    glBindVertexArray(vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, rb.fbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.pbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, w, h, GL_RED, GL_FLOAT, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+    rb.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    rb.view_proj = view_proj;
+    rb.scene_key = scene_key;
+    rb.pending = true;
+
+    POP_GPU_SECTION()
+}
+
+static void build_hiz(Culler* culler, const float* src, int w, int h) {
+    auto& hiz = culler->hiz;
+
+    size_t total = 0;
+    int num_levels = 0;
+    int lw = w, lh = h;
+    while (num_levels < (int)ARRAY_SIZE(hiz.dim)) {
+        hiz.offset[num_levels] = total;
+        hiz.dim[num_levels][0] = lw;
+        hiz.dim[num_levels][1] = lh;
+        total += (size_t)lw * lh;
+        num_levels += 1;
+        if (lw == 1 && lh == 1) break;
+        lw = MAX(1, (lw + 1) / 2);
+        lh = MAX(1, (lh + 1) / 2);
+    }
+    hiz.num_levels = num_levels;
+
+    md_array_resize(hiz.data, total, culler->alloc);
+    MEMCPY(hiz.data, src, (size_t)w * h * sizeof(float));
+
+    for (int l = 1; l < num_levels; ++l) {
+        const int pw = hiz.dim[l - 1][0];
+        const int ph = hiz.dim[l - 1][1];
+        const float* prev = hiz.data + hiz.offset[l - 1];
+        float* curr = hiz.data + hiz.offset[l];
+        for (int y = 0; y < hiz.dim[l][1]; ++y) {
+            const int y0 = y * 2;
+            const int y1 = MIN(y * 2 + 1, ph - 1);
+            for (int x = 0; x < hiz.dim[l][0]; ++x) {
+                const int x0 = x * 2;
+                const int x1 = MIN(x * 2 + 1, pw - 1);
+                const float d = MAX(MAX(prev[y0 * pw + x0], prev[y0 * pw + x1]), MAX(prev[y1 * pw + x0], prev[y1 * pw + x1]));
+                curr[y * hiz.dim[l][0] + x] = d;
+            }
+        }
+    }
+}
+
+void poll_depth(Culler* culler) {
+    ASSERT(culler);
+    auto& rb = culler->readback;
+    if (!rb.pending || !culler->alloc) return;
+
+    const GLenum res = glClientWaitSync((GLsync)rb.fence, 0, 0);
+    if (res == GL_TIMEOUT_EXPIRED) return;
+
+    glDeleteSync((GLsync)rb.fence);
+    rb.fence = 0;
+    rb.pending = false;
+    if (res == GL_WAIT_FAILED) return;
+
+    const size_t bytes = (size_t)rb.dim[0] * rb.dim[1] * sizeof(float);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.pbo);
+    const float* src = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+    if (src) {
+        build_hiz(culler, src, rb.dim[0], rb.dim[1]);
+        culler->hiz.view_proj = rb.view_proj;
+        culler->hiz.scene_key = rb.scene_key;
+        culler->hiz.valid = true;
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+}  // namespace culling
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <core/md_vec_math.h>
+#include <core/md_array.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct md_allocator_i;
+struct md_bitfield_t;
+
+// Visibility culling of clusters of consecutive atoms (chunks) for the impostor representations.
+// Each chunk is tested against the view frustum and against a hierarchical max-depth buffer (Hi-Z) of a previous frame.
+// The depth buffer is reduced on the GPU to a coarse image which is read back asynchronously, the remaining levels are built on the CPU.
+// Since the Hi-Z lags behind by a frame or two, it is only used when it was captured with the same scene key as the current frame,
+// which identifies the view and the contents of the scene. Occlusion culling thus only applies while both are at rest, which keeps it conservative.
+// Chunks whose projected extent falls below the level of detail threshold keep only a subset of their atoms,
+// the number of kept atoms is proportional to the projected area of the chunk.
+
+namespace culling {
+
+enum ChunkState {
+    ChunkState_Visible,
+    ChunkState_Frustum,     // Outside of the view frustum
+    ChunkState_Occluded,    // Behind the Hi-Z
+    ChunkState_Detail,      // Reduced level of detail
+};
+
+struct Culler {
+    md_array(uint32_t) chunk_offset;    // [num_chunks + 1] first atom of each chunk
+    md_array(float)    aabb;            // [num_chunks * 6] (min xyz, max xyz)
+    md_array(uint8_t)  state;           // [num_chunks] ChunkState
+    md_array(uint32_t) keep;            // [num_chunks] number of atoms drawn of each chunk, zero if culled
+    size_t num_chunks = 0;
+
+    struct {
+        md_array(float) data;           // Levels of the pyramid stored consecutively, each texel holds the max depth of its footprint
+        size_t offset[16] = {};
+        int    dim[16][2] = {};
+        int    num_levels = 0;
+        mat4_t view_proj = {};          // Matrix of the frame the depth was captured from
+        uint64_t scene_key = 0;         // Key of the scene the depth was captured from
+        bool   valid = false;
+    } hiz;
+
+    struct {
+        uint32_t fbo = 0;
+        uint32_t tex = 0;
+        uint32_t pbo = 0;
+        void*    fence = 0;
+        int      dim[2] = {};
+        mat4_t   view_proj = {};
+        uint64_t scene_key = 0;
+        bool     pending = false;
+    } readback;
+
+    struct {
+        uint32_t chunks[4] = {};        // Number of chunks per ChunkState
+        size_t   atoms = 0;             // Number of drawn atoms
+    } stats;
+
+    md_allocator_i* alloc = 0;
+};
+
+void initialize();
+void shutdown();
+
+// Sets the chunks from the offsets of their first atom [num_chunks + 1]
+void init_chunks(Culler* culler, const uint32_t* chunk_offsets, size_t num_chunks, md_allocator_i* alloc);
+void destroy(Culler* culler);
+
+// Recomputes the bounding boxes of the chunks, the radii are scaled by radius_scale
+void update_bounds(Culler* culler, const float* x, const float* y, const float* z, const float* radius, float radius_scale);
+
+struct CullDesc {
+    mat4_t view_proj = {};
+    int viewport_width = 0;
+    int viewport_height = 0;
+
+    float padding = 0.0f;           // Added to the extent of the bounding boxes, covers geometry which extends beyond the atoms (bonds)
+    bool  occlusion = false;
+    uint64_t scene_key = 0;         // Identifies the view (excluding the sub-pixel jitter) and the contents of the scene, the Hi-Z is only used if it matches
+    float lod_pixel_size = 0.0f;    // Projected extent in pixels below which the level of detail is reduced, zero disables it
+};
+
+// Computes the state and the number of kept atoms of each chunk, returns a hash of the result
+uint64_t cull(Culler* culler, const CullDesc& desc);
+
+// Writes the atoms which are kept into the mask
+void write_atom_mask(md_bitfield_t* mask, const Culler* culler);
+
+// Reduces the depth texture and initiates an asynchronous readback of it, the depth is expected to be produced using view_proj from the scene given by scene_key
+// Modifies the framebuffer binding and the viewport
+void capture_depth(Culler* culler, uint32_t depth_tex, int width, int height, const mat4_t& view_proj, uint64_t scene_key);
+
+// Completes a pending readback if it is available without stalling and rebuilds the Hi-Z from it
+void poll_depth(Culler* culler);
+
+}  // namespace culling
@@ -0,0 +1,282 @@
+#include <gfx/ensemble_utils.h>
+
+#include <gfx/gl.h>
+#include <gfx/gl_utils.h>
+#include <gfx/profiler.h>
+
+#include <core/md_common.h>
+#include <core/md_str.h>
+#include <core/md_allocator.h>
+#include <core/md_log.h>
+
+static constexpr str_t v_shader_src = STR_LIT(
+R"(
+#version 330 core
+
+uniform usamplerBuffer u_buf_atom_idx;
+uniform samplerBuffer  u_buf_matrix;
+uniform samplerBuffer  u_buf_position;
+uniform samplerBuffer  u_buf_radius;
+uniform samplerBuffer  u_buf_color;
+
+uniform mat4  u_view_mat;
+uniform mat4  u_proj_mat;
+uniform int   u_stride;
+uniform int   u_instance_offset;
+uniform float u_radius_scale;
+uniform float u_viewport_height;
+
+out vec3 view_center;
+flat out float radius;
+flat out vec4  color;
+flat out uint  atom_idx;
+
+void main() {
+    int  inst = gl_InstanceID + u_instance_offset;
+    uint idx  = texelFetch(u_buf_atom_idx, inst * u_stride + gl_VertexID).r;
+
+    // Padding, place the point outside of the clip volume
+    if (idx == 0xFFFFFFFFU) {
+        gl_Position = vec4(2, 2, 2, 1);
+        gl_PointSize = 1.0;
+        return;
+    }
+
+    mat4 model_mat = mat4(
+        texelFetch(u_buf_matrix, inst * 4 + 0),
+        texelFetch(u_buf_matrix, inst * 4 + 1),
+        texelFetch(u_buf_matrix, inst * 4 + 2),
+        texelFetch(u_buf_matrix, inst * 4 + 3));
+
+    vec3 pos  = texelFetch(u_buf_position, int(idx)).xyz;
+    vec4 view = u_view_mat * model_mat * vec4(pos, 1.0);
+
+    view_center = view.xyz;
+    radius   = texelFetch(u_buf_radius, int(idx)).r * u_radius_scale;
+    color    = texelFetch(u_buf_color,  int(idx));
+    atom_idx = idx;
+
+    gl_Position = u_proj_mat * view;
+    // Conservative projected diameter in pixels, the exact silhouette is determined by the ray-sphere intersection
+    gl_PointSize = 2.5 * radius * u_proj_mat[1][1] * 0.5 * u_viewport_height / max(gl_Position.w, 1.0e-3);
+}
+)");
+
+static constexpr str_t f_shader_src = STR_LIT(
+R"(
+#version 330 core
+
+uniform mat4 u_proj_mat;
+uniform mat4 u_inv_proj_mat;
+uniform vec2 u_viewport_offset;
+uniform vec2 u_inv_viewport_size;
+
+in vec3 view_center;
+flat in float radius;
+flat in vec4  color;
+flat in uint  atom_idx;
+
+layout(location = 0) out vec4 out_color;
+layout(location = 1) out vec4 out_normal;
+layout(location = 2) out vec4 out_velocity;
+layout(location = 3) out vec4 out_picking;
+
+vec4 encode_normal (vec3 n) {
+    float p = sqrt(n.z*8+8);
+    return vec4(n.xy/p + 0.5,0,0);
+}
+
+vec4 encode_index(uint idx) {
+    return vec4(
+        float((idx >>  0U) & 0xFFU) / 255.0,
+        float((idx >>  8U) & 0xFFU) / 255.0,
+        float((idx >> 16U) & 0xFFU) / 255.0,
+        float((idx >> 24U) & 0xFFU) / 255.0);
+}
+
+void main() {
+    if (color.a == 0.0) discard;
+
+    // Ray through the fragment in view space, this holds for both perspective and orthographic projections
+    vec2 ndc = (gl_FragCoord.xy - u_viewport_offset) * u_inv_viewport_size * 2.0 - 1.0;
+    vec4 p0 = u_inv_proj_mat * vec4(ndc, -1.0, 1.0);
+    vec4 p1 = u_inv_proj_mat * vec4(ndc,  1.0, 1.0);
+    vec3 ro = p0.xyz / p0.w;
+    vec3 rd = normalize(p1.xyz / p1.w - ro);
+
+    vec3  oc = ro - view_center;
+    float b  = dot(oc, rd);
+    float c  = dot(oc, oc) - radius * radius;
+    float h  = b * b - c;
+    if (h < 0.0) discard;
+
+    vec3 hit = ro + rd * (-b - sqrt(h));
+    vec3 normal = (hit - view_center) / radius;
+
+    vec4 clip = u_proj_mat * vec4(hit, 1.0);
+    gl_FragDepth = (clip.z / clip.w) * 0.5 + 0.5;
+
+    out_color    = vec4(color.rgb, 1.0);
+    out_normal   = encode_normal(normal);
+    out_velocity = vec4(0);
+    out_picking  = encode_index(atom_idx);
+}
+)");
+
+namespace ensemble {
+
+static GLuint program = 0;
+
+void initialize() {
+    GLuint v_shader = gl::compile_shader_from_source(v_shader_src, GL_VERTEX_SHADER);
+    GLuint f_shader = gl::compile_shader_from_source(f_shader_src, GL_FRAGMENT_SHADER);
+    defer {
+        glDeleteShader(v_shader);
+        glDeleteShader(f_shader);
+    };
+
+    if (v_shader == 0 || f_shader == 0) {
+        MD_LOG_ERROR("shader compilation failed, shader program for ensembles will not be updated");
+        return;
+    }
+
+    if (!program) program = glCreateProgram();
+    const GLuint shaders[] = {v_shader, f_shader};
+    gl::attach_link_detach(program, shaders, (int)ARRAY_SIZE(shaders));
+}
+
+void shutdown() {
+    if (program) {
+        glDeleteProgram(program);
+        program = 0;
+    }
+}
+
+static void set_buffer_data(uint32_t* buf, uint32_t* tex, GLenum format, const void* data, size_t bytes) {
+    if (!*buf) glGenBuffers(1, buf);
+    if (!*tex) glGenTextures(1, tex);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, *buf);
+    glBufferData(GL_TEXTURE_BUFFER, bytes, data, GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glBindTexture(GL_TEXTURE_BUFFER, *tex);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, *buf);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void destroy(Ensemble* ens) {
+    ASSERT(ens);
+    uint32_t* bufs[] = {&ens->atom_idx.buf, &ens->matrix.buf, &ens->position.buf, &ens->radius.buf, &ens->color.buf};
+    uint32_t* texs[] = {&ens->atom_idx.tex, &ens->matrix.tex, &ens->position.tex, &ens->radius.tex, &ens->color.tex};
+    for (size_t i = 0; i < ARRAY_SIZE(bufs); ++i) {
+        if (*bufs[i]) glDeleteBuffers(1, bufs[i]);
+        if (*texs[i]) glDeleteTextures(1, texs[i]);
+        *bufs[i] = 0;
+        *texs[i] = 0;
+    }
+    ens->num_instances = 0;
+    ens->stride = 0;
+    ens->num_atoms = 0;
+}
+
+void set_instances(Ensemble* ens, const uint32_t* atom_indices, uint32_t stride, const mat4_t* matrices, uint32_t num_instances) {
+    ASSERT(ens);
+    ens->num_instances = num_instances;
+    ens->stride = stride;
+    if (num_instances == 0 || stride == 0) return;
+
+    ASSERT(atom_indices);
+    ASSERT(matrices);
+    set_buffer_data(&ens->atom_idx.buf, &ens->atom_idx.tex, GL_R32UI, atom_indices, (size_t)num_instances * stride * sizeof(uint32_t));
+    set_buffer_data(&ens->matrix.buf, &ens->matrix.tex, GL_RGBA32F, matrices, (size_t)num_instances * sizeof(mat4_t));
+}
+
+void set_atom_positions(Ensemble* ens, const float* x, const float* y, const float* z, size_t num_atoms) {
+    ASSERT(ens);
+    if (num_atoms == 0) return;
+
+    md_allocator_i* alloc = md_get_heap_allocator();
+    const size_t bytes = num_atoms * sizeof(float) * 3;
+    float* xyz = (float*)md_alloc(alloc, bytes);
+    defer { md_free(alloc, xyz, bytes); };
+
+    for (size_t i = 0; i < num_atoms; ++i) {
+        xyz[i * 3 + 0] = x[i];
+        xyz[i * 3 + 1] = y[i];
+        xyz[i * 3 + 2] = z[i];
+    }
+
+    set_buffer_data(&ens->position.buf, &ens->position.tex, GL_RGB32F, xyz, bytes);
+    ens->num_atoms = (uint32_t)num_atoms;
+}
+
+void set_atom_radii(Ensemble* ens, const float* radius, size_t num_atoms) {
+    ASSERT(ens);
+    if (num_atoms == 0) return;
+    set_buffer_data(&ens->radius.buf, &ens->radius.tex, GL_R32F, radius, num_atoms * sizeof(float));
+}
+
+void set_atom_colors(Ensemble* ens, const uint32_t* colors, size_t num_atoms) {
+    ASSERT(ens);
+    if (num_atoms == 0) return;
+    set_buffer_data(&ens->color.buf, &ens->color.tex, GL_RGBA8, colors, num_atoms * sizeof(uint32_t));
+}
+
+void draw(const DrawDesc& desc) {
+    const Ensemble* ens = desc.ensemble;
+    if (!ens || !program) return;
+    if (!ens->atom_idx.tex || !ens->matrix.tex || !ens->position.tex || !ens->radius.tex || !ens->color.tex) return;
+
+    const uint32_t beg = MIN(desc.instance_beg, ens->num_instances);
+    const uint32_t end = MIN(desc.instance_end, ens->num_instances);
+    if (beg >= end || ens->stride == 0) return;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    const mat4_t inv_proj_mat = mat4_inverse(desc.proj_mat);
+
+    PUSH_GPU_SECTION("Draw Ensemble")
+
+    // The vertex array is empty, all attributes are fetched from the texture buffers
+    static GLuint vao = 0;
+    if (!vao) glGenVertexArrays(1, &vao);
+
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    glUseProgram(program);
+
+    const GLuint textures[] = {ens->atom_idx.tex, ens->matrix.tex, ens->position.tex, ens->radius.tex, ens->color.tex};
+    const char*  samplers[] = {"u_buf_atom_idx", "u_buf_matrix", "u_buf_position", "u_buf_radius", "u_buf_color"};
+    for (int i = 0; i < (int)ARRAY_SIZE(textures); ++i) {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        glUniform1i(glGetUniformLocation(program, samplers[i]), i);
+    }
+
+    glUniformMatrix4fv(glGetUniformLocation(program, "u_view_mat"), 1, GL_FALSE, &desc.view_mat.elem[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(program, "u_proj_mat"), 1, GL_FALSE, &desc.proj_mat.elem[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(program, "u_inv_proj_mat"), 1, GL_FALSE, &inv_proj_mat.elem[0][0]);
+    glUniform1i(glGetUniformLocation(program, "u_stride"), (GLint)ens->stride);
+    glUniform1i(glGetUniformLocation(program, "u_instance_offset"), (GLint)beg);
+    glUniform1f(glGetUniformLocation(program, "u_radius_scale"), desc.radius_scale);
+    glUniform1f(glGetUniformLocation(program, "u_viewport_height"), (float)viewport[3]);
+    glUniform2f(glGetUniformLocation(program, "u_viewport_offset"), (float)viewport[0], (float)viewport[1]);
+    glUniform2f(glGetUniformLocation(program, "u_inv_viewport_size"), 1.0f / (float)viewport[2], 1.0f / (float)viewport[3]);
+
+    glBindVertexArray(vao);
+    glDrawArraysInstanced(GL_POINTS, 0, (GLsizei)ens->stride, (GLsizei)(end - beg));
+    glBindVertexArray(0);
+
+    for (int i = 0; i < (int)ARRAY_SIZE(textures); ++i) {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    glUseProgram(0);
+    glDisable(GL_PROGRAM_POINT_SIZE);
+
+    POP_GPU_SECTION()
+}
+
+}  // namespace ensemble
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <core/md_vec_math.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Instanced rendering of superimposed structures (e.g. the reference ensemble of SDF densities)
+// Each instance is a subset of the atoms of the molecule, which is transformed by an individual matrix.
+// All instances share the atom positions, radii and colors, which means that the cost of an additional instance
+// is proportional to the number of atoms within it, rather than to the number of atoms in the molecule.
+// The atoms are drawn as ray-cast sphere impostors into the G-buffer (color, normal, velocity and picking).
+
+namespace ensemble {
+
+struct Ensemble {
+    struct {
+        uint32_t buf = 0;
+        uint32_t tex = 0;
+    } atom_idx, matrix, position, radius, color;
+
+    uint32_t num_instances = 0;
+    uint32_t stride = 0;        // Number of atom indices per instance (the largest instance), shorter instances are padded with UINT32_MAX
+    uint32_t num_atoms = 0;
+};
+
+void initialize();
+void shutdown();
+
+void destroy(Ensemble* ens);
+
+// Sets the instances from a table of atom indices [num_instances * stride] and their matrices [num_instances]
+void set_instances(Ensemble* ens, const uint32_t* atom_indices, uint32_t stride, const mat4_t* matrices, uint32_t num_instances);
+
+// Sets the shared per atom data
+void set_atom_positions(Ensemble* ens, const float* x, const float* y, const float* z, size_t num_atoms);
+void set_atom_radii(Ensemble* ens, const float* radius, size_t num_atoms);
+void set_atom_colors(Ensemble* ens, const uint32_t* colors, size_t num_atoms);
+
+struct DrawDesc {
+    const Ensemble* ensemble = NULL;
+    uint32_t instance_beg = 0;
+    uint32_t instance_end = UINT32_MAX;
+    float radius_scale = 1.0f;
+
+    mat4_t view_mat = {};
+    mat4_t proj_mat = {};
+};
+
+// Draws the instances [instance_beg, instance_end) into the currently bound framebuffer
+// The draw buffers are expected to be set to (color, normal, velocity, picking)
+void draw(const DrawDesc& desc);
+
+}  // namespace ensemble
@@ -316,6 +316,10 @@ static inline void get_pixel_channel_type(GLenum& channel, GLenum& type, GLenum
         channel = GL_RED;
         type = GL_FLOAT;
         break;
+    case GL_R16F:
+        channel = GL_RED;
+        type = GL_HALF_FLOAT;
+        break;
     default:
         channel = 0;
         type = 0;
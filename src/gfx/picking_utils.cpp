@@ -0,0 +1,154 @@
+#include <gfx/picking_utils.h>
+
+#include <gfx/gl.h>
+#include <gfx/postprocessing_utils.h>
+#include <gfx/profiler.h>
+
+#include <core/md_common.h>
+#include <core/md_allocator.h>
+#include <core/md_bitfield.h>
+
+#include <new>
+
+namespace picking {
+
+static inline uint32_t decode_idx(const uint8_t bgra[4]) {
+    return (bgra[0] << 16) | (bgra[1] << 8) | (bgra[2] << 0) | ((uint32_t)bgra[3] << 24);
+}
+
+static void decode_region(void* user_data) {
+    RegionQuery* query = (RegionQuery*)user_data;
+    const size_t num_pixels = (size_t)query->width * query->height;
+
+    // Neighbouring pixels mostly belong to the same atom or bond, which is only decoded once
+    uint32_t prev = INVALID_PICKING_IDX;
+    for (size_t i = 0; i < num_pixels; ++i) {
+        const uint32_t idx = decode_idx(query->pixels + i * 4);
+        if (idx == prev) continue;
+        prev = idx;
+        if (idx == INVALID_PICKING_IDX) continue;
+
+        // The index space is segmented into two parts, the first half is for atoms and the second half is for bonds
+        if (idx < 0x80000000) {
+            if (idx < query->num_atoms) {
+                md_bitfield_set_bit(&query->atom_mask, idx);
+            }
+        } else {
+            const uint32_t bond_idx = idx & 0x7FFFFFFF;
+            if (bond_idx < query->num_bonds) {
+                md_bitfield_set_bit(&query->atom_mask, query->bond_pairs[bond_idx].idx[0]);
+                md_bitfield_set_bit(&query->atom_mask, query->bond_pairs[bond_idx].idx[1]);
+            }
+        }
+    }
+}
+
+RegionQuery* query_region(const GBuffer* gbuf, int x, int y, int width, int height, size_t num_atoms, const md_bond_pair_t* bond_pairs, size_t num_bonds, md_allocator_i* alloc) {
+    ASSERT(gbuf);
+    ASSERT(alloc);
+
+    const int x0 = CLAMP(x, 0, (int)gbuf->width);
+    const int y0 = CLAMP(y, 0, (int)gbuf->height);
+    const int x1 = CLAMP(x + width,  0, (int)gbuf->width);
+    const int y1 = CLAMP(y + height, 0, (int)gbuf->height);
+
+    RegionQuery* query = (RegionQuery*)md_alloc(alloc, sizeof(RegionQuery));
+    new (query) RegionQuery();
+    query->x = x0;
+    query->y = y0;
+    query->width  = x1 - x0;
+    query->height = y1 - y0;
+    query->num_atoms  = num_atoms;
+    query->num_bonds  = bond_pairs ? num_bonds : 0;
+    query->bond_pairs = bond_pairs;
+    query->alloc = alloc;
+    md_bitfield_init(&query->atom_mask, alloc);
+    query->submit_time = md_time_current();
+
+    if (query->width == 0 || query->height == 0) {
+        query->state = RegionState_Complete;
+        return query;
+    }
+
+    PUSH_GPU_SECTION("Read Picking Region")
+    glGenBuffers(1, &query->pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, query->pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)query->width * query->height * 4, NULL, GL_STREAM_READ);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, gbuf->fbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT_PICKING);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(query->x, query->y, query->width, query->height, GL_BGRA, GL_UNSIGNED_BYTE, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    query->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    POP_GPU_SECTION()
+
+    return query;
+}
+
+bool poll_region(RegionQuery* query) {
+    ASSERT(query);
+
+    if (query->state == RegionState_Readback) {
+        query->latency_frames += 1;
+        const GLenum res = glClientWaitSync((GLsync)query->fence, 0, 0);
+        if (res == GL_TIMEOUT_EXPIRED) {
+            return false;
+        }
+        glDeleteSync((GLsync)query->fence);
+        query->fence = 0;
+
+        if (res != GL_WAIT_FAILED) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, query->pbo);
+            query->pixels = (const uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (size_t)query->width * query->height * 4, GL_MAP_READ_BIT);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+        if (!query->pixels) {
+            query->state = RegionState_Complete;
+        } else {
+            // The mapped pointer is only read by the task, the buffer is unmapped on this thread once it is done
+            query->task = task_system::create_pool_task(STR_LIT("##Decode Picking Region"), decode_region, query);
+            task_system::enqueue_task(query->task);
+            query->state = RegionState_Decoding;
+        }
+    }
+
+    if (query->state == RegionState_Decoding) {
+        if (task_system::task_is_running(query->task)) {
+            query->latency_frames += 1;
+            return false;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, query->pbo);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        query->pixels = 0;
+        query->task = 0;
+        query->state = RegionState_Complete;
+    }
+
+    if (query->latency_ms == 0) {
+        query->latency_ms = md_time_as_seconds(md_time_current() - query->submit_time) * 1000.0;
+    }
+    return true;
+}
+
+void free_region(RegionQuery* query) {
+    ASSERT(query);
+    if (query->task) {
+        task_system::task_wait_for(query->task);
+    }
+    if (query->pixels) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, query->pbo);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    if (query->fence) glDeleteSync((GLsync)query->fence);
+    if (query->pbo) glDeleteBuffers(1, &query->pbo);
+    md_bitfield_free(&query->atom_mask);
+
+    md_allocator_i* alloc = query->alloc;
+    query->~RegionQuery();
+    md_free(alloc, query, sizeof(RegionQuery));
+}
+
+}  // namespace picking
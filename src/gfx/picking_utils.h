@@ -0,0 +1,58 @@
+#pragma once
+
+#include <core/md_bitfield.h>
+#include <core/md_os.h>
+#include <md_molecule.h>
+#include <task_system.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct md_allocator_i;
+struct GBuffer;
+
+// Asynchronous readback of the picking ids within a region of the G-buffer.
+// The ids are copied into a pixel buffer object and fenced, once the copy has completed the buffer is mapped and decoded on the task pool.
+// Nothing waits for the GPU, the query is polled once per frame until it completes.
+
+namespace picking {
+
+enum RegionState {
+    RegionState_Readback,   // Waiting for the copy of the ids into the pixel buffer object
+    RegionState_Decoding,   // Decoding the mapped ids on the task pool
+    RegionState_Complete,
+};
+
+struct RegionQuery {
+    int x, y, width, height;    // Region in framebuffer coordinates, origin at the bottom left
+
+    uint32_t pbo = 0;
+    void* fence = 0;
+    const uint8_t* pixels = 0;  // Mapped contents of the pixel buffer object (BGRA) while decoding
+
+    size_t num_atoms = 0;
+    size_t num_bonds = 0;
+    const md_bond_pair_t* bond_pairs = 0;
+
+    md_bitfield_t atom_mask = {};   // Picked atoms, bonds contribute both of their atoms
+
+    RegionState state = RegionState_Readback;
+    task_system::ID task = 0;
+
+    md_timestamp_t submit_time = 0;
+    uint32_t latency_frames = 0;    // Number of polls until the result was available
+    double   latency_ms = 0;        // Time from the submission until the result was available
+
+    md_allocator_i* alloc = 0;
+};
+
+// Initiates the readback of the picking ids within the region, the region is clamped to the G-buffer
+// The bond pairs have to remain valid until the query is complete or freed
+RegionQuery* query_region(const GBuffer* gbuf, int x, int y, int width, int height, size_t num_atoms, const md_bond_pair_t* bond_pairs, size_t num_bonds, md_allocator_i* alloc);
+
+// Advances the query without stalling, returns true once the atom mask is available
+bool poll_region(RegionQuery* query);
+
+void free_region(RegionQuery* query);
+
+}  // namespace picking
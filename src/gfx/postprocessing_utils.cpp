@@ -32,6 +32,7 @@
 #include <core/md_hash.h>
 
 #include <gfx/gl_utils.h>
+#include <gfx/profiler.h>
 
 #include <stdio.h>
 #include <string.h>
@@ -39,18 +40,8 @@
 
 #include <shaders.inl>
 
-#define PUSH_GPU_SECTION(lbl)                                                                       \
-    {                                                                                               \
-        if (glPushDebugGroup) glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, GL_KHR_debug, -1, lbl); \
-    }
-#define POP_GPU_SECTION()                       \
-    {                                           \
-        if (glPopDebugGroup) glPopDebugGroup(); \
-    }
-
 namespace postprocessing {
 
-// @TODO: Use half-res render targets for SSAO
 // @TODO: Use shared textures for all postprocessing operations
 // @TODO: Use some kind of unified pipeline for all post processing operations
 
@@ -95,10 +86,14 @@ static struct {
         GLuint ubo_hbao_data = 0;
         GLuint fbo = 0;
         GLuint tex[2] = {};
+        int    tex_width = 0;
+        int    tex_height = 0;
 
         struct {
             GLuint program_persp = 0;
             GLuint program_ortho = 0;
+            GLuint program_persp_half = 0;  // Evaluated at half resolution of the linear depth
+            GLuint program_ortho_half = 0;
         } hbao;
 
         struct {
@@ -389,19 +384,9 @@ void initialize_rnd_tex(GLuint rnd_tex) {
 
 float compute_sharpness(float radius) { return 20.f / sqrtf(radius); }
 
-void initialize(int width, int height) {
-    gl.ssao.hbao.program_persp = setup_program_from_source(STR_LIT("ssao persp"), {(const char*)ssao_frag, ssao_frag_size}, STR_LIT("#define AO_PERSPECTIVE 1"));
-    gl.ssao.hbao.program_ortho = setup_program_from_source(STR_LIT("ssao ortho"), {(const char*)ssao_frag, ssao_frag_size}, STR_LIT("#define AO_PERSPECTIVE 0"));
-    gl.ssao.blur.program       = setup_program_from_source(STR_LIT("ssao blur"),  {(const char*)blur_frag, blur_frag_size});
-    
-    if (!gl.ssao.fbo) glGenFramebuffers(1, &gl.ssao.fbo);
-
-    if (!gl.ssao.tex_random) glGenTextures(1, &gl.ssao.tex_random);
-    if (!gl.ssao.tex[0])     glGenTextures(2, gl.ssao.tex);
-
-    if (!gl.ssao.ubo_hbao_data) glGenBuffers(1, &gl.ssao.ubo_hbao_data);
-
-    initialize_rnd_tex(gl.ssao.tex_random);
+void init_textures(int width, int height) {
+    if (!gl.ssao.fbo)    glGenFramebuffers(1, &gl.ssao.fbo);
+    if (!gl.ssao.tex[0]) glGenTextures(2, gl.ssao.tex);
 
     glBindTexture(GL_TEXTURE_2D, gl.ssao.tex[0]);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
@@ -424,6 +409,23 @@ void initialize(int width, int height) {
     glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gl.ssao.tex[1], 0);
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 
+    gl.ssao.tex_width  = width;
+    gl.ssao.tex_height = height;
+}
+
+void initialize(int width, int height) {
+    gl.ssao.hbao.program_persp = setup_program_from_source(STR_LIT("ssao persp"), {(const char*)ssao_frag, ssao_frag_size}, STR_LIT("#define AO_PERSPECTIVE 1"));
+    gl.ssao.hbao.program_ortho = setup_program_from_source(STR_LIT("ssao ortho"), {(const char*)ssao_frag, ssao_frag_size}, STR_LIT("#define AO_PERSPECTIVE 0"));
+    gl.ssao.hbao.program_persp_half = setup_program_from_source(STR_LIT("ssao persp half"), {(const char*)ssao_frag, ssao_frag_size}, STR_LIT("#define AO_PERSPECTIVE 1\n#define AO_HALF_RES 1"));
+    gl.ssao.hbao.program_ortho_half = setup_program_from_source(STR_LIT("ssao ortho half"), {(const char*)ssao_frag, ssao_frag_size}, STR_LIT("#define AO_PERSPECTIVE 0\n#define AO_HALF_RES 1"));
+    gl.ssao.blur.program       = setup_program_from_source(STR_LIT("ssao blur"),  {(const char*)blur_frag, blur_frag_size});
+
+    if (!gl.ssao.tex_random) glGenTextures(1, &gl.ssao.tex_random);
+    if (!gl.ssao.ubo_hbao_data) glGenBuffers(1, &gl.ssao.ubo_hbao_data);
+
+    initialize_rnd_tex(gl.ssao.tex_random);
+    init_textures(width, height);
+
     glBindBuffer(GL_UNIFORM_BUFFER, gl.ssao.ubo_hbao_data);
     glBufferData(GL_UNIFORM_BUFFER, sizeof(HBAOData), nullptr, GL_DYNAMIC_DRAW);
 }
@@ -435,6 +437,8 @@ void shutdown() {
     if (gl.ssao.ubo_hbao_data) glDeleteBuffers(1, &gl.ssao.ubo_hbao_data);
     if (gl.ssao.hbao.program_persp) glDeleteProgram(gl.ssao.hbao.program_persp);
     if (gl.ssao.hbao.program_ortho) glDeleteProgram(gl.ssao.hbao.program_ortho);
+    if (gl.ssao.hbao.program_persp_half) glDeleteProgram(gl.ssao.hbao.program_persp_half);
+    if (gl.ssao.hbao.program_ortho_half) glDeleteProgram(gl.ssao.hbao.program_ortho_half);
     if (gl.ssao.blur.program) glDeleteProgram(gl.ssao.blur.program);
 }
 
@@ -646,17 +650,7 @@ void shutdown() {
 }  // namespace tonemapping
 
 namespace dof {
-void initialize(int32_t width, int32_t height) {
-    {
-        gl.bokeh_dof.half_res.program = setup_program_from_source(STR_LIT("DOF prepass"), {(const char*)dof_half_res_prepass_frag, dof_half_res_prepass_frag_size});
-        if (gl.bokeh_dof.half_res.program) {
-            gl.bokeh_dof.half_res.uniform_loc.tex_depth   = glGetUniformLocation(gl.bokeh_dof.half_res.program, "u_tex_depth");
-            gl.bokeh_dof.half_res.uniform_loc.tex_color   = glGetUniformLocation(gl.bokeh_dof.half_res.program, "u_tex_color");
-            gl.bokeh_dof.half_res.uniform_loc.focus_point = glGetUniformLocation(gl.bokeh_dof.half_res.program, "u_focus_point");
-            gl.bokeh_dof.half_res.uniform_loc.focus_scale = glGetUniformLocation(gl.bokeh_dof.half_res.program, "u_focus_scale");
-        }
-    }
-
+void init_textures(int32_t width, int32_t height) {
     if (!gl.bokeh_dof.half_res.tex.color_coc) {
         glGenTextures(1, &gl.bokeh_dof.half_res.tex.color_coc);
     }
@@ -678,6 +672,20 @@ void initialize(int32_t width, int32_t height) {
         }
         glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
     }
+}
+
+void initialize(int32_t width, int32_t height) {
+    {
+        gl.bokeh_dof.half_res.program = setup_program_from_source(STR_LIT("DOF prepass"), {(const char*)dof_half_res_prepass_frag, dof_half_res_prepass_frag_size});
+        if (gl.bokeh_dof.half_res.program) {
+            gl.bokeh_dof.half_res.uniform_loc.tex_depth   = glGetUniformLocation(gl.bokeh_dof.half_res.program, "u_tex_depth");
+            gl.bokeh_dof.half_res.uniform_loc.tex_color   = glGetUniformLocation(gl.bokeh_dof.half_res.program, "u_tex_color");
+            gl.bokeh_dof.half_res.uniform_loc.focus_point = glGetUniformLocation(gl.bokeh_dof.half_res.program, "u_focus_point");
+            gl.bokeh_dof.half_res.uniform_loc.focus_scale = glGetUniformLocation(gl.bokeh_dof.half_res.program, "u_focus_scale");
+        }
+    }
+
+    init_textures(width, height);
 
     // DOF
     {
@@ -700,9 +708,16 @@ void shutdown() {}
 namespace blit {
 static GLuint program_tex = 0;
 static GLuint program_col = 0;
+static GLuint program_upsample = 0;
 static GLint uniform_loc_texture = -1;
 static GLint uniform_loc_color = -1;
 
+static struct {
+    GLint texture  = -1;
+    GLint tex_size = -1;
+    GLint tc_scl   = -1;
+} uniform_loc_upsample;
+
 constexpr str_t f_shader_src_tex = STR_LIT(R"(
 #version 150 core
 
@@ -726,17 +741,67 @@ void main() {
 }
 )");
 
+// Catmull-Rom filter evaluated with 9 bilinear taps instead of 16 point samples
+constexpr str_t f_shader_src_upsample = STR_LIT(R"(
+#version 150 core
+
+uniform sampler2D u_texture;
+uniform vec2      u_tex_size;
+
+in vec2 tc;
+out vec4 out_frag;
+
+void main() {
+    vec2 inv_size = 1.0 / u_tex_size;
+    vec2 pos = tc * u_tex_size;
+    vec2 center = floor(pos - 0.5) + 0.5;
+    vec2 f = pos - center;
+
+    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    vec2 w3 = f * f * (-0.5 + 0.5 * f);
+
+    vec2 w12 = w1 + w2;
+    vec2 tc0  = (center - 1.0) * inv_size;
+    vec2 tc12 = (center + w2 / w12) * inv_size;
+    vec2 tc3  = (center + 2.0) * inv_size;
+
+    vec4 result = vec4(0);
+    result += textureLod(u_texture, vec2(tc0.x,  tc0.y),  0) * w0.x  * w0.y;
+    result += textureLod(u_texture, vec2(tc12.x, tc0.y),  0) * w12.x * w0.y;
+    result += textureLod(u_texture, vec2(tc3.x,  tc0.y),  0) * w3.x  * w0.y;
+
+    result += textureLod(u_texture, vec2(tc0.x,  tc12.y), 0) * w0.x  * w12.y;
+    result += textureLod(u_texture, vec2(tc12.x, tc12.y), 0) * w12.x * w12.y;
+    result += textureLod(u_texture, vec2(tc3.x,  tc12.y), 0) * w3.x  * w12.y;
+
+    result += textureLod(u_texture, vec2(tc0.x,  tc3.y),  0) * w0.x  * w3.y;
+    result += textureLod(u_texture, vec2(tc12.x, tc3.y),  0) * w12.x * w3.y;
+    result += textureLod(u_texture, vec2(tc3.x,  tc3.y),  0) * w3.x  * w3.y;
+
+    // The negative lobes may overshoot
+    out_frag = max(result, vec4(0));
+}
+)");
+
 void initialize() {
     program_tex = setup_program_from_source(STR_LIT("blit texture"), f_shader_src_tex);
     uniform_loc_texture = glGetUniformLocation(program_tex, "u_texture");
 
     program_col = setup_program_from_source(STR_LIT("blit color"), f_shader_src_col);
     uniform_loc_color = glGetUniformLocation(program_col, "u_color");
+
+    program_upsample = setup_program_from_source(STR_LIT("blit upsample"), f_shader_src_upsample);
+    uniform_loc_upsample.texture  = glGetUniformLocation(program_upsample, "u_texture");
+    uniform_loc_upsample.tex_size = glGetUniformLocation(program_upsample, "u_tex_size");
+    uniform_loc_upsample.tc_scl   = glGetUniformLocation(program_upsample, "u_tc_scl");
 }
 
 void shutdown() {
     if (program_tex) glDeleteProgram(program_tex);
     if (program_col) glDeleteProgram(program_col);
+    if (program_upsample) glDeleteProgram(program_upsample);
 }
 }  // namespace blit
 
@@ -850,26 +915,7 @@ struct {
     } uniform_loc;
 } blit_neighbormax;
 
-void initialize(int32_t width, int32_t height) {
-    {
-        blit_velocity.program = setup_program_from_source(STR_LIT("screen-space velocity"), {(const char*)blit_velocity_frag, blit_velocity_frag_size});
-		blit_velocity.uniform_loc.tex_depth = glGetUniformLocation(blit_velocity.program, "u_tex_depth");
-        blit_velocity.uniform_loc.curr_clip_to_prev_clip_mat = glGetUniformLocation(blit_velocity.program, "u_curr_clip_to_prev_clip_mat");
-        blit_velocity.uniform_loc.jitter_uv = glGetUniformLocation(blit_velocity.program, "u_jitter_uv");
-
-    }
-    {
-        str_t defines = STR_LIT("#define TILE_SIZE " STRINGIFY_VAL(VEL_TILE_SIZE));
-        blit_tilemax.program = setup_program_from_source(STR_LIT("tilemax"), {(const char*)blit_tilemax_frag, blit_tilemax_frag_size}, defines);
-        blit_tilemax.uniform_loc.tex_vel = glGetUniformLocation(blit_tilemax.program, "u_tex_vel");
-        blit_tilemax.uniform_loc.tex_vel_texel_size = glGetUniformLocation(blit_tilemax.program, "u_tex_vel_texel_size");
-    }
-    {
-        blit_neighbormax.program = setup_program_from_source(STR_LIT("neighbormax"), {(const char*)blit_neighbormax_frag, blit_neighbormax_frag_size});
-        blit_neighbormax.uniform_loc.tex_vel = glGetUniformLocation(blit_neighbormax.program, "u_tex_vel");
-        blit_neighbormax.uniform_loc.tex_vel_texel_size = glGetUniformLocation(blit_neighbormax.program, "u_tex_vel_texel_size");
-    }
-
+void init_textures(int32_t width, int32_t height) {
     if (!gl.velocity.tex_tilemax) {
         glGenTextures(1, &gl.velocity.tex_tilemax);
     }
@@ -910,6 +956,29 @@ void initialize(int32_t width, int32_t height) {
     }
 }
 
+void initialize(int32_t width, int32_t height) {
+    {
+        blit_velocity.program = setup_program_from_source(STR_LIT("screen-space velocity"), {(const char*)blit_velocity_frag, blit_velocity_frag_size});
+		blit_velocity.uniform_loc.tex_depth = glGetUniformLocation(blit_velocity.program, "u_tex_depth");
+        blit_velocity.uniform_loc.curr_clip_to_prev_clip_mat = glGetUniformLocation(blit_velocity.program, "u_curr_clip_to_prev_clip_mat");
+        blit_velocity.uniform_loc.jitter_uv = glGetUniformLocation(blit_velocity.program, "u_jitter_uv");
+
+    }
+    {
+        str_t defines = STR_LIT("#define TILE_SIZE " STRINGIFY_VAL(VEL_TILE_SIZE));
+        blit_tilemax.program = setup_program_from_source(STR_LIT("tilemax"), {(const char*)blit_tilemax_frag, blit_tilemax_frag_size}, defines);
+        blit_tilemax.uniform_loc.tex_vel = glGetUniformLocation(blit_tilemax.program, "u_tex_vel");
+        blit_tilemax.uniform_loc.tex_vel_texel_size = glGetUniformLocation(blit_tilemax.program, "u_tex_vel_texel_size");
+    }
+    {
+        blit_neighbormax.program = setup_program_from_source(STR_LIT("neighbormax"), {(const char*)blit_neighbormax_frag, blit_neighbormax_frag_size});
+        blit_neighbormax.uniform_loc.tex_vel = glGetUniformLocation(blit_neighbormax.program, "u_tex_vel");
+        blit_neighbormax.uniform_loc.tex_vel_texel_size = glGetUniformLocation(blit_neighbormax.program, "u_tex_vel_texel_size");
+    }
+
+    init_textures(width, height);
+}
+
 void shutdown() {
     if (blit_velocity.program) glDeleteProgram(blit_velocity.program);
     if (gl.velocity.tex_tilemax) glDeleteTextures(1, &gl.velocity.tex_tilemax);
@@ -996,16 +1065,8 @@ void shutdown() {
 }
 }
 
-void initialize(int width, int height) {
-    if (!gl.vao) glGenVertexArrays(1, &gl.vao);
-
-    gl.v_shader_fs_quad = gl::compile_shader_from_source(v_shader_src_fs_quad, GL_VERTEX_SHADER);
-
-    // LINEARIZE DEPTH
-
-    gl.linear_depth.program_persp = setup_program_from_source(STR_LIT("linearize depth persp"), f_shader_src_linearize_depth, STR_LIT("#version 150 core\n#define PERSPECTIVE 1"));
-    gl.linear_depth.program_ortho = setup_program_from_source(STR_LIT("linearize depth ortho"), f_shader_src_linearize_depth, STR_LIT("#version 150 core\n#define PERSPECTIVE 0"));
-
+// Allocates the render targets which depend on the resolution
+static void init_targets(int width, int height) {
     if (!gl.linear_depth.texture) glGenTextures(1, &gl.linear_depth.texture);
     glBindTexture(GL_TEXTURE_2D, gl.linear_depth.texture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, nullptr);
@@ -1026,9 +1087,6 @@ void initialize(int width, int height) {
         glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
     }
 
-    gl.linear_depth.uniform_loc.clip_info = glGetUniformLocation(gl.linear_depth.program_persp, "u_clip_info");
-    gl.linear_depth.uniform_loc.tex_depth = glGetUniformLocation(gl.linear_depth.program_persp, "u_tex_depth");
-
     // COLOR
     if (!gl.targets.tex_color[0]) glGenTextures(2, gl.targets.tex_color);
     glBindTexture(GL_TEXTURE_2D, gl.targets.tex_color[0]);
@@ -1096,6 +1154,22 @@ void initialize(int width, int height) {
 
     gl.tex_width = width;
     gl.tex_height = height;
+}
+
+void initialize(int width, int height) {
+    if (!gl.vao) glGenVertexArrays(1, &gl.vao);
+
+    gl.v_shader_fs_quad = gl::compile_shader_from_source(v_shader_src_fs_quad, GL_VERTEX_SHADER);
+
+    // LINEARIZE DEPTH
+
+    gl.linear_depth.program_persp = setup_program_from_source(STR_LIT("linearize depth persp"), f_shader_src_linearize_depth, STR_LIT("#version 150 core\n#define PERSPECTIVE 1"));
+    gl.linear_depth.program_ortho = setup_program_from_source(STR_LIT("linearize depth ortho"), f_shader_src_linearize_depth, STR_LIT("#version 150 core\n#define PERSPECTIVE 0"));
+
+    gl.linear_depth.uniform_loc.clip_info = glGetUniformLocation(gl.linear_depth.program_persp, "u_clip_info");
+    gl.linear_depth.uniform_loc.tex_depth = glGetUniformLocation(gl.linear_depth.program_persp, "u_tex_depth");
+
+    init_targets(width, height);
 
     ssao::initialize(width, height);
     dof::initialize(width, height);
@@ -1111,6 +1185,13 @@ void initialize(int width, int height) {
     fxaa::initialize();
 }
 
+void resize(int width, int height) {
+    init_targets(width, height);
+    ssao::init_textures(width, height);
+    dof::init_textures(width, height);
+    velocity::init_textures(width, height);
+}
+
 void shutdown() {
     ssao::shutdown();
     dof::shutdown();
@@ -1149,7 +1230,7 @@ void compute_linear_depth(GLuint depth_tex, float near_plane, float far_plane, b
     glBindVertexArray(0);
 }
 
-void compute_ssao(GLuint linear_depth_tex, GLuint normal_tex, const mat4_t& proj_matrix, float intensity, float radius, float bias) {
+void compute_ssao(GLuint linear_depth_tex, GLuint normal_tex, const mat4_t& proj_matrix, float intensity, float radius, float bias, bool half_res) {
     ASSERT(glIsTexture(linear_depth_tex));
     ASSERT(glIsTexture(normal_tex));
 
@@ -1162,13 +1243,22 @@ void compute_ssao(GLuint linear_depth_tex, GLuint normal_tex, const mat4_t& proj
     glGetIntegerv(GL_SCISSOR_BOX, last_scissor_box);
     glGetIntegerv(GL_DRAW_BUFFER, &last_draw_buffer);
 
-    int width  = last_viewport[2];
-    int height = last_viewport[3];
+    // At half resolution the AO and the first blur pass are computed at the reduced size,
+    // the second blur pass is performed at the full size and upsamples the result
+    int width  = half_res ? MAX(last_viewport[2] / 2, 1) : last_viewport[2];
+    int height = half_res ? MAX(last_viewport[3] / 2, 1) : last_viewport[3];
+
+    if (width != gl.ssao.tex_width || height != gl.ssao.tex_height) {
+        ssao::init_textures(width, height);
+    }
 
     const bool ortho = is_orthographic_proj_matrix(proj_matrix);
     const float sharpness = ssao::compute_sharpness(radius);
     const vec2_t inv_res = vec2_t{ 1.f / (float)width, 1.f / (float)height };
 
+    // The linear depth may be larger than the viewport (the targets only grow), the AO textures are not
+    const vec2_t depth_tc_scl = vec2_t{ (float)last_viewport[2] / (float)gl.tex_width, (float)last_viewport[3] / (float)gl.tex_height };
+
     glBindVertexArray(gl.vao);
 
     ssao::HBAOData ubo_data = {};
@@ -1184,7 +1274,12 @@ void compute_ssao(GLuint linear_depth_tex, GLuint normal_tex, const mat4_t& proj
     glClearColor(1,1,1,1);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    GLuint program = ortho ? gl.ssao.hbao.program_ortho : gl.ssao.hbao.program_persp;
+    GLuint program = 0;
+    if (half_res) {
+        program = ortho ? gl.ssao.hbao.program_ortho_half : gl.ssao.hbao.program_persp_half;
+    } else {
+        program = ortho ? gl.ssao.hbao.program_ortho : gl.ssao.hbao.program_persp;
+    }
 
     PUSH_GPU_SECTION("HBAO")
     glUseProgram(program);
@@ -1201,6 +1296,7 @@ void compute_ssao(GLuint linear_depth_tex, GLuint normal_tex, const mat4_t& proj
     glUniform1i(glGetUniformLocation(program, "u_tex_linear_depth"), 0);
     glUniform1i(glGetUniformLocation(program, "u_tex_normal"), 1);
     glUniform1i(glGetUniformLocation(program, "u_tex_random"), 2);
+    glUniform2f(glGetUniformLocation(program, "u_depth_tc_scl"), depth_tc_scl.x, depth_tc_scl.y);
 
     glDrawArrays(GL_TRIANGLES, 0, 3);
     POP_GPU_SECTION()
@@ -1212,6 +1308,7 @@ void compute_ssao(GLuint linear_depth_tex, GLuint normal_tex, const mat4_t& proj
     glUniform1i(glGetUniformLocation(gl.ssao.blur.program, "u_tex_ao"), 1);
     glUniform1f(glGetUniformLocation(gl.ssao.blur.program, "u_sharpness"), sharpness);
     glUniform1f(glGetUniformLocation(gl.ssao.blur.program, "u_zmax"), ubo_data.z_max);
+    glUniform2f(glGetUniformLocation(gl.ssao.blur.program, "u_depth_tc_scl"), depth_tc_scl.x, depth_tc_scl.y);
     glUniform2f(glGetUniformLocation(gl.ssao.blur.program, "u_inv_res_dir"), inv_res.x, 0);
 
     glActiveTexture(GL_TEXTURE1);
@@ -1643,6 +1740,21 @@ void blit_texture(GLuint tex) {
     glUseProgram(0);
 }
 
+// Upsamples the region [width, height] of a texture with the size of the postprocessing targets into the viewport
+static void upsample_texture(GLuint tex, int width, int height) {
+    ASSERT(glIsTexture(tex));
+    glUseProgram(blit::program_upsample);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glUniform1i(blit::uniform_loc_upsample.texture, 0);
+    glUniform2f(blit::uniform_loc_upsample.tex_size, (float)gl.tex_width, (float)gl.tex_height);
+    glUniform2f(blit::uniform_loc_upsample.tc_scl, (float)width / (float)gl.tex_width, (float)height / (float)gl.tex_height);
+    glBindVertexArray(gl.vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
 void blit_color(vec4_t color) {
     glUseProgram(blit::program_col);
     glUniform4fv(blit::uniform_loc_color, 1, &color.x);
@@ -1807,11 +1919,12 @@ void shade_and_postprocess(const Descriptor& desc, const ViewParam& view_param)
     glGetIntegerv(GL_SCISSOR_BOX, last_scissor_box);
     glGetIntegerv(GL_DRAW_BUFFER, &last_draw_buffer);
 
-    int width = last_viewport[2];
-    int height = last_viewport[3];
+    int width  = desc.input_resolution.width  > 0 ? desc.input_resolution.width  : last_viewport[2];
+    int height = desc.input_resolution.height > 0 ? desc.input_resolution.height : last_viewport[3];
 
+    // The targets only grow, callers which alternate between different resolutions would otherwise reallocate them every frame
     if (width > (int)gl.tex_width || height > (int)gl.tex_height) {
-        initialize(width, height);
+        resize(MAX(width, (int)gl.tex_width), MAX(height, (int)gl.tex_height));
     }
 
     //glViewport(0, 0, gl.tex_width, gl.tex_height);
@@ -1881,7 +1994,7 @@ void shade_and_postprocess(const Descriptor& desc, const ViewParam& view_param)
 
     if (desc.ambient_occlusion.enabled) {
         PUSH_GPU_SECTION("SSAO")
-        compute_ssao(gl.linear_depth.texture, desc.input_textures.normal, view_param.matrix.curr.proj, desc.ambient_occlusion.intensity, desc.ambient_occlusion.radius, desc.ambient_occlusion.bias);
+        compute_ssao(gl.linear_depth.texture, desc.input_textures.normal, view_param.matrix.curr.proj, desc.ambient_occlusion.intensity, desc.ambient_occlusion.radius, desc.ambient_occlusion.bias, desc.ambient_occlusion.half_res);
         POP_GPU_SECTION()
     }
 
@@ -1955,7 +2068,13 @@ void shade_and_postprocess(const Descriptor& desc, const ViewParam& view_param)
 
     swap_target();
     glDepthMask(0);
-    blit_texture(src_texture);
+    if (width == last_viewport[2] && height == last_viewport[3]) {
+        blit_texture(src_texture);
+    } else {
+        PUSH_GPU_SECTION("Upsample")
+        upsample_texture(src_texture, width, height);
+        POP_GPU_SECTION()
+    }
 
     glDepthMask(1);
     glColorMask(1, 1, 1, 1);
@@ -2116,6 +2235,10 @@ void destroy_gbuffer(GBuffer* gbuf) {
 
     if (gbuf->pbo_picking.color[0]) glDeleteBuffers((int)ARRAY_SIZE(gbuf->pbo_picking.color), gbuf->pbo_picking.color);
     if (gbuf->pbo_picking.depth[0]) glDeleteBuffers((int)ARRAY_SIZE(gbuf->pbo_picking.depth), gbuf->pbo_picking.depth);
+    for (uint32_t i = 0; i < ARRAY_SIZE(gbuf->pbo_picking.fence); ++i) {
+        if (gbuf->pbo_picking.fence[i]) glDeleteSync(gbuf->pbo_picking.fence[i]);
+        gbuf->pbo_picking.fence[i] = 0;
+    }
 }
 
 // #picking
@@ -2130,39 +2253,56 @@ PickingData read_picking_data(GBuffer* gbuf, int x, int y) {
     else {
 #endif
         ASSERT(gbuf);
-        uint32_t N = (uint32_t)ARRAY_SIZE(gbuf->pbo_picking.color);
-        uint32_t frame = gbuf->pbo_picking.frame++;
-        uint32_t queue = (frame) % N;
-        uint32_t read  = (frame + N-1) % N;
-
-        uint8_t  color[4];
-        float    depth;
+        auto& pbo = gbuf->pbo_picking;
+        const uint32_t N = (uint32_t)ARRAY_SIZE(pbo.color);
+        const uint32_t latency = CLAMP(pbo.latency, 1U, N - 1);
+        const uint32_t frame = pbo.frame++;
+        const uint32_t queue = (frame) % N;
+        const uint32_t read  = (frame + N - latency) % N;
 
         PUSH_GPU_SECTION("READ PICKING DATA")
         glBindFramebuffer(GL_READ_FRAMEBUFFER, gbuf->fbo);
         glReadBuffer(GL_COLOR_ATTACHMENT_PICKING);
 
         // Queue async reads from current frame to pixel pack buffer
-        glBindBuffer(GL_PIXEL_PACK_BUFFER, gbuf->pbo_picking.color[queue]);
+        // A fence which remains in the slot belongs to a read which never completed in time, which is superseded
+        if (pbo.fence[queue]) glDeleteSync(pbo.fence[queue]);
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo.color[queue]);
         glReadPixels(x, y, 1, 1, GL_BGRA, GL_UNSIGNED_BYTE, 0);
 
-        glBindBuffer(GL_PIXEL_PACK_BUFFER, gbuf->pbo_picking.depth[queue]);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo.depth[queue]);
         glReadPixels(x, y, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
 
-        // Read values from previous frames pixel pack buffer
-        glBindBuffer(GL_PIXEL_PACK_BUFFER, gbuf->pbo_picking.color[read]);
-        glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, sizeof(color), color);
+        pbo.fence[queue] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        pbo.submit_frame[queue] = frame;
 
-        glBindBuffer(GL_PIXEL_PACK_BUFFER, gbuf->pbo_picking.depth[read]);
-        glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, sizeof(depth), &depth);
+        // Read values from the pixel pack buffer of 'latency' frames ago, if its read has completed
+        if (pbo.fence[read] && glClientWaitSync(pbo.fence[read], 0, 0) != GL_TIMEOUT_EXPIRED) {
+            uint8_t color[4];
+            float   depth;
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo.color[read]);
+            glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, sizeof(color), color);
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo.depth[read]);
+            glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, sizeof(depth), &depth);
+
+            // BGRA
+            pbo.idx = (color[0] << 16) | (color[1] << 8) | (color[2] << 0) | (color[3] << 24);
+            pbo.depth_value  = depth;
+            pbo.result_frame = pbo.submit_frame[read];
+
+            glDeleteSync(pbo.fence[read]);
+            pbo.fence[read] = 0;
+        }
 
         glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
         glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
         POP_GPU_SECTION()
 
-        // BGRA
-        data.idx   = (color[0] << 16) | (color[1] << 8) | (color[2] << 0) | (color[3] << 24);
-        data.depth = depth;
+        data.idx   = pbo.idx;
+        data.depth = pbo.depth_value;
 
 #if EXPERIMENTAL_GFX_API
     }
@@ -6,6 +6,7 @@
 #include <core/md_vec_math.h>
 
 #define INVALID_PICKING_IDX (~0U)
+#define PICKING_MAX_LATENCY 3
 
 #define GL_COLOR_ATTACHMENT_COLOR        GL_COLOR_ATTACHMENT0
 #define GL_COLOR_ATTACHMENT_NORMAL       GL_COLOR_ATTACHMENT1
@@ -27,11 +28,18 @@ struct GBuffer {
     } tex;
 
     struct {
-        // @NOTE: Many of each, we submit the read and use it some frame(s) later
-        // This means that we read with N-1 frames latency
-        uint32_t color[2] = {};
-        uint32_t depth[2] = {};
+        // @NOTE: Many of each, we submit the read and use it 'latency' frames later
+        // If the read has not completed by then, the previous result is kept rather than stalling
+        uint32_t color[PICKING_MAX_LATENCY + 1] = {};
+        uint32_t depth[PICKING_MAX_LATENCY + 1] = {};
+        GLsync   fence[PICKING_MAX_LATENCY + 1] = {};
+        uint32_t submit_frame[PICKING_MAX_LATENCY + 1] = {};
         uint32_t frame = 0;
+        uint32_t latency = 1;
+
+        uint32_t result_frame = 0;      // Frame in which the current result was submitted
+        uint32_t idx = INVALID_PICKING_IDX;
+        float    depth_value = 1.0f;
     } pbo_picking;
 
     uint32_t fbo = 0;
@@ -49,6 +57,8 @@ struct PickingData {
 namespace postprocessing {
 
 void initialize(int width, int height);
+// Reallocates the render targets without recompiling the shaders
+void resize(int width, int height);
 void shutdown();
 
 typedef int Tonemapping;
@@ -83,6 +93,7 @@ struct Descriptor {
         float radius = 6.0f;
         float intensity = 3.0f;
         float bias = 0.1f;
+        bool half_res = false;      // Computed at half resolution and upsampled by the blur
     } ambient_occlusion;
 
     struct {
@@ -117,6 +128,13 @@ struct Descriptor {
         GLuint velocity = 0;
         GLuint transparency = 0;
     } input_textures;
+
+    // Resolution of the input textures, zero means the size of the viewport
+    // If it differs from the viewport the result is upsampled into it
+    struct {
+        int width = 0;
+        int height = 0;
+    } input_resolution;
 };
 
 void apply_tonemapping(GLuint color_tex, Tonemapping tonemapping, float exposure = 1.0f, float gamma = 2.4f);
@@ -0,0 +1,384 @@
+#include <gfx/profiler.h>
+
+#include <gfx/gl.h>
+
+#include <core/md_common.h>
+#include <core/md_allocator.h>
+#include <core/md_hash.h>
+#include <core/md_log.h>
+#include <core/md_os.h>
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#define PROFILER_FRAME_BUFFERS  2
+#define PROFILER_MAX_EVENTS     512
+#define PROFILER_MAX_SECTIONS   256
+#define PROFILER_MAX_DEPTH      64
+#define PROFILER_LABEL_LEN      64
+#define PROFILER_TRACE_CAPACITY (1 << 16)
+
+namespace profiler {
+
+struct Section {
+    uint64_t key;
+    char     label[PROFILER_LABEL_LEN];
+    uint32_t depth;
+    bool     gpu;
+
+    // Ring of the timings of the last frames the section occurred in
+    float    cpu_ms[PROFILER_AVERAGE_FRAMES];
+    float    gpu_ms[PROFILER_AVERAGE_FRAMES];
+    uint32_t head;
+    uint32_t count;
+    uint32_t calls;
+
+    // Accumulated over the frame which is being resolved
+    float    acc_cpu_ms;
+    float    acc_gpu_ms;
+    uint32_t acc_calls;
+};
+
+struct Event {
+    uint32_t section;
+    bool     gpu;
+    bool     top;           // GPU section which is not nested within another GPU section
+    md_timestamp_t cpu_beg;
+    md_timestamp_t cpu_end;
+};
+
+struct Frame {
+    Event    events[PROFILER_MAX_EVENTS];
+    uint32_t queries[PROFILER_MAX_EVENTS * 2];
+    uint32_t num_events;
+    uint32_t last_query;    // The query which was submitted last, once it is available all of the frame is
+    md_timestamp_t cpu_ref; // CPU and GPU time sampled at the beginning of the frame, used to align the clocks
+    int64_t  gpu_ref;
+    bool     pending;
+};
+
+struct TraceEvent {
+    uint32_t section;
+    bool     gpu;
+    double   cpu_beg_us;    // Relative to the initialization of the profiler
+    double   cpu_end_us;
+    double   gpu_beg_us;
+    double   gpu_end_us;
+};
+
+struct StackEntry {
+    uint32_t event;         // UINT32_MAX if the section is not recorded
+    uint32_t section;
+    bool     gpu;
+};
+
+static struct {
+    Frame    frames[PROFILER_FRAME_BUFFERS];
+    uint64_t frame_idx = 0;
+    bool     in_frame = false;
+    bool     enabled = true;
+    bool     initialized = false;
+
+    Section  sections[PROFILER_MAX_SECTIONS];
+    uint32_t num_sections = 0;
+
+    StackEntry stack[PROFILER_MAX_DEPTH];
+    uint32_t depth = 0;
+    uint32_t gpu_depth = 0; // Number of GPU sections on the stack
+
+    // Sections of the last resolved frame in the order of submission
+    uint32_t order[PROFILER_MAX_SECTIONS];
+    uint32_t num_order = 0;
+
+    TraceEvent* trace = 0;
+    size_t   trace_head = 0;
+    size_t   trace_count = 0;
+
+    md_timestamp_t start = 0;
+    uint64_t dropped = 0;
+    uint64_t resolved = 0;
+    float    last_gpu_ms = 0;
+} ctx;
+
+void initialize() {
+    if (ctx.initialized) return;
+    for (int i = 0; i < PROFILER_FRAME_BUFFERS; ++i) {
+        glGenQueries(PROFILER_MAX_EVENTS * 2, ctx.frames[i].queries);
+        ctx.frames[i].num_events = 0;
+        ctx.frames[i].pending = false;
+    }
+    ctx.trace = (TraceEvent*)md_alloc(md_get_heap_allocator(), PROFILER_TRACE_CAPACITY * sizeof(TraceEvent));
+    ctx.trace_head = 0;
+    ctx.trace_count = 0;
+    ctx.start = md_time_current();
+    ctx.initialized = true;
+}
+
+void shutdown() {
+    if (!ctx.initialized) return;
+    for (int i = 0; i < PROFILER_FRAME_BUFFERS; ++i) {
+        glDeleteQueries(PROFILER_MAX_EVENTS * 2, ctx.frames[i].queries);
+    }
+    md_free(md_get_heap_allocator(), ctx.trace, PROFILER_TRACE_CAPACITY * sizeof(TraceEvent));
+    ctx.trace = 0;
+    ctx.initialized = false;
+}
+
+void set_enabled(bool enabled) {
+    // Takes effect at the beginning of the next frame
+    ctx.enabled = enabled;
+}
+
+bool enabled() {
+    return ctx.enabled;
+}
+
+static uint32_t find_section(const char* label, uint32_t parent, uint32_t depth, bool gpu) {
+    const uint64_t seed = parent != UINT32_MAX ? ctx.sections[parent].key : 0;
+    const uint64_t key  = md_hash64(label, strlen(label), seed);
+    for (uint32_t i = 0; i < ctx.num_sections; ++i) {
+        if (ctx.sections[i].key == key) return i;
+    }
+    if (ctx.num_sections == PROFILER_MAX_SECTIONS) return UINT32_MAX;
+
+    Section& s = ctx.sections[ctx.num_sections];
+    MEMSET(&s, 0, sizeof(Section));
+    s.key   = key;
+    s.depth = depth;
+    s.gpu   = gpu;
+    // The label is written verbatim into the trace, quotes and backslashes would break the JSON
+    size_t len = 0;
+    for (; label[len] && len < PROFILER_LABEL_LEN - 1; ++len) {
+        s.label[len] = (label[len] == '"' || label[len] == '\\') ? '\'' : label[len];
+    }
+    s.label[len] = '\0';
+    return ctx.num_sections++;
+}
+
+static void record_trace(const Frame& frame, const Event& e, uint64_t gpu_beg, uint64_t gpu_end) {
+    const double ref_us = md_time_as_seconds(frame.cpu_ref - ctx.start) * 1.0e6;
+
+    TraceEvent& t = ctx.trace[ctx.trace_head];
+    t.section    = e.section;
+    t.gpu        = e.gpu;
+    t.cpu_beg_us = md_time_as_seconds(e.cpu_beg - ctx.start) * 1.0e6;
+    t.cpu_end_us = md_time_as_seconds(e.cpu_end - ctx.start) * 1.0e6;
+    t.gpu_beg_us = e.gpu ? ref_us + (double)((int64_t)gpu_beg - frame.gpu_ref) * 1.0e-3 : 0.0;
+    t.gpu_end_us = e.gpu ? ref_us + (double)((int64_t)gpu_end - frame.gpu_ref) * 1.0e-3 : 0.0;
+
+    ctx.trace_head = (ctx.trace_head + 1) % PROFILER_TRACE_CAPACITY;
+    ctx.trace_count = MIN(ctx.trace_count + 1, PROFILER_TRACE_CAPACITY);
+}
+
+// Reads back the timings of the frame if they are available without stalling, otherwise the frame is dropped
+static void resolve_frame(Frame* frame) {
+    if (frame->last_query != UINT32_MAX) {
+        GLint available = 0;
+        glGetQueryObjectiv(frame->queries[frame->last_query], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            ctx.dropped += 1;
+            return;
+        }
+    }
+
+    ctx.num_order = 0;
+    float gpu_ms = 0;
+    for (uint32_t i = 0; i < frame->num_events; ++i) {
+        const Event& e = frame->events[i];
+        Section& s = ctx.sections[e.section];
+
+        GLuint64 gpu_beg = 0;
+        GLuint64 gpu_end = 0;
+        if (e.gpu) {
+            glGetQueryObjectui64v(frame->queries[i * 2 + 0], GL_QUERY_RESULT, &gpu_beg);
+            glGetQueryObjectui64v(frame->queries[i * 2 + 1], GL_QUERY_RESULT, &gpu_end);
+        }
+
+        if (s.acc_calls == 0) {
+            ctx.order[ctx.num_order++] = e.section;
+        }
+        s.acc_cpu_ms += (float)(md_time_as_seconds(e.cpu_end - e.cpu_beg) * 1000.0);
+        s.acc_gpu_ms += (float)((double)(gpu_end - gpu_beg) * 1.0e-6);
+        s.acc_calls  += 1;
+        if (e.top) {
+            gpu_ms += (float)((double)(gpu_end - gpu_beg) * 1.0e-6);
+        }
+
+        record_trace(*frame, e, gpu_beg, gpu_end);
+    }
+    ctx.last_gpu_ms = gpu_ms;
+    ctx.resolved += 1;
+
+    for (uint32_t i = 0; i < ctx.num_order; ++i) {
+        Section& s = ctx.sections[ctx.order[i]];
+        s.cpu_ms[s.head] = s.acc_cpu_ms;
+        s.gpu_ms[s.head] = s.acc_gpu_ms;
+        s.head  = (s.head + 1) % PROFILER_AVERAGE_FRAMES;
+        s.count = MIN(s.count + 1, PROFILER_AVERAGE_FRAMES);
+        s.calls = s.acc_calls;
+        s.acc_cpu_ms = 0;
+        s.acc_gpu_ms = 0;
+        s.acc_calls  = 0;
+    }
+}
+
+void begin_frame() {
+    if (!ctx.initialized) return;
+    ASSERT(!ctx.in_frame);
+
+    ctx.frame_idx += 1;
+    Frame& frame = ctx.frames[ctx.frame_idx % PROFILER_FRAME_BUFFERS];
+    if (frame.pending) {
+        resolve_frame(&frame);
+        frame.pending = false;
+    }
+    frame.num_events = 0;
+    frame.last_query = UINT32_MAX;
+
+    ctx.in_frame = ctx.enabled;
+    if (ctx.in_frame) {
+        frame.cpu_ref = md_time_current();
+        glGetInteger64v(GL_TIMESTAMP, &frame.gpu_ref);
+    }
+}
+
+void end_frame() {
+    if (!ctx.in_frame) return;
+    ASSERT(ctx.depth == 0);
+
+    Frame& frame = ctx.frames[ctx.frame_idx % PROFILER_FRAME_BUFFERS];
+    frame.pending = frame.num_events > 0;
+    ctx.in_frame = false;
+}
+
+void push_section(const char* label, bool gpu) {
+    ASSERT(label);
+    ASSERT(ctx.depth < PROFILER_MAX_DEPTH);
+    if (gpu && glPushDebugGroup) glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, GL_KHR_debug, -1, label);
+
+    StackEntry entry = {UINT32_MAX, UINT32_MAX, gpu};
+    if (ctx.in_frame) {
+        Frame& frame = ctx.frames[ctx.frame_idx % PROFILER_FRAME_BUFFERS];
+        const uint32_t parent = ctx.depth > 0 ? ctx.stack[ctx.depth - 1].section : UINT32_MAX;
+        entry.section = find_section(label, parent, ctx.depth, gpu);
+        if (entry.section != UINT32_MAX && frame.num_events < PROFILER_MAX_EVENTS) {
+            entry.event = frame.num_events++;
+            Event& e = frame.events[entry.event];
+            e.section = entry.section;
+            e.gpu     = gpu;
+            e.top     = gpu && ctx.gpu_depth == 0;
+            e.cpu_beg = md_time_current();
+            if (gpu) {
+                glQueryCounter(frame.queries[entry.event * 2 + 0], GL_TIMESTAMP);
+                frame.last_query = entry.event * 2 + 0;
+            }
+        }
+    }
+    ctx.stack[ctx.depth++] = entry;
+    if (gpu) ctx.gpu_depth += 1;
+}
+
+void pop_section() {
+    ASSERT(ctx.depth > 0);
+    if (ctx.depth == 0) return;
+
+    const StackEntry entry = ctx.stack[--ctx.depth];
+    if (entry.gpu) ctx.gpu_depth -= 1;
+    if (entry.event != UINT32_MAX && ctx.in_frame) {
+        Frame& frame = ctx.frames[ctx.frame_idx % PROFILER_FRAME_BUFFERS];
+        Event& e = frame.events[entry.event];
+        e.cpu_end = md_time_current();
+        if (entry.gpu) {
+            glQueryCounter(frame.queries[entry.event * 2 + 1], GL_TIMESTAMP);
+            frame.last_query = entry.event * 2 + 1;
+        }
+    }
+    if (entry.gpu && glPopDebugGroup) glPopDebugGroup();
+}
+
+size_t get_stats(SectionStats* stats, size_t capacity) {
+    ASSERT(stats);
+    size_t count = 0;
+    for (uint32_t i = 0; i < ctx.num_order && count < capacity; ++i) {
+        const Section& s = ctx.sections[ctx.order[i]];
+        float cpu_sum = 0;
+        float gpu_sum = 0;
+        float gpu_max = 0;
+        for (uint32_t j = 0; j < s.count; ++j) {
+            cpu_sum += s.cpu_ms[j];
+            gpu_sum += s.gpu_ms[j];
+            gpu_max = MAX(gpu_max, s.gpu_ms[j]);
+        }
+        const float scl = s.count > 0 ? 1.0f / s.count : 0.0f;
+        stats[count++] = {
+            .label = s.label,
+            .depth = s.depth,
+            .calls = s.calls,
+            .gpu = s.gpu,
+            .cpu_avg_ms = cpu_sum * scl,
+            .gpu_avg_ms = gpu_sum * scl,
+            .gpu_max_ms = gpu_max,
+        };
+    }
+    return count;
+}
+
+uint64_t num_dropped_frames() {
+    return ctx.dropped;
+}
+
+uint64_t num_resolved_frames() {
+    return ctx.resolved;
+}
+
+float last_frame_gpu_ms() {
+    return ctx.last_gpu_ms;
+}
+
+static bool write_line(md_file_o* file, const char* fmt, ...) {
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (len < 0) return false;
+    len = MIN(len, (int)sizeof(buf) - 1);
+    return md_file_write(file, buf, (size_t)len) == (size_t)len;
+}
+
+bool write_trace(str_t path) {
+    md_file_o* file = md_file_open(path, MD_FILE_WRITE);
+    if (!file) {
+        MD_LOG_ERROR("Failed to open file '" STR_FMT "' for writing the profiler trace", STR_ARG(path));
+        return false;
+    }
+    defer { md_file_close(file); };
+
+    bool ok = write_line(file, "{\"traceEvents\":[\n");
+    ok &= write_line(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n");
+    ok &= write_line(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"GPU\"}}");
+
+    const size_t first = (ctx.trace_head + PROFILER_TRACE_CAPACITY - ctx.trace_count) % PROFILER_TRACE_CAPACITY;
+    for (size_t i = 0; i < ctx.trace_count && ok; ++i) {
+        const TraceEvent& t = ctx.trace[(first + i) % PROFILER_TRACE_CAPACITY];
+        const char* label = ctx.sections[t.section].label;
+        ok &= write_line(file, ",\n{\"name\":\"%s\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}", label, t.cpu_beg_us, t.cpu_end_us - t.cpu_beg_us);
+        if (t.gpu) {
+            ok &= write_line(file, ",\n{\"name\":\"%s\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":0,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}", label, t.gpu_beg_us, t.gpu_end_us - t.gpu_beg_us);
+        }
+    }
+    ok &= write_line(file, "\n]}\n");
+
+    if (!ok) {
+        MD_LOG_ERROR("Failed to write the profiler trace to '" STR_FMT "'", STR_ARG(path));
+    }
+    return ok;
+}
+
+void clear_trace() {
+    ctx.trace_head = 0;
+    ctx.trace_count = 0;
+}
+
+}  // namespace profiler
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <core/md_str.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Frame profiler for the sections marked by PUSH_GPU_SECTION / PUSH_CPU_SECTION.
+// GPU sections are measured with timestamp queries which are placed at the beginning and end of each section,
+// timer queries (GL_TIME_ELAPSED) cannot be nested and the sections are. The queries are double buffered,
+// the results of a frame are read back when its buffer is reused, if they are not yet available the frame is dropped instead of stalling.
+// Sections are identified by their label and the section they are nested within, multiple occurrences within a frame are accumulated.
+// All functions are expected to be called from the thread which owns the GL context.
+
+#define PROFILER_AVERAGE_FRAMES 64
+
+// For cpu profiling
+#define PUSH_CPU_SECTION(lbl) { profiler::push_section(lbl, false); }
+#define POP_CPU_SECTION()     { profiler::pop_section(); }
+
+// For gpu profiling
+#define PUSH_GPU_SECTION(lbl) { profiler::push_section(lbl, true); }
+#define POP_GPU_SECTION()     { profiler::pop_section(); }
+
+namespace profiler {
+
+struct SectionStats {
+    const char* label;
+    uint32_t depth;
+    uint32_t calls;         // Number of occurrences within the last frame
+    bool     gpu;
+    float    cpu_avg_ms;    // Averages over the last PROFILER_AVERAGE_FRAMES frames
+    float    gpu_avg_ms;
+    float    gpu_max_ms;
+};
+
+void initialize();
+void shutdown();
+
+void set_enabled(bool enabled);
+bool enabled();
+
+// Delimits the frame, sections outside of a frame only emit the debug markers
+void begin_frame();
+void end_frame();
+
+void push_section(const char* label, bool gpu);
+void pop_section();
+
+// Fills stats with the sections of the last resolved frame in the order they were submitted, returns the number of sections written
+size_t get_stats(SectionStats* stats, size_t capacity);
+
+// Number of frames which were dropped since their queries were not available in time
+uint64_t num_dropped_frames();
+
+// Number of frames which have been resolved, can be used to detect when last_frame_gpu_ms is updated
+uint64_t num_resolved_frames();
+
+// GPU time of the last resolved frame, the sum of the outermost GPU sections
+float last_frame_gpu_ms();
+
+// Writes the recorded frames as a trace in the chrome tracing format (chrome://tracing, ui.perfetto.dev)
+// CPU and GPU timings are written as two separate threads where the GPU timestamps are aligned to the CPU clock per frame
+bool write_trace(str_t path);
+void clear_trace();
+
+}  // namespace profiler
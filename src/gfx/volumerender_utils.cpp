@@ -2,27 +2,21 @@
 
 #include <gfx/gl.h>
 #include <gfx/gl_utils.h>
+#include <gfx/profiler.h>
 #include <gfx/postprocessing_utils.h>
 #include <color_utils.h>
+#include <sparse_volume.h>
 
 #include <core/md_common.h>
 #include <core/md_log.h>
 #include <core/md_os.h>
 #include <core/md_vec_math.h>
+#include <core/md_allocator.h>
 
 #include <implot.h>
 
 #include <shaders.inl>
 
-#define PUSH_GPU_SECTION(lbl)                                                                       \
-    {                                                                                               \
-        if (glPushDebugGroup) glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, GL_KHR_debug, -1, lbl); \
-    }
-#define POP_GPU_SECTION()                       \
-    {                                           \
-        if (glPopDebugGroup) glPopDebugGroup(); \
-    }
-
 static constexpr str_t v_shader_src_fs_quad = STR_LIT(
     R"(
 #version 150 core
@@ -93,6 +87,39 @@ void main() {
 }
 )");
 
+static constexpr str_t f_shader_src_macro_cells = STR_LIT(
+R"(
+#version 150 core
+
+uniform sampler3D u_tex_volume;
+uniform int u_layer;
+uniform int u_cell_dim;
+
+out vec2 out_frag;
+
+void main() {
+    ivec3 dim  = textureSize(u_tex_volume, 0);
+    ivec3 cell = ivec3(ivec2(gl_FragCoord.xy), u_layer);
+
+    // Interpolated samples within the cell are influenced by the voxels of the cell and one voxel beyond each side
+    ivec3 beg = clamp(cell * u_cell_dim - 1, ivec3(0), dim - 1);
+    ivec3 end = clamp(cell * u_cell_dim + u_cell_dim, ivec3(0), dim - 1);
+
+    vec2 range = vec2(3.0e38, -3.0e38);
+    for (int z = beg.z; z <= end.z; ++z) {
+        for (int y = beg.y; y <= end.y; ++y) {
+            for (int x = beg.x; x <= end.x; ++x) {
+                float v = texelFetch(u_tex_volume, ivec3(x, y, z), 0).r;
+                range = vec2(min(range.x, v), max(range.y, v));
+            }
+        }
+    }
+    out_frag = range;
+}
+)");
+
+#define MACRO_CELL_DIM 8
+
 namespace volume {
 
 static struct {
@@ -114,6 +141,10 @@ static struct {
         GLuint dvr_only = 0;
         GLuint iso_only = 0;
         GLuint dvr_and_iso = 0;
+        GLuint dvr_only_bricked = 0;
+        GLuint iso_only_bricked = 0;
+        GLuint dvr_and_iso_bricked = 0;
+        GLuint macro_cells = 0;
         GLuint median = 0;
     } program;
 } gl;
@@ -152,6 +183,10 @@ void initialize() {
     GLuint f_shader_dvr_only            = gl::compile_shader_from_source({(const char*)raycaster_frag, raycaster_frag_size}, GL_FRAGMENT_SHADER, STR_LIT("#define INCLUDE_DVR"));
     GLuint f_shader_iso_only            = gl::compile_shader_from_source({(const char*)raycaster_frag, raycaster_frag_size}, GL_FRAGMENT_SHADER, STR_LIT("#define INCLUDE_ISO"));
     GLuint f_shader_dvr_and_iso         = gl::compile_shader_from_source({(const char*)raycaster_frag, raycaster_frag_size}, GL_FRAGMENT_SHADER, STR_LIT("#define INCLUDE_DVR\n#define INCLUDE_ISO"));
+    GLuint f_shader_dvr_only_bricked    = gl::compile_shader_from_source({(const char*)raycaster_frag, raycaster_frag_size}, GL_FRAGMENT_SHADER, STR_LIT("#define BRICKED\n#define INCLUDE_DVR"));
+    GLuint f_shader_iso_only_bricked    = gl::compile_shader_from_source({(const char*)raycaster_frag, raycaster_frag_size}, GL_FRAGMENT_SHADER, STR_LIT("#define BRICKED\n#define INCLUDE_ISO"));
+    GLuint f_shader_dvr_and_iso_bricked = gl::compile_shader_from_source({(const char*)raycaster_frag, raycaster_frag_size}, GL_FRAGMENT_SHADER, STR_LIT("#define BRICKED\n#define INCLUDE_DVR\n#define INCLUDE_ISO"));
+    GLuint f_shader_macro_cells         = gl::compile_shader_from_source(f_shader_src_macro_cells, GL_FRAGMENT_SHADER);
 
     defer {
         glDeleteShader(v_shader_vol);
@@ -159,9 +194,14 @@ void initialize() {
         glDeleteShader(f_shader_dvr_only);
         glDeleteShader(f_shader_iso_only);
         glDeleteShader(f_shader_dvr_and_iso);
+        glDeleteShader(f_shader_dvr_only_bricked);
+        glDeleteShader(f_shader_iso_only_bricked);
+        glDeleteShader(f_shader_dvr_and_iso_bricked);
+        glDeleteShader(f_shader_macro_cells);
     };
 
-    if (v_shader_entry_exit == 0 || v_shader_vol == 0 || f_shader_entry_exit == 0|| f_shader_dvr_only == 0 || f_shader_iso_only == 0 || f_shader_dvr_and_iso == 0) {
+    if (v_shader_entry_exit == 0 || v_shader_vol == 0 || f_shader_entry_exit == 0|| f_shader_dvr_only == 0 || f_shader_iso_only == 0 || f_shader_dvr_and_iso == 0 ||
+        f_shader_dvr_only_bricked == 0 || f_shader_iso_only_bricked == 0 || f_shader_dvr_and_iso_bricked == 0 || f_shader_macro_cells == 0) {
         MD_LOG_ERROR("shader compilation failed, shader program for raycasting will not be updated");
         return;
     }
@@ -171,6 +211,10 @@ void initialize() {
     if (!gl.program.dvr_only) gl.program.dvr_only = glCreateProgram();
     if (!gl.program.iso_only) gl.program.iso_only = glCreateProgram();
     if (!gl.program.dvr_and_iso) gl.program.dvr_and_iso = glCreateProgram();
+    if (!gl.program.dvr_only_bricked) gl.program.dvr_only_bricked = glCreateProgram();
+    if (!gl.program.iso_only_bricked) gl.program.iso_only_bricked = glCreateProgram();
+    if (!gl.program.dvr_and_iso_bricked) gl.program.dvr_and_iso_bricked = glCreateProgram();
+    if (!gl.program.macro_cells) gl.program.macro_cells = glCreateProgram();
 
     {
         const GLuint shaders[] = {v_shader_entry_exit, f_shader_entry_exit};
@@ -192,6 +236,22 @@ void initialize() {
         const GLuint shaders[] = {v_shader_vol, f_shader_dvr_and_iso};
         gl::attach_link_detach(gl.program.dvr_and_iso, shaders, (int)ARRAY_SIZE(shaders));
     }
+    {
+        const GLuint shaders[] = {v_shader_vol, f_shader_dvr_only_bricked};
+        gl::attach_link_detach(gl.program.dvr_only_bricked, shaders, (int)ARRAY_SIZE(shaders));
+    }
+    {
+        const GLuint shaders[] = {v_shader_vol, f_shader_iso_only_bricked};
+        gl::attach_link_detach(gl.program.iso_only_bricked, shaders, (int)ARRAY_SIZE(shaders));
+    }
+    {
+        const GLuint shaders[] = {v_shader_vol, f_shader_dvr_and_iso_bricked};
+        gl::attach_link_detach(gl.program.dvr_and_iso_bricked, shaders, (int)ARRAY_SIZE(shaders));
+    }
+    {
+        const GLuint shaders[] = {v_shader_vol, f_shader_macro_cells};
+        gl::attach_link_detach(gl.program.macro_cells, shaders, (int)ARRAY_SIZE(shaders));
+    }
 
     if (!gl.vbo) {
         // https://stackoverflow.com/questions/28375338/cube-using-single-gl-triangle-strip
@@ -319,8 +379,249 @@ void compute_transfer_function_texture(uint32_t* tex, int colormap, ramp_type_t
     md_temp_set_pos_back(temp_pos);
 }
 
+#define PADDED_BRICK_DIM (SPARSE_VOLUME_BRICK_DIM + 2)
+
+// Round to nearest even, values beyond the range of half floats become infinite
+static inline uint16_t float_to_half(float value) {
+    const uint32_t f32_inf = 255U << 23;
+    const uint32_t f16_max = (127U + 16U) << 23;
+    const uint32_t denorm_magic_bits = ((127U - 15U) + (23U - 10U) + 1U) << 23;
+
+    uint32_t x;
+    MEMCPY(&x, &value, sizeof(x));
+    const uint32_t sign = x & 0x80000000U;
+    x ^= sign;
+
+    uint16_t h;
+    if (x >= f16_max) {
+        h = (x > f32_inf) ? 0x7E00 : 0x7C00;
+    } else if (x < (113U << 23)) {
+        // Subnormal, the addition aligns the mantissa and performs the rounding
+        float f, denorm_magic;
+        MEMCPY(&f, &x, sizeof(f));
+        MEMCPY(&denorm_magic, &denorm_magic_bits, sizeof(denorm_magic));
+        f += denorm_magic;
+        MEMCPY(&x, &f, sizeof(x));
+        h = (uint16_t)(x - denorm_magic_bits);
+    } else {
+        const uint32_t mant_odd = (x >> 13) & 1;
+        x += ((uint32_t)(15 - 127) << 23) + 0xFFF;
+        x += mant_odd;
+        h = (uint16_t)(x >> 13);
+    }
+    return h | (uint16_t)(sign >> 16);
+}
+
+bool compute_bricked_volume_layout(BrickedVolume* vol, const viamd::sparse_volume_t* sparse, int max_texture_dim) {
+    ASSERT(vol);
+    ASSERT(sparse);
+
+    *vol = {};
+    MEMCPY(vol->dim, sparse->dim, sizeof(vol->dim));
+    MEMCPY(vol->brick_count, sparse->brick_count, sizeof(vol->brick_count));
+
+    const size_t num_occupied = viamd::sparse_volume_num_occupied_bricks(sparse);
+    if (num_occupied == 0) return true;
+
+    // The location of a brick is stored with 8 bits per axis within the index
+    const int max_bricks = MIN(max_texture_dim / PADDED_BRICK_DIM, 255);
+
+    // Pack the bricks into an atlas which is as cubic as possible, growing in z when the extent in x and y is exhausted
+    int* atlas_bricks = vol->atlas_bricks;
+    atlas_bricks[0] = MIN((int)ceilf(cbrtf((float)num_occupied)), max_bricks);
+    atlas_bricks[1] = MIN((int)((num_occupied + atlas_bricks[0] - 1) / atlas_bricks[0]), atlas_bricks[0]);
+    atlas_bricks[2] = (int)((num_occupied + atlas_bricks[0] * atlas_bricks[1] - 1) / (atlas_bricks[0] * atlas_bricks[1]));
+    if (atlas_bricks[2] > max_bricks) {
+        MD_LOG_ERROR("Sparse volume does not fit within the maximum 3D texture size");
+        return false;
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        vol->atlas_dim[i] = atlas_bricks[i] * PADDED_BRICK_DIM;
+    }
+    vol->num_bricks = (uint32_t)num_occupied;
+    return true;
+}
+
+size_t bricked_volume_atlas_bytes(const BrickedVolume& vol) {
+    return (size_t)vol.atlas_dim[0] * vol.atlas_dim[1] * vol.atlas_dim[2] * sizeof(uint16_t);
+}
+
+size_t bricked_volume_index_bytes(const BrickedVolume& vol) {
+    return (size_t)vol.brick_count[0] * vol.brick_count[1] * vol.brick_count[2] * sizeof(uint32_t);
+}
+
+void write_bricked_volume_rows(void* atlas_data, void* index_data, const BrickedVolume& vol, const viamd::sparse_volume_t* sparse, size_t row_beg, size_t row_end) {
+    ASSERT(atlas_data || vol.num_bricks == 0);
+    ASSERT(index_data);
+    ASSERT(sparse);
+
+    uint16_t* atlas = (uint16_t*)atlas_data;
+    uint32_t* index = (uint32_t*)index_data;
+    const int* count = vol.brick_count;
+    const int* atlas_bricks = vol.atlas_bricks;
+    const int* atlas_dim = vol.atlas_dim;
+
+    for (size_t row = row_beg; row < row_end; ++row) {
+        const int by = (int)(row % count[1]);
+        const int bz = (int)(row / count[1]);
+        for (int bx = 0; bx < count[0]; ++bx) {
+            uint32_t& entry = index[((size_t)bz * count[1] + by) * count[0] + bx];
+            const uint32_t slot = viamd::sparse_volume_brick_index(sparse, bx, by, bz);
+            if (slot == UINT32_MAX) {
+                entry = 0;
+                continue;
+            }
+
+            const int ax = (int)(slot % atlas_bricks[0]);
+            const int ay = (int)(slot / atlas_bricks[0] % atlas_bricks[1]);
+            const int az = (int)(slot / (atlas_bricks[0] * atlas_bricks[1]));
+            entry = (uint32_t)ax | ((uint32_t)ay << 8) | ((uint32_t)az << 16) | (0xFFU << 24);
+
+            // Neighbourhood of the brick, NULL where the neighbour is unoccupied or lies outside of the volume
+            const float* nbr[3][3][3];
+            for (int dz = 0; dz < 3; ++dz) {
+                for (int dy = 0; dy < 3; ++dy) {
+                    for (int dx = 0; dx < 3; ++dx) {
+                        const uint32_t n = viamd::sparse_volume_brick_index(sparse, bx + dx - 1, by + dy - 1, bz + dz - 1);
+                        nbr[dz][dy][dx] = (n == UINT32_MAX) ? NULL : sparse->bricks + (size_t)n * SPARSE_VOLUME_BRICK_SIZE;
+                    }
+                }
+            }
+
+            // Convert the rows of the brick, the apron is taken from the edges of the neighbouring bricks and is zero where they are unoccupied
+            // Voxels of the bricks which lie outside of the volume are stored as zero within the sparse volume
+            for (int z = 0; z < PADDED_BRICK_DIM; ++z) {
+                const int nz = (z == 0) ? 0 : (z == PADDED_BRICK_DIM - 1) ? 2 : 1;
+                const int lz = (z + SPARSE_VOLUME_BRICK_DIM - 1) % SPARSE_VOLUME_BRICK_DIM;
+                for (int y = 0; y < PADDED_BRICK_DIM; ++y) {
+                    const int ny = (y == 0) ? 0 : (y == PADDED_BRICK_DIM - 1) ? 2 : 1;
+                    const int ly = (y + SPARSE_VOLUME_BRICK_DIM - 1) % SPARSE_VOLUME_BRICK_DIM;
+                    const size_t src = ((size_t)lz * SPARSE_VOLUME_BRICK_DIM + ly) * SPARSE_VOLUME_BRICK_DIM;
+                    uint16_t* dst = atlas + ((size_t)(az * PADDED_BRICK_DIM + z) * atlas_dim[1] + (ay * PADDED_BRICK_DIM + y)) * atlas_dim[0] + ax * PADDED_BRICK_DIM;
+
+                    const float* l = nbr[nz][ny][0];
+                    const float* c = nbr[nz][ny][1];
+                    const float* r = nbr[nz][ny][2];
+                    dst[0] = l ? float_to_half(l[src + SPARSE_VOLUME_BRICK_DIM - 1]) : 0;
+                    for (int x = 0; x < SPARSE_VOLUME_BRICK_DIM; ++x) {
+                        dst[1 + x] = c ? float_to_half(c[src + x]) : 0;
+                    }
+                    dst[PADDED_BRICK_DIM - 1] = r ? float_to_half(r[src]) : 0;
+                }
+            }
+        }
+    }
+}
+
+void upload_bricked_volume(BrickedVolume* vol, const void* atlas, const void* index) {
+    ASSERT(vol);
+    if (vol->num_bricks == 0) return;
+
+    // The slots of the atlas beyond the last brick are left undefined, they are never referenced by the index
+    gl::init_texture_3D(&vol->atlas, vol->atlas_dim[0], vol->atlas_dim[1], vol->atlas_dim[2], GL_R16F);
+    gl::set_texture_3D_data(vol->atlas, atlas, GL_R16F);
+
+    const int* count = vol->brick_count;
+    if (!vol->index) glGenTextures(1, &vol->index);
+    glBindTexture(GL_TEXTURE_3D, vol->index);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8UI, count[0], count[1], count[2], 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, index);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+void free_bricked_volume(BrickedVolume* vol) {
+    ASSERT(vol);
+    if (vol->atlas) glDeleteTextures(1, &vol->atlas);
+    if (vol->index) glDeleteTextures(1, &vol->index);
+    *vol = {};
+}
+
+void compute_macro_cell_texture(uint32_t* macro_cell_tex, uint32_t volume_tex) {
+    ASSERT(macro_cell_tex);
+    if (!glIsTexture(volume_tex)) return;
+
+    int dim[3];
+    glBindTexture(GL_TEXTURE_3D, volume_tex);
+    glGetTexLevelParameteriv(GL_TEXTURE_3D, 0, GL_TEXTURE_WIDTH,  &dim[0]);
+    glGetTexLevelParameteriv(GL_TEXTURE_3D, 0, GL_TEXTURE_HEIGHT, &dim[1]);
+    glGetTexLevelParameteriv(GL_TEXTURE_3D, 0, GL_TEXTURE_DEPTH,  &dim[2]);
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    const int cells[3] = {
+        (dim[0] + MACRO_CELL_DIM - 1) / MACRO_CELL_DIM,
+        (dim[1] + MACRO_CELL_DIM - 1) / MACRO_CELL_DIM,
+        (dim[2] + MACRO_CELL_DIM - 1) / MACRO_CELL_DIM,
+    };
+    if (cells[0] == 0 || cells[1] == 0 || cells[2] == 0) return;
+
+    if (!*macro_cell_tex) glGenTextures(1, macro_cell_tex);
+    glBindTexture(GL_TEXTURE_3D, *macro_cell_tex);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_RG32F, cells[0], cells[1], cells[2], 0, GL_RG, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    GLint bound_fbo;
+    GLint bound_viewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &bound_fbo);
+    glGetIntegerv(GL_VIEWPORT, bound_viewport);
+    const GLboolean blend = glIsEnabled(GL_BLEND);
+    const GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+
+    PUSH_GPU_SECTION("VOLUME MACRO CELLS")
+    GLuint fbo = 0;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glViewport(0, 0, cells[0], cells[1]);
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_3D, volume_tex);
+
+    const GLuint prog = gl.program.macro_cells;
+    glUseProgram(prog);
+    glUniform1i(glGetUniformLocation(prog, "u_tex_volume"), 0);
+    glUniform1i(glGetUniformLocation(prog, "u_cell_dim"), MACRO_CELL_DIM);
+    const GLint uniform_loc_layer = glGetUniformLocation(prog, "u_layer");
+
+    glBindVertexArray(gl.vao);
+    for (int z = 0; z < cells[2]; ++z) {
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, *macro_cell_tex, 0, z);
+        glUniform1i(uniform_loc_layer, z);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, bound_fbo);
+    glDeleteFramebuffers(1, &fbo);
+    POP_GPU_SECTION()
+
+    glViewport(bound_viewport[0], bound_viewport[1], bound_viewport[2], bound_viewport[3]);
+    if (blend) glEnable(GL_BLEND);
+    if (depth_test) glEnable(GL_DEPTH_TEST);
+}
+
 void render_volume(const RenderDesc& desc) {
     if (!desc.dvr.enabled && !desc.iso.enabled) return;
+    // An empty bricked volume has no atlas and there is nothing to render
+    if (desc.bricked && !desc.bricked->atlas) return;
+    // The dense texture is released while the bricked representation is in use, and is absent until the first dense upload completes
+    if (!desc.bricked && !desc.texture.volume) return;
+
+    PUSH_GPU_SECTION("Render Volume")
 
     int    iso_count = CLAMP((int)desc.iso.count, 0, 8);
     float  iso_values[8];
@@ -455,12 +756,26 @@ void render_volume(const RenderDesc& desc) {
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, gl.tex_exit);
 
+    const bool bricked = desc.bricked != NULL;
+
     glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_3D, desc.texture.volume);
+    glBindTexture(GL_TEXTURE_3D, bricked ? desc.bricked->atlas : desc.texture.volume);
 
     glActiveTexture(GL_TEXTURE3);
     glBindTexture(GL_TEXTURE_2D, desc.texture.transfer_function);
 
+    if (bricked) {
+        glActiveTexture(GL_TEXTURE4);
+        glBindTexture(GL_TEXTURE_3D, desc.bricked->index);
+    }
+
+    // The macro cells are computed from the dense volume texture, and do not apply to the bricked representation
+    const bool macro_cells = desc.texture.macro_cells && !bricked;
+    if (macro_cells) {
+        glActiveTexture(GL_TEXTURE5);
+        glBindTexture(GL_TEXTURE_3D, desc.texture.macro_cells);
+    }
+
     glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gl.tex_result, 0);
     glDrawBuffer(GL_COLOR_ATTACHMENT0);
 
@@ -486,7 +801,12 @@ void render_volume(const RenderDesc& desc) {
 
     PUSH_GPU_SECTION("VOLUME RAYCASTING")
     {
-        const GLuint vol_prog = desc.dvr.enabled ? (desc.iso.enabled ? gl.program.dvr_and_iso : gl.program.dvr_only) : gl.program.iso_only;
+        GLuint vol_prog = 0;
+        if (bricked) {
+            vol_prog = desc.dvr.enabled ? (desc.iso.enabled ? gl.program.dvr_and_iso_bricked : gl.program.dvr_only_bricked) : gl.program.iso_only_bricked;
+        } else {
+            vol_prog = desc.dvr.enabled ? (desc.iso.enabled ? gl.program.dvr_and_iso : gl.program.dvr_only) : gl.program.iso_only;
+        }
 
         const GLint uniform_block_index     = glGetUniformBlockIndex(vol_prog, "UniformData");
         const GLint uniform_loc_tex_entry   = glGetUniformLocation(vol_prog, "u_tex_entry");
@@ -508,6 +828,17 @@ void render_volume(const RenderDesc& desc) {
         glUniform1i(uniform_loc_iso_count, (int)iso_count);
         glUniformBlockBinding(vol_prog, uniform_block_index, 0);
 
+        glUniform1i(glGetUniformLocation(vol_prog, "u_tex_macro_cells"), 5);
+        glUniform1i(glGetUniformLocation(vol_prog, "u_macro_cells_enabled"), macro_cells ? 1 : 0);
+        glUniform1f(glGetUniformLocation(vol_prog, "u_max_step_scale"), MAX(1.0f, desc.sampling.max_step_scale));
+
+        if (bricked) {
+            const BrickedVolume* b = desc.bricked;
+            glUniform1i(glGetUniformLocation(vol_prog, "u_tex_brick_index"), 4);
+            glUniform3f(glGetUniformLocation(vol_prog, "u_volume_dim"), (float)b->dim[0], (float)b->dim[1], (float)b->dim[2]);
+            glUniform3f(glGetUniformLocation(vol_prog, "u_inv_atlas_dim"), 1.0f / (float)b->atlas_dim[0], 1.0f / (float)b->atlas_dim[1], 1.0f / (float)b->atlas_dim[2]);
+        }
+
         glDrawArrays(GL_TRIANGLES, 0, 3);
 
         glBindVertexArray(0);
@@ -528,6 +859,7 @@ void render_volume(const RenderDesc& desc) {
             glDrawBuffers(bound_draw_buffer_count, (GLenum*)bound_draw_buffer);
     }
 
+    POP_GPU_SECTION()
 }
 
 }  // namespace volume
@@ -3,6 +3,10 @@
 #include <core/md_vec_math.h>
 #include <core/md_str.h>
 
+namespace viamd {
+struct sparse_volume_t;
+}
+
 namespace volume {
 
 void initialize();
@@ -22,6 +26,42 @@ enum ramp_type_t {
 // If you want a monotonic ramp (standard), you can for example use SAWTOOTH with a period of 1
 void compute_transfer_function_texture(uint32_t* texture, int implot_colormap, ramp_type_t ramp_type = RAMP_TYPE_SAWTOOTH, float ramp_scale = 1.0f, float ramp_period = 1.0f, int resolution = 128);
 
+// GPU representation of a sparse volume (see sparse_volume.h)
+// The occupied bricks are packed into a 3D atlas texture, where each brick is padded by a one voxel apron taken from its neighbours
+// in order to support trilinear filtering across brick boundaries. The index texture holds the location of each brick within the atlas.
+struct BrickedVolume {
+    uint32_t atlas = 0;
+    uint32_t index = 0;
+    int dim[3] = {};
+    int brick_count[3] = {};
+    int atlas_bricks[3] = {};   // Extent of the atlas in bricks
+    int atlas_dim[3] = {};
+    uint32_t num_bricks = 0;    // Number of occupied bricks stored in the atlas
+};
+
+// The construction is split into steps, such that the contents can be produced on the task pool and streamed through a pixel unpack buffer.
+// Only upload_bricked_volume and free_bricked_volume issue GL calls.
+
+// Computes the layout of the atlas for the sparse volume, returns false if it does not fit within the maximum 3D texture size
+bool compute_bricked_volume_layout(BrickedVolume* vol, const viamd::sparse_volume_t* sparse, int max_texture_dim);
+
+// Sizes of the atlas (half floats) and the index (RGBA8UI) given the layout
+size_t bricked_volume_atlas_bytes(const BrickedVolume& vol);
+size_t bricked_volume_index_bytes(const BrickedVolume& vol);
+
+// Writes the padded bricks and the index entries of the rows of bricks [row_beg, row_end), where row = bz * brick_count[1] + by
+// Disjoint ranges of rows write to disjoint memory and may be written concurrently
+void write_bricked_volume_rows(void* atlas, void* index, const BrickedVolume& vol, const viamd::sparse_volume_t* sparse, size_t row_beg, size_t row_end);
+
+// Creates the textures from the atlas and index data, which are interpreted as offsets into the bound pixel unpack buffer if there is one
+void upload_bricked_volume(BrickedVolume* vol, const void* atlas, const void* index);
+void free_bricked_volume(BrickedVolume* vol);
+
+// Computes a texture which holds the (min, max) value of each macro cell (8x8x8 voxels) of the volume texture.
+// The range of a cell covers all voxels which contribute to interpolated samples within it, which lets the ray-casting
+// skip cells that cannot contribute to the result. It has to be recomputed whenever the contents of the volume changes.
+void compute_macro_cell_texture(uint32_t* macro_cell_texture, uint32_t volume_texture);
+
 /*
     Renders a volumetric texture using OpenGL.
     - volume_texture: An OpenGL 3D texture containing the data
@@ -35,6 +75,9 @@ void compute_transfer_function_texture(uint32_t* texture, int implot_colormap, r
     - isosurface:     information on isovalues and associated colors
     - voxel_spacing:  spacing of voxels in world space
     - clip_planes:    define a subvolume (min, max)[0-1] which represents the visible portion of the volume
+    - macro_cells:    optional (min, max) macro cell texture of the volume (see compute_macro_cell_texture), enables empty space skipping
+    - bricked:        optional bricked representation of the volume, which is used in place of the volume texture if supplied
+    - max_step_scale: the step length grows with the accumulated opacity up to this scale of the base step length (1 = fixed step length)
 */
 
 struct RenderDesc {
@@ -49,6 +92,7 @@ struct RenderDesc {
     struct {
         uint32_t volume = 0;
         uint32_t transfer_function = 0;
+        uint32_t macro_cells = 0;
     } texture;
 
     struct {
@@ -102,6 +146,12 @@ struct RenderDesc {
     } shading;
 
     vec3_t voxel_spacing = {};
+
+    const BrickedVolume* bricked = NULL;
+
+    struct {
+        float max_step_scale = 1.0f;
+    } sampling;
 };
 
 void render_volume(const RenderDesc& desc);
@@ -43,10 +43,16 @@
 #include <gfx/immediate_draw_utils.h>
 #include <gfx/postprocessing_utils.h>
 #include <gfx/volumerender_utils.h>
+#include <gfx/ensemble_utils.h>
+#include <gfx/culling_utils.h>
+#include <gfx/picking_utils.h>
 
 #include <imgui_widgets.h>
 #include <implot_widgets.h>
 #include <task_system.h>
+#include <trajectory_sweep.h>
+#include <sparse_volume.h>
+#include <data_export.h>
 #include <color_utils.h>
 #include <loader.h>
 #include <image.h>
@@ -64,6 +70,11 @@
 
 #include <stdio.h>
 #include <bitset>
+#include <atomic>
+
+#if !MD_PLATFORM_WINDOWS
+#include <signal.h>
+#endif
 
 #include <viamd.h>
 #include <serialization_utils.h>
@@ -78,6 +89,12 @@
 #define IR_SEMAPHORE_MAX_COUNT 3
 #define MEASURE_EVALUATION_TIME 1
 #define FRAME_ALLOCATOR_BYTES MEGABYTES(256)
+#define PLOT_LOD_MIN_SAMPLES 4096   // Temporal properties with fewer samples are always plotted at full resolution
+#define PLOT_LOD_BASE_LEVEL 3       // The first level of detail holds buckets of 2^3 samples
+#define PLOT_LOD_MAX_LEVELS 32
+#define SCREENSHOT_MAX_DIM 16384     // Largest width or height of offscreen renders
+#define SCREENSHOT_TILE_MARGIN 64    // Guard band in pixels around the tiles of offscreen renders, covers the footprint of the screen space passes (DOF, SSAO, FXAA, sharpen)
+#define MOVIE_EXPORT_MAX_SLOTS 8     // Largest number of exported frames which are in flight
 
 #define LOG_INFO  MD_LOG_INFO
 #define LOG_DEBUG MD_LOG_DEBUG
@@ -91,6 +108,10 @@ static md_allocator_i* persistent_alloc = 0;
 static TextEditor editor {};
 static bool use_gfx = false;
 
+#if MEASURE_EVALUATION_TIME
+static md_timestamp_t eval_full_start_time = 0;
+#endif
+
 constexpr str_t header_snippet = STR_LIT(
 R"(#01010110#01001001#01000001#01001101#01000100#01001101#01000001#01001001#01010110#
 #                                                                                #
@@ -189,11 +210,7 @@ enum AtomBit_ {
     AtomBit_Highlighted = 1,
     AtomBit_Selected    = 2,
     AtomBit_Visible     = 4,
-};
-
-enum RepBit_ {
-    RepBit_DirtyColor   = 0x1,
-    RepBit_DirtyFilter  = 0x2
+    AtomBit_InView      = 8,
 };
 
 enum MarkerType_{
@@ -205,6 +222,9 @@ enum MarkerType_{
 
 // #struct Structure Declarations
 
+struct HistogramJob;
+struct PlotLod;
+
 // This is viamd's representation of a property
 struct DisplayProperty {
     enum Type {
@@ -248,6 +268,16 @@ struct DisplayProperty {
         double y_min;
         double y_max;
         md_allocator_i* alloc;
+
+        // Integer counts per bin (dim * (num_bins + 1), the extra bin per dimension collects values outside of the range)
+        // and the contiguous frame range [frame_beg, frame_end) they were computed from, empty if the frames were not contiguous.
+        // This allows the histogram of a sliding temporal window to be updated incrementally with the frames that enter and leave it.
+        md_array(uint32_t) counts = 0;
+        uint32_t frame_beg = 0;
+        uint32_t frame_end = 0;
+
+        // Pending asynchronous computation, its result is swapped in once complete
+        HistogramJob* job = 0;
     };
 
     Type type = Type_Temporal;
@@ -297,6 +327,20 @@ struct DisplayProperty {
     bool show_in_volume = false;
     bool partial_evaluation = false;
 
+    // Fraction of the frames which have been evaluated [0,1]
+    // The evaluation is progressive (coarse to fine), so the data is valid but sparse until the coverage reaches 1
+    float coverage = 1.0f;
+
+    // Number of evaluated frames when the histogram was last computed
+    size_t hist_frame_count = 0;
+
+    // Level of detail pyramid for plotting temporal data of long trajectories
+    PlotLod* lod = 0;
+
+    // Fingerprint of the timeline filter when the histogram was last computed
+    // (Only used for filtered properties which are derived from the full evaluation)
+    uint64_t filter_fingerprint = 0;
+
     // Encodes which indices of the population to show (if applicable, i.e. dim > 1)
     std::bitset<MAX_POPULATION_SIZE> population_mask = {};
 
@@ -382,11 +426,16 @@ static inline uint64_t generate_fingerprint() {
     return (uint64_t)md_time_current();
 }
 
+static void cancel_histogram_job(DisplayProperty::Histogram* hist);
+
 static void free_histogram(DisplayProperty::Histogram* hist) {
     ASSERT(hist);
     ASSERT(hist->alloc);
+    cancel_histogram_job(hist);
     md_array_free(hist->bins, hist->alloc);
+    md_array_free(hist->counts, hist->alloc);
     hist->bins = 0;
+    hist->counts = 0;
 }
 
 static void compute_histogram(float* bins, int num_bins, float bin_range_min, float bin_range_max, const float* values, int num_values, float* bin_val_min, float* bin_val_max) {
@@ -422,64 +471,492 @@ static void compute_histogram(float* bins, int num_bins, float bin_range_min, fl
     if (bin_val_max) *bin_val_max = max_val;
 }
 
-static void compute_histogram_masked(DisplayProperty::Histogram* hist, int num_bins, float value_range_min, float value_range_max, const float* values, int dim, const md_bitfield_t* mask, bool aggregate = false) {
+// Histograms of temporal properties are computed asynchronously on the task pool.
+// The frames are partitioned over the workers which bin into private per-thread bins, the last range to complete merges and normalizes the bins.
+struct HistogramJob {
+    const float* values;
+    int32_t* frame_indices;
+    uint32_t num_frames;
+    int dim;
+    int hist_dim;
+    int num_bins;
+    float value_min;
+    float value_max;
+
+    // Set if the frames form a contiguous range
+    uint32_t frame_beg;
+    uint32_t frame_end;
+
+    // num_threads * hist_dim * (num_bins + 1), the extra bin per dimension collects values which fall outside of the range
+    uint32_t* thread_bins;
+    uint32_t num_threads;
+
+    // Result
+    uint32_t* counts;   // hist_dim * (num_bins + 1)
+    float* bins;        // hist_dim * num_bins
+    float bin_min;
+    float bin_max;
+
+    task_system::ID task;
+    std::atomic_uint32_t frames_binned;
+    std::atomic_bool done;
+};
+
+static inline size_t histogram_job_thread_bin_count(const HistogramJob* job) {
+    return (size_t)job->num_threads * job->hist_dim * (job->num_bins + 1);
+}
+
+static void histogram_job_free(HistogramJob* job) {
+    ASSERT(job);
+    md_allocator_i* alloc = md_get_heap_allocator();
+    md_free(alloc, job->frame_indices, job->num_frames * sizeof(int32_t));
+    md_free(alloc, job->thread_bins, histogram_job_thread_bin_count(job) * sizeof(uint32_t));
+    md_free(alloc, job->counts, (size_t)job->hist_dim * (job->num_bins + 1) * sizeof(uint32_t));
+    md_free(alloc, job->bins, (size_t)job->hist_dim * job->num_bins * sizeof(float));
+    job->~HistogramJob();
+    md_free(alloc, job, sizeof(HistogramJob));
+}
+
+// Normalizes integer counts (hist_dim * (num_bins + 1)) into a density (hist_dim * num_bins), the extra bin per dimension is ignored
+static void histogram_normalize(float* bins, float* bin_min, float* bin_max, const uint32_t* counts, int hist_dim, int num_bins, float value_range_min, float value_range_max) {
+    float min_bin =  FLT_MAX;
+    float max_bin = -FLT_MAX;
+    const float width = (value_range_max - value_range_min) / num_bins;
+    for (int i = 0; i < hist_dim; ++i) {
+        const uint32_t* src = counts + (size_t)(num_bins + 1) * i;
+        float* dst = bins + (size_t)num_bins * i;
+
+        uint32_t count = 0;
+        for (int j = 0; j < num_bins; ++j) {
+            count += src[j];
+        }
+
+        const float scl = count > 0 ? 1.0f / (width * count) : 0.0f;
+        for (int j = 0; j < num_bins; ++j) {
+            dst[j] = src[j] * scl;
+            min_bin = MIN(min_bin, dst[j]);
+            max_bin = MAX(max_bin, dst[j]);
+        }
+    }
+
+    *bin_min = min_bin;
+    *bin_max = max_bin;
+}
+
+// Adds delta to the bins of the values of a single frame, delta = UINT32_MAX removes the frame.
+// bin_idx is scratch space of length dim.
+static inline void histogram_bin_frame(uint32_t* bins, int* bin_idx, const float* values, int dim, bool aggregate, int num_bins, float value_range_min, float value_range_max, uint32_t delta) {
+    const float scl = num_bins / (value_range_max - value_range_min);
+    const float max_bin = (float)(num_bins - 1);
+
+    // Branch free computation of the bin indices so that the compiler can vectorize it
+    // Values which fall outside of the range are directed to the extra bin
+    for (int i = 0; i < dim; ++i) {
+        const float v = values[i];
+        const int  idx = (int)CLAMP((v - value_range_min) * scl, 0.0f, max_bin);
+        const bool valid = (value_range_min <= v) & (v <= value_range_max);
+        bin_idx[i] = valid ? idx : num_bins;
+    }
+
+    if (aggregate) {
+        for (int i = 0; i < dim; ++i) {
+            bins[bin_idx[i]] += delta;
+        }
+    } else {
+        for (int i = 0; i < dim; ++i) {
+            bins[(num_bins + 1) * i + bin_idx[i]] += delta;
+        }
+    }
+}
+
+static void histogram_job_merge(HistogramJob* job) {
+    const size_t count = (size_t)job->hist_dim * (job->num_bins + 1);
+    MEMSET(job->counts, 0, count * sizeof(uint32_t));
+    for (uint32_t t = 0; t < job->num_threads; ++t) {
+        const uint32_t* src = job->thread_bins + count * t;
+        for (size_t i = 0; i < count; ++i) {
+            job->counts[i] += src[i];
+        }
+    }
+    histogram_normalize(job->bins, &job->bin_min, &job->bin_max, job->counts, job->hist_dim, job->num_bins, job->value_min, job->value_max);
+}
+
+static void histogram_job_bin_range(uint32_t range_beg, uint32_t range_end, void* user_data, uint32_t thread_num) {
+    HistogramJob* job = (HistogramJob*)user_data;
+    ASSERT(thread_num < job->num_threads);
+
+    const int dim = job->dim;
+    const bool aggregate = job->hist_dim == 1;
+    uint32_t* bins = job->thread_bins + (size_t)thread_num * job->hist_dim * (job->num_bins + 1);
+
+    md_allocator_i* alloc = md_get_heap_allocator();
+    int* bin_idx = (int*)md_alloc(alloc, sizeof(int) * dim);
+    defer { md_free(alloc, bin_idx, sizeof(int) * dim); };
+
+    for (uint32_t f = range_beg; f < range_end; ++f) {
+        const float* values = job->values + (size_t)job->frame_indices[f] * dim;
+        histogram_bin_frame(bins, bin_idx, values, dim, aggregate, job->num_bins, job->value_min, job->value_max, 1);
+    }
+
+    // The last range to complete merges the result
+    const uint32_t count = range_end - range_beg;
+    if (job->frames_binned.fetch_add(count) + count == job->num_frames) {
+        histogram_job_merge(job);
+        job->done = true;
+    }
+}
+
+// Interrupts and waits for a pending histogram computation, its result is discarded
+static void cancel_histogram_job(DisplayProperty::Histogram* hist) {
+    ASSERT(hist);
+    if (hist->job) {
+        task_system::task_interrupt_and_wait_for(hist->job->task);
+        histogram_job_free(hist->job);
+        hist->job = 0;
+    }
+}
+
+// Returns true if the histogram has a pending computation.
+// If the computation is complete, the result is swapped into the histogram.
+static bool update_histogram_job(DisplayProperty::Histogram* hist) {
+    ASSERT(hist);
+    HistogramJob* job = hist->job;
+    if (!job) return false;
+
+    if (job->done) {
+        md_array_resize(hist->bins, (size_t)(job->hist_dim * job->num_bins), hist->alloc);
+        MEMCPY(hist->bins, job->bins, md_array_bytes(hist->bins));
+        md_array_resize(hist->counts, (size_t)(job->hist_dim * (job->num_bins + 1)), hist->alloc);
+        MEMCPY(hist->counts, job->counts, md_array_bytes(hist->counts));
+        hist->frame_beg = job->frame_beg;
+        hist->frame_end = job->frame_end;
+        hist->dim = job->hist_dim;
+        hist->num_bins = job->num_bins;
+        hist->x_min = job->value_min;
+        hist->x_max = job->value_max;
+        hist->y_min = job->bin_min;
+        hist->y_max = job->bin_max;
+    } else if (task_system::task_is_running(job->task)) {
+        return true;
+    }
+
+    // Either complete or interrupted
+    histogram_job_free(job);
+    hist->job = 0;
+    return false;
+}
+
+// Updates the histogram to represent the frames [frame_beg, frame_end) by only adding and removing the frames which enter and leave the range.
+// All frames within the range are assumed to be evaluated.
+// Returns false if the histogram cannot be updated incrementally, in which case it has to be recomputed.
+static bool update_histogram_window(DisplayProperty::Histogram* hist, int num_bins, float value_range_min, float value_range_max, const float* values, int dim, uint32_t frame_beg, uint32_t frame_end, bool aggregate = false) {
+    ASSERT(hist);
+    ASSERT(values);
+    ASSERT(dim > 0);
+
+    const int hist_dim = aggregate ? 1 : dim;
+    if (hist->job) return false;
+    if (hist->frame_beg >= hist->frame_end || frame_beg >= frame_end) return false;
+    if (hist->num_bins != num_bins || hist->dim != hist_dim) return false;
+    if ((float)hist->x_min != value_range_min || (float)hist->x_max != value_range_max) return false;
+    if (md_array_size(hist->counts) != (size_t)(hist_dim * (num_bins + 1))) return false;
+    if (hist->frame_beg == frame_beg && hist->frame_end == frame_end) return true;
+
+    const uint32_t overlap_beg = MAX(frame_beg, hist->frame_beg);
+    const uint32_t overlap_end = MIN(frame_end, hist->frame_end);
+    if (overlap_end <= overlap_beg) return false;
+
+    // If the delta is larger than the range itself, we are better off with a (parallel) recomputation
+    const uint32_t overlap = overlap_end - overlap_beg;
+    const uint32_t delta = (hist->frame_end - hist->frame_beg - overlap) + (frame_end - frame_beg - overlap);
+    if (delta > frame_end - frame_beg) return false;
+
+    int* bin_idx = (int*)md_alloc(frame_alloc, sizeof(int) * dim);
+
+    // Remove the frames which left the range
+    for (uint32_t f = hist->frame_beg; f < overlap_beg; ++f) {
+        histogram_bin_frame(hist->counts, bin_idx, values + (size_t)f * dim, dim, aggregate, num_bins, value_range_min, value_range_max, UINT32_MAX);
+    }
+    for (uint32_t f = overlap_end; f < hist->frame_end; ++f) {
+        histogram_bin_frame(hist->counts, bin_idx, values + (size_t)f * dim, dim, aggregate, num_bins, value_range_min, value_range_max, UINT32_MAX);
+    }
+
+    // Add the frames which entered the range
+    for (uint32_t f = frame_beg; f < overlap_beg; ++f) {
+        histogram_bin_frame(hist->counts, bin_idx, values + (size_t)f * dim, dim, aggregate, num_bins, value_range_min, value_range_max, 1);
+    }
+    for (uint32_t f = overlap_end; f < frame_end; ++f) {
+        histogram_bin_frame(hist->counts, bin_idx, values + (size_t)f * dim, dim, aggregate, num_bins, value_range_min, value_range_max, 1);
+    }
+
+    hist->frame_beg = frame_beg;
+    hist->frame_end = frame_end;
+
+    float bin_min, bin_max;
+    md_array_resize(hist->bins, (size_t)(hist_dim * num_bins), hist->alloc);
+    histogram_normalize(hist->bins, &bin_min, &bin_max, hist->counts, hist_dim, num_bins, value_range_min, value_range_max);
+    hist->y_min = bin_min;
+    hist->y_max = bin_max;
+
+    return true;
+}
+
+static void compute_histogram_masked_async(DisplayProperty::Histogram* hist, int num_bins, float value_range_min, float value_range_max, const float* values, int dim, const md_bitfield_t* mask, bool aggregate = false) {
     ASSERT(hist);
     ASSERT(values);
     ASSERT(mask);
     ASSERT(dim > 0);
+    ASSERT(num_bins > 0);
+
+    cancel_histogram_job(hist);
+
+    const int hist_dim = aggregate ? 1 : dim;
+    const size_t num_frames = md_bitfield_popcount(mask);
+    const size_t num_threads = task_system::pool_num_threads();
 
-    md_vm_arena_temp_t temp = md_vm_arena_temp_begin(frame_alloc);
-    defer { md_vm_arena_temp_end(temp); };
+    if (num_frames == 0 || value_range_max <= value_range_min || num_threads == 0) {
+        // Nothing to bin
+        hist->dim = hist_dim;
+        md_array_resize(hist->bins, (size_t)(hist_dim * num_bins), hist->alloc);
+        MEMSET(hist->bins, 0, md_array_bytes(hist->bins));
+        hist->num_bins = num_bins;
+        hist->x_min = value_range_min;
+        hist->x_max = value_range_max;
+        hist->y_min = 0;
+        hist->y_max = 0;
+        md_array_shrink(hist->counts, 0);
+        hist->frame_beg = 0;
+        hist->frame_end = 0;
+        return;
+    }
 
-    hist->dim = aggregate ? 1 : dim;
-    md_array_resize(hist->bins, (size_t)(hist->dim * num_bins), hist->alloc);
-    MEMSET(hist->bins, 0, md_array_bytes(hist->bins));
+    md_allocator_i* alloc = md_get_heap_allocator();
+    HistogramJob* job = (HistogramJob*)md_alloc(alloc, sizeof(HistogramJob));
+    new (job) HistogramJob();
+    job->values = values;
+    job->num_frames = (uint32_t)num_frames;
+    job->dim = dim;
+    job->hist_dim = hist_dim;
+    job->num_bins = num_bins;
+    job->value_min = value_range_min;
+    job->value_max = value_range_max;
+    job->num_threads = (uint32_t)num_threads;
+
+    // Extract the frame indices up front, this traverses the mask one word at a time rather than one bit at a time
+    job->frame_indices = (int32_t*)md_alloc(alloc, num_frames * sizeof(int32_t));
+    md_bitfield_iter_extract_indices(job->frame_indices, num_frames, md_bitfield_iter_create(mask));
+    if ((size_t)(job->frame_indices[num_frames - 1] - job->frame_indices[0] + 1) == num_frames) {
+        job->frame_beg = (uint32_t)job->frame_indices[0];
+        job->frame_end = (uint32_t)job->frame_indices[num_frames - 1] + 1;
+    }
+
+    const size_t thread_bin_bytes = histogram_job_thread_bin_count(job) * sizeof(uint32_t);
+    job->thread_bins = (uint32_t*)md_alloc(alloc, thread_bin_bytes);
+    MEMSET(job->thread_bins, 0, thread_bin_bytes);
+    job->counts = (uint32_t*)md_alloc(alloc, (size_t)hist_dim * (num_bins + 1) * sizeof(uint32_t));
+    job->bins = (float*)md_alloc(alloc, (size_t)hist_dim * num_bins * sizeof(float));
+
+    job->task = task_system::create_pool_task(STR_LIT("##Compute Histogram"), 0, job->num_frames, histogram_job_bin_range, job);
+    hist->job = job;
+    task_system::enqueue_task(job->task);
+}
 
-    const size_t num_samples = md_bitfield_popcount(mask) * dim;
-    if (num_samples == 0) return;
+// Level of detail pyramid of temporal data, such that the cost of plotting long trajectories is proportional to the number of pixels
+// Level l holds buckets of 2^l consecutive samples with the min, max and mean of their y-values, for each population index
+// The levels are built asynchronously once the evaluation is complete
+struct PlotLodBucket {
+    float y_min;
+    float y_max;
+    float y_mean;
+};
 
-    const float range_ext = value_range_max - value_range_min;
-    const float inv_range = range_ext > 0.0f ? 1.0f / range_ext : 0.0f;
+struct PlotLod {
+    const DisplayProperty* dp;
+    int dim;
+    int num_samples;
+    int num_levels;
 
-    int* count = (int*)md_vm_arena_push_zero_array(frame_alloc, int, hist->dim);
+    // Offset and number of buckets for level (PLOT_LOD_BASE_LEVEL + i) within the buckets of a population index
+    size_t level_offset[PLOT_LOD_MAX_LEVELS];
+    size_t level_count[PLOT_LOD_MAX_LEVELS];
+    size_t stride;
 
-    // We evaluate each frame, one at a time
-    md_bitfield_iter_t it = md_bitfield_iter_create(mask);
-    while (md_bitfield_iter_next(&it)) {
-        const int val_idx = dim * (int)md_bitfield_iter_idx(&it);
-        for (int i = 0; i < dim; ++i) {
-            const float val = values[val_idx + i];
-            if (val < value_range_min || value_range_max < val) continue;
-            const int bin_idx = CLAMP((int)(((val - value_range_min) * inv_range) * num_bins), 0, num_bins - 1);
+    PlotLodBucket* buckets; // dim * stride
 
-            if (aggregate) {
-                hist->bins[bin_idx] += 1.0f;
-                count[0] += 1;
-            } else {
-                hist->bins[num_bins * i + bin_idx] += 1.0f;
-                count[i] += 1;
+    uint64_t fingerprint;
+    task_system::ID task;
+    std::atomic_uint32_t dims_complete;
+};
+
+// Number of samples covered by bucket b of the given level
+static inline int plot_lod_bucket_size(int level, size_t b, int num_samples) {
+    const size_t beg = b << level;
+    const size_t end = MIN((b + 1) << level, (size_t)num_samples);
+    return (int)(end - beg);
+}
+
+static void plot_lod_build_range(uint32_t range_beg, uint32_t range_end, void* user_data, uint32_t thread_num) {
+    (void)thread_num;
+    PlotLod* lod = (PlotLod*)user_data;
+    const DisplayProperty* dp = lod->dp;
+
+    for (uint32_t k = range_beg; k < range_end; ++k) {
+        DisplayProperty::Payload payload = {
+            .display_prop = (DisplayProperty*)dp,
+            .dim_idx = (int)k,
+        };
+
+        PlotLodBucket* buckets = lod->buckets + lod->stride * k;
+
+        // The base level is computed from the samples, for areas the second getter gives the other bound
+        PlotLodBucket* dst = buckets + lod->level_offset[0];
+        for (size_t b = 0; b < lod->level_count[0]; ++b) {
+            const int s_beg = (int)(b << PLOT_LOD_BASE_LEVEL);
+            const int s_end = s_beg + plot_lod_bucket_size(PLOT_LOD_BASE_LEVEL, b, lod->num_samples);
+            float y_min =  FLT_MAX;
+            float y_max = -FLT_MAX;
+            double y_sum = 0;
+            for (int s = s_beg; s < s_end; ++s) {
+                const float lo = (float)dp->getter[0](s, &payload).y;
+                const float hi = dp->getter[1] ? (float)dp->getter[1](s, &payload).y : lo;
+                y_min = MIN(y_min, MIN(lo, hi));
+                y_max = MAX(y_max, MAX(lo, hi));
+                y_sum += 0.5 * (lo + hi);
+            }
+            dst[b] = {y_min, y_max, (float)(y_sum / (s_end - s_beg))};
+        }
+
+        // The remaining levels are computed from the previous level
+        for (int i = 1; i < lod->num_levels; ++i) {
+            const int src_level = PLOT_LOD_BASE_LEVEL + i - 1;
+            const PlotLodBucket* src = buckets + lod->level_offset[i - 1];
+            const size_t src_count = lod->level_count[i - 1];
+            dst = buckets + lod->level_offset[i];
+            for (size_t b = 0; b < lod->level_count[i]; ++b) {
+                const size_t b0 = 2 * b;
+                const size_t b1 = 2 * b + 1;
+                if (b1 < src_count) {
+                    const float w0 = (float)plot_lod_bucket_size(src_level, b0, lod->num_samples);
+                    const float w1 = (float)plot_lod_bucket_size(src_level, b1, lod->num_samples);
+                    dst[b] = {
+                        MIN(src[b0].y_min, src[b1].y_min),
+                        MAX(src[b0].y_max, src[b1].y_max),
+                        (src[b0].y_mean * w0 + src[b1].y_mean * w1) / (w0 + w1),
+                    };
+                } else {
+                    dst[b] = src[b0];
+                }
             }
         }
+
+        lod->dims_complete += 1;
     }
+}
 
-    float min_bin =  FLT_MAX;
-    float max_bin = -FLT_MAX;
-    const float width = range_ext / num_bins;
-    for (int i = 0; i < hist->dim; ++i) {
-        const float scl = 1.0f / (width * count[i]);
-        for (int j = 0; j < num_bins; ++j) {
-            float& val = hist->bins[num_bins * i + j];
-            val *= scl;
-            min_bin = MIN(min_bin, val);
-            max_bin = MAX(max_bin, val);
-        }
+static void plot_lod_free(PlotLod* lod) {
+    ASSERT(lod);
+    md_allocator_i* alloc = md_get_heap_allocator();
+    md_free(alloc, lod->buckets, lod->dim * lod->stride * sizeof(PlotLodBucket));
+    lod->~PlotLod();
+    md_free(alloc, lod, sizeof(PlotLod));
+}
+
+static void cancel_plot_lod(DisplayProperty* dp) {
+    ASSERT(dp);
+    if (dp->lod) {
+        task_system::task_interrupt_and_wait_for(dp->lod->task);
+        plot_lod_free(dp->lod);
+        dp->lod = 0;
+    }
+}
+
+static inline bool plot_lod_ready(const DisplayProperty& dp) {
+    const PlotLod* lod = dp.lod;
+    return lod && lod->dims_complete == (uint32_t)lod->dim && lod->num_samples == dp.num_samples && lod->fingerprint == dp.prop_data->fingerprint;
+}
+
+static void update_plot_lod(DisplayProperty* dp) {
+    ASSERT(dp);
+    if (dp->lod) {
+        if (task_system::task_is_running(dp->lod->task)) return;
+        if (plot_lod_ready(*dp)) return;
+        // Stale or interrupted
+        plot_lod_free(dp->lod);
+        dp->lod = 0;
+    }
+
+    if (dp->coverage < 1.0f || dp->num_samples < PLOT_LOD_MIN_SAMPLES || !dp->getter[0] || !dp->prop_data) return;
+
+    md_allocator_i* alloc = md_get_heap_allocator();
+    PlotLod* lod = (PlotLod*)md_alloc(alloc, sizeof(PlotLod));
+    new (lod) PlotLod();
+    lod->dp = dp;
+    lod->dim = CLAMP(dp->dim, 1, MAX_POPULATION_SIZE);
+    lod->num_samples = dp->num_samples;
+    lod->fingerprint = dp->prop_data->fingerprint;
+
+    size_t count = ((size_t)dp->num_samples + (1 << PLOT_LOD_BASE_LEVEL) - 1) >> PLOT_LOD_BASE_LEVEL;
+    while (lod->num_levels < PLOT_LOD_MAX_LEVELS) {
+        lod->level_offset[lod->num_levels] = lod->stride;
+        lod->level_count[lod->num_levels] = count;
+        lod->stride += count;
+        lod->num_levels += 1;
+        if (count == 1) break;
+        count = (count + 1) / 2;
+    }
+
+    lod->buckets = (PlotLodBucket*)md_alloc(alloc, lod->dim * lod->stride * sizeof(PlotLodBucket));
+    lod->task = task_system::create_pool_task(STR_LIT("##Build Plot LOD"), 0, lod->dim, plot_lod_build_range, lod);
+    dp->lod = lod;
+    task_system::enqueue_task(lod->task);
+}
+
+// Selects the level of detail for plotting num_visible samples within a plot of width_in_pixels.
+// Returns 0 if the samples should be plotted at full resolution.
+static int plot_lod_select_level(const PlotLod* lod, int num_visible, float width_in_pixels) {
+    const double max_samples = MAX(2.0 * width_in_pixels, 64.0);
+    int level = 0;
+    while (level < PLOT_LOD_BASE_LEVEL + lod->num_levels - 1 && num_visible / (double)(1 << level) > max_samples) {
+        level += 1;
     }
+    return level < PLOT_LOD_BASE_LEVEL ? 0 : level;
+}
+
+struct PlotLodPayload {
+    const PlotLodBucket* buckets;
+    const float* x_values;
+    int level;
+    int offset;
+    int num_samples;
+};
+
+static inline double plot_lod_x(const PlotLodPayload* p, int b) {
+    // Use the center sample of the bucket
+    const int s = MIN(((p->offset + b) << p->level) + (1 << (p->level - 1)), p->num_samples - 1);
+    return p->x_values[s];
+}
+
+static ImPlotPoint get_lod_min(int idx, void* user_data) {
+    const PlotLodPayload* p = (const PlotLodPayload*)user_data;
+    return ImPlotPoint(plot_lod_x(p, idx), p->buckets[idx].y_min);
+}
+
+static ImPlotPoint get_lod_max(int idx, void* user_data) {
+    const PlotLodPayload* p = (const PlotLodPayload*)user_data;
+    return ImPlotPoint(plot_lod_x(p, idx), p->buckets[idx].y_max);
+}
+
+static ImPlotPoint get_lod_mean(int idx, void* user_data) {
+    const PlotLodPayload* p = (const PlotLodPayload*)user_data;
+    return ImPlotPoint(plot_lod_x(p, idx), p->buckets[idx].y_mean);
+}
 
-    hist->num_bins = num_bins;
-    hist->x_min = value_range_min;
-    hist->x_max = value_range_max;
-    hist->y_min = min_bin;
-    hist->y_max = max_bin;
+// Cancels pending asynchronous work which reads from the display properties and their evaluation data
+static void cancel_display_property_jobs(ApplicationState* data) {
+    for (size_t i = 0; i < md_array_size(data->display_properties); ++i) {
+        cancel_histogram_job(&data->display_properties[i].hist);
+        cancel_plot_lod(&data->display_properties[i]);
+    }
 }
 
 static void downsample_histogram(float* dst_bins, int num_dst_bins, const float* src_bins, const float* src_weights, int num_src_bins) {
@@ -629,9 +1106,11 @@ static void clear_dataset_items(ApplicationState* data);
 
 static void init_display_properties(ApplicationState* data);
 static void update_display_properties(ApplicationState* data);
+static bool requires_filtered_evaluation(const md_script_ir_t* ir);
 
 static void update_density_volume(ApplicationState* data);
 static void clear_density_volume(ApplicationState* data);
+static void cancel_density_volume_jobs(ApplicationState* data);
 
 static void interpolate_atomic_properties(ApplicationState* data);
 static void update_view_param(ApplicationState* data);
@@ -642,6 +1121,9 @@ static void handle_camera_interaction(ApplicationState* data);
 //static void init_display_properties(ApplicationState* data);
 //static void update_density_volume_texture(ApplicationState* data);
 static void handle_picking(ApplicationState* data);
+static void request_selection_region(ApplicationState* data, int x, int y, int width, int height, SelectionOperator op, bool commit);
+static void update_selection_region(ApplicationState* data);
+static void free_selection_region(ApplicationState* data);
 
 static void fill_gbuffer(ApplicationState* data);
 static void apply_postprocessing(const ApplicationState& data);
@@ -655,6 +1137,7 @@ static void draw_main_menu(ApplicationState* data);
 static void draw_context_popup(ApplicationState* data);
 static void draw_selection_query_window(ApplicationState* data);
 static void draw_selection_grow_window(ApplicationState* data);
+static void cancel_selection_grow_job(ApplicationState* data);
 static void draw_animation_window(ApplicationState* data);
 static void draw_representations_window(ApplicationState* data);
 static void draw_timeline_window(ApplicationState* data);
@@ -668,7 +1151,11 @@ static void draw_debug_window(ApplicationState* data);
 static void draw_property_export_window(ApplicationState* data);
 static void draw_notifications_window();
 
+static void print_color_benchmark(ApplicationState* data, int num_atoms);
+
 static void update_md_buffers(ApplicationState* data);
+static void update_culling(ApplicationState* data);
+static void update_dynamic_resolution(ApplicationState* data);
 
 static void init_molecule_data(ApplicationState* data);
 static void init_trajectory_data(ApplicationState* data);
@@ -680,10 +1167,17 @@ static bool load_dataset_from_file(ApplicationState* data, const LoadParam& para
 static void load_workspace(ApplicationState* data, str_t file);
 static void save_workspace(ApplicationState* data, str_t file);
 
-static bool export_xvg(const float* column_data[], const char* column_labels[], size_t num_columns, size_t num_rows, str_t filename);
-static bool export_csv(const float* column_data[], const char* column_labels[], size_t num_columns, size_t num_rows, str_t filename);
 
 static void create_screenshot(ApplicationState* data);
+static void create_high_res_render(ApplicationState* data, str_t path, int width, int height);
+static void update_screenshot_jobs(ApplicationState* data);
+static void free_screenshot_jobs(ApplicationState* data);
+
+static bool start_movie_export(ApplicationState* data);
+static void update_movie_export(ApplicationState* data);
+static void capture_movie_frame(ApplicationState* data);
+static void free_movie_export(ApplicationState* data);
+static void draw_movie_export_window(ApplicationState* data);
 
 // Representations
 static Representation* create_representation(ApplicationState* data, RepresentationType type = RepresentationType::SpaceFill,
@@ -692,12 +1186,15 @@ static Representation* clone_representation(ApplicationState* data, const Repres
 static void remove_representation(ApplicationState*, int idx);
 static void update_representation(ApplicationState*, Representation* rep);
 static void update_representation_info(ApplicationState*);
-static void update_all_representations(ApplicationState*);
+static void update_all_representations(ApplicationState*, uint32_t dirty_flags = RepBit_DirtyAll);
 static void init_representation(ApplicationState*, Representation* rep);
 static void init_all_representations(ApplicationState*);
 static void clear_representations(ApplicationState*);
 static void create_default_representations(ApplicationState*);
 static void recompute_atom_visibility_mask(ApplicationState*);
+static void free_representation_property(Representation* rep);
+static bool property_color_job_done(const PropertyColorJob* job);
+static const DisplayProperty* find_representation_property(const ApplicationState* state, const Representation* rep);
 
 // Selections
 static Selection* create_selection(ApplicationState* data, str_t name, md_bitfield_t* bf = 0);
@@ -705,6 +1202,7 @@ static void remove_selection(ApplicationState* data, int idx);
 static void clear_selections(ApplicationState* data);
 
 static bool filter_expression(ApplicationState* data, str_t expr, md_bitfield_t* mask, bool* is_dynamic, char* error_str, int error_cap);
+static void prefetch_representation_filters(ApplicationState* data);
 
 static void modify_selection(ApplicationState* data, md_bitfield_t* atom_mask, SelectionOperator op = SelectionOperator::Set) {
     ASSERT(data);
@@ -721,6 +1219,100 @@ static void set_hovered_property(ApplicationState* data, str_t label, int popula
     data->hovered_display_property_pop_idx = population_idx;
 }
 
+struct CommandLine {
+    md_array(const char*) files = 0;
+    int width  = 0;
+    int height = 0;
+    bool headless = false;
+    bool help = false;
+    int benchmark_colors = 0;   // Number of synthetic atoms of the color kernel benchmark, zero if no benchmark is requested
+
+    bool export_frames = false;
+    const char* export_path = 0;
+    const char* export_command = 0;
+    double frames[3] = {0, -1, 1};  // Begin, end and stride of the export, a negative end corresponds to the last frame
+};
+
+static void print_usage() {
+    printf("Usage: viamd [options] [files...]\n"
+           "Options:\n"
+           "  --export <file>             Export the frames of the trajectory as images (jpg, png, bmp), the index of the frame is appended to the file name\n"
+           "  --pipe <command>            Export the frames as raw RGBA to the standard input of the command, {width} and {height} are replaced by the dimensions\n"
+           "  --frames <beg:end[:stride]> Range of the exported frames, defaults to all frames\n"
+           "  --size <width>x<height>     Size of the window, which is the resolution of the exported frames\n"
+           "  --headless                  Run without showing the window and exit once the export is complete\n"
+           "  --benchmark-colors <atoms>  Time the color mapping kernels for the number of synthetic atoms, print the timings and exit\n"
+           "                              The residue name and chain id mappings are timed on the loaded files, the window is not shown\n"
+           "  --help                      Show this message\n");
+}
+
+// Anything which is not an option is assumed to be a file to load
+static bool parse_command_line(CommandLine* cmd, int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--", 2) != 0) {
+            md_array_push(cmd->files, arg, persistent_alloc);
+            continue;
+        }
+
+        if (strcmp(arg, "--help") == 0) {
+            cmd->help = true;
+            print_usage();
+            return false;
+        } else if (strcmp(arg, "--headless") == 0) {
+            cmd->headless = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            LOG_ERROR("Missing value of option '%s'", arg);
+            return false;
+        }
+        const char* val = argv[++i];
+
+        if (strcmp(arg, "--export") == 0) {
+            cmd->export_frames = true;
+            cmd->export_path = val;
+        } else if (strcmp(arg, "--pipe") == 0) {
+            cmd->export_frames = true;
+            cmd->export_command = val;
+        } else if (strcmp(arg, "--frames") == 0) {
+            if (sscanf(val, "%lf:%lf:%lf", &cmd->frames[0], &cmd->frames[1], &cmd->frames[2]) < 2) {
+                LOG_ERROR("Invalid frame range '%s', expected <beg:end[:stride]>", val);
+                return false;
+            }
+        } else if (strcmp(arg, "--size") == 0) {
+            if (sscanf(val, "%ix%i", &cmd->width, &cmd->height) != 2 || cmd->width <= 0 || cmd->height <= 0) {
+                LOG_ERROR("Invalid size '%s', expected <width>x<height>", val);
+                return false;
+            }
+        } else if (strcmp(arg, "--benchmark-colors") == 0) {
+            if (sscanf(val, "%i", &cmd->benchmark_colors) != 1 || cmd->benchmark_colors <= 0) {
+                LOG_ERROR("Invalid number of atoms '%s'", val);
+                return false;
+            }
+        } else {
+            LOG_ERROR("Unknown option '%s'", arg);
+            print_usage();
+            return false;
+        }
+    }
+
+    if (cmd->benchmark_colors) {
+        if (cmd->export_frames) {
+            LOG_ERROR("The benchmark cannot be combined with an export");
+            return false;
+        }
+        cmd->headless = true;
+    }
+
+    if (cmd->headless && !cmd->export_frames && !cmd->benchmark_colors) {
+        LOG_ERROR("Running headless requires an export, given by --export or --pipe");
+        return false;
+    }
+    return true;
+}
+
 int main(int argc, char** argv) {
 #if DEBUG
     persistent_alloc = md_tracking_allocator_create(md_get_heap_allocator());
@@ -794,17 +1386,27 @@ int main(int argc, char** argv) {
     md_bitfield_init(&data.selection.grow.mask, persistent_alloc);
 
     md_bitfield_init(&data.representation.visibility_mask, persistent_alloc);
+    for (size_t i = 0; i < ARRAY_SIZE(data.mold.atom_flags.masks); ++i) {
+        md_bitfield_init(&data.mold.atom_flags.masks[i], persistent_alloc);
+    }
+    md_bitfield_init(&data.mold.culling.mask, persistent_alloc);
 
     md_semaphore_init(&data.script.ir_semaphore, IR_SEMAPHORE_MAX_COUNT);
 
+    CommandLine cmd = {};
+    if (!parse_command_line(&cmd, argc, argv)) {
+        return cmd.help ? 0 : -1;
+    }
+
     // Init platform
     LOG_DEBUG("Initializing GL...");
-    if (!application::initialize(&data.app, 0, 0, STR_LIT("VIAMD"))) {
+    if (!application::initialize(&data.app, cmd.width, cmd.height, STR_LIT("VIAMD"), cmd.headless)) {
         LOG_ERROR("Could not initialize application...\n");
         return -1;
     }
 
-    data.app.window.vsync = true;
+    // There is nothing to synchronize with when nothing is presented
+    data.app.window.vsync = !cmd.headless;
     data.app.file_drop.user_data = &data;
     data.app.file_drop.callback = [](size_t num_files, const str_t file_paths[], void* user_data) {
         ApplicationState* data = (ApplicationState*)user_data;
@@ -830,6 +1432,12 @@ int main(int argc, char** argv) {
     postprocessing::initialize(data.gbuffer.width, data.gbuffer.height);
     LOG_DEBUG("Initializing volume...");
     volume::initialize();
+    LOG_DEBUG("Initializing ensemble...");
+    ensemble::initialize();
+    LOG_DEBUG("Initializing culling...");
+    culling::initialize();
+    LOG_DEBUG("Initializing profiler...");
+    profiler::initialize();
     LOG_DEBUG("Initializing task system...");
     const size_t num_threads = VIAMD_NUM_WORKER_THREADS == 0 ? md_os_num_processors() : VIAMD_NUM_WORKER_THREADS;
     task_system::initialize(CLAMP(num_threads, 2, (uint32_t)md_os_num_processors()));
@@ -869,17 +1477,15 @@ int main(int argc, char** argv) {
             }
         }
 #endif
-        if (argc > 1) {
-            // Assume argv[1..] are files to load
-            // Currently we do not support any command line flags
-            // So anything here which is a file path is assumed to be a file to load
-            for (int i = 1; i < argc; ++i) {
-                str_t path = str_from_cstr(argv[i]);
-                if (md_path_is_valid(path)) {
-                    file_queue_push(&data.file_queue, path);
-                }
+        for (size_t i = 0; i < md_array_size(cmd.files); ++i) {
+            str_t path = str_from_cstr(cmd.files[i]);
+            if (md_path_is_valid(path)) {
+                file_queue_push(&data.file_queue, path);
+            } else {
+                LOG_ERROR("Invalid path: '%s'", cmd.files[i]);
             }
         }
+        md_array_free(cmd.files, persistent_alloc);
     }
 
 #if EXPERIMENTAL_SDF == 1
@@ -893,6 +1499,7 @@ int main(int argc, char** argv) {
     // Main loop
     while (!data.app.window.should_close) {
         application::update(&data.app);
+        profiler::begin_frame();
         
         // This needs to happen first (in imgui events) to enable docking of imgui windows
 #if VIAMD_IMGUI_ENABLE_DOCKSPACE
@@ -971,6 +1578,41 @@ int main(int argc, char** argv) {
             }
         }
 
+        // An export requested from the command line starts once all files have been loaded
+        if (cmd.export_frames && file_queue_empty(&data.file_queue)) {
+            if (data.load_dataset.show_window && cmd.headless) {
+                LOG_ERROR("The dataset requires the load dialogue, which is not available when running headless");
+                data.app.window.should_close = true;
+            } else if (!data.load_dataset.show_window) {
+                cmd.export_frames = false;
+                data.movie.beg_frame = cmd.frames[0];
+                data.movie.end_frame = cmd.frames[1] < 0 ? (double)md_trajectory_num_frames(data.mold.traj) : cmd.frames[1];
+                data.movie.stride    = cmd.frames[2];
+                data.movie.exit_on_completion = cmd.headless;
+                if (cmd.export_command) {
+                    data.movie.output = MovieOutput::Pipe;
+                    str_copy_to_char_buf(data.movie.command, sizeof(data.movie.command), str_from_cstr(cmd.export_command));
+                } else {
+                    data.movie.output = MovieOutput::Images;
+                    str_copy_to_char_buf(data.movie.path, sizeof(data.movie.path), str_from_cstr(cmd.export_path));
+                }
+                if (!start_movie_export(&data) && cmd.headless) {
+                    data.app.window.should_close = true;
+                }
+            }
+        }
+
+        // A benchmark requested from the command line runs once all files have been loaded
+        if (cmd.benchmark_colors && file_queue_empty(&data.file_queue)) {
+            if (data.load_dataset.show_window) {
+                LOG_ERROR("The dataset requires the load dialogue, which is not available when running headless");
+            } else {
+                print_color_benchmark(&data, cmd.benchmark_colors);
+            }
+            cmd.benchmark_colors = 0;
+            data.app.window.should_close = true;
+        }
+
         viamd::event_system_broadcast_event(viamd::EventType_ViamdFrameTick, viamd::EventPayloadType_ApplicationState, &data);
 
         // GUI
@@ -983,6 +1625,7 @@ int main(int argc, char** argv) {
         if (data.dataset.show_window) draw_dataset_window(&data);
         if (data.selection.query.show_window) draw_selection_query_window(&data);
         if (data.selection.grow.show_window) draw_selection_grow_window(&data);
+        if (data.movie.show_window) draw_movie_export_window(&data);
         if (data.show_property_export_window) draw_property_export_window(&data);
         if (data.show_debug_window) draw_debug_window(&data);
 
@@ -1026,6 +1669,8 @@ int main(int argc, char** argv) {
                 LOG_INFO("Recompiling shaders and re-initializing volume");
                 postprocessing::initialize(data.gbuffer.width, data.gbuffer.height);
                 volume::initialize();
+                ensemble::initialize();
+                culling::initialize();
                 md_gl_shaders_destroy(data.mold.gl_shaders);
                 data.mold.gl_shaders = md_gl_shaders_create(shader_output_snippet);
             }
@@ -1051,6 +1696,7 @@ int main(int argc, char** argv) {
                 }
 
                 data.mold.dirty_buffers |= MolBit_DirtyPosition;   // Update previous position to not get motion trail when paused
+                data.mold.position_generation += 1;
             }
 
             if (ImGui::IsKeyPressed(KEY_SKIP_TO_PREV_FRAME) || ImGui::IsKeyPressed(KEY_SKIP_TO_NEXT_FRAME)) {
@@ -1110,6 +1756,8 @@ int main(int argc, char** argv) {
             }
         }
 
+        update_movie_export(&data);
+
         {
             static auto prev_frame = data.animation.frame;
             if (data.animation.frame != prev_frame) {
@@ -1152,10 +1800,11 @@ int main(int argc, char** argv) {
             POP_CPU_SECTION()
 
             PUSH_CPU_SECTION("Update dynamic representations")
+            prefetch_representation_filters(&data);
             for (size_t i = 0; i < md_array_size(data.representation.reps); ++i) {
                 auto& rep = data.representation.reps[i];
                 if (!rep.enabled) continue;
-                if (rep.dynamic_evaluation || rep.color_mapping == ColorMapping::SecondaryStructure) {
+                if (rep.dynamic_evaluation || rep.color_mapping == ColorMapping::SecondaryStructure || rep.color_mapping == ColorMapping::Property) {
                     update_representation(&data, &rep);
                 }
             }
@@ -1164,6 +1813,15 @@ int main(int argc, char** argv) {
             if (!time_stopped) {
                 time_stopped = true;
                 data.mold.dirty_buffers |= MolBit_DirtyPosition;
+                data.mold.position_generation += 1;
+            }
+        }
+
+        // The property colors are evaluated asynchronously, the representations are updated once the evaluation is complete
+        for (size_t i = 0; i < md_array_size(data.representation.reps); ++i) {
+            auto& rep = data.representation.reps[i];
+            if (rep.enabled && rep.prop.job && property_color_job_done(rep.prop.job)) {
+                update_representation(&data, &rep);
             }
         }
 
@@ -1189,7 +1847,7 @@ int main(int argc, char** argv) {
                 if (md_semaphore_try_aquire_n(&data.script.ir_semaphore, IR_SEMAPHORE_MAX_COUNT)) {
                     defer {
                         md_semaphore_release_n(&data.script.ir_semaphore, IR_SEMAPHORE_MAX_COUNT);
-                        update_all_representations(&data);
+                        update_all_representations(&data, RepBit_DirtyFilter);
                     };
 
                     // Now we hold all semaphores for the script
@@ -1301,13 +1959,23 @@ int main(int argc, char** argv) {
 
         if (num_frames > 0) {
             if (data.script.eval_init) {
-                if (task_system::task_is_running(data.tasks.evaluate_full)) md_script_eval_interrupt(data.script.full_eval);
-                if (task_system::task_is_running(data.tasks.evaluate_filt)) md_script_eval_interrupt(data.script.filt_eval);
+                if (sweep::consumer_is_running(data.tasks.evaluate_full)) {
+                    md_script_eval_interrupt(data.script.full_eval);
+                    sweep::consumer_interrupt(data.tasks.evaluate_full);
+                }
+                if (sweep::consumer_is_running(data.tasks.evaluate_filt)) {
+                    md_script_eval_interrupt(data.script.filt_eval);
+                    sweep::consumer_interrupt(data.tasks.evaluate_filt);
+                }
                     
-                if (task_system::task_is_running(data.tasks.evaluate_full) == false &&
-                    task_system::task_is_running(data.tasks.evaluate_filt) == false) {
+                if (sweep::consumer_is_running(data.tasks.evaluate_full) == false &&
+                    sweep::consumer_is_running(data.tasks.evaluate_filt) == false) {
                     data.script.eval_init = false;
 
+                    // Pending histogram computations read from the evaluation data
+                    cancel_display_property_jobs(&data);
+                    cancel_density_volume_jobs(&data);
+
                     if (data.script.full_eval) {
                         md_script_eval_free(data.script.full_eval);
                     }
@@ -1332,8 +2000,9 @@ int main(int argc, char** argv) {
             }
 
             if (data.script.full_eval && data.script.evaluate_full) {
-                if (task_system::task_is_running(data.tasks.evaluate_full)) {
+                if (sweep::consumer_is_running(data.tasks.evaluate_full)) {
                     md_script_eval_interrupt(data.script.full_eval);
+                    sweep::consumer_interrupt(data.tasks.evaluate_full);
                 } else {
                     if (md_script_ir_valid(data.script.eval_ir) &&
                         md_script_eval_ir_fingerprint(data.script.full_eval) == md_script_ir_fingerprint(data.script.eval_ir))
@@ -1342,31 +2011,30 @@ int main(int argc, char** argv) {
                         md_script_eval_clear_data(data.script.full_eval);
 
                         if (md_script_ir_property_count(data.script.eval_ir) > 0) {
-                            data.tasks.evaluate_full = task_system::create_pool_task(STR_LIT("Eval Full"), 0, (uint32_t)num_frames, [](uint32_t frame_beg, uint32_t frame_end, void* user_data, uint32_t thread_num) {
-                                (void)thread_num;
+#if MEASURE_EVALUATION_TIME
+                            eval_full_start_time = md_time_current();
+#endif
+                            // The evaluation is performed as part of a trajectory sweep, which shares the loaded frames with other consumers
+                            // The frame has been loaded through the trajectory cache prior to the call, so the evaluation will hit the cache
+                            data.tasks.evaluate_full = sweep::submit(STR_LIT("Eval Full"), 0, (uint32_t)num_frames, [](uint32_t frame_idx, const md_trajectory_frame_header_t*, const float*, const float*, const float*, void* user_data) {
                                 ApplicationState* data = (ApplicationState*)user_data;
-                                md_script_eval_frame_range(data->script.full_eval, data->script.eval_ir, &data->mold.mol, data->mold.traj, frame_beg, frame_end);
-                            }, &data);
-                            
+                                md_script_eval_frame_range(data->script.full_eval, data->script.eval_ir, &data->mold.mol, data->mold.traj, frame_idx, frame_idx + 1);
+                            }, &data, [](void* user_data) {
+                                (void)user_data;
 #if MEASURE_EVALUATION_TIME
-                            uint64_t time = (uint64_t)md_time_current();
-                            task_system::ID time_task = task_system::create_pool_task(STR_LIT("##Time Eval Full"), [](void* user_data) {
-                                uint64_t t1 = md_time_current();
-                                uint64_t t0 = (uint64_t)user_data;
-                                double s = md_time_as_seconds(t1 - t0);
+                                double s = md_time_as_seconds(md_time_current() - eval_full_start_time);
                                 LOG_INFO("Evaluation completed in: %.3fs", s);
-                            }, (void*)time);
 #endif
-                            task_system::set_task_dependency(time_task, data.tasks.evaluate_full);
-                            task_system::enqueue_task(data.tasks.evaluate_full);
+                            }, sweep::ConsumerFlag_Progressive);
                         }
                     }
                 }
             }
 
             if (data.script.filt_eval && data.script.evaluate_filt && data.timeline.filter.enabled) {
-                if (task_system::task_is_running(data.tasks.evaluate_filt)) {
+                if (sweep::consumer_is_running(data.tasks.evaluate_filt)) {
                     md_script_eval_interrupt(data.script.filt_eval);
+                    sweep::consumer_interrupt(data.tasks.evaluate_filt);
                 } else {
                     //if (md_semaphore_try_aquire(&data.script.ir_semaphore)) {
                         if (md_script_ir_valid(data.script.eval_ir) &&
@@ -1375,16 +2043,14 @@ int main(int argc, char** argv) {
                             data.script.evaluate_filt = false;
                             md_script_eval_clear_data(data.script.filt_eval);
 
-                            if (md_script_ir_property_count(data.script.eval_ir) > 0) {
+                            if (requires_filtered_evaluation(data.script.eval_ir)) {
                                 const uint32_t traj_frames = (uint32_t)md_trajectory_num_frames(data.mold.traj);
                                 const uint32_t beg_frame = CLAMP((uint32_t)data.timeline.filter.beg_frame, 0, traj_frames-1);
                                 const uint32_t end_frame = CLAMP((uint32_t)data.timeline.filter.end_frame + 1, beg_frame + 1, traj_frames);
-                                data.tasks.evaluate_filt = task_system::create_pool_task(STR_LIT("Eval Filt"), beg_frame, end_frame, [](uint32_t beg, uint32_t end, void* user_data, uint32_t thread_num) {
-                                    (void)thread_num;
+                                data.tasks.evaluate_filt = sweep::submit(STR_LIT("Eval Filt"), beg_frame, end_frame, [](uint32_t frame_idx, const md_trajectory_frame_header_t*, const float*, const float*, const float*, void* user_data) {
                                     ApplicationState* data = (ApplicationState*)user_data;
-                                    md_script_eval_frame_range(data->script.filt_eval, data->script.eval_ir, &data->mold.mol, data->mold.traj, beg, end);
+                                    md_script_eval_frame_range(data->script.filt_eval, data->script.eval_ir, &data->mold.mol, data->mold.traj, frame_idx, frame_idx + 1);
                                 }, &data);
-                                task_system::enqueue_task(data.tasks.evaluate_filt);
                             }
                             
                             /*
@@ -1403,13 +2069,24 @@ int main(int argc, char** argv) {
             }
         }
 
+        // Launch all trajectory consumers which were submitted during this frame within a single sweep
+        sweep::update(data.mold.traj, data.mold.mol.atom.count);
+
+        update_dynamic_resolution(&data);
+
         // Resize Framebuffer
-        if ((data.gbuffer.width != data.app.framebuffer.width || data.gbuffer.height != data.app.framebuffer.height) &&
+        // The G-buffer is rendered at the scaled resolution and upsampled to the framebuffer in the postprocessing
+        const float render_scale = data.visuals.dynamic_resolution.scale;
+        const int render_width  = MAX((int)(data.app.framebuffer.width  * render_scale + 0.5f), 1);
+        const int render_height = MAX((int)(data.app.framebuffer.height * render_scale + 0.5f), 1);
+        if (((int)data.gbuffer.width != render_width || (int)data.gbuffer.height != render_height) &&
             (data.app.framebuffer.width != 0 && data.app.framebuffer.height != 0)) {
-            init_gbuffer(&data.gbuffer, data.app.framebuffer.width, data.app.framebuffer.height);
-            postprocessing::initialize(data.gbuffer.width, data.gbuffer.height);
+            init_gbuffer(&data.gbuffer, render_width, render_height);
+            postprocessing::resize(data.gbuffer.width, data.gbuffer.height);
         }
 
+        update_culling(&data);
+
         // The motivation for doing this is to reduce the frequency at which we invalidate and upload the atom flag field to the GPU
         // For large systems, this can be a costly operation: Consider a system of 100'000'000 atoms
         // The the size of each bitfield to represent the mask would be 12.5 MB
@@ -1419,6 +2096,8 @@ int main(int argc, char** argv) {
         uint64_t h_hash = md_bitfield_hash64(&data.selection.highlight_mask, 0);
         uint64_t s_hash = md_bitfield_hash64(&data.selection.selection_mask, 0);
         uint64_t f_hash = v_hash ^ h_hash ^ s_hash;
+        data.selection.highlight_mask_hash = h_hash;
+        data.selection.selection_mask_hash = s_hash;
 
         // These represent the 'current' state so we can compare against it to see if they were modified
         static uint64_t highlight_hash = 0;
@@ -1446,9 +2125,18 @@ int main(int argc, char** argv) {
         update_display_properties(&data);
 
         handle_picking(&data);
+        update_screenshot_jobs(&data);
         clear_gbuffer(&data.gbuffer);
         fill_gbuffer(&data);
 
+        if (data.visuals.culling.enabled && data.visuals.culling.occlusion && data.mold.culling.culler.num_chunks > 0) {
+            const mat4_t view_proj = data.view.param.matrix.curr.proj * data.view.param.matrix.curr.view;
+            culling::capture_depth(&data.mold.culling.culler, data.gbuffer.tex.depth, data.gbuffer.width, data.gbuffer.height, view_proj, data.mold.culling.scene_key);
+        }
+
+        capture_movie_frame(&data);
+        update_selection_region(&data);
+
         // Activate backbuffer
         glDisable(GL_DEPTH_TEST);
         glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
@@ -1471,8 +2159,8 @@ int main(int argc, char** argv) {
 
         if (!data.screenshot.hide_gui && !str_empty(data.screenshot.path_to_file)) {
             create_screenshot(&data);
-            data.screenshot.path_to_file = {};
             str_free(data.screenshot.path_to_file, persistent_alloc);
+            data.screenshot.path_to_file = {};
         }
 
         viamd::event_system_process_event_queue();
@@ -1481,11 +2169,16 @@ int main(int argc, char** argv) {
         // Reset frame allocator
         md_vm_arena_reset(frame_alloc);
 
+        profiler::end_frame();
+
         // Swap buffers
         application::swap_buffers(&data.app);
     }
 
     interrupt_async_tasks(&data);
+    free_screenshot_jobs(&data);
+    free_movie_export(&data);
+    free_selection_region(&data);
 
     viamd::event_system_broadcast_event(viamd::EventType_ViamdShutdown);
 
@@ -1496,6 +2189,12 @@ int main(int argc, char** argv) {
     postprocessing::shutdown();
     LOG_DEBUG("Shutting down volume...");
     volume::shutdown();
+    LOG_DEBUG("Shutting down ensemble...");
+    ensemble::shutdown();
+    LOG_DEBUG("Shutting down culling...");
+    culling::shutdown();
+    LOG_DEBUG("Shutting down profiler...");
+    profiler::shutdown();
     LOG_DEBUG("Shutting down task system...");
     task_system::shutdown();
 
@@ -1505,93 +2204,286 @@ int main(int argc, char** argv) {
     return 0;
 }
 
-static void init_dataset_items(ApplicationState* data) {
-    clear_dataset_items(data);
-    if (data->mold.mol.atom.count == 0) return;
+// Items which share a label (e.g. residue names) are grouped through an open addressing hash table keyed on the hash of the label.
+// The groups are accumulated per chunk in parallel, and merged in chunk order, which preserves the order of first occurrence.
+struct DatasetGroup {
+    str_t label;
+    uint64_t hash;
+    uint32_t count;
+    uint32_t atom_count;
+    double mass;
+};
 
-    for (size_t i = 0; i < data->mold.mol.chain.count; ++i) {
-        DatasetItem item = {};
-        str_t str = LBL_TO_STR(data->mold.mol.chain.id[i]);
-        snprintf(item.label, sizeof(item.label), "%.*s", (int)str.len, str.ptr);
-        snprintf(item.query, sizeof(item.query), "chain(%d)", (int)(i+1));
-        size_t atom_count = md_chain_atom_count(data->mold.mol.chain, i);
-        item.count = 1;
-        item.fraction = atom_count / (float)data->mold.mol.atom.count;
-        md_array_push(data->dataset.chains, item, persistent_alloc);
-    }
+struct DatasetGroupTable {
+    md_array(DatasetGroup) groups;
+    md_array(uint32_t) slots;  // Index + 1 of the group, 0 marks an empty slot
+    md_allocator_i* alloc;
+};
 
-    for (size_t i = 0; i < data->mold.mol.residue.count; ++i) {
-        const float fraction_size = md_residue_atom_count(data->mold.mol.residue, i) / (float)data->mold.mol.atom.count;
-        {
-            // Do resname
-            str_t resname = LBL_TO_STR(data->mold.mol.residue.name[i]);
-            DatasetItem* item = 0;
-            for (size_t j = 0; j < md_array_size(data->dataset.residue_names); ++j) {
-                if (strcmp(data->dataset.residue_names[j].label, resname.ptr) == 0) {
-                    item = &data->dataset.residue_names[j];
-                    break;
-                }
-            }
-            if (!item) {
-                DatasetItem it = {};
-                snprintf(it.label, sizeof(it.label), "%.*s", (int)resname.len, resname.ptr);
-                snprintf(it.query, sizeof(it.query), "resname('%.*s')", (int)resname.len, resname.ptr);
-                it.count = 0;
-                it.fraction = 0;
-                item = md_array_push(data->dataset.residue_names, it, persistent_alloc);
-            }
-            item->count += 1;
-            item->fraction += fraction_size;
-        }
+static void dataset_group_table_rehash(DatasetGroupTable* table, size_t num_slots) {
+    md_array_resize(table->slots, num_slots, table->alloc);
+    MEMSET(table->slots, 0, num_slots * sizeof(uint32_t));
+    const size_t mask = num_slots - 1;
+    for (size_t i = 0; i < md_array_size(table->groups); ++i) {
+        size_t slot = table->groups[i].hash & mask;
+        while (table->slots[slot]) slot = (slot + 1) & mask;
+        table->slots[slot] = (uint32_t)(i + 1);
     }
+}
 
-    for (size_t i = 0; i < data->mold.mol.atom.count; ++i) {
-        {
-            // Do atom label
-            str_t label = LBL_TO_STR(data->mold.mol.atom.type[i]);
-            DatasetItem* item = 0;
-            for (size_t j = 0; j < md_array_size(data->dataset.atom_types); ++j) {
-                if (strcmp(data->dataset.atom_types[j].label, label.ptr) == 0) {
-                    item = &data->dataset.atom_types[j];
-                    break;
-                }
-            }
-            if (!item) {
-                DatasetItem it = {};
-                snprintf(it.label, sizeof(it.label), "%.*s", (int)label.len, label.ptr);
-                snprintf(it.query, sizeof(it.query), "type('%.*s')", (int)label.len, label.ptr);
-                it.count = 0;
-                it.fraction = 0;
-                item = md_array_push(data->dataset.atom_types, it, persistent_alloc);
-            }
-            item->count += 1;
-        }
-    }
+static DatasetGroup* dataset_group_table_get(DatasetGroupTable* table, str_t label, uint64_t hash) {
+    size_t num_slots = md_array_size(table->slots);
+    // Keep the load factor below 0.5
+    if ((md_array_size(table->groups) + 1) * 2 > num_slots) {
+        num_slots = MAX(num_slots * 2, 64);
+        dataset_group_table_rehash(table, num_slots);
+    }
+    const size_t mask = num_slots - 1;
+    size_t slot = hash & mask;
+    while (table->slots[slot]) {
+        DatasetGroup* group = &table->groups[table->slots[slot] - 1];
+        if (group->hash == hash && str_eq(group->label, label)) {
+            return group;
+        }
+        slot = (slot + 1) & mask;
+    }
+    DatasetGroup group = {
+        .label = label,
+        .hash = hash,
+    };
+    table->slots[slot] = (uint32_t)(md_array_size(table->groups) + 1);
+    return md_array_push(table->groups, group, table->alloc);
+}
 
-    for (size_t i = 0; i < md_array_size(data->dataset.atom_types); ++i) {
-        data->dataset.atom_types[i].fraction = data->dataset.atom_types[i].count / (float)data->mold.mol.atom.count;
+static void dataset_group_table_merge(DatasetGroupTable* dst, const DatasetGroupTable* src) {
+    for (size_t i = 0; i < md_array_size(src->groups); ++i) {
+        const DatasetGroup& group = src->groups[i];
+        DatasetGroup* dst_group = dataset_group_table_get(dst, group.label, group.hash);
+        dst_group->count      += group.count;
+        dst_group->atom_count += group.atom_count;
+        dst_group->mass       += group.mass;
     }
 }
 
-static void clear_dataset_items(ApplicationState* data) {
-    md_array_free(data->dataset.chains, persistent_alloc);
-    md_array_free(data->dataset.residue_names, persistent_alloc);
-    md_array_free(data->dataset.atom_types, persistent_alloc);
+#define DATASET_CHUNK_SIZE (64 * 1024)
+
+struct DatasetAtomChunk {
+    DatasetGroupTable atom_types;
+    // Partial masses of the chains which overlap the atoms of the chunk, starting with the chain chain_beg
+    uint32_t chain_beg;
+    md_array(double) chain_mass;
+};
+
+struct DatasetStatsJob {
+    const md_molecule_t* mol;
+    DatasetGroupTable* res_chunks;
+    DatasetAtomChunk* atom_chunks;
+    uint32_t num_res_chunks;
+    uint32_t num_atom_chunks;
+};
+
+// Index of the first chain which ends after the atom, the chains are ordered by their atom offsets
+static size_t dataset_chain_lower_bound(const md_molecule_t& mol, int32_t atom_idx) {
+    size_t lo = 0, hi = mol.chain.count;
+    while (lo < hi) {
+        const size_t mid = (lo + hi) / 2;
+        if (md_chain_atom_range(mol.chain, mid).end <= atom_idx) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
 }
 
-static void display_property_copy_param_from_old(DisplayProperty& item, const DisplayProperty* old_items, int64_t num_old_items) {
-    // See if we have a matching item in the old list
-    for (int64_t i = 0; i < num_old_items; ++i) {
-        if (strcmp(item.label, old_items[i].label) == 0 && item.type == old_items[i].type) {
-            // Copy relevant parameters from existing item which we want to be persistent
-            item.temporal_subplot_mask      = old_items[i].temporal_subplot_mask;
-            item.distribution_subplot_mask  = old_items[i].distribution_subplot_mask;
-            item.color                      = old_items[i].color;
-            item.temporal_subplot_mask      = old_items[i].temporal_subplot_mask;
-            item.distribution_subplot_mask  = old_items[i].distribution_subplot_mask;
-            item.show_in_volume             = old_items[i].show_in_volume;
-            item.plot_type                  = old_items[i].plot_type;
-            item.colormap_alpha			    = old_items[i].colormap_alpha;
+static void init_dataset_items(ApplicationState* data) {
+    clear_dataset_items(data);
+    const md_molecule_t& mol = data->mold.mol;
+    if (mol.atom.count == 0) return;
+
+    md_allocator_i* arena = md_arena_allocator_create(md_get_heap_allocator(), MEGABYTES(1));
+    defer { md_arena_allocator_destroy(arena); };
+
+    const float inv_atom_count = 1.0f / (float)mol.atom.count;
+    double total_mass = 0.0;
+
+    DatasetStatsJob job = {
+        .mol = &mol,
+        .num_res_chunks  = (uint32_t)((mol.residue.count + DATASET_CHUNK_SIZE - 1) / DATASET_CHUNK_SIZE),
+        .num_atom_chunks = (uint32_t)((mol.atom.count    + DATASET_CHUNK_SIZE - 1) / DATASET_CHUNK_SIZE),
+    };
+    const uint32_t num_chunks = job.num_res_chunks + job.num_atom_chunks;
+    job.res_chunks  = (DatasetGroupTable*)md_alloc(arena, job.num_res_chunks  * sizeof(DatasetGroupTable));
+    job.atom_chunks = (DatasetAtomChunk*) md_alloc(arena, job.num_atom_chunks * sizeof(DatasetAtomChunk));
+    MEMSET(job.res_chunks,  0, job.num_res_chunks  * sizeof(DatasetGroupTable));
+    MEMSET(job.atom_chunks, 0, job.num_atom_chunks * sizeof(DatasetAtomChunk));
+    // Each chunk gets its own arena, since the chunks are populated concurrently
+    for (uint32_t i = 0; i < job.num_res_chunks; ++i) {
+        job.res_chunks[i].alloc = md_arena_allocator_create(md_get_heap_allocator(), MEGABYTES(1));
+    }
+    for (uint32_t i = 0; i < job.num_atom_chunks; ++i) {
+        job.atom_chunks[i].atom_types.alloc = md_arena_allocator_create(md_get_heap_allocator(), MEGABYTES(1));
+    }
+    defer {
+        for (uint32_t i = 0; i < job.num_res_chunks; ++i) {
+            md_arena_allocator_destroy(job.res_chunks[i].alloc);
+        }
+        for (uint32_t i = 0; i < job.num_atom_chunks; ++i) {
+            md_arena_allocator_destroy(job.atom_chunks[i].atom_types.alloc);
+        }
+    };
+
+    // Residue chunks come first, followed by the atom chunks
+    task_system::ID task = task_system::create_pool_task(STR_LIT("##Dataset Items"), 0, num_chunks, [](uint32_t range_beg, uint32_t range_end, void* user_data, uint32_t thread_num) {
+        (void)thread_num;
+        DatasetStatsJob* job = (DatasetStatsJob*)user_data;
+        const md_molecule_t& mol = *job->mol;
+        for (uint32_t chunk_idx = range_beg; chunk_idx < range_end; ++chunk_idx) {
+            if (chunk_idx < job->num_res_chunks) {
+                DatasetGroupTable* table = &job->res_chunks[chunk_idx];
+                const size_t beg = (size_t)chunk_idx * DATASET_CHUNK_SIZE;
+                const size_t end = MIN(beg + DATASET_CHUNK_SIZE, mol.residue.count);
+                for (size_t i = beg; i < end; ++i) {
+                    const str_t resname = LBL_TO_STR(mol.residue.name[i]);
+                    const md_range_t range = md_residue_atom_range(mol.residue, i);
+                    double mass = 0.0;
+                    if (mol.atom.mass) {
+                        for (int32_t j = range.beg; j < range.end; ++j) {
+                            mass += mol.atom.mass[j];
+                        }
+                    }
+                    DatasetGroup* group = dataset_group_table_get(table, resname, md_hash64(resname.ptr, resname.len, 0));
+                    group->count += 1;
+                    group->atom_count += (uint32_t)(range.end - range.beg);
+                    group->mass += mass;
+                }
+            } else {
+                const uint32_t atom_chunk_idx = chunk_idx - job->num_res_chunks;
+                DatasetAtomChunk* chunk = &job->atom_chunks[atom_chunk_idx];
+                DatasetGroupTable* table = &chunk->atom_types;
+                const size_t beg = (size_t)atom_chunk_idx * DATASET_CHUNK_SIZE;
+                const size_t end = MIN(beg + DATASET_CHUNK_SIZE, mol.atom.count);
+
+                // The chains which overlap the chunk, atoms are not necessarily part of a chain
+                const size_t chain_beg = dataset_chain_lower_bound(mol, (int32_t)beg);
+                const size_t chain_end = dataset_chain_lower_bound(mol, (int32_t)end - 1) + 1;
+                chunk->chain_beg = (uint32_t)chain_beg;
+                if (chain_beg < mol.chain.count) {
+                    md_array_resize(chunk->chain_mass, MIN(chain_end, mol.chain.count) - chain_beg, table->alloc);
+                    MEMSET(chunk->chain_mass, 0, md_array_bytes(chunk->chain_mass));
+                }
+                size_t chain = chain_beg;
+                md_range_t chain_range = chain < mol.chain.count ? md_chain_atom_range(mol.chain, chain) : md_range_t{};
+
+                // Consecutive atoms often share the type, in which case the lookup is skipped
+                DatasetGroup* group = 0;
+                str_t prev_label = {};
+                for (size_t i = beg; i < end; ++i) {
+                    const str_t label = LBL_TO_STR(mol.atom.type[i]);
+                    if (!group || !str_eq(label, prev_label)) {
+                        group = dataset_group_table_get(table, label, md_hash64(label.ptr, label.len, 0));
+                        prev_label = label;
+                    }
+                    const double mass = mol.atom.mass ? mol.atom.mass[i] : 0.0;
+                    group->count += 1;
+                    group->atom_count += 1;
+                    group->mass += mass;
+
+                    while (chain < mol.chain.count && chain_range.end <= (int32_t)i) {
+                        chain += 1;
+                        if (chain < mol.chain.count) chain_range = md_chain_atom_range(mol.chain, chain);
+                    }
+                    if (chain < mol.chain.count && chain_range.beg <= (int32_t)i) {
+                        chunk->chain_mass[chain - chain_beg] += mass;
+                    }
+                }
+            }
+        }
+    }, &job);
+    task_system::enqueue_task(task);
+    task_system::task_wait_for(task);
+
+    DatasetGroupTable residue_names = {.alloc = arena};
+    DatasetGroupTable atom_types    = {.alloc = arena};
+    md_array(double) chain_mass = md_array_create(double, mol.chain.count, arena);
+    MEMSET(chain_mass, 0, md_array_bytes(chain_mass));
+    for (uint32_t i = 0; i < job.num_res_chunks; ++i) {
+        dataset_group_table_merge(&residue_names, &job.res_chunks[i]);
+    }
+    for (uint32_t i = 0; i < job.num_atom_chunks; ++i) {
+        const DatasetAtomChunk& chunk = job.atom_chunks[i];
+        dataset_group_table_merge(&atom_types, &chunk.atom_types);
+        for (size_t j = 0; j < md_array_size(chunk.chain_mass); ++j) {
+            chain_mass[chunk.chain_beg + j] += chunk.chain_mass[j];
+        }
+    }
+    for (size_t i = 0; i < md_array_size(atom_types.groups); ++i) {
+        total_mass += atom_types.groups[i].mass;
+    }
+    const float inv_total_mass = total_mass > 0.0 ? (float)(1.0 / total_mass) : 0.0f;
+
+    for (size_t i = 0; i < mol.chain.count; ++i) {
+        const md_range_t range = md_chain_atom_range(mol.chain, i);
+        DatasetItem item = {};
+        str_t str = LBL_TO_STR(mol.chain.id[i]);
+        snprintf(item.label, sizeof(item.label), "%.*s", (int)str.len, str.ptr);
+        snprintf(item.query, sizeof(item.query), "chain(%d)", (int)(i+1));
+        item.count = 1;
+        item.fraction = (range.end - range.beg) * inv_atom_count;
+        item.mass_fraction = (float)chain_mass[i] * inv_total_mass;
+        // The residues are ordered by their atom offsets, so the residues of the chain are found by binary search
+        auto lower_bound = [&mol](int32_t atom_idx) {
+            size_t lo = 0, hi = mol.residue.count;
+            while (lo < hi) {
+                const size_t mid = (lo + hi) / 2;
+                if (md_residue_atom_range(mol.residue, mid).beg < atom_idx) lo = mid + 1;
+                else hi = mid;
+            }
+            return lo;
+        };
+        item.residue_count = (uint32_t)(lower_bound(range.end) - lower_bound(range.beg));
+        md_array_push(data->dataset.chains, item, persistent_alloc);
+    }
+
+    for (size_t i = 0; i < md_array_size(residue_names.groups); ++i) {
+        const DatasetGroup& group = residue_names.groups[i];
+        DatasetItem item = {};
+        snprintf(item.label, sizeof(item.label), "%.*s", (int)group.label.len, group.label.ptr);
+        snprintf(item.query, sizeof(item.query), "resname('%.*s')", (int)group.label.len, group.label.ptr);
+        item.count = group.count;
+        item.fraction = group.atom_count * inv_atom_count;
+        item.mass_fraction = (float)group.mass * inv_total_mass;
+        md_array_push(data->dataset.residue_names, item, persistent_alloc);
+    }
+
+    for (size_t i = 0; i < md_array_size(atom_types.groups); ++i) {
+        const DatasetGroup& group = atom_types.groups[i];
+        DatasetItem item = {};
+        snprintf(item.label, sizeof(item.label), "%.*s", (int)group.label.len, group.label.ptr);
+        snprintf(item.query, sizeof(item.query), "type('%.*s')", (int)group.label.len, group.label.ptr);
+        item.count = group.count;
+        item.fraction = group.count * inv_atom_count;
+        item.mass_fraction = (float)group.mass * inv_total_mass;
+        md_array_push(data->dataset.atom_types, item, persistent_alloc);
+    }
+}
+
+static void clear_dataset_items(ApplicationState* data) {
+    md_array_free(data->dataset.chains, persistent_alloc);
+    md_array_free(data->dataset.residue_names, persistent_alloc);
+    md_array_free(data->dataset.atom_types, persistent_alloc);
+}
+
+static void display_property_copy_param_from_old(DisplayProperty& item, const DisplayProperty* old_items, int64_t num_old_items) {
+    // See if we have a matching item in the old list
+    for (int64_t i = 0; i < num_old_items; ++i) {
+        if (strcmp(item.label, old_items[i].label) == 0 && item.type == old_items[i].type) {
+            // Copy relevant parameters from existing item which we want to be persistent
+            item.temporal_subplot_mask      = old_items[i].temporal_subplot_mask;
+            item.distribution_subplot_mask  = old_items[i].distribution_subplot_mask;
+            item.color                      = old_items[i].color;
+            item.temporal_subplot_mask      = old_items[i].temporal_subplot_mask;
+            item.distribution_subplot_mask  = old_items[i].distribution_subplot_mask;
+            item.show_in_volume             = old_items[i].show_in_volume;
+            item.plot_type                  = old_items[i].plot_type;
+            item.colormap_alpha			    = old_items[i].colormap_alpha;
             item.colormap                   = old_items[i].colormap;
             item.color_type                 = old_items[i].color_type;
             item.marker_size                = old_items[i].marker_size;
@@ -1601,6 +2493,19 @@ static void display_property_copy_param_from_old(DisplayProperty& item, const Di
     }
 }
 
+// Temporal properties are frame-local, so their filtered counterparts can be derived from the full evaluation by masking frames.
+// Only properties which are aggregated over the frames (distributions, volumes) require an actual evaluation of the filtered range.
+static bool requires_filtered_evaluation(const md_script_ir_t* ir) {
+    const size_t num_props = md_script_ir_property_count(ir);
+    const str_t* prop_names = md_script_ir_property_names(ir);
+    for (size_t i = 0; i < num_props; ++i) {
+        if (!(md_script_ir_property_flags(ir, prop_names[i]) & MD_SCRIPT_PROPERTY_FLAG_TEMPORAL)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 static void init_display_properties(ApplicationState* data) {
     DisplayProperty* new_items = 0;
     DisplayProperty* old_items = data->display_properties;
@@ -1628,7 +2533,10 @@ static void init_display_properties(ApplicationState* data) {
         for (size_t i = 0; i < num_props; ++i) {
             str_t prop_name = prop_names[i];
             md_script_property_flags_t prop_flags = md_script_ir_property_flags(ir, prop_name);
-            const md_script_property_data_t* prop_data = md_script_eval_property_data(eval, prop_name);
+
+            // Filtered temporal properties are derived from the full evaluation
+            const md_script_eval_t* prop_eval = (partial_evaluation && (prop_flags & MD_SCRIPT_PROPERTY_FLAG_TEMPORAL)) ? data->script.full_eval : eval;
+            const md_script_property_data_t* prop_data = md_script_eval_property_data(prop_eval, prop_name);
 
             if (!prop_data) {
                 MD_LOG_DEBUG("Failed to extract property data from property!");
@@ -1647,7 +2555,7 @@ static void init_display_properties(ApplicationState* data) {
             item.prop_flags = prop_flags;
             item.prop_data = prop_data;
             item.vis_payload = md_script_ir_property_vis_payload(ir, prop_name);
-            item.eval = eval;
+            item.eval = prop_eval;
             item.prop_fingerprint = 0;
             item.population_mask.set();
             item.temporal_subplot_mask = 0;
@@ -1838,6 +2746,7 @@ static void init_display_properties(ApplicationState* data) {
 
     for (size_t i = 0; i < md_array_size(old_items); ++i) {
         free_histogram(&old_items[i].hist);
+        cancel_plot_lod(&old_items[i]);
     }
 
     md_array_resize(data->display_properties, md_array_size(new_items), persistent_alloc);
@@ -1847,15 +2756,71 @@ static void init_display_properties(ApplicationState* data) {
 static void update_display_properties(ApplicationState* data) {
     ASSERT(data);
 
+    const size_t num_frames = md_array_size(data->timeline.x_values);
+
     for (size_t i = 0; i < md_array_size(data->display_properties); ++i) {
         DisplayProperty& dp = data->display_properties[i];
-        if (dp.type == DisplayProperty::Type_Distribution) {
-            if (dp.prop_fingerprint != dp.prop_data->fingerprint || dp.num_bins != dp.hist.num_bins) {
+
+        // Filtered properties which are derived from the full evaluation
+        const bool derived = dp.partial_evaluation && dp.eval && dp.eval == data->script.full_eval;
+
+        const md_bitfield_t* frame_mask = 0;
+        md_bitfield_t filt_mask = {};
+        size_t beg_frame = 0;
+        size_t end_frame = 0;
+        size_t frame_count = 0;
+        size_t eval_frame_count = 0;
+        if (dp.eval && num_frames > 0) {
+            frame_mask = md_script_eval_frame_mask(dp.eval);
+            if (dp.partial_evaluation) {
+                beg_frame = (size_t)CLAMP(data->timeline.filter.beg_frame, 0.0, (double)(num_frames - 1));
+                end_frame = (size_t)CLAMP(data->timeline.filter.end_frame + 1, (double)(beg_frame + 1), (double)num_frames);
+                frame_count = end_frame - beg_frame;
+                if (derived) {
+                    md_bitfield_init(&filt_mask, frame_alloc);
+                    md_bitfield_copy(&filt_mask, frame_mask);
+                    md_bitfield_clear_range(&filt_mask, 0, beg_frame);
+                    md_bitfield_clear_range(&filt_mask, end_frame, num_frames);
+                    frame_mask = &filt_mask;
+                }
+            } else {
+                end_frame = num_frames;
+                frame_count = num_frames;
+            }
+            eval_frame_count = md_bitfield_popcount(frame_mask);
+        }
+        dp.coverage = frame_count > 0 ? CLAMP((float)((double)eval_frame_count / (double)frame_count), 0.0f, 1.0f) : 1.0f;
+
+        if (dp.type == DisplayProperty::Type_Temporal) {
+            update_plot_lod(&dp);
+        }
+        else if (dp.type == DisplayProperty::Type_Distribution) {
+            // A new computation is only considered once the pending one is complete
+            if (update_histogram_job(&dp.hist)) continue;
+
+            // While the evaluation is in progress, the histogram is refreshed from the frames which are available so far
+            // We only refresh it when a significant portion of new frames has been added, to not recompute it every frame
+            const size_t refresh_count = MAX(frame_count / 64, 1);
+            const bool frames_added = (eval_frame_count == frame_count && dp.hist_frame_count != eval_frame_count) || (eval_frame_count >= dp.hist_frame_count + refresh_count);
+
+            const bool filter_changed = derived && dp.filter_fingerprint != data->timeline.filter.fingerprint;
+
+            const bool prop_changed = dp.prop_fingerprint != dp.prop_data->fingerprint || dp.num_bins != dp.hist.num_bins;
+
+            if (prop_changed || frames_added || filter_changed) {
                 dp.prop_fingerprint = dp.prop_data->fingerprint;
+                dp.hist_frame_count = eval_frame_count;
+                dp.filter_fingerprint = data->timeline.filter.fingerprint;
         
                 if (dp.prop_flags & MD_SCRIPT_PROPERTY_FLAG_TEMPORAL) {
                     DisplayProperty::Histogram& hist = dp.hist;
-                    compute_histogram_masked(&hist, dp.num_bins, dp.prop_data->min_range[0], dp.prop_data->max_range[0], dp.prop_data->values, dp.prop_data->dim[1], md_script_eval_frame_mask(dp.eval), dp.aggregate_histogram);
+                    // If the values are unchanged and the window is fully evaluated, only the frames which entered or left the window are binned
+                    // This is the common case for the temporal window during playback
+                    const bool incremental = !prop_changed && eval_frame_count == frame_count &&
+                        update_histogram_window(&hist, dp.num_bins, dp.prop_data->min_range[0], dp.prop_data->max_range[0], dp.prop_data->values, dp.prop_data->dim[1], (uint32_t)beg_frame, (uint32_t)end_frame, dp.aggregate_histogram);
+                    if (!incremental) {
+                        compute_histogram_masked_async(&hist, dp.num_bins, dp.prop_data->min_range[0], dp.prop_data->max_range[0], dp.prop_data->values, dp.prop_data->dim[1], frame_mask, dp.aggregate_histogram);
+                    }
                 }
                 else if (dp.prop_flags & MD_SCRIPT_PROPERTY_FLAG_DISTRIBUTION) {
                     DisplayProperty::Histogram& hist = dp.hist;
@@ -1873,6 +2838,436 @@ static void update_display_properties(ApplicationState* data) {
     }
 }
 
+// The SDF payload of the density volume is evaluated asynchronously on the task pool, since it may be costly for large ensembles.
+// The job owns its allocations and a snapshot of the atom coordinates, such that the main thread is free to animate the molecule meanwhile.
+struct DensityRepJob {
+    md_allocator_i* arena;
+    md_script_vis_t vis;
+    md_molecule_t mol;
+    md_script_vis_ctx_t ctx;
+    const md_script_vis_payload_o* vis_payload;
+    bool result;
+
+    // Atom indices of the structures [num_instances * stride], padded with UINT32_MAX
+    uint32_t* instance_atoms;
+    uint32_t stride;
+    uint32_t num_instances;
+
+    task_system::ID task;
+    std::atomic_bool done;
+};
+
+static void density_rep_job_free(DensityRepJob* job) {
+    ASSERT(job);
+    md_script_vis_free(&job->vis);
+    md_arena_allocator_destroy(job->arena);
+    job->~DensityRepJob();
+    md_free(md_get_heap_allocator(), job, sizeof(DensityRepJob));
+}
+
+static DensityRepJob* launch_density_rep_job(ApplicationState* data, const md_script_vis_payload_o* vis_payload) {
+    md_allocator_i* alloc = md_get_heap_allocator();
+    DensityRepJob* job = (DensityRepJob*)md_alloc(alloc, sizeof(DensityRepJob));
+    new (job) DensityRepJob();
+    job->arena = md_arena_allocator_create(alloc, MEGABYTES(1));
+    job->vis_payload = vis_payload;
+    md_script_vis_init(&job->vis, job->arena);
+
+    // Shallow copy of the molecule with private coordinates
+    job->mol = data->mold.mol;
+    const size_t count = data->mold.mol.atom.count;
+    job->mol.atom.x = (float*)md_alloc(job->arena, count * sizeof(float));
+    job->mol.atom.y = (float*)md_alloc(job->arena, count * sizeof(float));
+    job->mol.atom.z = (float*)md_alloc(job->arena, count * sizeof(float));
+    MEMCPY(job->mol.atom.x, data->mold.mol.atom.x, count * sizeof(float));
+    MEMCPY(job->mol.atom.y, data->mold.mol.atom.y, count * sizeof(float));
+    MEMCPY(job->mol.atom.z, data->mold.mol.atom.z, count * sizeof(float));
+
+    job->ctx = {
+        .ir = data->script.eval_ir,
+        .mol = &job->mol,
+        .traj = data->mold.traj,
+    };
+
+    job->task = task_system::create_pool_task(STR_LIT("##Evaluate Density Representation"), [](void* user_data) {
+        DensityRepJob* job = (DensityRepJob*)user_data;
+        job->result = md_script_vis_eval_payload(&job->vis, job->vis_payload, 0, &job->ctx, MD_SCRIPT_VISUALIZE_SDF);
+        if (job->result) {
+            const md_bitfield_t* structures = job->vis.sdf.structures;
+            const size_t num_structures = md_array_size(structures);
+            uint32_t stride = 0;
+            for (size_t i = 0; i < num_structures; ++i) {
+                stride = MAX(stride, (uint32_t)md_bitfield_popcount(&structures[i]));
+            }
+            const size_t count = num_structures * stride;
+            job->instance_atoms = (uint32_t*)md_alloc(job->arena, count * sizeof(uint32_t));
+            MEMSET(job->instance_atoms, 0xFF, count * sizeof(uint32_t));
+            for (size_t i = 0; i < num_structures; ++i) {
+                md_bitfield_iter_extract_indices((int32_t*)(job->instance_atoms + i * stride), stride, md_bitfield_iter_create(&structures[i]));
+            }
+            job->stride = stride;
+            job->num_instances = (uint32_t)num_structures;
+        }
+        job->done = true;
+    }, job);
+    task_system::enqueue_task(job->task);
+
+    return job;
+}
+
+// Updates the volume transform and the reference structures from a completed job
+static void apply_density_rep_job(ApplicationState* data, const DensityRepJob* job, const md_script_property_data_t* prop_data) {
+    const md_script_vis_t& vis = job->vis;
+    if (job->result && vis.sdf.extent) {
+        const float s = vis.sdf.extent;
+        vec3_t min_aabb = { -s, -s, -s };
+        vec3_t max_aabb = { s, s, s };
+        data->density_volume.model_mat = volume::compute_model_to_world_matrix(min_aabb, max_aabb);
+        data->density_volume.voxel_spacing = vec3_t{2*s / prop_data->dim[1], 2*s / prop_data->dim[2], 2*s / prop_data->dim[3]};
+    }
+
+    // Only the first structure is drawn through a full representation (the reference structure),
+    // the superimposed structures of the ensemble are drawn instanced, which does not require a representation per structure
+    const size_t num_reps = job->result ? MIN(md_array_size(vis.sdf.structures), 1) : 0;
+
+    const size_t old_size = md_array_size(data->density_volume.gl_reps);
+    if (data->density_volume.gl_reps) {
+        // Only free superflous entries
+        for (size_t i = num_reps; i < old_size; ++i) {
+            md_gl_rep_destroy(data->density_volume.gl_reps[i]);
+        }
+    }
+    md_array_resize(data->density_volume.gl_reps, num_reps, persistent_alloc);
+    md_array_resize(data->density_volume.rep_model_mats, num_reps, persistent_alloc);
+
+    for (size_t i = old_size; i < num_reps; ++i) {
+        // Only init new entries
+        data->density_volume.gl_reps[i] = md_gl_rep_create(data->mold.gl_mol);
+    }
+
+    const auto& mol = data->mold.mol;
+    auto& rep = data->density_volume.rep;
+    const size_t num_colors = data->mold.mol.atom.count;
+    const size_t num_bytes = sizeof(uint32_t) * num_colors;
+    uint32_t* colors = (uint32_t*)md_vm_arena_push(frame_alloc, num_bytes);
+    defer { md_vm_arena_pop(frame_alloc, num_bytes); };
+
+    switch (rep.colormap) {
+    case ColorMapping::Uniform:
+        color_atoms_uniform(colors, mol.atom.count, rep.color);
+        break;
+    case ColorMapping::Cpk:
+        color_atoms_cpk(colors, mol.atom.count, mol);
+        break;
+    case ColorMapping::AtomLabel:
+        color_atoms_type(colors, mol.atom.count, mol);
+        break;
+    case ColorMapping::AtomIndex:
+        color_atoms_idx(colors, mol.atom.count, mol);
+        break;
+    case ColorMapping::ResName:
+        color_atoms_res_name(colors, mol.atom.count, mol);
+        break;
+    case ColorMapping::ResId:
+        color_atoms_res_id(colors, mol.atom.count, mol);
+        break;
+    case ColorMapping::ChainId:
+        color_atoms_chain_id(colors, mol.atom.count, mol);
+        break;
+    case ColorMapping::ChainIndex:
+        color_atoms_chain_idx(colors, mol.atom.count, mol);
+        break;
+    case ColorMapping::SecondaryStructure:
+        color_atoms_sec_str(colors, mol.atom.count, mol);
+        break;
+    default:
+        ASSERT(false);
+        break;
+    }
+
+    // The ensemble shares the colors between all instances, the atoms of each instance are given by its indices
+    ensemble::Ensemble* ens = &data->density_volume.ensemble;
+    ensemble::set_instances(ens, job->instance_atoms, job->stride, vis.sdf.matrices, job->num_instances);
+    ensemble::set_atom_positions(ens, job->mol.atom.x, job->mol.atom.y, job->mol.atom.z, job->mol.atom.count);
+    ensemble::set_atom_radii(ens, mol.atom.radius, mol.atom.count);
+    ensemble::set_atom_colors(ens, colors, num_colors);
+
+    for (size_t i = 0; i < num_reps; ++i) {
+        filter_colors(colors, num_colors, &vis.sdf.structures[i]);
+        md_gl_rep_set_color(data->density_volume.gl_reps[i], 0, (uint32_t)num_colors, colors, 0);
+        data->density_volume.rep_model_mats[i] = vis.sdf.matrices[i];
+    }
+}
+
+// The density volume is streamed to the GPU through a pixel unpack buffer into the back texture of a double buffered pair.
+// The values are copied into the mapped buffer in parallel on the task pool, then the transfer is issued from the buffer and
+// fenced. Once the fence is signaled, the back texture is swapped to the front. The front texture is rendered throughout.
+// In the bricked mode, the sparse volume and the layout of its atlas are instead built on the task pool. The padded bricks and the index
+// are then written into the mapped buffer on the task pool and transferred in the same manner, only the GL calls are issued on the main thread.
+// The sparse volume is only kept until the bricks have been written, and the dense textures are released while the bricked representation is in use.
+struct VolumeUpload {
+    const float* values;
+    void* mapped;
+    size_t bytes;
+    int dim[3];
+    float max_value;
+    GLsync fence;
+
+    bool bricked;
+    bool layout_valid;
+    int max_texture_dim;
+    viamd::sparse_volume_t sparse;
+    volume::BrickedVolume bricked_volume;   // Layout and textures of the uploaded bricked representation
+
+    task_system::ID task;
+};
+
+// Number of bytes copied per range
+#define VOLUME_UPLOAD_RANGE_BYTES (1024 * 1024)
+
+static void volume_upload_free(VolumeUpload* upload) {
+    ASSERT(upload);
+    if (upload->fence) {
+        glDeleteSync(upload->fence);
+    }
+    viamd::sparse_volume_free(&upload->sparse);
+    volume::free_bricked_volume(&upload->bricked_volume);
+    upload->~VolumeUpload();
+    md_free(md_get_heap_allocator(), upload, sizeof(VolumeUpload));
+}
+
+// Orphans the previous storage of the buffer and maps it for writing, such that the mapping does not stall on a transfer which may still be in flight
+static void* map_volume_upload_buffer(uint32_t* pbo, size_t bytes) {
+    if (!*pbo) {
+        glGenBuffers(1, pbo);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, *pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return mapped;
+}
+
+static VolumeUpload* launch_volume_upload(ApplicationState* data, const md_script_property_data_t* prop_data) {
+    auto& tex = data->density_volume.volume_texture;
+    const int dim[3] = { prop_data->dim[1], prop_data->dim[2], prop_data->dim[3] };
+    const size_t bytes = (size_t)dim[0] * dim[1] * dim[2] * sizeof(float);
+    if (bytes == 0) return nullptr;
+
+    md_allocator_i* alloc = md_get_heap_allocator();
+
+    if (tex.bricked) {
+        VolumeUpload* upload = (VolumeUpload*)md_alloc(alloc, sizeof(VolumeUpload));
+        new (upload) VolumeUpload();
+        upload->values = prop_data->values;
+        upload->bytes = bytes;
+        MEMCPY(upload->dim, dim, sizeof(dim));
+        upload->max_value = prop_data->max_value;
+        upload->bricked = true;
+        glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &upload->max_texture_dim);
+
+        upload->task = task_system::create_pool_task(STR_LIT("##Build Sparse Volume"), [](void* user_data) {
+            VolumeUpload* upload = (VolumeUpload*)user_data;
+            if (viamd::sparse_volume_init_from_dense(&upload->sparse, upload->values, upload->dim, 0.0f, md_get_heap_allocator())) {
+                upload->layout_valid = volume::compute_bricked_volume_layout(&upload->bricked_volume, &upload->sparse, upload->max_texture_dim);
+            }
+        }, upload);
+        task_system::enqueue_task(upload->task);
+
+        return upload;
+    }
+
+    void* mapped = map_volume_upload_buffer(&tex.pbo, bytes);
+    if (!mapped) {
+        // Fallback to a synchronous upload
+        gl::init_texture_3D(&tex.id, dim[0], dim[1], dim[2], GL_R16F);
+        gl::set_texture_3D_data(tex.id, prop_data->values, GL_R32F);
+        volume::compute_macro_cell_texture(&tex.macro_cells, tex.id);
+        MEMCPY(tex.dim, dim, sizeof(dim));
+        tex.max_value = prop_data->max_value;
+        tex.use_bricked = false;
+        return nullptr;
+    }
+
+    VolumeUpload* upload = (VolumeUpload*)md_alloc(alloc, sizeof(VolumeUpload));
+    new (upload) VolumeUpload();
+    upload->values = prop_data->values;
+    upload->mapped = mapped;
+    upload->bytes = bytes;
+    MEMCPY(upload->dim, dim, sizeof(dim));
+    upload->max_value = prop_data->max_value;
+
+    const uint32_t num_ranges = (uint32_t)((bytes + VOLUME_UPLOAD_RANGE_BYTES - 1) / VOLUME_UPLOAD_RANGE_BYTES);
+    upload->task = task_system::create_pool_task(STR_LIT("##Copy Volume"), 0, num_ranges, [](uint32_t range_beg, uint32_t range_end, void* user_data, uint32_t thread_num) {
+        (void)thread_num;
+        VolumeUpload* upload = (VolumeUpload*)user_data;
+        for (uint32_t i = range_beg; i < range_end; ++i) {
+            const size_t beg = (size_t)i * VOLUME_UPLOAD_RANGE_BYTES;
+            const size_t end = MIN(beg + VOLUME_UPLOAD_RANGE_BYTES, upload->bytes);
+            MEMCPY((char*)upload->mapped + beg, (const char*)upload->values + beg, end - beg);
+        }
+    }, upload);
+    task_system::enqueue_task(upload->task);
+
+    return upload;
+}
+
+static void free_dense_volume_textures(ApplicationState* data) {
+    auto& tex = data->density_volume.volume_texture;
+    gl::free_texture(&tex.id);
+    gl::free_texture(&tex.back_id);
+    gl::free_texture(&tex.macro_cells);
+    if (tex.pbo) {
+        glDeleteBuffers(1, &tex.pbo);
+        tex.pbo = 0;
+    }
+}
+
+// Makes the uploaded bricked representation the current one
+static void swap_in_bricked_volume(ApplicationState* data, VolumeUpload* upload) {
+    auto& tex = data->density_volume.volume_texture;
+    volume::free_bricked_volume(&tex.bricked_volume);
+    tex.bricked_volume = upload->bricked_volume;
+    upload->bricked_volume = {};
+    tex.use_bricked = true;
+    MEMCPY(tex.dim, upload->dim, sizeof(tex.dim));
+    tex.max_value = upload->max_value;
+    free_dense_volume_textures(data);
+}
+
+// Advances the bricked upload, returns true when it is complete
+static bool update_bricked_volume_upload(ApplicationState* data, VolumeUpload* upload) {
+    auto& tex = data->density_volume.volume_texture;
+    if (task_system::task_is_running(upload->task)) return false;
+
+    if (!upload->layout_valid) {
+        LOG_ERROR("Failed to upload the sparse density volume, falling back to the dense representation");
+        tex.bricked = false;
+        data->density_volume.dirty_vol = true;
+        return true;
+    }
+
+    const volume::BrickedVolume& layout = upload->bricked_volume;
+    const size_t atlas_bytes = volume::bricked_volume_atlas_bytes(layout);
+    const size_t num_rows = (size_t)layout.brick_count[1] * layout.brick_count[2];
+
+    if (!upload->mapped && !upload->fence) {
+        // The sparse volume and the layout are complete
+        if (layout.num_bricks == 0) {
+            swap_in_bricked_volume(data, upload);
+            return true;
+        }
+
+        upload->bytes = atlas_bytes + volume::bricked_volume_index_bytes(layout);
+        upload->mapped = map_volume_upload_buffer(&tex.pbo, upload->bytes);
+        if (!upload->mapped) {
+            // Fallback to a synchronous upload
+            md_allocator_i* alloc = md_get_heap_allocator();
+            char* buf = (char*)md_alloc(alloc, upload->bytes);
+            volume::write_bricked_volume_rows(buf, buf + atlas_bytes, layout, &upload->sparse, 0, num_rows);
+            volume::upload_bricked_volume(&upload->bricked_volume, buf, buf + atlas_bytes);
+            md_free(alloc, buf, upload->bytes);
+            swap_in_bricked_volume(data, upload);
+            return true;
+        }
+
+        upload->task = task_system::create_pool_task(STR_LIT("##Write Bricks"), 0, (uint32_t)num_rows, [](uint32_t range_beg, uint32_t range_end, void* user_data, uint32_t thread_num) {
+            (void)thread_num;
+            VolumeUpload* upload = (VolumeUpload*)user_data;
+            char* atlas = (char*)upload->mapped;
+            char* index = atlas + volume::bricked_volume_atlas_bytes(upload->bricked_volume);
+            volume::write_bricked_volume_rows(atlas, index, upload->bricked_volume, &upload->sparse, range_beg, range_end);
+        }, upload);
+        task_system::enqueue_task(upload->task);
+        return false;
+    }
+
+    if (!upload->fence) {
+        viamd::sparse_volume_free(&upload->sparse);
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, tex.pbo);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        // With an unpack buffer bound, the data pointers are interpreted as offsets into the buffer
+        volume::upload_bricked_volume(&upload->bricked_volume, NULL, (const void*)(uintptr_t)atlas_bytes);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        upload->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        return false;
+    }
+
+    const GLenum status = glClientWaitSync(upload->fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return false;
+
+    swap_in_bricked_volume(data, upload);
+    return true;
+}
+
+// Advances the upload, returns true when it is complete (and the upload has been freed)
+static bool update_volume_upload(ApplicationState* data) {
+    auto& tex = data->density_volume.volume_texture;
+    VolumeUpload* upload = tex.upload;
+    ASSERT(upload);
+
+    if (upload->bricked) {
+        if (!update_bricked_volume_upload(data, upload)) return false;
+        volume_upload_free(upload);
+        return true;
+    }
+
+    if (!upload->fence) {
+        if (task_system::task_is_running(upload->task)) return false;
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, tex.pbo);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        gl::init_texture_3D(&tex.back_id, upload->dim[0], upload->dim[1], upload->dim[2], GL_R16F);
+        // With an unpack buffer bound, the data pointer is interpreted as an offset into the buffer
+        gl::set_texture_3D_data(tex.back_id, NULL, GL_R32F);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        upload->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        return false;
+    }
+
+    const GLenum status = glClientWaitSync(upload->fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return false;
+
+    const uint32_t front = tex.id;
+    tex.id = tex.back_id;
+    tex.back_id = front;
+    volume::compute_macro_cell_texture(&tex.macro_cells, tex.id);
+    MEMCPY(tex.dim, upload->dim, sizeof(tex.dim));
+    tex.max_value = upload->max_value;
+    tex.use_bricked = false;
+
+    // The bricked representation is only retained while it is in use
+    volume::free_bricked_volume(&tex.bricked_volume);
+
+    volume_upload_free(upload);
+    return true;
+}
+
+// Cancels pending asynchronous work which reads from the evaluation data of the density volume
+static void cancel_density_volume_jobs(ApplicationState* data) {
+    if (data->density_volume.rep_job) {
+        task_system::task_wait_for(data->density_volume.rep_job->task);
+        density_rep_job_free(data->density_volume.rep_job);
+        data->density_volume.rep_job = nullptr;
+        data->density_volume.dirty_rep = true;
+    }
+    VolumeUpload* upload = data->density_volume.volume_texture.upload;
+    if (upload) {
+        task_system::task_interrupt_and_wait_for(upload->task);
+        if (upload->mapped && !upload->fence) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, data->density_volume.volume_texture.pbo);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        volume_upload_free(upload);
+        data->density_volume.volume_texture.upload = nullptr;
+        data->density_volume.dirty_vol = true;
+    }
+}
+
 static void update_density_volume(ApplicationState* data) {
     if (data->density_volume.dvr.tf.dirty) {
         data->density_volume.dvr.tf.dirty = false;
@@ -1926,115 +3321,45 @@ static void update_density_volume(ApplicationState* data) {
         data->density_volume.dirty_rep = true;
     }
 
-    if (data->density_volume.dirty_rep) {
-        if (prop_data && vis_payload) {
-            data->density_volume.dirty_rep = false;
-            size_t num_reps = 0;
-            bool result = false;
-            md_script_vis_t vis = {};
-
-            if (md_script_ir_valid(data->script.eval_ir)) {
-                md_script_vis_init(&vis, frame_alloc);
-                md_script_vis_ctx_t ctx = {
-                    .ir = data->script.eval_ir,
-                    .mol = &data->mold.mol,
-                    .traj = data->mold.traj,
-                };
-                result = md_script_vis_eval_payload(&vis, vis_payload, 0, &ctx, MD_SCRIPT_VISUALIZE_SDF);
-            }
-
-            if (result) {
-                if (vis.sdf.extent) {
-                    const float s = vis.sdf.extent;
-                    vec3_t min_aabb = { -s, -s, -s };
-                    vec3_t max_aabb = { s, s, s };
-                    data->density_volume.model_mat = volume::compute_model_to_world_matrix(min_aabb, max_aabb);
-                    data->density_volume.voxel_spacing = vec3_t{2*s / prop_data->dim[1], 2*s / prop_data->dim[2], 2*s / prop_data->dim[3]};
-                }
-                num_reps = md_array_size(vis.sdf.structures);
-            }
-
-            // We need to limit this for performance reasons
-            num_reps = MIN(num_reps, 100);
-
-            const size_t old_size = md_array_size(data->density_volume.gl_reps);
-            if (data->density_volume.gl_reps) {
-                // Only free superflous entries
-                for (size_t i = num_reps; i < old_size; ++i) {
-                    md_gl_rep_destroy(data->density_volume.gl_reps[i]);
-                }
-            }
-            md_array_resize(data->density_volume.gl_reps, num_reps, persistent_alloc);
-            md_array_resize(data->density_volume.rep_model_mats, num_reps, persistent_alloc);
-
-            for (size_t i = old_size; i < num_reps; ++i) {
-                // Only init new entries
-                data->density_volume.gl_reps[i] = md_gl_rep_create(data->mold.gl_mol);
+    if (data->density_volume.rep_job) {
+        DensityRepJob* job = data->density_volume.rep_job;
+        if (job->done) {
+            // The result is discarded if the selected property changed while the job was in flight
+            if (job->vis_payload == vis_payload && prop_data) {
+                apply_density_rep_job(data, job, prop_data);
             }
+            density_rep_job_free(job);
+            data->density_volume.rep_job = nullptr;
+        }
+    }
 
-            const auto& mol = data->mold.mol;
-            auto& rep = data->density_volume.rep;
-            const size_t num_colors = data->mold.mol.atom.count;
-            const size_t num_bytes = sizeof(uint32_t) * num_colors;
-            uint32_t* colors = (uint32_t*)md_vm_arena_push(frame_alloc, num_bytes);
-            defer { md_vm_arena_pop(frame_alloc, num_bytes); };
-
-            switch (rep.colormap) {
-            case ColorMapping::Uniform:
-                color_atoms_uniform(colors, mol.atom.count, rep.color);
-                break;
-            case ColorMapping::Cpk:
-                color_atoms_cpk(colors, mol.atom.count, mol);
-                break;
-            case ColorMapping::AtomLabel:
-                color_atoms_type(colors, mol.atom.count, mol);
-                break;
-            case ColorMapping::AtomIndex:
-                color_atoms_idx(colors, mol.atom.count, mol);
-                break;
-            case ColorMapping::ResName:
-                color_atoms_res_name(colors, mol.atom.count, mol);
-                break;
-            case ColorMapping::ResId:
-                color_atoms_res_id(colors, mol.atom.count, mol);
-                break;
-            case ColorMapping::ChainId:
-                color_atoms_chain_id(colors, mol.atom.count, mol);
-                break;
-            case ColorMapping::ChainIndex:
-                color_atoms_chain_idx(colors, mol.atom.count, mol);
-                break;
-            case ColorMapping::SecondaryStructure:
-                color_atoms_sec_str(colors, mol.atom.count, mol);
-                break;
-            default:
-                ASSERT(false);
-                break;
-            }
+    // If the representation is invalidated while a job is in flight, it remains dirty and a new job is launched once the current one completes
+    if (data->density_volume.dirty_rep && !data->density_volume.rep_job) {
+        if (prop_data && vis_payload && md_script_ir_valid(data->script.eval_ir)) {
+            data->density_volume.dirty_rep = false;
+            data->density_volume.rep_job = launch_density_rep_job(data, vis_payload);
+        }
+    }
 
-            for (size_t i = 0; i < num_reps; ++i) {
-                filter_colors(colors, num_colors, &vis.sdf.structures[i]);
-                md_gl_rep_set_color(data->density_volume.gl_reps[i], 0, (uint32_t)num_colors, colors, 0);
-                data->density_volume.rep_model_mats[i] = vis.sdf.matrices[i];
-            }
+    if (data->density_volume.volume_texture.upload) {
+        if (update_volume_upload(data)) {
+            data->density_volume.volume_texture.upload = nullptr;
         }
     }
 
-    if (data->density_volume.dirty_vol) {
+    if (data->density_volume.dirty_vol && !data->density_volume.volume_texture.upload) {
         if (prop_data) {
             data->density_volume.dirty_vol = false;
-            if (!data->density_volume.volume_texture.id) {
-                int dim[3] = { prop_data->dim[1], prop_data->dim[2], prop_data->dim[3] };
-                gl::init_texture_3D(&data->density_volume.volume_texture.id, dim[0], dim[1], dim[2], GL_R16F);
-                MEMCPY(data->density_volume.volume_texture.dim, dim, sizeof(dim));
-                data->density_volume.volume_texture.max_value = prop_data->max_value;
-            }
-            gl::set_texture_3D_data(data->density_volume.volume_texture.id, prop_data->values, GL_R32F);
+            data->density_volume.volume_texture.upload = launch_volume_upload(data, prop_data);
         }
     }
 }
 
 static void clear_density_volume(ApplicationState* state) {
+    cancel_density_volume_jobs(state);
+    volume::free_bricked_volume(&state->density_volume.volume_texture.bricked_volume);
+    state->density_volume.volume_texture.use_bricked = false;
+    ensemble::destroy(&state->density_volume.ensemble);
     md_array_shrink(state->density_volume.gl_reps, 0);
     md_array_shrink(state->density_volume.rep_model_mats, 0);
     state->density_volume.model_mat = {0};
@@ -2443,6 +3768,7 @@ static void interpolate_atomic_properties(ApplicationState* state) {
     mol.unit_cell = payload.unit_cell;
 
     state->mold.dirty_buffers |= MolBit_DirtyPosition;
+    state->mold.position_generation += 1;
     state->mold.dirty_buffers |= MolBit_DirtySecondaryStructure;
 }
 
@@ -2542,24 +3868,190 @@ static void reset_view(ApplicationState* data, bool move_camera, bool smooth_tra
     data->view.trackball_param.max_distance = optimal_dist * 10.0f;
 }
 
-static bool filter_expression(ApplicationState* data, str_t expr, md_bitfield_t* mask, bool* is_dynamic = NULL, char* error_buf = NULL, int error_cap = 0) {
-    if (data->mold.mol.atom.count == 0) return false;    
-    
+// The results of filter expressions are cached, such that representations and the selection query which share an expression only evaluate it once.
+// Static expressions remain valid until the cache is cleared (script, topology or selections change), dynamic expressions are additionally keyed by the frame.
+#define FILTER_CACHE_CAPACITY 32
+
+struct FilterCacheEntry {
+    uint64_t expr_hash = 0;     // Hash of the normalized expression and the script, zero for free entries
+    uint64_t frame_hash = 0;    // Frame which a dynamic expression was evaluated for
+    uint64_t last_use = 0;
+    md_bitfield_t mask = {};
+    bool evaluated = false;
     bool success = false;
+    bool is_dynamic = false;
+    char error[256] = "";
+};
+
+static struct {
+    md_array(FilterCacheEntry) entries = 0;
+    uint64_t use_counter = 0;
+} filter_cache;
 
+static void filter_cache_clear() {
+    for (size_t i = 0; i < md_array_size(filter_cache.entries); ++i) {
+        filter_cache.entries[i].expr_hash = 0;
+    }
+}
+
+// Expressions which only differ in whitespace share the same entry
+static uint64_t filter_expr_hash(const ApplicationState* data, str_t expr) {
+    md_vm_arena_temp_t tmp = md_vm_arena_temp_begin(frame_alloc);
+    defer { md_vm_arena_temp_end(tmp); };
+
+    char* buf = (char*)md_vm_arena_push(frame_alloc, expr.len + 1);
+    size_t len = 0;
+    bool in_quote = false;
+    bool pending_space = false;
+    for (size_t i = 0; i < expr.len; ++i) {
+        const char c = expr.ptr[i];
+        if (!in_quote && (c == ' ' || c == '\t' || c == '\n' || c == '\r')) {
+            pending_space = len > 0;
+            continue;
+        }
+        if (pending_space) buf[len++] = ' ';
+        pending_space = false;
+        if (c == '\'' || c == '"') in_quote = !in_quote;
+        buf[len++] = c;
+    }
+
+    const uint64_t ir_fingerprint = data->script.ir ? md_script_ir_fingerprint(data->script.ir) : 0;
+    const uint64_t hash = md_hash64(buf, len, ir_fingerprint);
+    return hash ? hash : 1;
+}
+
+static uint64_t filter_frame_hash(const ApplicationState* data) {
+    return md_hash64(&data->animation.frame, sizeof(data->animation.frame), 0);
+}
+
+static int filter_cache_find(uint64_t expr_hash) {
+    for (size_t i = 0; i < md_array_size(filter_cache.entries); ++i) {
+        if (filter_cache.entries[i].expr_hash == expr_hash) return (int)i;
+    }
+    return -1;
+}
+
+static bool filter_cache_entry_valid(const FilterCacheEntry& entry, uint64_t frame_hash) {
+    return entry.evaluated && (!entry.is_dynamic || entry.frame_hash == frame_hash);
+}
+
+// Returns the index of a free entry, the least recently used entry is replaced when the cache is full
+static int filter_cache_insert(uint64_t expr_hash) {
+    int idx = -1;
+    for (size_t i = 0; i < md_array_size(filter_cache.entries); ++i) {
+        if (filter_cache.entries[i].expr_hash == 0) {
+            idx = (int)i;
+            break;
+        }
+    }
+    if (idx == -1 && md_array_size(filter_cache.entries) < FILTER_CACHE_CAPACITY) {
+        FilterCacheEntry* entry = md_array_push(filter_cache.entries, FilterCacheEntry(), persistent_alloc);
+        md_bitfield_init(&entry->mask, md_get_heap_allocator());
+        idx = (int)md_array_size(filter_cache.entries) - 1;
+    }
+    if (idx == -1) {
+        idx = 0;
+        for (size_t i = 1; i < md_array_size(filter_cache.entries); ++i) {
+            if (filter_cache.entries[i].last_use < filter_cache.entries[idx].last_use) idx = (int)i;
+        }
+    }
+    FilterCacheEntry& entry = filter_cache.entries[idx];
+    entry.expr_hash = expr_hash;
+    entry.evaluated = false;
+    entry.last_use = ++filter_cache.use_counter;
+    return idx;
+}
+
+// This may be called concurrently for different entries
+static void filter_cache_evaluate(ApplicationState* data, str_t expr, FilterCacheEntry* entry, uint64_t frame_hash) {
+    entry->success = false;
+    entry->is_dynamic = false;
+    entry->error[0] = '\0';
     if (md_semaphore_aquire(&data->script.ir_semaphore)) {
         defer { md_semaphore_release(&data->script.ir_semaphore); };
-        return md_filter(mask, expr, &data->mold.mol, data->script.ir, is_dynamic, error_buf, error_cap);
+        entry->success = md_filter(&entry->mask, expr, &data->mold.mol, data->script.ir, &entry->is_dynamic, entry->error, sizeof(entry->error));
+        entry->frame_hash = frame_hash;
+        entry->evaluated = true;
+    } else {
+        // Nothing was evaluated, so the entry is released
+        entry->expr_hash = 0;
     }
-
-    return success;
 }
 
-// ### DRAW WINDOWS ###
-static void draw_main_menu(ApplicationState* data) {
-    ASSERT(data);
-    bool new_clicked = false;
-    char path_buf[2048] = "";
+static bool filter_expression(ApplicationState* data, str_t expr, md_bitfield_t* mask, bool* is_dynamic = NULL, char* error_buf = NULL, int error_cap = 0) {
+    if (data->mold.mol.atom.count == 0) return false;
+
+    const uint64_t expr_hash = filter_expr_hash(data, expr);
+    const uint64_t frame_hash = filter_frame_hash(data);
+
+    int idx = filter_cache_find(expr_hash);
+    if (idx == -1 || !filter_cache_entry_valid(filter_cache.entries[idx], frame_hash)) {
+        if (idx == -1) idx = filter_cache_insert(expr_hash);
+        filter_cache_evaluate(data, expr, &filter_cache.entries[idx], frame_hash);
+    }
+
+    FilterCacheEntry& entry = filter_cache.entries[idx];
+    entry.last_use = ++filter_cache.use_counter;
+    if (is_dynamic) *is_dynamic = entry.is_dynamic;
+    if (error_buf && error_cap > 0) snprintf(error_buf, error_cap, "%s", entry.error);
+    if (entry.success) {
+        md_bitfield_copy(mask, &entry.mask);
+    }
+    return entry.success;
+}
+
+// Evaluates the expressions which are not present in the cache in parallel on the task pool
+// Subsequent calls to filter_expression with these expressions are then served from the cache
+static void prefetch_filter_expressions(ApplicationState* data, const str_t* exprs, size_t count) {
+    if (data->mold.mol.atom.count == 0 || count < 2) return;
+
+    md_vm_arena_temp_t tmp = md_vm_arena_temp_begin(frame_alloc);
+    defer { md_vm_arena_temp_end(tmp); };
+
+    struct Item {
+        str_t expr;
+        int idx;
+    };
+    struct Payload {
+        ApplicationState* data;
+        Item* items;
+        uint64_t frame_hash;
+    } payload = {data, (Item*)md_vm_arena_push(frame_alloc, count * sizeof(Item)), filter_frame_hash(data)};
+
+    // At most half of the cache is evicted, such that the prefetched entries do not evict each other
+    uint32_t num_items = 0;
+    for (size_t i = 0; i < count && num_items < FILTER_CACHE_CAPACITY / 2; ++i) {
+        const uint64_t expr_hash = filter_expr_hash(data, exprs[i]);
+        int idx = filter_cache_find(expr_hash);
+        if (idx != -1 && filter_cache_entry_valid(filter_cache.entries[idx], payload.frame_hash)) continue;
+        bool duplicate = false;
+        for (uint32_t j = 0; j < num_items; ++j) {
+            if (filter_cache.entries[payload.items[j].idx].expr_hash == expr_hash) {
+                duplicate = true;
+                break;
+            }
+        }
+        if (duplicate) continue;
+        if (idx == -1) idx = filter_cache_insert(expr_hash);
+        payload.items[num_items++] = {exprs[i], idx};
+    }
+    if (num_items < 2) return;
+
+    task_system::ID id = task_system::create_pool_task(STR_LIT("##Evaluate Filters"), 0, num_items, [](uint32_t range_beg, uint32_t range_end, void* user_data, uint32_t) {
+        Payload* p = (Payload*)user_data;
+        for (uint32_t i = range_beg; i < range_end; ++i) {
+            filter_cache_evaluate(p->data, p->items[i].expr, &filter_cache.entries[p->items[i].idx], p->frame_hash);
+        }
+    }, &payload);
+    task_system::enqueue_task(id);
+    task_system::task_wait_for(id);
+}
+
+// ### DRAW WINDOWS ###
+static void draw_main_menu(ApplicationState* data) {
+    ASSERT(data);
+    bool new_clicked = false;
+    char path_buf[2048] = "";
 
     if (ImGui::BeginMainMenuBar()) {
         if (ImGui::BeginMenu("File")) {
@@ -2686,6 +4178,47 @@ static void draw_main_menu(ApplicationState* data) {
             ImGui::Separator();
 #endif
 
+            // Culling
+            ImGui::BeginGroup();
+            ImGui::PushID("Culling");
+            ImGui::Checkbox("Culling", &data->visuals.culling.enabled);
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Skip the atoms of Spacefill, Licorice and Ball And Stick representations which are outside of the view or occluded");
+            }
+            if (data->visuals.culling.enabled) {
+                ImGui::Checkbox("Occlusion", &data->visuals.culling.occlusion);
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Skip the atoms which are hidden behind the depth of a previous frame\nOnly applies while the view and the scene are at rest");
+                }
+                ImGui::SliderFloat("Detail Threshold", &data->visuals.culling.lod_pixel_size, 0.0f, 16.0f, "%.1f px");
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Clusters of atoms which project to fewer pixels than this are drawn with a subset of their atoms");
+                }
+            }
+            ImGui::PopID();
+            ImGui::EndGroup();
+            ImGui::Separator();
+
+            // Dynamic Resolution
+            ImGui::BeginGroup();
+            ImGui::PushID("Dynamic Resolution");
+            ImGui::Checkbox("Dynamic Resolution", &data->visuals.dynamic_resolution.enabled);
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Reduce the resolution of the SSAO and the rendering to hold the target GPU frame time\nThe GPU time is measured by the profiler, which has to be enabled");
+            }
+            if (data->visuals.dynamic_resolution.enabled) {
+                ImGui::SliderFloat("Target", &data->visuals.dynamic_resolution.target_ms, 4.0f, 50.0f, "%.1f ms");
+                ImGui::SliderFloat("Min Scale", &data->visuals.dynamic_resolution.min_scale, 0.25f, 1.0f, "%.2f");
+                ImGui::Text("Scale: %.2f (%i x %i), SSAO: %s", data->visuals.dynamic_resolution.scale, (int)data->gbuffer.width, (int)data->gbuffer.height,
+                    data->visuals.dynamic_resolution.ssao_half_res ? "half" : "full");
+                if (!profiler::enabled()) {
+                    ImGui::TextDisabled("The profiler is disabled");
+                }
+            }
+            ImGui::PopID();
+            ImGui::EndGroup();
+            ImGui::Separator();
+
             // DOF
             ImGui::BeginGroup();
             ImGui::Checkbox("Depth of Field", &data->visuals.dof.enabled);
@@ -2745,6 +4278,10 @@ static void draw_main_menu(ApplicationState* data) {
             if (ImGui::MenuItem("Clear")) {
                 md_bitfield_clear(&data->selection.selection_mask);
             }
+            ImGui::Checkbox("Select Occluded Atoms", &data->selection.region.include_occluded);
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Region selections (Shift + Drag) include atoms which are hidden behind others");
+            }
             ImGui::Spacing();
             ImGui::Separator();
 
@@ -2776,7 +4313,7 @@ static void draw_main_menu(ApplicationState* data) {
                     ImGui::SameLine();
                     if (ImGui::Button("Load")) {
                         md_bitfield_copy(&data->selection.selection_mask, &sel.atom_mask);
-                        update_all_representations(data);
+                        update_all_representations(data, RepBit_DirtyFilter);
                     }
                     if (ImGui::IsItemHovered()) {
                         ImGui::SetTooltip("Load the stored selection into the active selection");
@@ -2787,7 +4324,7 @@ static void draw_main_menu(ApplicationState* data) {
                         ImGui::SetTooltip("Store the active selection into the stored selection");
                         md_bitfield_copy(&sel.atom_mask, &data->selection.selection_mask);
                         data->script.compile_ir = true;
-                        update_all_representations(data);
+                        update_all_representations(data, RepBit_DirtyFilter);
                     }
                     ImGui::SameLine();
                     if (ImGui::DeleteButton("Remove")) {
@@ -2826,6 +4363,31 @@ static void draw_main_menu(ApplicationState* data) {
                 }
                 ImGui::GetCurrentWindow()->Hidden = true;
             }
+            ImGui::Separator();
+            ImGui::Text("High Resolution Render");
+            ImGui::InputInt("Width",  &data->screenshot.width,  256, 1024);
+            ImGui::InputInt("Height", &data->screenshot.height, 256, 1024);
+            data->screenshot.width  = CLAMP(data->screenshot.width,  1, SCREENSHOT_MAX_DIM);
+            data->screenshot.height = CLAMP(data->screenshot.height, 1, SCREENSHOT_MAX_DIM);
+            if (ImGui::MenuItem("Render Image")) {
+                if (application::file_dialog(path_buf, sizeof(path_buf), application::FileDialogFlag_Save, STR_LIT("jpg,png,bmp"))) {
+                    size_t path_len = strnlen(path_buf, sizeof(path_buf));
+                    str_t ext;
+                    if (!extract_ext(&ext, {path_buf, path_len})) {
+                        path_len += snprintf(path_buf + path_len, sizeof(path_buf) - path_len, ".png");
+                    }
+                    create_high_res_render(data, {path_buf, path_len}, data->screenshot.width, data->screenshot.height);
+                }
+            }
+            for (size_t i = 0; i < md_array_size(data->screenshot.jobs); ++i) {
+                const ScreenshotJob* job = data->screenshot.jobs[i];
+                const int num_regions = MAX(1, job->tile.count[0] * job->tile.count[1]);
+                ImGui::ProgressBar(1.0f - (float)job->regions_left / (float)num_regions, ImVec2(-1, 0), job->regions_left > 0 ? "Rendering..." : "Encoding...");
+            }
+            ImGui::Separator();
+            if (ImGui::MenuItem("Export Frames...")) {
+                data->movie.show_window = true;
+            }
             ImGui::EndMenu();
         }
         if (ImGui::BeginMenu("Operations")) {
@@ -2871,6 +4433,7 @@ static void draw_main_menu(ApplicationState* data) {
                     md_molecule_t& mol = data->mold.mol;
                     md_util_pbc(mol.atom.x, mol.atom.y, mol.atom.z, 0, mol.atom.count, &mol.unit_cell);
                     data->mold.dirty_buffers |= MolBit_DirtyPosition;
+                    data->mold.position_generation += 1;
                 }
 
                 if (do_unwrap) {
@@ -2882,6 +4445,7 @@ static void draw_main_menu(ApplicationState* data) {
                         md_util_unwrap(mol.atom.x, mol.atom.y, mol.atom.z, s_idx, s_len, &mol.unit_cell);
                     }
                     data->mold.dirty_buffers |= MolBit_DirtyPosition;
+                    data->mold.position_generation += 1;
                 }
 
                 ImGui::EndTable();
@@ -3236,7 +4800,7 @@ void apply_atom_elem_mappings(ApplicationState* data) {
     md_util_molecule_postprocess(mol, data->mold.mol_alloc, MD_UTIL_POSTPROCESS_BOND_BIT | MD_UTIL_POSTPROCESS_STRUCTURE_BIT);
     data->mold.dirty_buffers |= MolBit_DirtyBonds;
 
-    update_all_representations(data);
+    update_all_representations(data, RepBit_DirtyFilter);
 }
 
 // Create a textual script describing a selection from a bitfield with respect to some reference index
@@ -3868,6 +5432,125 @@ void draw_context_popup(ApplicationState* data) {
     }
 }
 
+// Hash of the state which the spatial grid is built from
+static uint64_t spatial_grid_hash(const ApplicationState* data) {
+    const md_molecule_t& mol = data->mold.mol;
+    // The positions are tracked by their generation, which changes whenever they are modified (interpolation, pbc, unwrap, loading)
+    uint64_t hash = md_hash64(&data->mold.position_generation, sizeof(data->mold.position_generation), 0);
+    hash = md_hash64(&mol.atom.count, sizeof(mol.atom.count), hash);
+    hash = md_hash64(&mol.unit_cell.basis, sizeof(mol.unit_cell.basis), hash);
+    return hash;
+}
+
+// Radial growth of the selection, evaluated on the task pool such that the extent slider stays responsive for large systems
+// A job which is superseded by a new extent is interrupted
+// If the positions have changed since the spatial grid was built, the job also rebuilds the grid from a copy of the positions.
+// The grid is owned by the job until it has been freed, and is only marked as up to date if the job got to rebuild it.
+struct SelectionGrowJob {
+    md_bitfield_t mask;
+    md_bitfield_t viable_mask;
+    float extent;
+    SelectionLevel granularity;
+    viamd::spatial_grid_t* grid;
+    const md_molecule_t* mol;
+    bool result;
+
+    // Set if the grid is to be rebuilt
+    float* xyz;
+    size_t num_atoms;
+    float pbc_ext[3];
+    bool periodic;
+    uint64_t grid_hash;
+    bool grid_built;
+
+    task_system::ID task;
+    std::atomic_bool interrupt;
+    std::atomic_bool done;
+};
+
+static void selection_grow_job_free(ApplicationState* data, SelectionGrowJob* job) {
+    ASSERT(job);
+    if (job->grid_built) {
+        data->mold.grid_hash = job->grid_hash;
+    }
+    if (job->xyz) {
+        md_free(md_get_heap_allocator(), job->xyz, job->num_atoms * 3 * sizeof(float));
+    }
+    md_bitfield_free(&job->mask);
+    md_bitfield_free(&job->viable_mask);
+    job->~SelectionGrowJob();
+    md_free(md_get_heap_allocator(), job, sizeof(SelectionGrowJob));
+}
+
+static SelectionGrowJob* launch_selection_grow_job(ApplicationState* data) {
+    const md_molecule_t& mol = data->mold.mol;
+    SelectionGrowJob* job = (SelectionGrowJob*)md_alloc(md_get_heap_allocator(), sizeof(SelectionGrowJob));
+    new (job) SelectionGrowJob();
+    job->mask        = md_bitfield_create(md_get_heap_allocator());
+    job->viable_mask = md_bitfield_create(md_get_heap_allocator());
+    md_bitfield_copy(&job->mask, &data->selection.selection_mask);
+    md_bitfield_copy(&job->viable_mask, &data->representation.visibility_mask);
+    job->extent      = data->selection.grow.extent;
+    job->granularity = data->selection.granularity;
+    job->grid        = &data->mold.grid;
+    job->mol         = &data->mold.mol;
+    job->result      = false;
+    job->xyz         = nullptr;
+    job->num_atoms   = 0;
+    job->grid_hash   = 0;
+    job->grid_built  = false;
+    job->interrupt   = false;
+    job->done        = false;
+
+    const uint64_t hash = spatial_grid_hash(data);
+    if (hash != data->mold.grid_hash) {
+        // The positions are copied as they may be modified (e.g. during playback) while the grid is built
+        job->num_atoms = mol.atom.count;
+        job->xyz = (float*)md_alloc(md_get_heap_allocator(), job->num_atoms * 3 * sizeof(float));
+        MEMCPY(job->xyz + job->num_atoms * 0, mol.atom.x, job->num_atoms * sizeof(float));
+        MEMCPY(job->xyz + job->num_atoms * 1, mol.atom.y, job->num_atoms * sizeof(float));
+        MEMCPY(job->xyz + job->num_atoms * 2, mol.atom.z, job->num_atoms * sizeof(float));
+        job->periodic = (mol.unit_cell.flags & MD_UNIT_CELL_FLAG_ORTHO);
+        job->pbc_ext[0] = mol.unit_cell.basis[0][0];
+        job->pbc_ext[1] = mol.unit_cell.basis[1][1];
+        job->pbc_ext[2] = mol.unit_cell.basis[2][2];
+        job->grid_hash = hash;
+        // The grid is invalid until the job has rebuilt it
+        data->mold.grid_hash = 0;
+    }
+
+    job->task = task_system::create_pool_task(STR_LIT("##Grow Selection"), [](void* user_data) {
+        SelectionGrowJob* job = (SelectionGrowJob*)user_data;
+        defer { job->done = true; };
+        if (job->xyz) {
+            if (job->interrupt) return;
+            const float* x = job->xyz + job->num_atoms * 0;
+            const float* y = job->xyz + job->num_atoms * 1;
+            const float* z = job->xyz + job->num_atoms * 2;
+            if (!viamd::spatial_grid_init(job->grid, x, y, z, job->num_atoms, SPATIAL_GRID_DEFAULT_CELL_EXT, job->periodic ? job->pbc_ext : NULL, md_get_heap_allocator())) {
+                return;
+            }
+            job->grid_built = true;
+        }
+        if (viamd::spatial_grid_grow_mask_by_radius(&job->mask, job->grid, job->extent, &job->viable_mask, &job->interrupt)) {
+            grow_mask_by_selection_granularity(&job->mask, job->granularity, *job->mol);
+            job->result = true;
+        }
+    }, job);
+    task_system::enqueue_task(job->task);
+    return job;
+}
+
+static void cancel_selection_grow_job(ApplicationState* data) {
+    SelectionGrowJob* job = data->selection.grow.job;
+    if (job) {
+        job->interrupt = true;
+        task_system::task_wait_for(job->task);
+        selection_grow_job_free(data, job);
+        data->selection.grow.job = nullptr;
+    }
+}
+
 static void draw_selection_grow_window(ApplicationState* data) {
     ImGui::SetNextWindowSize(ImVec2(300,150), ImGuiCond_Always);
     if (ImGui::Begin("Selection Grow", &data->selection.grow.show_window, ImGuiWindowFlags_NoDocking | ImGuiWindowFlags_NoCollapse)) {
@@ -3881,7 +5564,11 @@ static void draw_selection_grow_window(ApplicationState* data) {
         const bool sel_changed = popcount != sel_popcount;
         ImGui::PopItemWidth();
 
-        const bool apply = ImGui::Button("Apply");
+        bool apply = ImGui::Button("Apply");
+        if (data->selection.grow.job) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("Evaluating...");
+        }
 
         // Need to invalidate when selection changes
         data->selection.grow.mask_invalid |= (mode_changed || extent_changed || appearing || sel_changed);
@@ -3889,21 +5576,41 @@ static void draw_selection_grow_window(ApplicationState* data) {
         if (data->selection.grow.mask_invalid) {
             sel_popcount = popcount;
             data->selection.grow.mask_invalid = false;
-            md_bitfield_copy(&data->selection.grow.mask, &data->selection.selection_mask);
+            cancel_selection_grow_job(data);
 
             switch (data->selection.grow.mode) {
             case SelectionGrowth::CovalentBond:
+                md_bitfield_copy(&data->selection.grow.mask, &data->selection.selection_mask);
                 md_util_mask_grow_by_bonds(&data->selection.grow.mask, &data->mold.mol, (int)data->selection.grow.extent, &data->representation.visibility_mask);
+                grow_mask_by_selection_granularity(&data->selection.grow.mask, data->selection.granularity, data->mold.mol);
                 break;
             case SelectionGrowth::Radial: {
-                md_util_mask_grow_by_radius(&data->selection.grow.mask, &data->mold.mol, data->selection.grow.extent, &data->representation.visibility_mask);
+                if (data->mold.mol.atom.count > 0) {
+                    // The previous result is kept as preview until the job completes
+                    data->selection.grow.job = launch_selection_grow_job(data);
+                } else {
+                    md_bitfield_copy(&data->selection.grow.mask, &data->selection.selection_mask);
+                    md_util_mask_grow_by_radius(&data->selection.grow.mask, &data->mold.mol, data->selection.grow.extent, &data->representation.visibility_mask);
+                    grow_mask_by_selection_granularity(&data->selection.grow.mask, data->selection.granularity, data->mold.mol);
+                }
                 break;
             }
             default:
                 ASSERT(false);
             }
+        }
 
-            grow_mask_by_selection_granularity(&data->selection.grow.mask, data->selection.granularity, data->mold.mol);
+        SelectionGrowJob* job = data->selection.grow.job;
+        if (job && (apply || job->done)) {
+            // Applying has to wait for the pending result
+            task_system::task_wait_for(job->task);
+            if (job->result) {
+                md_bitfield_copy(&data->selection.grow.mask, &job->mask);
+            } else {
+                apply = false;
+            }
+            selection_grow_job_free(data, job);
+            data->selection.grow.job = nullptr;
         }
 
         const bool show_preview =   (ImGui::GetHoveredID() == ImGui::GetID("##Extent")) ||
@@ -4041,6 +5748,80 @@ static void draw_animation_window(ApplicationState* data) {
     ImGui::End();
 }
 
+static void draw_movie_export_window(ApplicationState* data) {
+    ASSERT(data);
+    const int num_frames = (int)md_trajectory_num_frames(data->mold.traj);
+    const double min_frame = 0.0;
+    const double max_frame = num_frames > 0 ? (double)(num_frames - 1) : 0.0;
+
+    ImGui::SetNextWindowSize({400,220}, ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Export Frames", &data->movie.show_window, ImGuiWindowFlags_NoDocking | ImGuiWindowFlags_NoCollapse)) {
+        if (ImGui::IsWindowAppearing() && data->movie.end_frame <= data->movie.beg_frame) {
+            data->movie.end_frame = max_frame;
+        }
+
+        MovieExport* movie = data->movie.job;
+        if (movie) ImGui::PushDisabled();
+
+        const float item_width = MAX(ImGui::GetContentRegionAvail().x - 80.f, 100.f);
+        ImGui::PushItemWidth(item_width);
+        ImGui::SliderScalar("Begin", ImGuiDataType_Double, &data->movie.beg_frame, &min_frame, &max_frame, "%.0f");
+        ImGui::SliderScalar("End",   ImGuiDataType_Double, &data->movie.end_frame, &min_frame, &max_frame, "%.0f");
+        ImGui::InputDouble("Stride", &data->movie.stride, 1.0, 10.0, "%.2f");
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Number of frames between the exported frames, fractional strides are interpolated");
+        }
+        data->movie.stride = MAX(data->movie.stride, 0.01);
+        ImGui::Combo("Output", (int*)(&data->movie.output), "Images\0Pipe\0\0");
+        if (data->movie.output == MovieOutput::Images) {
+            ImGui::InputText("File", data->movie.path, sizeof(data->movie.path));
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("The index of the frame is appended to the file name, the extension determines the format (jpg, png, bmp)");
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("...")) {
+                char path_buf[1024];
+                if (application::file_dialog(path_buf, sizeof(path_buf), application::FileDialogFlag_Save, STR_LIT("jpg,png,bmp"))) {
+                    size_t path_len = strnlen(path_buf, sizeof(path_buf));
+                    str_t ext;
+                    if (!extract_ext(&ext, {path_buf, path_len})) {
+                        path_len += snprintf(path_buf + path_len, sizeof(path_buf) - path_len, ".png");
+                    }
+                    str_copy_to_char_buf(data->movie.path, sizeof(data->movie.path), {path_buf, path_len});
+                }
+            }
+        } else {
+            ImGui::InputText("Command", data->movie.command, sizeof(data->movie.command));
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Raw RGBA frames are written to the standard input of the command\n{width} and {height} are replaced by the dimensions of the frames");
+            }
+        }
+        ImGui::PopItemWidth();
+        ImGui::Text("Resolution: %i x %i", (int)data->app.framebuffer.width, (int)data->app.framebuffer.height);
+
+        if (movie) ImGui::PopDisabled();
+
+        if (movie) {
+            const int num_done = movie->num_written + movie->num_failed;
+            char label[64];
+            snprintf(label, sizeof(label), "%i / %i", num_done, movie->num_frames);
+            ImGui::ProgressBar((float)num_done / (float)movie->num_frames, ImVec2(item_width, 0), label);
+            ImGui::SameLine();
+            if (ImGui::Button("Cancel")) {
+                free_movie_export(data);
+                LOG_INFO("The export was canceled");
+            }
+        } else {
+            if (num_frames == 0) ImGui::PushDisabled();
+            if (ImGui::Button("Export")) {
+                start_movie_export(data);
+            }
+            if (num_frames == 0) ImGui::PopDisabled();
+        }
+    }
+    ImGui::End();
+}
+
 static void draw_representations_window(ApplicationState* state) {
     if (!state->representation.show_window) return;
 
@@ -4137,62 +5918,43 @@ static void draw_representations_window(ApplicationState* state) {
                 if (ImGui::Combo("color", (int*)(&rep.color_mapping), color_mapping_str, IM_ARRAYSIZE(color_mapping_str))) {
                     update_rep = true;
                 }
-#if 0
                 if (rep.color_mapping == ColorMapping::Property) {
-                    // @TODO: Update this with something more proper, and use a filter window to allow the user to specify a property
-                    /*
-                    if (!rep.prop_is_valid) ImGui::PushStyleColor(ImGuiCol_FrameBg, TEXT_BG_ERROR_COLOR);
-                    if (ImGui::InputText("property", rep.prop.cstr(), rep.prop.capacity())) {
-                        update_color = true;
-                    }
-                    if (ImGui::IsItemHovered() && !rep.prop_is_valid) {
-                        ImGui::SetTooltip("%s", rep.prop_error.cstr());
-                    }
-                    if (!rep.prop_is_valid) ImGui::PopStyleColor();
-                    */
-
-                    static int prop_idx = 0;
-                    const md_script_property_t* props[32] = {0};
-                    size_t num_props = 0;
-                    for (size_t j = 0; j < md_array_size(data->display_properties); ++j) {
-                        if (data->display_properties[j].type == DisplayProperty::Type_Temporal) {
-                            props[num_props++] = data->display_properties[j].prop;
-                        }
-                        if (num_props == ARRAY_SIZE(props)) break;
-                    }
-
-                    rep.prop = NULL;
-                    if (num_props > 0) {
-                        prop_idx = CLAMP(prop_idx, 0, (int)num_props-1);
-                        if (ImGui::BeginCombo("Prop", props[prop_idx]->ident.ptr)) {
-                            for (size_t j = 0; j < num_props; ++j) {
-                                if (ImGui::Selectable(props[j]->ident.ptr, prop_idx == i)) {
-                                    prop_idx = (int)j;
-                                    rep.map_beg = props[j]->data.min_value;
-                                    rep.map_end = props[j]->data.max_value;
-                                    update_rep = true;
-                                }
+                    // Temporal properties are mapped onto the atoms of their structures, the remaining atoms are given the uniform color
+                    const DisplayProperty* cur_prop = find_representation_property(state, &rep);
+                    if (!cur_prop) ImGui::PushInvalid();
+                    if (ImGui::BeginCombo("property", rep.prop.ident[0] != '\0' ? rep.prop.ident : "none")) {
+                        for (size_t j = 0; j < md_array_size(state->display_properties); ++j) {
+                            const DisplayProperty& dp = state->display_properties[j];
+                            if (dp.type != DisplayProperty::Type_Temporal || !dp.vis_payload || !dp.prop_data) continue;
+                            if (ImGui::Selectable(dp.label, strcmp(dp.label, rep.prop.ident) == 0)) {
+                                snprintf(rep.prop.ident, sizeof(rep.prop.ident), "%s", dp.label);
+                                rep.prop.map_min = rep.prop.map_beg = dp.prop_data->min_range[0];
+                                rep.prop.map_max = rep.prop.map_end = dp.prop_data->max_range[0];
+                                update_rep = true;
                             }
-                            ImGui::EndCombo();
                         }
-                        rep.prop = props[prop_idx];
+                        ImGui::EndCombo();
+                    }
+                    if (!cur_prop) ImGui::PopInvalid();
 
-                        if (ImPlot::ColormapButton(ImPlot::GetColormapName(rep.color_map), ImVec2(item_width,0), rep.color_map)) {
+                    if (cur_prop) {
+                        if (ImPlot::ColormapButton(ImPlot::GetColormapName(rep.prop.color_map), ImVec2(item_width, 0), rep.prop.color_map)) {
                             ImGui::OpenPopup("Color Map Selector");
                         }
-                        ImGui::DragFloatRange2("Min / Max",&rep.map_beg, &rep.map_end, 0.01f, rep.prop->data.min_value, rep.prop->data.max_value);
                         if (ImGui::BeginPopup("Color Map Selector")) {
                             for (int map = 0; map < ImPlot::GetColormapCount(); ++map) {
-                                if (ImPlot::ColormapButton(ImPlot::GetColormapName(map), ImVec2(item_width,0), map)) {
-                                    rep.color_map = map;
+                                if (ImPlot::ColormapButton(ImPlot::GetColormapName(map), ImVec2(item_width, 0), map)) {
+                                    rep.prop.color_map = map;
+                                    update_rep = true;
                                     ImGui::CloseCurrentPopup();
                                 }
                             }
                             ImGui::EndPopup();
                         }
+                        const float speed = (rep.prop.map_max - rep.prop.map_min) * 0.001f;
+                        update_rep |= ImGui::DragFloatRange2("range", &rep.prop.map_beg, &rep.prop.map_end, MAX(speed, 0.0001f), rep.prop.map_min, rep.prop.map_max);
                     }
                 }
-#endif
                 if (rep.filt_is_dynamic || rep.color_mapping == ColorMapping::Property) {
                     ImGui::Checkbox("auto-update", &rep.dynamic_evaluation);
                     if (!rep.dynamic_evaluation) {
@@ -4206,7 +5968,7 @@ static void draw_representations_window(ApplicationState* state) {
                     rep.dynamic_evaluation = false;
                 }
                 ImGui::PopItemWidth();
-                if (rep.color_mapping == ColorMapping::Uniform) {
+                if (rep.color_mapping == ColorMapping::Uniform || rep.color_mapping == ColorMapping::Property) {
                     update_rep |= ImGui::ColorEdit4("color", (float*)&rep.uniform_color, ImGuiColorEditFlags_NoInputs);
                 }
                 ImGui::PushItemWidth(item_width);
@@ -4454,16 +6216,34 @@ static void draw_async_task_window(ApplicationState* data) {
     constexpr float WIDTH = 300.f;
     constexpr float MARGIN = 10.f;
 
+    // Sweep tasks are shared between multiple consumers, so these are not shown (or interrupted) as a whole.
+    // Instead each consumer gets its own entry, such that interrupting one does not affect the others within the same sweep.
+    struct Entry {
+        task_system::ID task;
+        sweep::ID consumer;
+        str_t label;
+    };
+
     task_system::ID tasks[256];
+    sweep::ID consumers[64];
     size_t num_tasks = task_system::pool_running_tasks(tasks, ARRAY_SIZE(tasks));
-    bool any_task_label_visible = false;
-    for (size_t i = 0; i < num_tasks; i++) {
+    size_t num_consumers = sweep::running_consumers(consumers, ARRAY_SIZE(consumers));
+
+    Entry entries[8];
+    size_t num_entries = 0;
+    for (size_t i = 0; i < num_tasks && num_entries < ARRAY_SIZE(entries); i++) {
+        if (sweep::is_sweep_task(tasks[i])) continue;
         str_t label = task_system::task_label(tasks[i]);
         if (!label || label[0] == '\0' || (label[0] == '#' && label[1] == '#')) continue;
-        any_task_label_visible = true;
+        entries[num_entries++] = {tasks[i], sweep::INVALID_ID, label};
+    }
+    for (size_t i = 0; i < num_consumers && num_entries < ARRAY_SIZE(entries); i++) {
+        str_t label = sweep::consumer_label(consumers[i]);
+        if (!label || label[0] == '\0' || (label[0] == '#' && label[1] == '#')) continue;
+        entries[num_entries++] = {task_system::INVALID_ID, consumers[i], label};
     }
     
-    if (any_task_label_visible) {
+    if (num_entries > 0) {
         ImGuiViewport* viewport = ImGui::GetMainViewport();
         ImGui::SetNextWindowPos(viewport->Pos + ImVec2(data->app.window.width - WIDTH - MARGIN,
                                                        ImGui::GetCurrentContext()->FontBaseSize + ImGui::GetStyle().FramePadding.y * 2.f + MARGIN));
@@ -4477,25 +6257,28 @@ static void draw_async_task_window(ApplicationState* data) {
         const float size = ImGui::GetFontSize() + pad * 2;
 
         char buf[64];
-        for (size_t i = 0; i < MIN(num_tasks, 8); i++) {
-            const auto id = tasks[i];
-            str_t label = task_system::task_label(id);
-            float fract = task_system::task_fraction_complete(id);
-
-            if (!label || label[0] == '\0' || (label[0] == '#' && label[1] == '#')) continue;
+        for (size_t i = 0; i < num_entries; i++) {
+            const Entry& e = entries[i];
+            float fract = e.consumer != sweep::INVALID_ID ? sweep::consumer_fraction_complete(e.consumer) : task_system::task_fraction_complete(e.task);
 
-            snprintf(buf, sizeof(buf), "%.*s %.1f%%", (int)label.len, label.ptr, fract * 100.f);
+            ImGui::PushID((int)i);
+            snprintf(buf, sizeof(buf), "%.*s %.1f%%", (int)e.label.len, e.label.ptr, fract * 100.f);
             ImGui::ProgressBar(fract, ImVec2(ImGui::GetContentRegionAvail().x - (size + pad),0), buf);
             ImGui::SameLine();
             if (ImGui::DeleteButton((const char*)ICON_FA_XMARK, ImVec2(size, size))) {
-                task_system::task_interrupt(id);
-                if (id == data->tasks.evaluate_full) {
-                    md_script_eval_interrupt(data->script.full_eval);
-                }
-                else if(id == data->tasks.evaluate_filt) {
-                    md_script_eval_interrupt(data->script.filt_eval);
+                if (e.consumer != sweep::INVALID_ID) {
+                    sweep::consumer_interrupt(e.consumer);
+                    if (e.consumer == data->tasks.evaluate_full) {
+                        md_script_eval_interrupt(data->script.full_eval);
+                    }
+                    if (e.consumer == data->tasks.evaluate_filt) {
+                        md_script_eval_interrupt(data->script.filt_eval);
+                    }
+                } else {
+                    task_system::task_interrupt(e.task);
                 }
             }
+            ImGui::PopID();
         }
 
         ImGui::End();
@@ -4808,6 +6591,30 @@ static float distance_to_linesegment(vec2_t line_beg, vec2_t line_end, vec2_t po
     }
 }
 
+// Used to plot a subset of the samples, e.g. the frames which have been evaluated so far or the visible range of samples
+struct IndexedPayload {
+    ImPlotGetter getter;
+    void* payload;
+    const int32_t* indices;
+    int offset;
+};
+
+static ImPlotPoint get_indexed_point(int idx, void* user_data) {
+    const IndexedPayload* p = (const IndexedPayload*)user_data;
+    return p->getter(p->indices ? p->indices[idx] : p->offset + idx, p->payload);
+}
+
+// Draws an indicator of the fraction of frames which the plotted data is based upon (if not all)
+static void draw_plot_coverage(float coverage) {
+    if (coverage >= 1.0f) return;
+    char buf[32];
+    snprintf(buf, sizeof(buf), "Coverage: %.1f%%", coverage * 100.0f);
+    const ImVec2 pos = ImPlot::GetPlotPos() + ImGui::GetStyle().FramePadding;
+    ImPlot::PushPlotClipRect();
+    ImPlot::GetPlotDrawList()->AddText(pos, IM_COL32(255, 255, 255, 160), buf);
+    ImPlot::PopPlotClipRect();
+}
+
 static void visualize_payload(ApplicationState* data, const md_script_vis_payload_o* payload, int subidx, md_script_vis_flags_t flags) {
     md_script_vis_ctx_t ctx = {
         .ir   = data->script.eval_ir,
@@ -5163,11 +6970,39 @@ static void draw_timeline_window(ApplicationState* data) {
                         }
                     }
                     
+                    // Visible range of frames, only the samples within this range are plotted
+                    const ImPlotRange view_x = ImPlot::GetPlotLimits().X;
+                    const int view_beg_frame = (int)time_to_frame(view_x.Min, data->timeline.x_values) - 1;
+                    const int view_end_frame = (int)time_to_frame(view_x.Max, data->timeline.x_values) + 2;
+                    const float plot_width = ImPlot::GetPlotSize().x;
+
+                    float coverage = 1.0f;
                     for (int j = 0; j < num_props; ++j) {
                         DisplayProperty& dp = data->display_properties[j];
                         if ((dp.type != DisplayProperty::Type_Temporal)) continue;
                         if (!(dp.temporal_subplot_mask & (1 << i))) continue;
 
+                        coverage = MIN(coverage, dp.coverage);
+
+                        // While the evaluation is in progress, we only plot the frames which have been evaluated so far
+                        const int32_t* sample_indices = 0;
+                        int sample_offset = 0;
+                        int num_samples = dp.num_samples;
+                        int lod_level = 0;
+                        if (dp.coverage < 1.0f && dp.eval) {
+                            const md_bitfield_t* frame_mask = md_script_eval_frame_mask(dp.eval);
+                            num_samples = MIN((int)md_bitfield_popcount(frame_mask), dp.num_samples);
+                            int32_t* indices = (int32_t*)md_alloc(frame_alloc, MAX(num_samples, 1) * sizeof(int32_t));
+                            md_bitfield_iter_extract_indices(indices, num_samples, md_bitfield_iter_create(frame_mask));
+                            sample_indices = indices;
+                        } else {
+                            sample_offset = CLAMP(view_beg_frame, 0, dp.num_samples);
+                            num_samples = CLAMP(view_end_frame, sample_offset, dp.num_samples) - sample_offset;
+                            if (plot_lod_ready(dp)) {
+                                lod_level = plot_lod_select_level(dp.lod, num_samples, plot_width);
+                            }
+                        }
+
                         if (ImPlot::IsLegendEntryHovered(dp.label)) {
                             visualize_payload(data, dp.vis_payload, -1, MD_SCRIPT_VISUALIZE_ATOMS | MD_SCRIPT_VISUALIZE_GEOMETRY);
                             set_hovered_property(data, str_from_cstr(dp.label));
@@ -5272,7 +7107,7 @@ static void draw_timeline_window(ApplicationState* data) {
                             ImPlot::EndLegendPopup();
                         }
 
-                        auto plot = [j, &dp, hovered_prop_idx, hovered_pop_idx](int k) {
+                        auto plot = [j, &dp, hovered_prop_idx, hovered_pop_idx, sample_indices, sample_offset, num_samples, lod_level](int k) {
                             const float  hov_fill_alpha  = 1.25f;
                             const float  hov_line_weight = 2.0f;
                             const float  hov_col_scl = 1.5f;
@@ -5318,18 +7153,62 @@ static void draw_timeline_window(ApplicationState* data) {
                                 .dim_idx = k,
                             };
 
+                            if (lod_level > 0) {
+                                // Plot the min/max envelope and the mean of the buckets from the level of detail pyramid
+                                const PlotLod* lod = dp.lod;
+                                const int bucket_beg = sample_offset >> lod_level;
+                                const int bucket_end = ((sample_offset + num_samples - 1) >> lod_level) + 1;
+                                PlotLodPayload lod_payload = {
+                                    .buckets = lod->buckets + lod->stride * k + lod->level_offset[lod_level - PLOT_LOD_BASE_LEVEL] + bucket_beg,
+                                    .x_values = dp.x_values,
+                                    .level = lod_level,
+                                    .offset = bucket_beg,
+                                    .num_samples = dp.num_samples,
+                                };
+                                const int num_buckets = bucket_end - bucket_beg;
+
+                                switch (dp.plot_type) {
+                                case DisplayProperty::PlotType_Line:
+                                    ImPlot::SetNextFillStyle(color, 0.5f * fill_alpha);
+                                    ImPlot::PlotShadedG(dp.label, get_lod_min, &lod_payload, get_lod_max, &lod_payload, num_buckets);
+                                    ImPlot::SetNextLineStyle(color, weight);
+                                    ImPlot::PlotLineG(dp.label, get_lod_mean, &lod_payload, num_buckets);
+                                    break;
+                                case DisplayProperty::PlotType_Area:
+                                    ImPlot::SetNextFillStyle(color, fill_alpha);
+                                    ImPlot::PlotShadedG(dp.label, get_lod_min, &lod_payload, get_lod_max, &lod_payload, num_buckets);
+                                    break;
+                                case DisplayProperty::PlotType_Scatter:
+                                    ImPlot::SetNextMarkerStyle(dp.marker_type, dp.marker_size, color, marker_line_weight, marker_line_color);
+                                    ImPlot::PlotScatterG(dp.label, get_lod_mean, &lod_payload, num_buckets);
+                                    break;
+                                default:
+                                    ASSERT(false);
+                                    break;
+                                }
+                                return;
+                            }
+
+                            IndexedPayload indexed_payload[2] = {
+                                {dp.getter[0], &payload, sample_indices, sample_offset},
+                                {dp.getter[1], &payload, sample_indices, sample_offset},
+                            };
+
+                            ImPlotGetter getter[2]  = {get_indexed_point, get_indexed_point};
+                            void* getter_payload[2] = {&indexed_payload[0], &indexed_payload[1]};
+
                             switch (dp.plot_type) {
                             case DisplayProperty::PlotType_Line:
                                 ImPlot::SetNextLineStyle(color, weight);
-                                ImPlot::PlotLineG(dp.label, dp.getter[0], &payload, dp.num_samples);
+                                ImPlot::PlotLineG(dp.label, getter[0], getter_payload[0], num_samples);
                                 break;
                             case DisplayProperty::PlotType_Area:
                                 ImPlot::SetNextFillStyle(color, fill_alpha);
-                                ImPlot::PlotShadedG(dp.label, dp.getter[0], &payload, dp.getter[1], &payload, dp.num_samples);
+                                ImPlot::PlotShadedG(dp.label, getter[0], getter_payload[0], getter[1], getter_payload[1], num_samples);
                                 break;
                             case DisplayProperty::PlotType_Scatter:
                                 ImPlot::SetNextMarkerStyle(dp.marker_type, dp.marker_size, color, marker_line_weight, marker_line_color);
-                                ImPlot::PlotScatterG(dp.label, dp.getter[0], &payload, dp.num_samples);
+                                ImPlot::PlotScatterG(dp.label, getter[0], getter_payload[0], num_samples);
                                 break;
                             default:
                                 // Should not end up here
@@ -5407,6 +7286,8 @@ static void draw_timeline_window(ApplicationState* data) {
                         }
                     }
                     
+                    draw_plot_coverage(coverage);
+
                     ImPlot::EndPlot();
                 }
             }
@@ -5722,11 +7603,16 @@ static void draw_distribution_window(ApplicationState* data) {
                         }
                     }
                     
+                    float coverage = 1.0f;
                     for (int j = 0; j < num_props; ++j) {
                         DisplayProperty& dp = data->display_properties[j];
                         if (dp.type != DisplayProperty::Type_Distribution) continue;
                         if (!(dp.distribution_subplot_mask & (1 << i))) continue;
 
+                        if (dp.prop_flags & MD_SCRIPT_PROPERTY_FLAG_TEMPORAL) {
+                            coverage = MIN(coverage, dp.coverage);
+                        }
+
                         if (ImPlot::IsLegendEntryHovered(dp.label)) {
                             visualize_payload(data, dp.vis_payload, -1, MD_SCRIPT_VISUALIZE_ATOMS | MD_SCRIPT_VISUALIZE_GEOMETRY);
                             set_hovered_property(data, str_from_cstr(dp.label));
@@ -5973,6 +7859,8 @@ static void draw_distribution_window(ApplicationState* data) {
                         ImPlot::PopPlotClipRect();
                     }
 
+                    draw_plot_coverage(coverage);
+
                     ImPlot::EndPlot();
                 }
             }
@@ -6066,6 +7954,10 @@ static void draw_density_volume_window(ApplicationState* data) {
                     }
                     ImGui::SliderFloat("TF Min Value", &data->density_volume.dvr.tf.min_val, 0.0f, 1000.f, "%.3f", ImGuiSliderFlags_Logarithmic);
                     ImGui::SliderFloat("TF Max Value", &data->density_volume.dvr.tf.max_val, 0.0f, 1000.f, "%.3f", ImGuiSliderFlags_Logarithmic);
+                    ImGui::SliderFloat("Max Step Scale", &data->density_volume.dvr.max_step_scale, 1.0f, 4.0f, "%.2f", ImGuiSliderFlags_AlwaysClamp);
+                    if (ImGui::IsItemHovered()) {
+                        ImGui::SetTooltip("The step length grows with the accumulated opacity up to this scale of the base step length\n1 = fixed step length, larger values are faster but may miss thin features behind dense regions");
+                    }
 
                     ImGui::Unindent();
                 }
@@ -6102,6 +7994,23 @@ static void draw_density_volume_window(ApplicationState* data) {
                     }
                     ImGui::Unindent();
                 }
+                ImGui::Separator();
+                auto& vol_tex = data->density_volume.volume_texture;
+                if (ImGui::Checkbox("Sparse (Bricked) Storage", &vol_tex.bricked)) {
+                    data->density_volume.dirty_vol = true;
+                }
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Only store and upload the bricks (%i^3 voxels) of the volume which contain density,\nempty bricks are skipped during ray-casting", SPARSE_VOLUME_BRICK_DIM);
+                }
+                if (vol_tex.use_bricked) {
+                    const volume::BrickedVolume& bv = vol_tex.bricked_volume;
+                    const size_t num_bricks  = (size_t)bv.brick_count[0] * bv.brick_count[1] * bv.brick_count[2];
+                    const size_t atlas_bytes = (size_t)bv.atlas_dim[0] * bv.atlas_dim[1] * bv.atlas_dim[2] * sizeof(uint16_t) + num_bricks * sizeof(uint32_t);
+                    // The atlas and the dense texture are both stored as half floats
+                    const size_t dense_bytes = (size_t)vol_tex.dim[0] * vol_tex.dim[1] * vol_tex.dim[2] * sizeof(uint16_t);
+                    ImGui::Text("Occupied Bricks: %u / %zu", bv.num_bricks, num_bricks);
+                    ImGui::Text("GPU Memory: %.2f MB (Dense %.2f MB)", atlas_bytes / (1024.0 * 1024.0), dense_bytes / (1024.0 * 1024.0));
+                }
                 ImGui::EndMenu();
             }
 
@@ -6353,12 +8262,8 @@ static void draw_density_volume_window(ApplicationState* data) {
             }
         }
 
-        size_t num_reps = md_array_size(data->density_volume.gl_reps);
+        const size_t num_reps = md_array_size(data->density_volume.gl_reps);
         if (selected_property > -1 && data->density_volume.show_reference_structures && num_reps > 0) {
-            if (!data->density_volume.show_reference_ensemble) {
-                num_reps = 1;
-            }
-
             md_gl_draw_op_t* draw_ops = 0;
 
             md_gl_draw_op_t op = {};
@@ -6385,6 +8290,20 @@ static void draw_density_volume_window(ApplicationState* data) {
 
             md_gl_draw(&draw_args);
 
+            if (data->density_volume.show_reference_ensemble) {
+                // The first structure is the reference structure, which has already been drawn above
+                ensemble::DrawDesc ens_desc = {
+                    .ensemble = &data->density_volume.ensemble,
+                    .instance_beg = 1,
+                    .radius_scale = data->density_volume.rep.param[0],
+                    .view_mat = view_mat,
+                    .proj_mat = proj_mat,
+                };
+                glDrawBuffers(4, draw_buffers);
+                ensemble::draw(ens_desc);
+                glDrawBuffers((int)ARRAY_SIZE(draw_buffers), draw_buffers);
+            }
+
             if (is_hovered) {
                 vec2_t coord = {mouse_pos_in_canvas.x, (float)gbuf.height - mouse_pos_in_canvas.y};
                 PickingData pd = read_picking_data(&gbuf, (int)coord.x, (int)coord.y);
@@ -6407,6 +8326,7 @@ static void draw_density_volume_window(ApplicationState* data) {
                     .texture = {
                         .volume = data->density_volume.volume_texture.id,
                         .transfer_function = data->density_volume.dvr.tf.id,
+                        .macro_cells = data->density_volume.volume_texture.macro_cells,
                     },
                     .matrix = {
                         .model = data->density_volume.model_mat,
@@ -6435,8 +8355,11 @@ static void draw_density_volume_window(ApplicationState* data) {
                         .dir_radiance = {10,10,10},
                         .ior = 1.5f,
                     },
-                    .voxel_spacing = data->density_volume.voxel_spacing
-                    
+                    .voxel_spacing = data->density_volume.voxel_spacing,
+                    .bricked = data->density_volume.volume_texture.use_bricked ? &data->density_volume.volume_texture.bricked_volume : NULL,
+                    .sampling = {
+                        .max_step_scale = data->density_volume.dvr.max_step_scale,
+                    },
                 };
                 volume::render_volume(vol_desc);
             }
@@ -6568,7 +8491,11 @@ static void draw_dataset_window(ApplicationState* data) {
                         ImGui::PopStyleColor();
 
                         if (ImGui::IsItemHovered()) {
-                            ImGui::SetTooltip("%s: count %d (%.2f%%)", item.label, item.count, item.fraction * 100.f);
+                            if (item.residue_count) {
+                                ImGui::SetTooltip("%s: residues %d, atoms %.2f%%, mass %.2f%%", item.label, item.residue_count, item.fraction * 100.f, item.mass_fraction * 100.f);
+                            } else {
+                                ImGui::SetTooltip("%s: count %d (%.2f%%), mass %.2f%%", item.label, item.count, item.fraction * 100.f, item.mass_fraction * 100.f);
+                            }
                             filter_expression(data, str_from_cstr(item.query), &data->selection.highlight_mask);
                         }
 
@@ -6595,6 +8522,91 @@ static void draw_dataset_window(ApplicationState* data) {
     ImGui::End();
 }
 
+struct ColorBenchmark {
+    int num_atoms = 10000000;
+    double ms_cpk = 0;
+    double ms_res_name = 0;
+    double ms_chain_id = 0;
+    double ms_filter = 0;
+    double ms_saturation = 0;
+    bool has_result = false;
+};
+
+// Times the color mapping kernels on synthetic data of the given size, residue and chain mappings use the loaded molecule
+static void run_color_benchmark(ApplicationState* data, ColorBenchmark* bench) {
+    const size_t count = (size_t)MAX(bench->num_atoms, 1);
+    md_allocator_i* alloc = md_get_heap_allocator();
+
+    md_element_t* elements = (md_element_t*)md_alloc(alloc, count * sizeof(md_element_t));
+    uint32_t*     colors   = (uint32_t*)md_alloc(alloc, count * sizeof(uint32_t));
+    defer {
+        md_free(alloc, elements, count * sizeof(md_element_t));
+        md_free(alloc, colors, count * sizeof(uint32_t));
+    };
+
+    for (size_t i = 0; i < count; ++i) {
+        elements[i] = (md_element_t)(1 + (i * 7) % 118);
+    }
+
+    md_bitfield_t mask = md_bitfield_create(alloc);
+    defer { md_bitfield_free(&mask); };
+    for (size_t i = 0; i < count; i += 4096) {
+        md_bitfield_set_range(&mask, i, MIN(i + 3072, count));
+    }
+
+    md_molecule_t mol = {};
+    mol.atom.count   = count;
+    mol.atom.element = elements;
+
+    md_timestamp_t t0 = md_time_current();
+    color_atoms_cpk(colors, count, mol);
+    md_timestamp_t t1 = md_time_current();
+    filter_colors(colors, count, &mask);
+    md_timestamp_t t2 = md_time_current();
+    scale_saturation(colors, count, 0.5f);
+    md_timestamp_t t3 = md_time_current();
+
+    bench->ms_cpk        = md_time_as_seconds(t1 - t0) * 1000.0;
+    bench->ms_filter     = md_time_as_seconds(t2 - t1) * 1000.0;
+    bench->ms_saturation = md_time_as_seconds(t3 - t2) * 1000.0;
+
+    const md_molecule_t& loaded = data->mold.mol;
+    if (loaded.atom.count > 0) {
+        uint32_t* loaded_colors = (uint32_t*)md_alloc(alloc, loaded.atom.count * sizeof(uint32_t));
+        md_timestamp_t t4 = md_time_current();
+        color_atoms_res_name(loaded_colors, loaded.atom.count, loaded);
+        md_timestamp_t t5 = md_time_current();
+        color_atoms_chain_id(loaded_colors, loaded.atom.count, loaded);
+        md_timestamp_t t6 = md_time_current();
+        md_free(alloc, loaded_colors, loaded.atom.count * sizeof(uint32_t));
+
+        bench->ms_res_name = md_time_as_seconds(t5 - t4) * 1000.0;
+        bench->ms_chain_id = md_time_as_seconds(t6 - t5) * 1000.0;
+    } else {
+        bench->ms_res_name = 0;
+        bench->ms_chain_id = 0;
+    }
+    bench->has_result = true;
+}
+
+// Runs the benchmark from the command line and prints the timings in a form which is easy to parse by scripts
+static void print_color_benchmark(ApplicationState* data, int num_atoms) {
+    ColorBenchmark bench;
+    bench.num_atoms = CLAMP(num_atoms, 1, 100000000);
+    run_color_benchmark(data, &bench);
+
+    printf("atoms %d\n", bench.num_atoms);
+    printf("cpk_ms %.3f\n", bench.ms_cpk);
+    printf("filter_ms %.3f\n", bench.ms_filter);
+    printf("saturation_ms %.3f\n", bench.ms_saturation);
+    if (data->mold.mol.atom.count > 0) {
+        printf("loaded_atoms %d\n", (int)data->mold.mol.atom.count);
+        printf("res_name_ms %.3f\n", bench.ms_res_name);
+        printf("chain_id_ms %.3f\n", bench.ms_chain_id);
+    }
+    fflush(stdout);
+}
+
 static void draw_debug_window(ApplicationState* data) {
     ASSERT(data);
 
@@ -6646,6 +8658,95 @@ static void draw_debug_window(ApplicationState* data) {
                 update_all_representations(data);
             }
         }
+
+        if (ImGui::CollapsingHeader("Culling")) {
+            const culling::Culler& culler = data->mold.culling.culler;
+            ImGui::Text("Chunks: %zu", culler.num_chunks);
+            ImGui::Text("Visible: %u, Reduced Detail: %u", culler.stats.chunks[culling::ChunkState_Visible], culler.stats.chunks[culling::ChunkState_Detail]);
+            ImGui::Text("Frustum Culled: %u, Occluded: %u", culler.stats.chunks[culling::ChunkState_Frustum], culler.stats.chunks[culling::ChunkState_Occluded]);
+            ImGui::Text("Drawn Atoms: %zu / %zu", culler.stats.atoms, (size_t)data->mold.mol.atom.count);
+            ImGui::Text("Hi-Z: %s (%i x %i)", culler.hiz.valid ? "valid" : "invalid", culler.hiz.dim[0][0], culler.hiz.dim[0][1]);
+        }
+
+        if (ImGui::CollapsingHeader("Picking")) {
+            int latency = (int)data->gbuffer.pbo_picking.latency;
+            if (ImGui::SliderInt("Readback Latency", &latency, 1, PICKING_MAX_LATENCY)) {
+                data->gbuffer.pbo_picking.latency = (uint32_t)latency;
+            }
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Number of frames from the submission of the picking read until its result is used");
+            }
+            ImGui::Text("Picking Result Age: %u frames", data->gbuffer.pbo_picking.frame - 1 - data->gbuffer.pbo_picking.result_frame);
+            ImGui::Text("Region Readback: %.2f ms (%u frames)", data->selection.region.latency_ms, data->selection.region.latency_frames);
+        }
+
+        if (ImGui::CollapsingHeader("Profiler")) {
+            bool enabled = profiler::enabled();
+            if (ImGui::Checkbox("Enabled", &enabled)) {
+                profiler::set_enabled(enabled);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Save Trace...")) {
+                char path_buf[1024];
+                if (application::file_dialog(path_buf, sizeof(path_buf), application::FileDialogFlag_Save, STR_LIT("json"))) {
+                    str_t path = str_from_cstr(path_buf);
+                    if (profiler::write_trace(path)) {
+                        LOG_SUCCESS("Wrote profiler trace to '" STR_FMT "'", STR_ARG(path));
+                    }
+                }
+            }
+            ImGui::SetItemTooltip("Writes the timings of the recorded frames in the chrome tracing format");
+            ImGui::SameLine();
+            if (ImGui::Button("Clear Trace")) {
+                profiler::clear_trace();
+            }
+            ImGui::Text("Dropped Frames: %llu", (unsigned long long)profiler::num_dropped_frames());
+
+            profiler::SectionStats stats[256];
+            const size_t num_stats = profiler::get_stats(stats, ARRAY_SIZE(stats));
+            ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+            if (num_stats > 0 && ImGui::BeginTable("##profiler", 5, flags)) {
+                ImGui::TableSetupColumn("Section", ImGuiTableColumnFlags_WidthStretch);
+                ImGui::TableSetupColumn("Calls");
+                ImGui::TableSetupColumn("CPU (ms)");
+                ImGui::TableSetupColumn("GPU (ms)");
+                ImGui::TableSetupColumn("GPU Max (ms)");
+                ImGui::TableHeadersRow();
+                for (size_t i = 0; i < num_stats; ++i) {
+                    const profiler::SectionStats& s = stats[i];
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::Text("%*s%s", (int)s.depth * 2, "", s.label);
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%u", s.calls);
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%.3f", s.cpu_avg_ms);
+                    if (s.gpu) {
+                        ImGui::TableSetColumnIndex(3);
+                        ImGui::Text("%.3f", s.gpu_avg_ms);
+                        ImGui::TableSetColumnIndex(4);
+                        ImGui::Text("%.3f", s.gpu_max_ms);
+                    }
+                }
+                ImGui::EndTable();
+            }
+        }
+
+        static ColorBenchmark color_bench;
+        if (ImGui::CollapsingHeader("Color Kernel Benchmark")) {
+            ImGui::InputInt("Atoms", &color_bench.num_atoms, 1000000, 10000000);
+            color_bench.num_atoms = CLAMP(color_bench.num_atoms, 1, 100000000);
+            if (ImGui::Button("Run")) {
+                run_color_benchmark(data, &color_bench);
+            }
+            if (color_bench.has_result) {
+                ImGui::Text("CPK: %.2f ms", color_bench.ms_cpk);
+                ImGui::Text("Filter: %.2f ms", color_bench.ms_filter);
+                ImGui::Text("Saturation: %.2f ms", color_bench.ms_saturation);
+                ImGui::Text("Residue Name (loaded): %.2f ms", color_bench.ms_res_name);
+                ImGui::Text("Chain Id (loaded): %.2f ms", color_bench.ms_chain_id);
+            }
+        }
     }
     ImGui::End();
 }
@@ -6802,84 +8903,6 @@ static void draw_script_editor_window(ApplicationState* data) {
     ImGui::End();
 }
 
-static bool export_xvg(const float* column_data[], const char* column_labels[], size_t num_columns, size_t num_rows, str_t filename) {
-    ASSERT(column_data);
-    ASSERT(column_labels);
-    ASSERT(num_columns >= 0);
-    ASSERT(num_rows >= 0);
-
-    md_file_o* file = md_file_open(filename, MD_FILE_WRITE);
-    if (!file) {
-        LOG_ERROR("Failed to open file '" STR_FMT "' to write data.", STR_ARG(filename));
-        return false;
-    }    
-
-    time_t t;
-    struct tm* info;
-    time(&t);
-    info = localtime(&t);
-
-    // Print Header
-    md_file_printf(file, "# This file was created %s", asctime(info));
-    md_file_printf(file, "# Created by:\n");
-    md_file_printf(file, "# VIAMD \n");
-
-    // Print Legend Meta
-    md_file_printf(file, "@    title \"VIAMD Properties\"\n");
-    md_file_printf(file, "@    xaxis  label \"Time\"\n");
-    md_file_printf(file, "@ TYPE xy\n");
-    md_file_printf(file, "@ view 0.15, 0.15, 0.75, 0.85\n");
-    md_file_printf(file, "@ legend on\n");
-    md_file_printf(file, "@ legend box on\n");
-    md_file_printf(file, "@ legend loctype view\n");
-    md_file_printf(file, "@ legend 0.78, 0.8\n");
-    md_file_printf(file, "@ legend length %i\n", num_columns);
-
-    for (size_t j = 0; j < num_columns; ++j) {
-        md_file_printf(file, "@ s%zu legend \"%s\"\n", j, column_labels[j]);
-    }
-
-    for (size_t i = 0; i < num_rows; ++i) {
-        for (size_t j = 0; j < num_columns; ++j) {
-            md_file_printf(file, "%12.6f ", column_data[j][i]);
-        }
-        md_file_printf(file, "\n");
-    }
-
-    md_file_close(file);
-    LOG_SUCCESS("Successfully exported XVG file to '%.*s'", (int)filename.len, filename.ptr);
-    return true;
-}
-
-static bool export_csv(const float* column_data[], const char* column_labels[], size_t num_columns, size_t num_rows, str_t filename) {
-    ASSERT(column_data);
-    ASSERT(column_labels);
-    ASSERT(num_columns >= 0);
-    ASSERT(num_rows >= 0);
-
-    md_file_o* file = md_file_open(filename, MD_FILE_WRITE);
-    if (!file) {
-        LOG_ERROR("Failed to open file '%.*s' to write data.", (int)filename.len, filename.ptr);
-        return false;
-    }
-    
-    for (size_t i = 0; i < num_columns; ++i) {
-        md_file_printf(file, "%s,", column_labels[i]);
-    }
-    md_file_printf(file, "\n");
-
-    for (size_t i = 0; i < num_rows; ++i) {
-        for (size_t j = 0; j < num_columns; ++j) {
-            md_file_printf(file, "%.6g,", column_data[j][i]);
-        }
-        md_file_printf(file, "\n");
-    }
-
-    md_file_close(file);
-    LOG_SUCCESS("Successfully exported CSV file to '%.*s'", (int)filename.len, filename.ptr);
-    return true;
-}
-
 static bool export_cube(const ApplicationState& data, const md_script_property_data_t* prop_data, const md_script_vis_payload_o* vis_payload, str_t filename) {
     // @NOTE: First we need to extract some meta data for the cube format, we need the atom indices/bits for any SDF
     // And the origin + extent of the volume in spatial coordinates (Ångström)
@@ -6976,16 +8999,9 @@ static bool export_cube(const ApplicationState& data, const md_script_property_d
             md_file_printf(file, "%5i %5i\n", 1, 1);
 
             // Write density data
-            int count = 0;
-            for (int x = 0; x < vol_dim[0]; ++x) {
-                for (int y = 0; y < vol_dim[1]; ++y) {
-                    for (int z = 0; z < vol_dim[2]; ++z) {
-                        int idx = z * vol_dim[0] * vol_dim[1] + y * vol_dim[0] + x;
-                        float val = prop_data->values[idx];
-                        md_file_printf(file, " %12.6E", val);
-                        if (++count % 6 == 0) md_file_printf(file, "\n");
-                    }
-                }
+            if (!viamd::write_cube_voxels(file, prop_data->values, vol_dim)) {
+                md_file_close(file);
+                return false;
             }
         }
 
@@ -6998,6 +9014,49 @@ static bool export_cube(const ApplicationState& data, const md_script_property_d
     return true;
 }
 
+// Exports the density volume in one of the binary formats (npy or raw float32 with a JSON header)
+static bool export_volume(const ApplicationState& data, const md_script_property_data_t* prop_data, const md_script_vis_payload_o* vis_payload, str_t title, str_t filename, str_t ext, bool compress) {
+    if (!prop_data) {
+        LOG_ERROR("Export Volume: The property to be exported did not exist");
+        return false;
+    }
+
+    const int vol_dim[3] = {prop_data->dim[1], prop_data->dim[2], prop_data->dim[3]};
+
+    if (str_eq(ext, STR_LIT("npy"))) {
+        return viamd::export_volume_npy(filename, prop_data->values, vol_dim);
+    }
+
+    // The raw format carries the voxel size, which is given by the extent of the SDF
+    if (!vis_payload) {
+        LOG_ERROR("Export Volume: Missing input visualization data");
+        return false;
+    }
+
+    md_script_vis_t vis = { 0 };
+    md_script_vis_init(&vis, frame_alloc);
+    defer { md_script_vis_free(&vis); };
+
+    bool result = false;
+    if (md_script_ir_valid(data.script.eval_ir)) {
+        md_script_vis_ctx_t ctx = {
+            .ir = data.script.eval_ir,
+            .mol = &data.mold.mol,
+            .traj = data.mold.traj,
+        };
+        result = md_script_vis_eval_payload(&vis, vis_payload, 0, &ctx, MD_SCRIPT_VISUALIZE_SDF);
+    }
+
+    if (!result) {
+        LOG_ERROR("Failed to visualize volume for export.");
+        return false;
+    }
+
+    const float s = vis.sdf.extent;
+    const float voxel_size[3] = {2 * s / vol_dim[0], 2 * s / vol_dim[1], 2 * s / vol_dim[2]};
+    return viamd::export_volume_raw(filename, title, prop_data->values, vol_dim, voxel_size, compress ? viamd::VolumeCompression_Zlib : viamd::VolumeCompression_None);
+}
+
 #define APPEND_BUF(buf, len, fmt, ...) (len += snprintf(buf + len, MAX(0, (int)sizeof(buf) - len), fmt, ##__VA_ARGS__) + 1)
 
 static md_array(float) sample_range(float beg, float end, int sample_count, md_allocator_i* alloc) {
@@ -7019,11 +9078,15 @@ static void draw_property_export_window(ApplicationState* data) {
 
     ExportFormat table_formats[] {
         {STR_LIT("XVG"), STR_LIT("xvg")},
-        {STR_LIT("CSV"), STR_LIT("csv")}
+        {STR_LIT("CSV"), STR_LIT("csv")},
+        {STR_LIT("Raw float32 (JSON header)"), STR_LIT("bin")},
+        {STR_LIT("NumPy"), STR_LIT("npy")},
     };
 
     ExportFormat volume_formats[] {
         {STR_LIT("Gaussian Cube"), STR_LIT("cube")},
+        {STR_LIT("Raw float32 (JSON header)"), STR_LIT("bin")},
+        {STR_LIT("NumPy"), STR_LIT("npy")},
     };
 
     if (ImGui::Begin("Property Export", &data->show_property_export_window)) {
@@ -7031,6 +9094,7 @@ static void draw_property_export_window(ApplicationState* data) {
         static int property_idx  = 0;
         static int table_format  = 0;
         static int volume_format = 0;
+        static bool volume_compress = false;
 
         int num_properties = (int)md_array_size(data->display_properties);
         if (num_properties == 0) {
@@ -7040,7 +9104,7 @@ static void draw_property_export_window(ApplicationState* data) {
             return;
         }
 
-        if (task_system::task_is_running(data->tasks.evaluate_full)) {
+        if (sweep::consumer_is_running(data->tasks.evaluate_full)) {
             ImGui::Text("The properties are currently being evaluated, please wait...");
             ImGui::End();
             property_idx = 0;
@@ -7098,6 +9162,12 @@ static void draw_property_export_window(ApplicationState* data) {
                 ImGui::EndCombo();
             }
             file_extension = volume_formats[volume_format].ext;
+            if (str_eq(file_extension, STR_LIT("bin"))) {
+                ImGui::Checkbox("Compress (zlib)", &volume_compress);
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Compress the volume in independent chunks, each stored as its size (uint32) followed by a zlib stream");
+                }
+            }
         }
 
         if (property_idx != -1) {
@@ -7118,9 +9188,6 @@ static void draw_property_export_window(ApplicationState* data) {
             ASSERT(property_idx != -1);
             char path_buf[1024];
             DisplayProperty& dp = data->display_properties[property_idx];
-            md_array(const float*)  column_data = 0;
-            md_array(str_t)         column_labels = 0;
-            md_array(str_t)         legends = 0;
 
             if (application::file_dialog(path_buf, sizeof(path_buf), application::FileDialogFlag_Save, file_extension)) {
                 str_t path = {path_buf, strnlen(path_buf, sizeof(path_buf))};
@@ -7129,96 +9196,84 @@ static void draw_property_export_window(ApplicationState* data) {
                         if (export_cube(*data, dp.prop_data, dp.vis_payload, path)) {
                             LOG_SUCCESS("Successfully exported property '%s' to '" STR_FMT "'", dp.label, STR_ARG(path));
                         }
+                    } else {
+                        if (export_volume(*data, dp.prop_data, dp.vis_payload, str_from_cstr(dp.label), path, file_extension, volume_compress)) {
+                            LOG_SUCCESS("Successfully exported property '%s' to '" STR_FMT "'", dp.label, STR_ARG(path));
+                        }
                     }
                 } else {
-                    md_file_o* file = md_file_open(path, MD_FILE_WRITE | MD_FILE_BINARY);
-                    if (file) {
-                        str_t out_str = {};
-                        if (dp.type == DisplayProperty::Type_Temporal) {
-                            const double* traj_times = md_trajectory_frame_times(data->mold.traj);
-                            const size_t  num_frames = md_trajectory_num_frames(data->mold.traj);
-                            md_array(float) time = md_array_create(float, num_frames, alloc);
-                            for (size_t i = 0; i < num_frames; ++i) {
-                                time[i] = (float)traj_times[i];
-                            }
-
-                            str_t x_label = STR_LIT("Frame");
-                            str_t y_label = str_from_cstr(dp.label);
-
-                            if (!md_unit_unitless(dp.unit[1])) {
-                                y_label = str_printf(alloc, "%s (%s)", dp.label, dp.unit_str);
-                            }
+                    md_array(viamd::table_column_t) columns = 0;
+                    str_t title   = str_from_cstr(dp.label);
+                    str_t x_label = {};
+                    str_t y_label = str_from_cstr(dp.label);
+                    size_t num_rows = 0;
+
+                    if (dp.type == DisplayProperty::Type_Temporal) {
+                        const double* traj_times = md_trajectory_frame_times(data->mold.traj);
+                        const size_t  num_frames = md_trajectory_num_frames(data->mold.traj);
+                        md_array(float) time = md_array_create(float, num_frames, alloc);
+                        for (size_t i = 0; i < num_frames; ++i) {
+                            time[i] = (float)traj_times[i];
+                        }
 
-                            md_unit_t time_unit = md_trajectory_time_unit(data->mold.traj);
-                            if (!md_unit_empty(time_unit)) {
-                                char time_buf[64];
-                                size_t len = md_unit_print(time_buf, sizeof(time_buf), time_unit);
-                                x_label = str_printf(alloc, "Time (" STR_FMT ")", len, time_buf);
-                            }
+                        x_label = STR_LIT("Frame");
+                        if (!md_unit_unitless(dp.unit[1])) {
+                            y_label = str_printf(alloc, "%s (%s)", dp.label, dp.unit_str[1]);
+                        }
 
-                            md_array_push(column_data, time, alloc);
-                            md_array_push(column_labels, x_label, alloc);
+                        md_unit_t time_unit = md_trajectory_time_unit(data->mold.traj);
+                        if (!md_unit_empty(time_unit)) {
+                            char time_buf[64];
+                            size_t len = md_unit_print(time_buf, sizeof(time_buf), time_unit);
+                            x_label = str_printf(alloc, "Time (" STR_FMT ")", len, time_buf);
+                        }
 
-                            if (dp.dim > 1) {
-                                for (int i = 0; i < dp.dim; ++i) {
-                                    str_t  legend = str_printf(alloc, "%s[%i]", dp.label, i + 1);
-                                    float* values = (float*)md_alloc(alloc, sizeof(float) * num_frames);
-                                    for (size_t j = 0; j < num_frames; ++j) {
-                                        values[j] = dp.y_values[j * dp.dim + i];
-                                    }
-                                    md_array_push(column_data, values, alloc);
-                                    md_array_push(legends, legend, alloc);
-                                    md_array_push(column_labels, legend, alloc);
-                                }
-                            } else {
-                                md_array_push(column_data, dp.y_values, alloc);
-                                md_array_push(column_labels, y_label, alloc);
-                            }
+                        md_array_push(columns, (viamd::table_column_t{x_label, time, 1}), alloc);
 
-                            if (str_eq(file_extension, STR_LIT("xvg"))) {
-                                str_t header = md_xvg_format_header(str_from_cstr(dp.label), x_label, y_label, md_array_size(legends), legends, alloc);
-                                out_str = md_xvg_format(header, md_array_size(column_data), num_frames, column_data, alloc);
-                            } else if (str_eq(file_extension, STR_LIT("csv"))) {
-                                out_str = md_csv_write_to_str(column_data, column_labels, md_array_size(column_data), num_frames, alloc);
+                        // The values are interleaved per frame, so we reference them with a stride rather than copying them into columns
+                        if (dp.dim > 1) {
+                            for (int i = 0; i < dp.dim; ++i) {
+                                str_t legend = str_printf(alloc, "%s[%i]", dp.label, i + 1);
+                                md_array_push(columns, (viamd::table_column_t{legend, dp.y_values + i, (size_t)dp.dim}), alloc);
                             }
+                        } else {
+                            md_array_push(columns, (viamd::table_column_t{y_label, dp.y_values, 1}), alloc);
+                        }
+                        num_rows = num_frames;
+                    } else if (dp.type == DisplayProperty::Type_Distribution) {
+                        md_array(float) x_values = sample_range(dp.hist.x_min, dp.hist.x_max, dp.hist.num_bins, alloc);
 
+                        x_label = str_from_cstr(dp.unit_str[0]);
+                        if (strlen(dp.unit_str[1]) > 0) {
+                            y_label = str_printf(alloc, "%s (%s)", dp.label, dp.unit_str[1]);
+                        }
 
-                        } else if (dp.type == DisplayProperty::Type_Distribution) {
-                            md_array(float) x_values = sample_range(dp.hist.x_min, dp.hist.x_max, dp.hist.num_bins, alloc);
+                        md_array_push(columns, (viamd::table_column_t{x_label, x_values, 1}), alloc);
 
-                            str_t x_label = str_from_cstr(dp.unit_str[0]);
-                            str_t y_label = str_from_cstr(dp.label);
-                            if (strlen(dp.unit_str[1]) > 0) {
-                                y_label = str_printf(frame_alloc, "%s (%s)", dp.label, dp.unit_str);
+                        if (dp.hist.dim > 1) {
+                            for (int i = 0; i < dp.hist.dim; ++i) {
+                                str_t legend = str_printf(alloc, "%s[%i]", dp.label, i + 1);
+                                md_array_push(columns, (viamd::table_column_t{legend, dp.hist.bins + i * dp.hist.num_bins, 1}), alloc);
                             }
+                        } else {
+                            md_array_push(columns, (viamd::table_column_t{y_label, dp.hist.bins, 1}), alloc);
+                        }
+                        num_rows = dp.hist.num_bins;
+                    }
 
-                            md_array_push(column_data, x_values, alloc);
-                            md_array_push(column_labels, x_label, alloc);
-
-                            if (dp.hist.dim > 1) {
-                                for (int i = 0; i < dp.hist.dim; ++i) {
-                                    md_array_push(column_data, dp.hist.bins + i * dp.hist.num_bins, alloc);
-                                    str_t legend = str_printf(alloc, "%s[%i]", dp.label, i + 1);
-                                    md_array_push(legends, legend, alloc);
-                                    md_array_push(column_labels, legend, alloc);
-                                }
-                            } else {
-                                md_array_push(column_data, dp.hist.bins, alloc);
-                                md_array_push(column_labels, y_label, alloc);
-                            }
+                    bool result = false;
+                    if (str_eq(file_extension, STR_LIT("xvg"))) {
+                        result = viamd::export_table_xvg(path, title, x_label, y_label, columns, md_array_size(columns), num_rows);
+                    } else if (str_eq(file_extension, STR_LIT("csv"))) {
+                        result = viamd::export_table_csv(path, columns, md_array_size(columns), num_rows);
+                    } else if (str_eq(file_extension, STR_LIT("bin"))) {
+                        result = viamd::export_table_raw(path, title, columns, md_array_size(columns), num_rows);
+                    } else if (str_eq(file_extension, STR_LIT("npy"))) {
+                        result = viamd::export_table_npy(path, columns, md_array_size(columns), num_rows);
+                    }
 
-                            if (str_eq(file_extension, STR_LIT("xvg"))) {
-                                str_t header = md_xvg_format_header(str_from_cstr(dp.label), x_label, y_label, md_array_size(legends), legends, alloc);
-                                out_str = md_xvg_format(header, md_array_size(column_data), dp.hist.num_bins, column_data, alloc);
-                            } else if (str_eq(file_extension, STR_LIT("csv"))) {
-                                out_str = md_csv_write_to_str(column_data, column_labels, md_array_size(column_data), dp.hist.num_bins, alloc);
-                            }
-                        }
-                        if (!str_empty(out_str)) {
-                            md_file_write(file, out_str.ptr, out_str.len);
-                            LOG_SUCCESS("Successfully exported property '%s' to '%.*s'", dp.label, (int)path.len, path.ptr);
-                        }
-                        md_file_close(file);
+                    if (result) {
+                        LOG_SUCCESS("Successfully exported property '%s' to '%.*s'", dp.label, (int)path.len, path.ptr);
                     }
                 }
             }
@@ -7228,6 +9283,252 @@ static void draw_property_export_window(ApplicationState* data) {
     ImGui::End();
 }
 
+// The atom flags are regenerated and uploaded in blocks of atoms, only the blocks which contain atoms where any of the masks
+// differ from the previous upload are touched. Hovering thus only touches the few blocks of the atoms which enter or leave the highlight.
+#define ATOM_FLAG_BLOCK 4096
+
+// Sets the bit in the flags of the atoms within the mask in the range [beg, end)
+// The mask is processed in words of 64 atoms, where empty and full words are handled without visiting the individual bits
+static void or_atom_flags(uint8_t* flags, const md_bitfield_t* mask, uint8_t bit, size_t beg, size_t end) {
+    beg = MAX(beg, (size_t)mask->beg_bit);
+    end = MIN(end, (size_t)mask->end_bit);
+    for (size_t w_beg = beg; w_beg < end; w_beg = (w_beg & ~(size_t)63) + 64) {
+        const size_t w_end = MIN((w_beg & ~(size_t)63) + 64, end);
+        if (md_bitfield_popcount_range(mask, w_beg, w_end) == 0) continue;
+        if (md_bitfield_test_all_range(mask, w_beg, w_end)) {
+            for (size_t i = w_beg; i < w_end; ++i) {
+                flags[i] |= bit;
+            }
+            continue;
+        }
+        uint64_t i = w_beg;
+        while ((i = md_bitfield_scan(mask, i, w_end)) != 0) {
+            flags[i - 1] |= bit;
+        }
+    }
+}
+
+struct AtomFlagPayload {
+    uint8_t* flags;
+    const md_bitfield_t* masks[4];
+    uint8_t bits[4];
+    size_t beg;
+    size_t end;
+};
+
+static void generate_atom_flags(const AtomFlagPayload& payload, size_t beg, size_t end) {
+    MEMSET(payload.flags + beg, 0, (end - beg) * sizeof(uint8_t));
+    for (int i = 0; i < (int)ARRAY_SIZE(payload.masks); ++i) {
+        or_atom_flags(payload.flags, payload.masks[i], payload.bits[i], beg, end);
+    }
+}
+
+static void update_atom_flags(ApplicationState* data) {
+    const size_t count = data->mold.mol.atom.count;
+    auto& cache = data->mold.atom_flags;
+
+    md_vm_arena_temp_t tmp = md_vm_arena_temp_begin(frame_alloc);
+    defer { md_vm_arena_temp_end(tmp); };
+
+    AtomFlagPayload payload = {
+        .flags = 0,
+        .masks = {&data->selection.highlight_mask, &data->selection.selection_mask, &data->representation.visibility_mask, &data->mold.culling.mask},
+        .bits  = {AtomBit_Highlighted, AtomBit_Selected, AtomBit_Visible, AtomBit_InView},
+    };
+
+    // The masks are identified by the hashes which are already maintained for them, such that unchanged masks are neither compared nor copied
+    const uint64_t hashes[4] = {data->selection.highlight_mask_hash, data->selection.selection_mask_hash, data->representation.visibility_mask_hash, data->mold.culling.hash};
+
+    // Atoms where any of the masks differ from the previous upload
+    md_bitfield_t diff = md_bitfield_create(frame_alloc);
+    if (md_array_size(cache.flags) != count) {
+        md_array_resize(cache.flags, count, persistent_alloc);
+        md_bitfield_set_range(&diff, 0, count);
+        for (int i = 0; i < (int)ARRAY_SIZE(payload.masks); ++i) {
+            md_bitfield_copy(&cache.masks[i], payload.masks[i]);
+            cache.hashes[i] = hashes[i];
+        }
+    } else {
+        md_bitfield_t tmp_bf = md_bitfield_create(frame_alloc);
+        for (int i = 0; i < (int)ARRAY_SIZE(payload.masks); ++i) {
+            if (hashes[i] == cache.hashes[i]) continue;
+            md_bitfield_andnot(&tmp_bf, payload.masks[i], &cache.masks[i]);
+            md_bitfield_or_inplace(&diff, &tmp_bf);
+            md_bitfield_andnot(&tmp_bf, &cache.masks[i], payload.masks[i]);
+            md_bitfield_or_inplace(&diff, &tmp_bf);
+            md_bitfield_copy(&cache.masks[i], payload.masks[i]);
+            cache.hashes[i] = hashes[i];
+        }
+    }
+    payload.flags = cache.flags;
+
+    // Consecutive blocks with changes are merged into a single range
+    size_t beg = 0;
+    uint64_t found;
+    while (beg < count && (found = md_bitfield_scan(&diff, beg, count)) != 0) {
+        const size_t range_beg = ((found - 1) / ATOM_FLAG_BLOCK) * ATOM_FLAG_BLOCK;
+        size_t range_end = MIN(range_beg + ATOM_FLAG_BLOCK, count);
+        while (range_end < count && md_bitfield_scan(&diff, range_end, MIN(range_end + ATOM_FLAG_BLOCK, count)) != 0) {
+            range_end = MIN(range_end + ATOM_FLAG_BLOCK, count);
+        }
+
+        const uint32_t num_blocks = (uint32_t)((range_end - range_beg + ATOM_FLAG_BLOCK - 1) / ATOM_FLAG_BLOCK);
+        if (num_blocks > 1 && task_system::pool_num_threads() > 0) {
+            payload.beg = range_beg;
+            payload.end = range_end;
+            task_system::ID id = task_system::create_pool_task(STR_LIT("##Atom Flags"), 0, num_blocks, [](uint32_t block_beg, uint32_t block_end, void* user_data, uint32_t) {
+                const AtomFlagPayload& payload = *(const AtomFlagPayload*)user_data;
+                const size_t beg = payload.beg + (size_t)block_beg * ATOM_FLAG_BLOCK;
+                const size_t end = MIN(payload.beg + (size_t)block_end * ATOM_FLAG_BLOCK, payload.end);
+                generate_atom_flags(payload, beg, end);
+            }, &payload);
+            task_system::enqueue_task(id);
+            task_system::task_wait_for(id);
+        } else {
+            generate_atom_flags(payload, range_beg, range_end);
+        }
+
+        md_gl_mol_set_atom_flags(data->mold.gl_mol, (uint32_t)range_beg, (uint32_t)(range_end - range_beg), cache.flags + range_beg, 0);
+        beg = range_end;
+    }
+}
+
+// Atoms are culled in chunks of consecutive residues, residues are merged until the chunk holds at least this many atoms
+#define CULL_CHUNK_SIZE 256
+
+// Added to the bounds of the chunks for representations with bonds, which extend beyond the atoms
+#define CULL_BOND_PADDING 1.0f
+
+static void init_culling(ApplicationState* data) {
+    const md_molecule_t& mol = data->mold.mol;
+    const uint32_t count = (uint32_t)mol.atom.count;
+
+    md_vm_arena_temp_t tmp = md_vm_arena_temp_begin(frame_alloc);
+    defer { md_vm_arena_temp_end(tmp); };
+
+    md_array(uint32_t) offsets = 0;
+    md_array_push(offsets, 0, frame_alloc);
+    uint32_t beg = 0;
+    auto split = [&](uint32_t end) {
+        // Long residues and atoms without residues are split into chunks of fixed size
+        while (end - beg >= 2 * CULL_CHUNK_SIZE) {
+            beg += CULL_CHUNK_SIZE;
+            md_array_push(offsets, beg, frame_alloc);
+        }
+        if (end - beg >= CULL_CHUNK_SIZE) {
+            beg = end;
+            md_array_push(offsets, beg, frame_alloc);
+        }
+    };
+    for (size_t i = 0; i < mol.residue.count; ++i) {
+        const md_range_t range = md_residue_atom_range(mol.residue, i);
+        if ((uint32_t)range.end > beg && (uint32_t)range.end <= count) {
+            split((uint32_t)range.end);
+        }
+    }
+    split(count);
+    if (beg < count) {
+        md_array_push(offsets, count, frame_alloc);
+    }
+
+    auto& c = data->mold.culling;
+    culling::init_chunks(&c.culler, offsets, md_array_size(offsets) - 1, persistent_alloc);
+    md_bitfield_clear(&c.mask);
+    // The hash identifies the content of the mask (for the atom flags), no result of the culling maps to the empty mask
+    c.hash = UINT64_MAX;
+    c.radius_scale = 0.0f;
+}
+
+// Culls the chunks against the current view and updates the mask of drawn atoms
+// Has to be called before the buffers are updated, as the bounds follow the dirty positions and radii
+static void update_culling(ApplicationState* data) {
+    const md_molecule_t& mol = data->mold.mol;
+    auto& c = data->mold.culling;
+    if (mol.atom.count == 0 || c.culler.num_chunks == 0) return;
+
+    culling::poll_depth(&c.culler);
+
+    if (!data->visuals.culling.enabled) {
+        // All atoms are kept, the hash of an empty result is used to mark the state
+        const uint64_t hash = 0;
+        if (c.hash != hash || md_bitfield_popcount(&c.mask) != mol.atom.count) {
+            md_bitfield_clear(&c.mask);
+            md_bitfield_set_range(&c.mask, 0, mol.atom.count);
+            c.hash = hash;
+            data->mold.dirty_buffers |= MolBit_DirtyFlags;
+        }
+        return;
+    }
+
+    float radius_scale = 1.0f;
+    float padding = 0.0f;
+    for (size_t i = 0; i < md_array_size(data->representation.reps); ++i) {
+        const Representation& rep = data->representation.reps[i];
+        if (!rep.enabled || !rep.type_is_valid) continue;
+        switch (rep.type) {
+        case RepresentationType::SpaceFill:
+            radius_scale = MAX(radius_scale, rep.scale.x);
+            break;
+        case RepresentationType::Licorice:
+            padding = MAX(padding, rep.scale.x + CULL_BOND_PADDING);
+            break;
+        case RepresentationType::BallAndStick:
+            radius_scale = MAX(radius_scale, rep.scale.x);
+            padding = MAX(padding, CULL_BOND_PADDING);
+            break;
+        default:
+            break;
+        }
+    }
+
+    if ((data->mold.dirty_buffers & (MolBit_DirtyPosition | MolBit_DirtyRadius)) || radius_scale != c.radius_scale) {
+        culling::update_bounds(&c.culler, mol.atom.x, mol.atom.y, mol.atom.z, mol.atom.radius, radius_scale);
+        c.radius_scale = radius_scale;
+    }
+
+    if (!data->visuals.culling.occlusion) {
+        // The depth is no longer captured, a stale Hi-Z must not be used once occlusion is enabled again
+        c.culler.hiz.valid = false;
+    }
+
+    // The captured depth is only valid for the same view and scene, the jitter of the projection is excluded as it is sub-pixel
+    const Camera& cam = data->view.camera;
+    uint64_t scene_key = md_hash64(&data->view.param.matrix.curr.view, sizeof(mat4_t), 0);
+    scene_key = md_hash64(&cam.fov_y, sizeof(cam.fov_y), scene_key);
+    scene_key = md_hash64(&cam.near_plane, sizeof(cam.near_plane), scene_key);
+    scene_key = md_hash64(&cam.far_plane, sizeof(cam.far_plane), scene_key);
+    scene_key = md_hash64(&cam.focus_distance, sizeof(cam.focus_distance), scene_key);
+    scene_key = md_hash64(&data->view.mode, sizeof(data->view.mode), scene_key);
+    scene_key = md_hash64(&data->gbuffer.width, sizeof(data->gbuffer.width), scene_key);
+    scene_key = md_hash64(&data->gbuffer.height, sizeof(data->gbuffer.height), scene_key);
+    scene_key = md_hash64(&data->mold.position_generation, sizeof(data->mold.position_generation), scene_key);
+    scene_key = md_hash64(&data->representation.visibility_mask_hash, sizeof(data->representation.visibility_mask_hash), scene_key);
+    for (size_t i = 0; i < md_array_size(data->representation.reps); ++i) {
+        const Representation& rep = data->representation.reps[i];
+        if (!rep.enabled) continue;
+        scene_key = md_hash64(&rep.type, sizeof(rep.type), scene_key);
+        scene_key = md_hash64(&rep.scale, sizeof(rep.scale), scene_key);
+        scene_key = md_hash64(&rep.mask_hash, sizeof(rep.mask_hash), scene_key);
+    }
+    c.scene_key = scene_key;
+
+    culling::CullDesc desc;
+    desc.view_proj = data->view.param.matrix.curr.proj * data->view.param.matrix.curr.view;
+    desc.viewport_width  = (int)data->gbuffer.width;
+    desc.viewport_height = (int)data->gbuffer.height;
+    desc.padding = padding;
+    desc.occlusion = data->visuals.culling.occlusion;
+    desc.scene_key = scene_key;
+    desc.lod_pixel_size = data->visuals.culling.lod_pixel_size;
+
+    const uint64_t hash = culling::cull(&c.culler, desc);
+    if (hash != c.hash) {
+        culling::write_atom_mask(&c.mask, &c.culler);
+        c.hash = hash;
+        data->mold.dirty_buffers |= MolBit_DirtyFlags;
+    }
+}
+
 static void update_md_buffers(ApplicationState* data) {
     ASSERT(data);
     const auto& mol = data->mold.mol;
@@ -7258,34 +9559,7 @@ static void update_md_buffers(ApplicationState* data) {
     }
 
     if (data->mold.dirty_buffers & MolBit_DirtyFlags) {
-        md_vm_arena_temp_t tmp = md_vm_arena_temp_begin(frame_alloc);
-        defer { md_vm_arena_temp_end(tmp); };
-
-        uint8_t* flags = (uint8_t*)md_vm_arena_push(frame_alloc, mol.atom.count * sizeof(uint8_t));
-        MEMSET(flags, 0, mol.atom.count * sizeof(uint8_t));
-
-        {
-            md_bitfield_iter_t it = md_bitfield_iter_create(&data->selection.highlight_mask);
-            while (md_bitfield_iter_next(&it)) {
-                uint64_t idx = md_bitfield_iter_idx(&it);
-                flags[idx] |= AtomBit_Highlighted;
-            }
-        }
-        {
-            md_bitfield_iter_t it = md_bitfield_iter_create(&data->selection.selection_mask);
-            while (md_bitfield_iter_next(&it)) {
-                uint64_t idx = md_bitfield_iter_idx(&it);
-                flags[idx] |= AtomBit_Selected;
-            }
-        }
-        {
-            md_bitfield_iter_t it = md_bitfield_iter_create(&data->representation.visibility_mask);
-            while (md_bitfield_iter_next(&it)) {
-                uint64_t idx = md_bitfield_iter_idx(&it);
-                flags[idx] |= AtomBit_Visible;
-            }
-        }
-        md_gl_mol_set_atom_flags(data->mold.gl_mol, 0, (uint32_t)mol.atom.count, flags, 0);
+        update_atom_flags(data);
     }
 
     if (data->mold.dirty_buffers & MolBit_DirtyBonds) {
@@ -7302,6 +9576,7 @@ static void update_md_buffers(ApplicationState* data) {
 }
 
 static void interrupt_async_tasks(ApplicationState* data) {
+    sweep::interrupt_all();
     task_system::pool_interrupt_running_tasks();
 
     if (data->script.full_eval) md_script_eval_interrupt(data->script.full_eval);
@@ -7314,6 +9589,7 @@ static void interrupt_async_tasks(ApplicationState* data) {
 static void free_trajectory_data(ApplicationState* data) {
     ASSERT(data);
     interrupt_async_tasks(data);
+    free_movie_export(data);
 
     if (data->mold.traj) {
         load::traj::close(data->mold.traj);
@@ -7371,32 +9647,22 @@ static void init_trajectory_data(ApplicationState* data) {
             MEMSET(data->trajectory_data.backbone_angles.data, 0, md_array_size(data->trajectory_data.backbone_angles.data) * sizeof (md_backbone_angles_t));
 
             // Launch work to compute the values
-            task_system::task_interrupt_and_wait_for(data->tasks.backbone_computations);
+            sweep::consumer_interrupt_and_wait_for(data->tasks.backbone_computations);
 
-            data->tasks.backbone_computations = task_system::create_pool_task(STR_LIT("Backbone Operations"), 0, (uint32_t)num_frames, [](uint32_t range_beg, uint32_t range_end, void* user_data, uint32_t thread_num) {
-                (void)thread_num;
+            data->tasks.backbone_computations = sweep::submit(STR_LIT("Backbone Operations"), 0, (uint32_t)num_frames, [](uint32_t frame_idx, const md_trajectory_frame_header_t*, const float* x, const float* y, const float* z, void* user_data) {
                 ApplicationState* data = (ApplicationState*)user_data;
                 
                 // Create copy here of molecule since we use the full structure as input
+                // Overwrite the coordinate section with the frame data supplied by the sweep (which is only read from)
                 md_molecule_t mol = data->mold.mol;
-
-                const size_t stride = ALIGN_TO(mol.atom.count, 8);
-                const size_t bytes = stride * sizeof(float) * 3;
-                float* coords = (float*)md_alloc(md_get_heap_allocator(), bytes);
-                defer { md_free(md_get_heap_allocator(), coords, bytes); };
-                // Overwrite the coordinate section, since we will load trajectory frame data into these
-                mol.atom.x = coords + stride * 0;
-                mol.atom.y = coords + stride * 1;
-                mol.atom.z = coords + stride * 2;
-
-                for (uint32_t frame_idx = range_beg; frame_idx < range_end; ++frame_idx) {
-                    md_trajectory_load_frame(data->mold.traj, frame_idx, NULL, mol.atom.x, mol.atom.y, mol.atom.z);
-                    md_util_backbone_angles_compute(data->trajectory_data.backbone_angles.data + data->trajectory_data.backbone_angles.stride * frame_idx, data->trajectory_data.backbone_angles.stride, &mol);
-                    md_util_backbone_secondary_structure_compute(data->trajectory_data.secondary_structure.data + data->trajectory_data.secondary_structure.stride * frame_idx, data->trajectory_data.secondary_structure.stride, &mol);
-                }
-            }, data);
-
-            task_system::ID main_task = task_system::create_main_task(STR_LIT("Update Trajectory Data"), [](void* user_data) {
+                mol.atom.x = (float*)x;
+                mol.atom.y = (float*)y;
+                mol.atom.z = (float*)z;
+
+                md_util_backbone_angles_compute(data->trajectory_data.backbone_angles.data + data->trajectory_data.backbone_angles.stride * frame_idx, data->trajectory_data.backbone_angles.stride, &mol);
+                md_util_backbone_secondary_structure_compute(data->trajectory_data.secondary_structure.data + data->trajectory_data.secondary_structure.stride * frame_idx, data->trajectory_data.secondary_structure.stride, &mol);
+            }, data, [](void* user_data) {
+                // Update Trajectory Data
                 ApplicationState* data = (ApplicationState*)user_data;
                 data->trajectory_data.backbone_angles.fingerprint = generate_fingerprint();
                 data->trajectory_data.secondary_structure.fingerprint = generate_fingerprint();
@@ -7404,14 +9670,11 @@ static void init_trajectory_data(ApplicationState* data) {
                 interpolate_atomic_properties(data);
                 data->mold.dirty_buffers |= MolBit_ClearVelocity;
                 update_all_representations(data);
-
-            }, data);
-
-            task_system::set_task_dependency(main_task, data->tasks.backbone_computations);
-            task_system::enqueue_task(data->tasks.backbone_computations);
+            });
         }
 
         data->mold.dirty_buffers |= MolBit_DirtyPosition;
+        data->mold.position_generation += 1;
         data->mold.dirty_buffers |= MolBit_ClearVelocity;
 
         // Prefetch frames
@@ -7437,6 +9700,12 @@ static bool load_trajectory_data(ApplicationState* data, str_t filename, md_traj
 static void free_molecule_data(ApplicationState* data) {
     ASSERT(data);
     interrupt_async_tasks(data);
+    cancel_selection_grow_job(data);
+    free_selection_region(data);
+    viamd::spatial_grid_free(&data->mold.grid);
+    data->mold.grid_hash = 0;
+    culling::destroy(&data->mold.culling.culler);
+    md_bitfield_clear(&data->mold.culling.mask);
 
     clear_dataset_items(data);
 
@@ -7449,6 +9718,8 @@ static void free_molecule_data(ApplicationState* data) {
 
     md_bitfield_clear(&data->selection.selection_mask);
     md_bitfield_clear(&data->selection.highlight_mask);
+    // The density representation job reads from the IR
+    cancel_density_volume_jobs(data);
     if (data->script.ir) {
         md_script_ir_free(data->script.ir);
         data->script.ir = nullptr;
@@ -7457,6 +9728,7 @@ static void free_molecule_data(ApplicationState* data) {
         md_script_ir_free(data->script.eval_ir);
         data->script.eval_ir = nullptr;
     }
+    cancel_display_property_jobs(data);
     if (data->script.full_eval) {
         md_script_eval_free(data->script.full_eval);
         data->script.full_eval = nullptr;
@@ -7480,6 +9752,10 @@ static void init_molecule_data(ApplicationState* data) {
         data->selection.bond_idx.right_click = -1;
 
         data->mold.gl_mol = md_gl_mol_create(&data->mold.mol);
+        // The flags of the new buffer are uploaded in full
+        md_array_shrink(data->mold.atom_flags.flags, 0);
+        data->mold.dirty_buffers |= MolBit_DirtyFlags;
+        init_culling(data);
 
 #if EXPERIMENTAL_GFX_API
         const md_molecule_t& mol = data->mold.mol;
@@ -7863,117 +10139,858 @@ static void save_workspace(ApplicationState* data, str_t filename) {
     viamd::write_bool(state, STR_LIT("DofEnabled"), data->visuals.dof.enabled);
     viamd::write_flt(state, STR_LIT("DofFocusScale"), data->visuals.dof.focus_scale);
 
-    viamd::write_section_header(state, STR_LIT("Camera"));
-    viamd::write_vec3(state, STR_LIT("Position"), data->view.camera.position);
-    viamd::write_quat(state, STR_LIT("Orientation"), data->view.camera.orientation);
-    viamd::write_flt(state,  STR_LIT("Distance"), data->view.camera.focus_distance);
-    viamd::write_int(state,  STR_LIT("Mode"), (int)data->view.mode);
+    viamd::write_section_header(state, STR_LIT("Camera"));
+    viamd::write_vec3(state, STR_LIT("Position"), data->view.camera.position);
+    viamd::write_quat(state, STR_LIT("Orientation"), data->view.camera.orientation);
+    viamd::write_flt(state,  STR_LIT("Distance"), data->view.camera.focus_distance);
+    viamd::write_int(state,  STR_LIT("Mode"), (int)data->view.mode);
+
+
+    for (size_t i = 0; i < md_array_size(data->representation.reps); ++i) {
+        const Representation& rep = data->representation.reps[i];
+        viamd::write_section_header(state, STR_LIT("Representation"));
+        viamd::write_str(state,  STR_LIT("Name"), str_from_cstr(rep.name));
+        viamd::write_str(state,  STR_LIT("Filter"), str_from_cstr(rep.filt));
+        viamd::write_bool(state, STR_LIT("Enabled"), rep.enabled);
+        viamd::write_int(state,  STR_LIT("Type"), (int)rep.type);
+        viamd::write_int(state,  STR_LIT("ColorMapping"), (int)rep.color_mapping);
+        viamd::write_vec4(state, STR_LIT("StaticColor"), rep.uniform_color);
+        viamd::write_flt(state,  STR_LIT("Saturation"), rep.saturation);
+        viamd::write_vec4(state, STR_LIT("Param"), rep.scale);
+        viamd::write_bool(state, STR_LIT("DynamicEval"), rep.dynamic_evaluation);
+
+        if (rep.type == RepresentationType::Orbital) {
+            viamd::write_int(state,  STR_LIT("OrbIdx"),      rep.orbital.orbital_idx);
+            viamd::write_int(state,  STR_LIT("OrbType"),(int)rep.orbital.type);
+            viamd::write_int(state,  STR_LIT("OrbRes"), (int)rep.orbital.vol.resolution);
+            viamd::write_flt(state,  STR_LIT("OrbIso"),      rep.orbital.vol.iso.values[0]);
+            viamd::write_vec4(state, STR_LIT("OrbColPos"),   rep.orbital.vol.iso.colors[0]);
+            viamd::write_vec4(state, STR_LIT("OrbColNeg"),   rep.orbital.vol.iso.colors[1]);
+        }
+    }
+
+    for (size_t i = 0; i < md_array_size(data->dataset.atom_element_remappings); ++i) {
+        const AtomElementMapping& mapping = data->dataset.atom_element_remappings[i];
+        viamd::write_section_header(state, STR_LIT("AtomElementMapping"));
+        viamd::write_str(state, STR_LIT("Label"), str_from_cstr(mapping.lbl));
+        viamd::write_int(state, STR_LIT("Element"), mapping.elem);
+    }
+
+    {
+        std::string text = editor.GetText();
+        viamd::write_section_header(state, STR_LIT("Script"));
+        viamd::write_str(state, STR_LIT("Text"), str_t{text.c_str(), text.size()});
+    }
+
+    for (size_t i = 0; i < md_array_size(data->selection.stored_selections); ++i) {
+        const Selection& sel = data->selection.stored_selections[i];
+        size_t cap = md_bitfield_serialize_size_in_bytes(&sel.atom_mask);
+        char* buf = (char*)md_vm_arena_push(frame_alloc, cap);
+        size_t len = md_bitfield_serialize(buf, &sel.atom_mask);
+        str_t encoded_mask = {buf, len};
+        viamd::write_section_header(state, STR_LIT("Selection"));
+        viamd::write_str(state, STR_LIT("Label"), str_from_cstr(sel.name));
+        viamd::write_str(state, STR_LIT("Mask"),  encoded_mask);
+    }
+
+    viamd::event_system_broadcast_event(viamd::EventType_ViamdSerialize, viamd::EventPayloadType_SerializationState, &state);
+
+    str_t text = md_strb_to_str(state.sb);
+    md_file_write(file, str_ptr(text), str_len(text));
+}
+
+// #screenshot
+// Screenshots are read back through pixel buffer objects and encoded on the task pool, the main thread never waits for the GPU or the encoder.
+// High resolution renders are composed of tiles the size of the G-buffer, each tile is rendered with an off-center projection of the full image.
+// One tile is rendered per frame, which keeps the application responsive during large renders.
+
+struct ScreenshotReadback {
+    uint32_t pbo;
+    GLsync fence;
+    int x, y, w, h;     // Region within the image, origin at the bottom left
+};
+
+struct ScreenshotJob {
+    str_t path;
+    uint32_t* rgba;     // [width * height] top to bottom
+    int width;
+    int height;
+
+    md_array(ScreenshotReadback) readbacks;
+    int regions_left;   // Regions which have not yet been copied into the image
+
+    struct {
+        int count[2];       // Number of tiles in x and y
+        int next;
+        int dim[2];         // Dimensions of the G-buffer the tiles are rendered with
+        int margin;         // Guard band which is rendered around each tile and cropped, the tiles advance by dim - 2 * margin
+        uint32_t fbo;
+        uint32_t tex;
+        ViewParam::Block view;
+        ViewParam::Block inv_view;
+        mat4_t proj;        // Projection of the full image
+    } tile;
+
+    task_system::ID task;
+    std::atomic_bool done;
+    bool result;
+};
+
+static ScreenshotJob* screenshot_job_create(str_t path, int width, int height) {
+    ScreenshotJob* job = (ScreenshotJob*)md_alloc(md_get_heap_allocator(), sizeof(ScreenshotJob));
+    new (job) ScreenshotJob();
+    job->path   = str_copy(path, md_get_heap_allocator());
+    job->width  = width;
+    job->height = height;
+    job->rgba   = (uint32_t*)md_alloc(md_get_heap_allocator(), (size_t)width * height * sizeof(uint32_t));
+    job->readbacks = 0;
+    job->regions_left = 0;
+    job->tile = {};
+    job->task = 0;
+    job->done = false;
+    job->result = false;
+    return job;
+}
+
+static void screenshot_job_free(ScreenshotJob* job) {
+    ASSERT(job);
+    if (job->task) task_system::task_wait_for(job->task);
+    for (size_t i = 0; i < md_array_size(job->readbacks); ++i) {
+        glDeleteSync(job->readbacks[i].fence);
+        glDeleteBuffers(1, &job->readbacks[i].pbo);
+    }
+    md_array_free(job->readbacks, md_get_heap_allocator());
+    if (job->tile.fbo) glDeleteFramebuffers(1, &job->tile.fbo);
+    if (job->tile.tex) glDeleteTextures(1, &job->tile.tex);
+    md_free(md_get_heap_allocator(), job->rgba, (size_t)job->width * job->height * sizeof(uint32_t));
+    str_free(job->path, md_get_heap_allocator());
+    job->~ScreenshotJob();
+    md_free(md_get_heap_allocator(), job, sizeof(ScreenshotJob));
+}
+
+// Initiates an asynchronous read of the region [src_x, src_y, w, h] of the bound read framebuffer into the image at (dst_x, dst_y)
+static void screenshot_queue_readback(ScreenshotJob* job, int src_x, int src_y, int dst_x, int dst_y, int w, int h) {
+    ScreenshotReadback rb = {
+        .pbo = 0,
+        .fence = 0,
+        .x = dst_x,
+        .y = dst_y,
+        .w = w,
+        .h = h,
+    };
+    glGenBuffers(1, &rb.pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)w * h * sizeof(uint32_t), NULL, GL_STREAM_READ);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(src_x, src_y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    rb.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    md_array_push(job->readbacks, rb, md_get_heap_allocator());
+}
+
+// Copies the completed readbacks into the image, the rows are flipped as part of the copy
+static void screenshot_poll_readbacks(ScreenshotJob* job) {
+    size_t i = 0;
+    while (i < md_array_size(job->readbacks)) {
+        ScreenshotReadback& rb = job->readbacks[i];
+        const GLenum res = glClientWaitSync(rb.fence, 0, 0);
+        if (res == GL_TIMEOUT_EXPIRED) {
+            ++i;
+            continue;
+        }
+        if (res != GL_WAIT_FAILED) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.pbo);
+            const uint32_t* src = (const uint32_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (size_t)rb.w * rb.h * sizeof(uint32_t), GL_MAP_READ_BIT);
+            if (src) {
+                for (int row = 0; row < rb.h; ++row) {
+                    uint32_t* dst = job->rgba + (size_t)(job->height - 1 - (rb.y + row)) * job->width + rb.x;
+                    MEMCPY(dst, src + (size_t)row * rb.w, rb.w * sizeof(uint32_t));
+                }
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+        glDeleteSync(rb.fence);
+        glDeleteBuffers(1, &rb.pbo);
+        job->regions_left -= 1;
+        job->readbacks[i] = *md_array_last(job->readbacks);
+        md_array_pop(job->readbacks);
+    }
+}
+
+static void screenshot_launch_encode(ScreenshotJob* job) {
+    job->task = task_system::create_pool_task(STR_LIT("Encode Screenshot"), [](void* user_data) {
+        ScreenshotJob* job = (ScreenshotJob*)user_data;
+        str_t ext = {};
+        extract_ext(&ext, job->path);
+        if (str_eq_cstr_ignore_case(ext, "jpg")) {
+            const int quality = 95;
+            job->result = image_write_jpg(job->path, job->rgba, job->width, job->height, quality);
+        } else if (str_eq_cstr_ignore_case(ext, "png")) {
+            job->result = image_write_png(job->path, job->rgba, job->width, job->height);
+        } else if (str_eq_cstr_ignore_case(ext, "bmp")) {
+            job->result = image_write_bmp(job->path, job->rgba, job->width, job->height);
+        }
+        job->done = true;
+    }, job);
+    task_system::enqueue_task(job->task);
+}
+
+static bool screenshot_ext_supported(str_t path) {
+    str_t ext = {};
+    extract_ext(&ext, path);
+    return str_eq_cstr_ignore_case(ext, "jpg") || str_eq_cstr_ignore_case(ext, "png") || str_eq_cstr_ignore_case(ext, "bmp");
+}
+
+// Captures the back buffer
+static void create_screenshot(ApplicationState* data) {
+    ASSERT(data);
+
+    str_t path = data->screenshot.path_to_file;
+    if (!screenshot_ext_supported(path)) {
+        str_t ext = {};
+        extract_ext(&ext, path);
+        LOG_ERROR("Non supported file-extension '%.*s' when saving screenshot", (int)ext.len, ext.ptr);
+        return;
+    }
+
+    const int width  = (int)data->app.framebuffer.width;
+    const int height = (int)data->app.framebuffer.height;
+    ScreenshotJob* job = screenshot_job_create(path, width, height);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glReadBuffer(GL_BACK);
+    screenshot_queue_readback(job, 0, 0, 0, 0, width, height);
+    job->regions_left = 1;
+
+    md_array_push(data->screenshot.jobs, job, persistent_alloc);
+}
+
+// Starts a tiled offscreen render of the current view at an arbitrary resolution
+static void create_high_res_render(ApplicationState* data, str_t path, int width, int height) {
+    ASSERT(data);
+
+    if (!screenshot_ext_supported(path)) {
+        LOG_ERROR("Supplied image extension is not supported");
+        return;
+    }
+    if (width <= 0 || height <= 0 || width > SCREENSHOT_MAX_DIM || height > SCREENSHOT_MAX_DIM) {
+        LOG_ERROR("Invalid render resolution %i x %i", width, height);
+        return;
+    }
+
+    const int tile_w = (int)data->gbuffer.width;
+    const int tile_h = (int)data->gbuffer.height;
+    ScreenshotJob* job = screenshot_job_create(path, width, height);
+    if (!job->rgba) {
+        LOG_ERROR("Failed to allocate %i x %i image for render", width, height);
+        screenshot_job_free(job);
+        return;
+    }
+
+    // The screen space passes sample neighbouring pixels, which would be missing at the borders of the tiles and cause seams.
+    // Each tile is therefore rendered with a guard band of pixels from the adjacent tiles, which is cropped in the readback.
+    const int margin = MIN(SCREENSHOT_TILE_MARGIN, MIN(tile_w, tile_h) / 4);
+    const int inner_w = tile_w - 2 * margin;
+    const int inner_h = tile_h - 2 * margin;
+
+    job->tile.count[0] = (width  + inner_w - 1) / inner_w;
+    job->tile.count[1] = (height + inner_h - 1) / inner_h;
+    job->tile.dim[0] = tile_w;
+    job->tile.dim[1] = tile_h;
+    job->tile.margin = margin;
+    job->regions_left = job->tile.count[0] * job->tile.count[1];
+
+    // The view is fixed at the start, such that all tiles are consistent
+    job->tile.view     = data->view.param.matrix.curr;
+    job->tile.inv_view = data->view.param.matrix.inv;
+    const float aspect_ratio = (float)width / (float)height;
+    if (data->view.mode == CameraMode::Perspective) {
+        job->tile.proj = camera_perspective_projection_matrix(data->view.camera, aspect_ratio);
+    } else {
+        const float h = data->view.camera.focus_distance * tanf(data->view.camera.fov_y * 0.5f);
+        const float w = aspect_ratio * h;
+        job->tile.proj = camera_orthographic_projection_matrix(-w, w, -h, h, data->view.camera.near_plane, data->view.camera.far_plane);
+    }
+
+    gl::init_texture_2D(&job->tile.tex, tile_w, tile_h, GL_RGBA8);
+    glGenFramebuffers(1, &job->tile.fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, job->tile.fbo);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, job->tile.tex, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+    // Frames of the trajectory should not change between the tiles
+    data->animation.mode = PlaybackMode::Stopped;
+
+    LOG_INFO("Rendering %i x %i image in %i tiles", width, height, job->regions_left);
+    md_array_push(data->screenshot.jobs, job, persistent_alloc);
+}
+
+static void render_screenshot_tile(ApplicationState* data, ScreenshotJob* job) {
+    const int tile_idx = job->tile.next++;
+    const int tx = tile_idx % job->tile.count[0];
+    const int ty = tile_idx / job->tile.count[0];
+    const int tw = job->tile.dim[0];
+    const int th = job->tile.dim[1];
+    const int m  = job->tile.margin;
+    // Region of the image which the tile contributes, the rendered region extends beyond it by the margin on each side
+    const int x0 = tx * (tw - 2 * m);
+    const int y0 = ty * (th - 2 * m);
+    const int rx = x0 - m;
+    const int ry = y0 - m;
+
+    // Maps the rendered region within the normalized device coordinates of the full image to [-1, 1]
+    const float sx = (float)job->width  / (float)tw;
+    const float sy = (float)job->height / (float)th;
+    const float cx = (2.0f * rx + tw) / (float)job->width  - 1.0f;
+    const float cy = (2.0f * ry + th) / (float)job->height - 1.0f;
+    mat4_t S = mat4_ident();
+    S.elem[0][0] = sx;
+    S.elem[1][1] = sy;
+    S.elem[3][0] = -cx * sx;
+    S.elem[3][1] = -cy * sy;
+
+    // Temporal history and view dependent culling do not carry over between the tiles
+    const ViewParam param = data->view.param;
+    const bool temporal_aa = data->visuals.temporal_aa.enabled;
+    const bool culling     = data->visuals.culling.enabled;
+    defer {
+        data->view.param = param;
+        data->visuals.temporal_aa.enabled = temporal_aa;
+        data->visuals.culling.enabled = culling;
+    };
+    data->visuals.temporal_aa.enabled = false;
+    data->visuals.culling.enabled = false;
+
+    ViewParam& p = data->view.param;
+    p.matrix.curr = job->tile.view;
+    p.matrix.inv  = job->tile.inv_view;
+    p.matrix.curr.proj = S * job->tile.proj;
+    p.matrix.inv.proj  = mat4_inverse(p.matrix.curr.proj);
+    p.matrix.prev = p.matrix.curr;
+    p.jitter.curr = {0, 0};
+    p.jitter.prev = {0, 0};
+    p.resolution  = {(float)tw, (float)th};
+
+    PUSH_GPU_SECTION("Screenshot Tile")
+    clear_gbuffer(&data->gbuffer);
+    fill_gbuffer(data);
+
+    glDisable(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, job->tile.fbo);
+    glViewport(0, 0, tw, th);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    apply_postprocessing(*data);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, job->tile.fbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    screenshot_queue_readback(job, m, m, x0, y0, MIN(tw - 2 * m, job->width - x0), MIN(th - 2 * m, job->height - y0));
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    POP_GPU_SECTION()
+}
+
+// Renders the next tile of a pending high resolution render, completes readbacks and finalizes encoded images
+// Has to be called after the picking of the frame has been read and before the G-buffer is filled
+static void update_screenshot_jobs(ApplicationState* data) {
+    bool tile_rendered = false;
+    size_t i = 0;
+    while (i < md_array_size(data->screenshot.jobs)) {
+        ScreenshotJob* job = data->screenshot.jobs[i];
+
+        const int num_tiles = job->tile.count[0] * job->tile.count[1];
+        if (!tile_rendered && job->tile.next < num_tiles) {
+            if (job->tile.dim[0] != (int)data->gbuffer.width || job->tile.dim[1] != (int)data->gbuffer.height) {
+                LOG_ERROR("The window was resized during the render of '%.*s', the render was aborted", (int)job->path.len, job->path.ptr);
+                screenshot_job_free(job);
+                data->screenshot.jobs[i] = *md_array_last(data->screenshot.jobs);
+                md_array_pop(data->screenshot.jobs);
+                continue;
+            }
+            render_screenshot_tile(data, job);
+            tile_rendered = true;
+        }
+
+        screenshot_poll_readbacks(job);
+
+        if (job->regions_left == 0 && !job->task) {
+            screenshot_launch_encode(job);
+        }
+
+        if (job->done) {
+            if (job->result) {
+                LOG_SUCCESS("Screenshot saved to: '%.*s'", (int)job->path.len, job->path.ptr);
+            } else {
+                LOG_ERROR("Failed to write screenshot to: '%.*s'", (int)job->path.len, job->path.ptr);
+            }
+            screenshot_job_free(job);
+            data->screenshot.jobs[i] = *md_array_last(data->screenshot.jobs);
+            md_array_pop(data->screenshot.jobs);
+            continue;
+        }
+        ++i;
+    }
+}
+
+static void free_screenshot_jobs(ApplicationState* data) {
+    for (size_t i = 0; i < md_array_size(data->screenshot.jobs); ++i) {
+        screenshot_job_free(data->screenshot.jobs[i]);
+    }
+    md_array_shrink(data->screenshot.jobs, 0);
+}
+
+// #dynamic_resolution
+
+// The scale is changed in steps of 1 / DYNAMIC_RESOLUTION_STEPS
+#define DYNAMIC_RESOLUTION_STEPS 16
+
+// Number of measured frames after a change before the next one is considered
+#define DYNAMIC_RESOLUTION_COOLDOWN 30
+
+// Adjusts the scale of the render resolution and the resolution of the SSAO from the measured GPU frame time
+// Changes are quantized and followed by a cooldown, as each of them reallocates the render targets
+static void update_dynamic_resolution(ApplicationState* data) {
+    auto& dr = data->visuals.dynamic_resolution;
+    if (!dr.enabled || !profiler::enabled()) {
+        dr.scale = 1.0f;
+        dr.ssao_half_res = false;
+        dr.gpu_ms = 0.0f;
+        dr.frames_since_change = 0;
+        return;
+    }
+
+    // The tiles of a high resolution render are required to have the same size
+    for (size_t i = 0; i < md_array_size(data->screenshot.jobs); ++i) {
+        const ScreenshotJob* job = data->screenshot.jobs[i];
+        if (job->tile.next < job->tile.count[0] * job->tile.count[1]) return;
+    }
+
+    // Only account for frames which have been resolved since the last call
+    const uint64_t frame = profiler::num_resolved_frames();
+    if (frame == dr.measured_frame) return;
+    dr.measured_frame = frame;
+
+    const float gpu_ms = profiler::last_frame_gpu_ms();
+    dr.gpu_ms = dr.gpu_ms == 0.0f ? gpu_ms : lerp(dr.gpu_ms, gpu_ms, 0.1f);
+    dr.frames_since_change += 1;
+    if (dr.frames_since_change < DYNAMIC_RESOLUTION_COOLDOWN) return;
+
+    const float step = 1.0f / DYNAMIC_RESOLUTION_STEPS;
+    const float min_scale = CLAMP(dr.min_scale, step, 1.0f);
+    const float scale = dr.scale;
+    const bool  ssao_half_res = dr.ssao_half_res;
+
+    if (dr.gpu_ms > dr.target_ms) {
+        if (data->visuals.ssao.enabled && !dr.ssao_half_res) {
+            dr.ssao_half_res = true;
+        } else {
+            // The cost is assumed to be proportional to the number of pixels, aim slightly below the target
+            float s = dr.scale * sqrtf(dr.target_ms * 0.9f / dr.gpu_ms);
+            s = floorf(s * DYNAMIC_RESOLUTION_STEPS) * step;
+            dr.scale = CLAMP(MIN(s, dr.scale - step), min_scale, 1.0f);
+        }
+    } else if (dr.gpu_ms < dr.target_ms * 0.75f) {
+        if (dr.scale < 1.0f) {
+            dr.scale = MIN(dr.scale + step, 1.0f);
+        } else {
+            dr.ssao_half_res = false;
+        }
+    }
+
+    if (dr.scale != scale || dr.ssao_half_res != ssao_half_res) {
+        dr.gpu_ms = 0.0f;
+        dr.frames_since_change = 0;
+    }
+}
 
+// #movie
+// Frame sequences are exported by stepping the animation frame over a range, at most one frame of the sequence is captured per application frame.
+// A frame is captured once its interpolation and the asynchronous updates of the representations are complete.
+// The frames are rendered offscreen and read back through pixel buffer objects into a bounded set of slots, which are encoded on the task pool.
+// The export stalls when all slots are occupied, which bounds the memory use while the encoding overlaps with the rendering of the following frames.
+// Raw frames which are piped to an external encoder have to arrive in order, they are written by a single task at a time.
 
-    for (size_t i = 0; i < md_array_size(data->representation.reps); ++i) {
-        const Representation& rep = data->representation.reps[i];
-        viamd::write_section_header(state, STR_LIT("Representation"));
-        viamd::write_str(state,  STR_LIT("Name"), str_from_cstr(rep.name));
-        viamd::write_str(state,  STR_LIT("Filter"), str_from_cstr(rep.filt));
-        viamd::write_bool(state, STR_LIT("Enabled"), rep.enabled);
-        viamd::write_int(state,  STR_LIT("Type"), (int)rep.type);
-        viamd::write_int(state,  STR_LIT("ColorMapping"), (int)rep.color_mapping);
-        viamd::write_vec4(state, STR_LIT("StaticColor"), rep.uniform_color);
-        viamd::write_flt(state,  STR_LIT("Saturation"), rep.saturation);
-        viamd::write_vec4(state, STR_LIT("Param"), rep.scale);
-        viamd::write_bool(state, STR_LIT("DynamicEval"), rep.dynamic_evaluation);
+#if MD_PLATFORM_WINDOWS
+#define movie_popen(cmd) _popen(cmd, "wb")
+#define movie_pclose _pclose
+#else
+#define movie_popen(cmd) popen(cmd, "w")
+#define movie_pclose pclose
+#endif
 
-        if (rep.type == RepresentationType::Orbital) {
-            viamd::write_int(state,  STR_LIT("OrbIdx"),      rep.orbital.orbital_idx);
-            viamd::write_int(state,  STR_LIT("OrbType"),(int)rep.orbital.type);
-            viamd::write_int(state,  STR_LIT("OrbRes"), (int)rep.orbital.vol.resolution);
-            viamd::write_flt(state,  STR_LIT("OrbIso"),      rep.orbital.vol.iso.values[0]);
-            viamd::write_vec4(state, STR_LIT("OrbColPos"),   rep.orbital.vol.iso.colors[0]);
-            viamd::write_vec4(state, STR_LIT("OrbColNeg"),   rep.orbital.vol.iso.colors[1]);
+enum MovieSlotState {
+    MovieSlotState_Free,
+    MovieSlotState_Readback,    // Waiting for the pixels to arrive in the pixel buffer object
+    MovieSlotState_Ready,       // Pixels are available, waiting to be written
+    MovieSlotState_Writing,
+};
+
+struct MovieSlot {
+    MovieSlotState state;
+    int index;                  // Index of the frame within the sequence
+    uint32_t pbo;
+    GLsync fence;
+    uint32_t* rgba;             // [width * height] top to bottom
+    char path[1024];
+    task_system::ID task;
+    MovieExport* movie;
+};
+
+struct MovieExport {
+    MovieOutput output;
+    str_t path;
+    FILE* pipe;
+    int width;
+    int height;
+
+    double beg_frame;
+    double stride;
+    int num_frames;
+    int next_frame;             // Index of the next frame to capture
+    int next_write;             // Index of the next frame to write to the pipe
+    bool frame_pending;         // The animation frame is set to the next frame, which is captured once it is ready
+    std::atomic_int num_written;
+    std::atomic_int num_failed;
+
+    uint32_t fbo;
+    uint32_t tex;
+
+    MovieSlot slots[MOVIE_EXPORT_MAX_SLOTS];
+    int num_slots;
+
+    // Settings which are restored once the export is complete
+    bool temporal_aa;
+    bool culling;
+    bool dynamic_resolution;
+};
+
+// Replaces {width} and {height} within the command
+static void movie_expand_command(char* buf, size_t cap, const char* cmd, int width, int height) {
+    size_t len = 0;
+    while (*cmd && len + 1 < cap) {
+        if (strncmp(cmd, "{width}", 7) == 0) {
+            len = MIN(len + snprintf(buf + len, cap - len, "%i", width), cap - 1);
+            cmd += 7;
+        } else if (strncmp(cmd, "{height}", 8) == 0) {
+            len = MIN(len + snprintf(buf + len, cap - len, "%i", height), cap - 1);
+            cmd += 8;
+        } else {
+            buf[len++] = *cmd++;
         }
     }
+    buf[len] = '\0';
+}
 
-    for (size_t i = 0; i < md_array_size(data->dataset.atom_element_remappings); ++i) {
-        const AtomElementMapping& mapping = data->dataset.atom_element_remappings[i];
-        viamd::write_section_header(state, STR_LIT("AtomElementMapping"));
-        viamd::write_str(state, STR_LIT("Label"), str_from_cstr(mapping.lbl));
-        viamd::write_int(state, STR_LIT("Element"), mapping.elem);
+static MovieSlot* movie_find_free_slot(MovieExport* movie) {
+    for (int i = 0; i < movie->num_slots; ++i) {
+        if (movie->slots[i].state == MovieSlotState_Free) return &movie->slots[i];
     }
+    return NULL;
+}
 
-    {
-        std::string text = editor.GetText();
-        viamd::write_section_header(state, STR_LIT("Script"));
-        viamd::write_str(state, STR_LIT("Text"), str_t{text.c_str(), text.size()});
+// The frame is ready once the asynchronous evaluations which affect its appearance are complete
+static bool movie_frame_ready(const ApplicationState* data) {
+    for (size_t i = 0; i < md_array_size(data->representation.reps); ++i) {
+        const Representation& rep = data->representation.reps[i];
+        if (!rep.enabled) continue;
+        if (rep.prop.job) return false;
+        if (rep.color_mapping == ColorMapping::Property && (data->script.compile_ir || task_system::task_is_running(data->tasks.evaluate_full))) return false;
     }
+    return true;
+}
 
-    for (size_t i = 0; i < md_array_size(data->selection.stored_selections); ++i) {
-        const Selection& sel = data->selection.stored_selections[i];
-        size_t cap = md_bitfield_serialize_size_in_bytes(&sel.atom_mask);
-        char* buf = (char*)md_vm_arena_push(frame_alloc, cap);
-        size_t len = md_bitfield_serialize(buf, &sel.atom_mask);
-        str_t encoded_mask = {buf, len};
-        viamd::write_section_header(state, STR_LIT("Selection"));
-        viamd::write_str(state, STR_LIT("Label"), str_from_cstr(sel.name));
-        viamd::write_str(state, STR_LIT("Mask"),  encoded_mask);
+static bool start_movie_export(ApplicationState* data) {
+    ASSERT(data);
+    free_movie_export(data);
+
+    const size_t num_traj_frames = md_trajectory_num_frames(data->mold.traj);
+    if (num_traj_frames == 0) {
+        LOG_ERROR("No trajectory is loaded, there are no frames to export");
+        return false;
+    }
+    if (data->movie.stride <= 0.0) {
+        LOG_ERROR("The stride of the export has to be positive");
+        return false;
     }
 
-    viamd::event_system_broadcast_event(viamd::EventType_ViamdSerialize, viamd::EventPayloadType_SerializationState, &state);
+    const double max_frame = (double)(num_traj_frames - 1);
+    const double beg_frame = CLAMP(data->movie.beg_frame, 0.0, max_frame);
+    const double end_frame = CLAMP(data->movie.end_frame, beg_frame, max_frame);
+    const int num_frames = (int)((end_frame - beg_frame) / data->movie.stride + 1e-6) + 1;
 
-    str_t text = md_strb_to_str(state.sb);
-    md_file_write(file, str_ptr(text), str_len(text));
+    str_t path = str_from_cstr(data->movie.path);
+    if (data->movie.output == MovieOutput::Images && !screenshot_ext_supported(path)) {
+        LOG_ERROR("Supplied image extension is not supported, expected jpg, png or bmp");
+        return false;
+    }
+
+    const int width  = (int)data->app.framebuffer.width;
+    const int height = (int)data->app.framebuffer.height;
+
+    FILE* pipe = NULL;
+    if (data->movie.output == MovieOutput::Pipe) {
+        char cmd[2048];
+        movie_expand_command(cmd, sizeof(cmd), data->movie.command, width, height);
+#if !MD_PLATFORM_WINDOWS
+        // Writing to an encoder which has terminated should fail rather than terminate the application
+        signal(SIGPIPE, SIG_IGN);
+#endif
+        pipe = movie_popen(cmd);
+        if (!pipe) {
+            LOG_ERROR("Failed to launch '%s'", cmd);
+            return false;
+        }
+        LOG_INFO("Piping frames to '%s'", cmd);
+    }
+
+    MovieExport* movie = (MovieExport*)md_alloc(md_get_heap_allocator(), sizeof(MovieExport));
+    new (movie) MovieExport();
+    movie->output = data->movie.output;
+    movie->path = str_copy(path, md_get_heap_allocator());
+    movie->pipe = pipe;
+    movie->width  = width;
+    movie->height = height;
+    movie->beg_frame = beg_frame;
+    movie->stride = data->movie.stride;
+    movie->num_frames = num_frames;
+    movie->next_frame = 0;
+    movie->next_write = 0;
+    movie->frame_pending = false;
+    movie->num_written = 0;
+    movie->num_failed = 0;
+
+    // One slot per worker keeps all of them busy, a few more than that does not improve the throughput
+    movie->num_slots = CLAMP((int)task_system::pool_num_threads(), 2, MOVIE_EXPORT_MAX_SLOTS);
+    const size_t bytes = (size_t)width * height * sizeof(uint32_t);
+    for (int i = 0; i < movie->num_slots; ++i) {
+        MovieSlot& slot = movie->slots[i];
+        slot = {};
+        slot.movie = movie;
+        slot.rgba = (uint32_t*)md_alloc(md_get_heap_allocator(), bytes);
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    gl::init_texture_2D(&movie->tex, width, height, GL_RGBA8);
+    glGenFramebuffers(1, &movie->fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, movie->fbo);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, movie->tex, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+    // Temporal history and view dependent culling lag behind the frame, which would make the frames depend on the previous ones
+    // The frames are rendered at the full resolution, independent of the GPU time
+    movie->temporal_aa = data->visuals.temporal_aa.enabled;
+    movie->culling     = data->visuals.culling.enabled;
+    movie->dynamic_resolution = data->visuals.dynamic_resolution.enabled;
+    data->visuals.temporal_aa.enabled = false;
+    data->visuals.culling.enabled = false;
+    data->visuals.dynamic_resolution.enabled = false;
+    data->animation.mode = PlaybackMode::Stopped;
+
+    data->movie.job = movie;
+    LOG_INFO("Exporting %i frames at %i x %i", num_frames, width, height);
+    return true;
 }
 
-void create_screenshot(ApplicationState* data) {
+static void free_movie_export(ApplicationState* data) {
     ASSERT(data);
+    MovieExport* movie = data->movie.job;
+    if (!movie) return;
+
+    const size_t bytes = (size_t)movie->width * movie->height * sizeof(uint32_t);
+    for (int i = 0; i < movie->num_slots; ++i) {
+        MovieSlot& slot = movie->slots[i];
+        if (slot.task) task_system::task_wait_for(slot.task);
+        if (slot.fence) glDeleteSync(slot.fence);
+        glDeleteBuffers(1, &slot.pbo);
+        md_free(md_get_heap_allocator(), slot.rgba, bytes);
+    }
+    if (movie->pipe) movie_pclose(movie->pipe);
+    if (movie->fbo) glDeleteFramebuffers(1, &movie->fbo);
+    if (movie->tex) glDeleteTextures(1, &movie->tex);
+
+    data->visuals.temporal_aa.enabled = movie->temporal_aa;
+    data->visuals.culling.enabled = movie->culling;
+    data->visuals.dynamic_resolution.enabled = movie->dynamic_resolution;
+
+    str_free(movie->path, md_get_heap_allocator());
+    movie->~MovieExport();
+    md_free(md_get_heap_allocator(), movie, sizeof(MovieExport));
+    data->movie.job = 0;
+}
 
-    md_vm_arena_temp_t tmp = md_vm_arena_temp_begin(frame_alloc);
-    defer { md_vm_arena_temp_end(tmp); };
-
-    str_t path = data->screenshot.path_to_file;
+static void movie_launch_write(MovieExport* movie, MovieSlot* slot) {
+    slot->state = MovieSlotState_Writing;
+    if (movie->output == MovieOutput::Images) {
+        str_t ext = {};
+        extract_ext(&ext, movie->path);
+        const int base_len = (int)(movie->path.len - ext.len - 1);
+        snprintf(slot->path, sizeof(slot->path), "%.*s_%05i.%.*s", base_len, movie->path.ptr, slot->index, (int)ext.len, ext.ptr);
+
+        slot->task = task_system::create_pool_task(STR_LIT("Encode Frame"), [](void* user_data) {
+            MovieSlot* slot = (MovieSlot*)user_data;
+            MovieExport* movie = slot->movie;
+            str_t path = str_from_cstr(slot->path);
+            str_t ext = {};
+            extract_ext(&ext, path);
+            bool result = false;
+            if (str_eq_cstr_ignore_case(ext, "jpg")) {
+                const int quality = 95;
+                result = image_write_jpg(path, slot->rgba, movie->width, movie->height, quality);
+            } else if (str_eq_cstr_ignore_case(ext, "png")) {
+                result = image_write_png(path, slot->rgba, movie->width, movie->height);
+            } else if (str_eq_cstr_ignore_case(ext, "bmp")) {
+                result = image_write_bmp(path, slot->rgba, movie->width, movie->height);
+            }
+            if (result) {
+                movie->num_written += 1;
+            } else {
+                movie->num_failed += 1;
+            }
+        }, slot);
+    } else {
+        slot->task = task_system::create_pool_task(STR_LIT("Write Frame"), [](void* user_data) {
+            MovieSlot* slot = (MovieSlot*)user_data;
+            MovieExport* movie = slot->movie;
+            const size_t count = (size_t)movie->width * movie->height;
+            if (fwrite(slot->rgba, sizeof(uint32_t), count, movie->pipe) == count) {
+                movie->num_written += 1;
+            } else {
+                movie->num_failed += 1;
+            }
+        }, slot);
+        movie->next_write += 1;
+    }
+    task_system::enqueue_task(slot->task);
+}
 
-    int width  = data->gbuffer.width;
-    int height = data->gbuffer.height;
-    size_t bytes = width * height * sizeof(uint32_t);
-    uint32_t* rgba = (uint32_t*)md_vm_arena_push(frame_alloc, bytes);
-    defer { md_vm_arena_pop(frame_alloc, bytes); };
+// Completes readbacks, hands captured frames to the encoders and steps the animation to the next frame of the sequence
+// Has to be called before the change of the animation frame is detected
+static void update_movie_export(ApplicationState* data) {
+    ASSERT(data);
+    MovieExport* movie = data->movie.job;
+    if (!movie) return;
 
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-    glReadBuffer(GL_BACK);
-    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
-    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+    if (movie->width != (int)data->app.framebuffer.width || movie->height != (int)data->app.framebuffer.height) {
+        LOG_ERROR("The window was resized during the export, the export was aborted");
+        free_movie_export(data);
+        return;
+    }
 
-    {
-        // @NOTE: Swap Rows to flip image with respect to y-axis
-        const uint32_t row_byte_size = width * sizeof(uint32_t);
-        uint32_t* row_t = (uint32_t*)md_alloc(frame_alloc, row_byte_size);
-        defer { md_free(frame_alloc, row_t, row_byte_size); };
-        for (uint32_t i = 0; i < (uint32_t)height / 2; ++i) {
-            uint32_t* row_a = rgba + i * width;
-            uint32_t* row_b = rgba + (height - 1 - i) * width;
-            if (row_a != row_b) {
-                MEMCPY(row_t, row_a, row_byte_size);  // tmp = a;
-                MEMCPY(row_a, row_b, row_byte_size);  // a = b;
-                MEMCPY(row_b, row_t, row_byte_size);  // b = tmp;
+    bool writing = false;
+    for (int i = 0; i < movie->num_slots; ++i) {
+        MovieSlot& slot = movie->slots[i];
+        if (slot.state == MovieSlotState_Readback) {
+            const GLenum res = glClientWaitSync(slot.fence, 0, 0);
+            if (res == GL_TIMEOUT_EXPIRED) continue;
+            const void* src = NULL;
+            if (res != GL_WAIT_FAILED) {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+                src = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (size_t)movie->width * movie->height * sizeof(uint32_t), GL_MAP_READ_BIT);
+            }
+            if (src) {
+                // Flip the rows as part of the copy
+                for (int row = 0; row < movie->height; ++row) {
+                    MEMCPY(slot.rgba + (size_t)(movie->height - 1 - row) * movie->width, (const uint32_t*)src + (size_t)row * movie->width, movie->width * sizeof(uint32_t));
+                }
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            } else {
+                MEMSET(slot.rgba, 0, (size_t)movie->width * movie->height * sizeof(uint32_t));
+                movie->num_failed += 1;
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            glDeleteSync(slot.fence);
+            slot.fence = 0;
+            slot.state = MovieSlotState_Ready;
+        } else if (slot.state == MovieSlotState_Writing) {
+            if (task_system::task_is_running(slot.task)) {
+                writing = true;
+            } else {
+                slot.task = 0;
+                slot.state = MovieSlotState_Free;
             }
         }
     }
 
-    str_t ext = {};
-    extract_ext(&ext, path);
+    for (int i = 0; i < movie->num_slots; ++i) {
+        MovieSlot& slot = movie->slots[i];
+        if (slot.state != MovieSlotState_Ready) continue;
+        if (movie->output == MovieOutput::Images) {
+            movie_launch_write(movie, &slot);
+        } else if (!writing && slot.index == movie->next_write) {
+            movie_launch_write(movie, &slot);
+            writing = true;
+        }
+    }
 
-    if (str_eq_cstr_ignore_case(ext, "jpg")) {
-        const int quality = 95;
-        image_write_jpg(path, rgba, width, height, quality);
-    } else if (str_eq_cstr_ignore_case(ext, "png")) {
-        image_write_png(path, rgba, width, height);
-    } else if (str_eq_cstr_ignore_case(ext, "bmp")) {
-        image_write_bmp(path, rgba, width, height);
-    } else {
-        LOG_ERROR("Non supported file-extension '%.*s' when saving screenshot", (int)ext.len, ext.ptr);
-        return;
+    if (!movie->frame_pending && movie->next_frame < movie->num_frames && movie_find_free_slot(movie)) {
+        data->animation.frame = movie->beg_frame + movie->next_frame * movie->stride;
+        data->animation.mode = PlaybackMode::Stopped;
+        movie->frame_pending = true;
+    }
+
+    if (movie->next_frame == movie->num_frames) {
+        for (int i = 0; i < movie->num_slots; ++i) {
+            if (movie->slots[i].state != MovieSlotState_Free) return;
+        }
+
+        int exit_code = 0;
+        if (movie->pipe) {
+            // Waits for the encoder to finish
+            exit_code = movie_pclose(movie->pipe);
+            movie->pipe = NULL;
+        }
+
+        const int num_written = movie->num_written;
+        const int num_failed  = movie->num_failed;
+        if (num_failed > 0) {
+            LOG_ERROR("Failed to write %i of %i frames", num_failed, movie->num_frames);
+        } else if (exit_code != 0) {
+            LOG_ERROR("The encoder exited with code %i", exit_code);
+        } else {
+            LOG_INFO("Exported %i frames", num_written);
+        }
+
+        free_movie_export(data);
+        if (data->movie.exit_on_completion) {
+            data->app.window.should_close = true;
+        }
     }
+}
+
+// Renders the pending frame of the sequence offscreen and initiates its readback, if the frame is ready
+// Has to be called after the G-buffer has been filled
+static void capture_movie_frame(ApplicationState* data) {
+    ASSERT(data);
+    MovieExport* movie = data->movie.job;
+    if (!movie || !movie->frame_pending || !movie_frame_ready(data)) return;
+
+    MovieSlot* slot = movie_find_free_slot(movie);
+    ASSERT(slot);
+
+    PUSH_GPU_SECTION("Movie Frame")
+    glDisable(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, movie->fbo);
+    glViewport(0, 0, movie->width, movie->height);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    apply_postprocessing(*data);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, movie->fbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, movie->width, movie->height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    POP_GPU_SECTION()
 
-    LOG_SUCCESS("Screenshot saved to: '%.*s'", (int)path.len, path.ptr);
+    slot->index = movie->next_frame++;
+    slot->state = MovieSlotState_Readback;
+    movie->frame_pending = false;
 }
 
 // #representation
@@ -7996,6 +11013,11 @@ static Representation* clone_representation(ApplicationState* state, const Repre
     Representation* clone = md_array_push(state->representation.reps, rep, persistent_alloc);
     clone->md_rep = {0};
     clone->atom_mask = {0};
+    clone->colors = 0;
+    clone->uploaded_colors = 0;
+    clone->prop.atom_structure = 0;
+    clone->prop.atom_scalar = 0;
+    clone->prop.job = 0;
     init_representation(state, clone);
     update_representation(state, clone);
     return clone;
@@ -8007,7 +11029,11 @@ static void remove_representation(ApplicationState* state, int idx) {
     auto& rep = state->representation.reps[idx];
     md_bitfield_free(&rep.atom_mask);
     md_gl_rep_destroy(rep.md_rep);
+    md_array_free(rep.colors, persistent_alloc);
+    md_array_free(rep.uploaded_colors, persistent_alloc);
+    free_representation_property(&rep);
     if (rep.orbital.vol.vol_tex != 0) gl::free_texture(&rep.orbital.vol.vol_tex);
+    if (rep.orbital.vol.macro_cell_tex != 0) gl::free_texture(&rep.orbital.vol.macro_cell_tex);
     if (rep.orbital.vol.dvr.tf_tex != 0) gl::free_texture(&rep.orbital.vol.dvr.tf_tex);
     md_array_swap_back_and_pop(state->representation.reps, idx);
 }
@@ -8026,11 +11052,250 @@ static void recompute_atom_visibility_mask(ApplicationState* state) {
     state->representation.visibility_mask_hash = md_bitfield_hash64(&mask, 0);
 }
 
-static void update_all_representations(ApplicationState* state) {
+// Evaluates the dirty filters of the enabled representations in parallel
+static void prefetch_representation_filters(ApplicationState* state) {
+    md_vm_arena_temp_t tmp = md_vm_arena_temp_begin(frame_alloc);
+    defer { md_vm_arena_temp_end(tmp); };
+
+    const size_t num_reps = md_array_size(state->representation.reps);
+    str_t* exprs = (str_t*)md_vm_arena_push(frame_alloc, num_reps * sizeof(str_t));
+    size_t count = 0;
+    for (size_t i = 0; i < num_reps; ++i) {
+        const auto& rep = state->representation.reps[i];
+        // Dynamically evaluated representations are only flagged as dirty within update_representation, but are re-evaluated on every update
+        if (rep.enabled && (rep.filt_is_dirty || rep.dynamic_evaluation)) {
+            exprs[count++] = str_from_cstr(rep.filt);
+        }
+    }
+    prefetch_filter_expressions(state, exprs, count);
+}
+
+static void update_all_representations(ApplicationState* state, uint32_t dirty_flags) {
+    if (dirty_flags & RepBit_DirtyFilter) {
+        // The script, topology or selections which the filters depend upon have changed
+        filter_cache_clear();
+    }
     for (size_t i = 0; i < md_array_size(state->representation.reps); ++i) {
         auto& rep = state->representation.reps[i];
-        rep.filt_is_dirty = true;
-        update_representation(state, &rep);
+        if (dirty_flags & RepBit_DirtyFilter) rep.filt_is_dirty  = true;
+        if (dirty_flags & RepBit_DirtyColor)  rep.color_is_dirty = true;
+    }
+    prefetch_representation_filters(state);
+    for (size_t i = 0; i < md_array_size(state->representation.reps); ++i) {
+        update_representation(state, &state->representation.reps[i]);
+    }
+}
+
+// Uploads the parts of the colors which differ from the previous upload, in blocks of atoms
+#define REP_COLOR_UPLOAD_BLOCK 1024
+
+static void upload_representation_colors(Representation* rep, const uint32_t* colors, size_t count, bool upload_all) {
+    if (upload_all) {
+        md_array_resize(rep->uploaded_colors, count, persistent_alloc);
+        md_gl_rep_set_color(rep->md_rep, 0, (uint32_t)count, colors, 0);
+        MEMCPY(rep->uploaded_colors, colors, count * sizeof(uint32_t));
+        return;
+    }
+
+    // Consecutive blocks which differ are merged into a single range
+    size_t range_beg = SIZE_MAX;
+    for (size_t beg = 0; beg < count; beg += REP_COLOR_UPLOAD_BLOCK) {
+        const size_t len = MIN(count - beg, (size_t)REP_COLOR_UPLOAD_BLOCK);
+        const bool differs = memcmp(colors + beg, rep->uploaded_colors + beg, len * sizeof(uint32_t)) != 0;
+        if (differs && range_beg == SIZE_MAX) {
+            range_beg = beg;
+        } else if (!differs && range_beg != SIZE_MAX) {
+            md_gl_rep_set_color(rep->md_rep, (uint32_t)range_beg, (uint32_t)(beg - range_beg), colors + range_beg, 0);
+            MEMCPY(rep->uploaded_colors + range_beg, colors + range_beg, (beg - range_beg) * sizeof(uint32_t));
+            range_beg = SIZE_MAX;
+        }
+    }
+    if (range_beg != SIZE_MAX) {
+        md_gl_rep_set_color(rep->md_rep, (uint32_t)range_beg, (uint32_t)(count - range_beg), colors + range_beg, 0);
+        MEMCPY(rep->uploaded_colors + range_beg, colors + range_beg, (count - range_beg) * sizeof(uint32_t));
+    }
+}
+
+// The colors of representations which are mapped by a property are evaluated for each frame on the task pool.
+// The values of the structures (population entries) are interpolated between the frames and quantized into colormap coordinates,
+// which are then scattered to the atoms of each structure. The colors are expanded from the coordinates through a colormap table,
+// such that a change of colormap does not require a new evaluation.
+#define PROPERTY_SCALAR_NONE 255
+
+struct PropertyColorJob {
+    md_allocator_i* arena;
+    float* values[2];               // [dim] values of the two frames which are interpolated
+    float  frame_fract;
+    float  map_beg;
+    float  map_end;
+    int    dim;
+
+    uint8_t* structure_scalar;      // [dim]
+    const int32_t* atom_structure;  // [num_atoms]
+    uint8_t* atom_scalar;           // [num_atoms] result, which is copied to the representation once complete
+    size_t num_atoms;
+
+    uint64_t hash;
+    task_system::ID structure_task;
+    task_system::ID atom_task;
+};
+
+static PropertyColorJob* launch_property_color_job(const float* values, int dim, int num_frames, double frame, float map_beg, float map_end, const int32_t* atom_structure, size_t num_atoms, uint64_t hash) {
+    md_allocator_i* arena = md_arena_allocator_create(md_get_heap_allocator(), MEGABYTES(1));
+    PropertyColorJob* job = (PropertyColorJob*)md_alloc(arena, sizeof(PropertyColorJob));
+    MEMSET(job, 0, sizeof(PropertyColorJob));
+    job->arena = arena;
+
+    // The values of the frames are copied, since the property data may be reevaluated meanwhile
+    const int i0 = CLAMP((int)frame, 0, num_frames - 1);
+    const int i1 = CLAMP(i0 + 1, 0, num_frames - 1);
+    const int idx[2] = {i0, i1};
+    for (int i = 0; i < 2; ++i) {
+        job->values[i] = (float*)md_alloc(arena, dim * sizeof(float));
+        MEMCPY(job->values[i], values + (size_t)idx[i] * dim, dim * sizeof(float));
+    }
+    job->frame_fract = CLAMP((float)(frame - i0), 0.0f, 1.0f);
+    job->map_beg = map_beg;
+    job->map_end = map_end;
+    job->dim = dim;
+    job->structure_scalar = (uint8_t*)md_alloc(arena, dim * sizeof(uint8_t));
+    job->atom_structure = atom_structure;
+    job->atom_scalar = (uint8_t*)md_alloc(arena, num_atoms * sizeof(uint8_t));
+    job->num_atoms = num_atoms;
+    job->hash = hash;
+
+    job->structure_task = task_system::create_pool_task(STR_LIT("##Property Colors"), [](void* user_data) {
+        PropertyColorJob* job = (PropertyColorJob*)user_data;
+        const float ext = job->map_end - job->map_beg;
+        const float scl = ext != 0.0f ? 1.0f / ext : 0.0f;
+        for (int i = 0; i < job->dim; ++i) {
+            const float value = lerpf(job->values[0][i], job->values[1][i], job->frame_fract);
+            const float t = CLAMP((value - job->map_beg) * scl, 0.0f, 1.0f);
+            job->structure_scalar[i] = (uint8_t)(t * (PROPERTY_SCALAR_NONE - 1) + 0.5f);
+        }
+    }, job);
+
+    job->atom_task = task_system::create_pool_task(STR_LIT("##Property Colors"), 0, (uint32_t)num_atoms, [](uint32_t range_beg, uint32_t range_end, void* user_data, uint32_t) {
+        PropertyColorJob* job = (PropertyColorJob*)user_data;
+        for (uint32_t i = range_beg; i < range_end; ++i) {
+            const int32_t s = job->atom_structure[i];
+            job->atom_scalar[i] = s >= 0 ? job->structure_scalar[s] : PROPERTY_SCALAR_NONE;
+        }
+    }, job);
+
+    task_system::set_task_dependency(job->atom_task, job->structure_task);
+    task_system::enqueue_task(job->structure_task);
+
+    return job;
+}
+
+static bool property_color_job_done(const PropertyColorJob* job) {
+    ASSERT(job);
+    return !task_system::task_is_running(job->structure_task) && !task_system::task_is_running(job->atom_task);
+}
+
+static void property_color_job_wait_and_free(PropertyColorJob* job) {
+    ASSERT(job);
+    task_system::task_wait_for(job->structure_task);
+    task_system::task_wait_for(job->atom_task);
+    md_arena_allocator_destroy(job->arena);
+}
+
+static void free_representation_property(Representation* rep) {
+    if (rep->prop.job) {
+        property_color_job_wait_and_free(rep->prop.job);
+        rep->prop.job = 0;
+    }
+    md_array_free(rep->prop.atom_structure, persistent_alloc);
+    md_array_free(rep->prop.atom_scalar, persistent_alloc);
+    rep->prop.atom_structure = 0;
+    rep->prop.atom_scalar = 0;
+    rep->prop.structure_hash = 0;
+    rep->prop.scalar_hash = 0;
+}
+
+static const DisplayProperty* find_representation_property(const ApplicationState* state, const Representation* rep) {
+    if (rep->prop.ident[0] == '\0') return NULL;
+    for (size_t i = 0; i < md_array_size(state->display_properties); ++i) {
+        const DisplayProperty& dp = state->display_properties[i];
+        if (dp.type == DisplayProperty::Type_Temporal && dp.vis_payload && strcmp(dp.label, rep->prop.ident) == 0) {
+            return &dp;
+        }
+    }
+    return NULL;
+}
+
+// Evaluates which atoms belong to each structure of the property, this is only required when the script changes
+static void update_representation_property_structures(ApplicationState* state, Representation* rep, const DisplayProperty* dp) {
+    const size_t num_atoms = state->mold.mol.atom.count;
+    md_array_resize(rep->prop.atom_structure, num_atoms, persistent_alloc);
+    MEMSET(rep->prop.atom_structure, 0xFF, num_atoms * sizeof(int32_t));
+
+    md_script_vis_ctx_t ctx = {
+        .ir   = state->script.eval_ir,
+        .mol  = &state->mold.mol,
+        .traj = state->mold.traj,
+    };
+
+    // A single valued property maps to all of its atoms
+    const int num_structures = dp->dim;
+    for (int i = 0; i < num_structures; ++i) {
+        md_vm_arena_temp_t tmp = md_vm_arena_temp_begin(frame_alloc);
+        md_script_vis_t vis = {0};
+        md_script_vis_init(&vis, frame_alloc);
+        if (md_script_vis_eval_payload(&vis, dp->vis_payload, num_structures > 1 ? i : -1, &ctx, MD_SCRIPT_VISUALIZE_ATOMS)) {
+            md_bitfield_iter_t it = md_bitfield_iter_create(&vis.atom_mask);
+            while (md_bitfield_iter_next(&it)) {
+                const uint64_t idx = md_bitfield_iter_idx(&it);
+                if (idx < num_atoms) rep->prop.atom_structure[idx] = i;
+            }
+        }
+        md_script_vis_free(&vis);
+        md_vm_arena_temp_end(tmp);
+    }
+}
+
+// Collects the result of a completed evaluation and launches a new one if the frame or the parameters have changed
+static void update_representation_property(ApplicationState* state, Representation* rep) {
+    if (rep->prop.job) {
+        if (!property_color_job_done(rep->prop.job)) {
+            return;
+        }
+        if (rep->prop.job->num_atoms == md_array_size(rep->prop.atom_scalar)) {
+            MEMCPY(rep->prop.atom_scalar, rep->prop.job->atom_scalar, rep->prop.job->num_atoms * sizeof(uint8_t));
+            rep->prop.scalar_hash = rep->prop.job->hash;
+        }
+        property_color_job_wait_and_free(rep->prop.job);
+        rep->prop.job = 0;
+    }
+
+    const DisplayProperty* dp = find_representation_property(state, rep);
+    if (!dp || !dp->y_values || dp->num_samples == 0 || dp->dim <= 0) {
+        rep->prop.scalar_hash = 0;
+        return;
+    }
+
+    const size_t num_atoms = state->mold.mol.atom.count;
+    uint64_t structure_hash = md_script_ir_fingerprint(state->script.eval_ir);
+    structure_hash = md_hash64(rep->prop.ident, strnlen(rep->prop.ident, sizeof(rep->prop.ident)), structure_hash);
+    structure_hash = md_hash64(&num_atoms, sizeof(num_atoms), structure_hash);
+    if (structure_hash != rep->prop.structure_hash || md_array_size(rep->prop.atom_structure) != num_atoms) {
+        update_representation_property_structures(state, rep, dp);
+        rep->prop.structure_hash = structure_hash;
+        md_array_resize(rep->prop.atom_scalar, num_atoms, persistent_alloc);
+        rep->prop.scalar_hash = 0;
+    }
+
+    const uint64_t fingerprint = dp->prop_data ? dp->prop_data->fingerprint : 0;
+    uint64_t scalar_hash = md_hash64(&structure_hash, sizeof(structure_hash), 0);
+    scalar_hash = md_hash64(&fingerprint, sizeof(fingerprint), scalar_hash);
+    scalar_hash = md_hash64(&state->animation.frame, sizeof(state->animation.frame), scalar_hash);
+    scalar_hash = md_hash64(&rep->prop.map_beg, sizeof(rep->prop.map_beg), scalar_hash);
+    scalar_hash = md_hash64(&rep->prop.map_end, sizeof(rep->prop.map_end), scalar_hash);
+
+    if (scalar_hash != rep->prop.scalar_hash) {
+        rep->prop.job = launch_property_color_job(dp->y_values, dp->dim, dp->num_samples, state->animation.frame, rep->prop.map_beg, rep->prop.map_end,
+            rep->prop.atom_structure, num_atoms, scalar_hash);
     }
 }
 
@@ -8043,17 +11308,36 @@ static void update_representation(ApplicationState* state, Representation* rep)
     md_vm_arena_temp_t tmp = md_vm_arena_temp_begin(frame_alloc);
     defer { md_vm_arena_temp_end(tmp); };
 
-    const size_t bytes = state->mold.mol.atom.count * sizeof(uint32_t);
-    uint32_t* colors = (uint32_t*)md_vm_arena_push(frame_alloc, bytes);
-
     const auto& mol = state->mold.mol;
+    const size_t bytes = mol.atom.count * sizeof(uint32_t);
+
+    // The cached colors are (re)allocated when the number of atoms changes, which requires everything to be recomputed
+    if (md_array_size(rep->colors) != mol.atom.count) {
+        md_array_resize(rep->colors, mol.atom.count, persistent_alloc);
+        rep->color_is_dirty = true;
+        rep->filt_is_dirty = true;
+    }
+    // Nothing has been uploaded until the uploaded colors match the number of atoms
+    const bool upload_all = md_array_size(rep->uploaded_colors) != mol.atom.count;
 
-    //md_script_property_t prop = {0};
-    //if (rep->color_mapping == ColorMapping::Property) {
-        //rep->prop_is_valid = md_script_compile_and_eval_property(&prop, rep->prop, &data->mold.mol, frame_allocator, &data->script.ir, rep->prop_error.beg(), rep->prop_error.capacity());
-    //}
+    // Parameters which the colors depend on, the colors of secondary structures change with the frame
+    uint64_t color_hash = md_hash64(&rep->color_mapping, sizeof(rep->color_mapping), 0);
+    color_hash = md_hash64(&rep->uniform_color, sizeof(rep->uniform_color), color_hash);
+    color_hash = md_hash64(&rep->saturation, sizeof(rep->saturation), color_hash);
+    if (rep->color_mapping == ColorMapping::SecondaryStructure) {
+        color_hash = md_hash64(&state->animation.frame, sizeof(state->animation.frame), color_hash);
+    }
+    if (rep->color_mapping == ColorMapping::Property) {
+        // The colors change once the evaluation of the property for the current frame is available
+        update_representation_property(state, rep);
+        color_hash = md_hash64(&rep->prop.scalar_hash, sizeof(rep->prop.scalar_hash), color_hash);
+        color_hash = md_hash64(&rep->prop.color_map, sizeof(rep->prop.color_map), color_hash);
+    }
 
-    switch (rep->color_mapping) {
+    const bool color_changed = rep->color_is_dirty || color_hash != rep->color_hash;
+    uint32_t* colors = rep->colors;
+
+    if (color_changed) switch (rep->color_mapping) {
         case ColorMapping::Uniform:
             color_atoms_uniform(colors, mol.atom.count, rep->uniform_color);
             break;
@@ -8082,68 +11366,30 @@ static void update_representation(ApplicationState* state, Representation* rep)
             color_atoms_sec_str(colors, mol.atom.count, mol);
             break;
         case ColorMapping::Property:
-            // @TODO: Map colors accordingly
-            //color_atoms_uniform(colors, mol.atom.count, rep->uniform_color);
-#if 0
-            if (rep->prop) {
-                MEMSET(colors, 0xFFFFFFFF, bytes);
-                md_script_pro
-                const float* values = rep->prop->data.values;
-                if (rep->prop->data.aggregate) {
-                    const int dim = rep->prop->data.dim[0];
-                    md_script_vis_t vis = {0};
-                    bool result = false;
-                    
-                    //if (md_semaphore_aquire(&data->script.ir_semaphore)) {
-                    //    defer { md_semaphore_release(&data->script.ir_semaphore); };
-                        
-                        if (md_script_ir_valid(state->script.eval_ir)) {
-                            md_script_vis_init(&vis, frame_alloc);
-                            md_script_vis_ctx_t ctx = {
-                                .ir = state->script.eval_ir,
-                                .mol = &state->mold.mol,
-                                .traj = state->mold.traj,
-                            };
-                            result = md_script_vis_eval_payload(&vis, rep->prop->vis_payload, 0, &ctx, MD_SCRIPT_VISUALIZE_ATOMS);
-                        }
-                    //}
-                    if (result) {
-                        if (dim == (int)md_array_size(vis.structure)) {
-                            int i0 = CLAMP((int)state->animation.frame + 0, 0, (int)rep->prop->data.num_values / dim - 1);
-                            int i1 = CLAMP((int)state->animation.frame + 1, 0, (int)rep->prop->data.num_values / dim - 1);
-                            float frame_fract = fractf((float)state->animation.frame);
-
-                            md_bitfield_t mask = {0};
-                            md_bitfield_init(&mask, frame_alloc);
-                            for (int i = 0; i < dim; ++i) {
-                                md_bitfield_and(&mask, &rep->atom_mask, &vis.structure[i]);
-                                float value = lerpf(values[i0 * dim + i], values[i1 * dim + i], frame_fract);
-                                float t = CLAMP((value - rep->map_beg) / (rep->map_end - rep->map_beg), 0, 1);
-                                ImVec4 color = ImPlot::SampleColormap(t, rep->color_map);
-                                color_atoms_uniform(colors, mol.atom.count, vec_cast(color), &mask);
-                            }
-                        }
-                    }
-                } else {
-                    int i0 = CLAMP((int)state->animation.frame + 0, 0, (int)rep->prop->data.num_values - 1);
-                    int i1 = CLAMP((int)state->animation.frame + 1, 0, (int)rep->prop->data.num_values - 1);
-                    float value = lerpf(values[i0], values[i1], fractf((float)state->animation.frame));
-                    float t = CLAMP((value - rep->map_beg) / (rep->map_end - rep->map_beg), 0, 1);
-                    ImVec4 color = ImPlot::SampleColormap(t, rep->color_map);
-                    color_atoms_uniform(colors, mol.atom.count, vec_cast(color));
-                }
+            if (rep->prop.scalar_hash && md_array_size(rep->prop.atom_scalar) == mol.atom.count) {
+                // Atoms which are not part of the property are given the uniform color
+                uint32_t table[256];
+                for (int i = 0; i < PROPERTY_SCALAR_NONE; ++i) {
+                    const float t = (float)i / (float)(PROPERTY_SCALAR_NONE - 1);
+                    table[i] = convert_color(vec_cast(ImPlot::SampleColormap(t, rep->prop.color_map)));
+                }
+                table[PROPERTY_SCALAR_NONE] = convert_color(rep->uniform_color);
+                color_atoms_scalar(colors, mol.atom.count, rep->prop.atom_scalar, table);
             } else {
                 color_atoms_uniform(colors, mol.atom.count, rep->uniform_color);
             }
-#endif
             break;
         default:
             ASSERT(false);
             break;
     }
 
-    if (rep->saturation != 1.0f) {
-        scale_saturation(colors, mol.atom.count, rep->saturation);
+    if (color_changed) {
+        if (rep->saturation != 1.0f) {
+            scale_saturation(colors, mol.atom.count, rep->saturation);
+        }
+        rep->color_hash = color_hash;
+        rep->color_is_dirty = false;
     }
 
     switch (rep->type) {
@@ -8174,6 +11420,7 @@ static void update_representation(ApplicationState* state, Representation* rep)
                     .orbital_idx = rep->orbital.orbital_idx,
                     .samples_per_angstrom = samples_per_angstrom[(int)rep->orbital.vol.resolution],
                     .dst_texture = &rep->orbital.vol.vol_tex,
+                    .dst_macro_cell_texture = &rep->orbital.vol.macro_cell_tex,
                 };
                 viamd::event_system_broadcast_event(viamd::EventType_RepresentationComputeOrbital, viamd::EventPayloadType_ComputeOrbital, &data);
 
@@ -8203,15 +11450,24 @@ static void update_representation(ApplicationState* state, Representation* rep)
         rep->filt_is_dirty = true;
     }
 
+    bool mask_changed = false;
     if (rep->filt_is_dirty) {
         rep->filt_is_valid = filter_expression(state, str_from_cstr(rep->filt), &rep->atom_mask, &rep->filt_is_dynamic, rep->filt_error, sizeof(rep->filt_error));
         rep->filt_is_dirty = false;
+        const uint64_t mask_hash = md_bitfield_hash64(&rep->atom_mask, 0);
+        mask_changed = mask_hash != rep->mask_hash;
+        rep->mask_hash = mask_hash;
     }
 
-    if (rep->filt_is_valid) {
-        filter_colors(colors, mol.atom.count, &rep->atom_mask);
-        state->representation.atom_visibility_mask_dirty = true;
-        md_gl_rep_set_color(rep->md_rep, 0, (uint32_t)mol.atom.count, colors, 0);
+    if (rep->filt_is_valid && (color_changed || mask_changed || upload_all)) {
+        uint32_t* filt_colors = (uint32_t*)md_vm_arena_push(frame_alloc, bytes);
+        MEMCPY(filt_colors, colors, bytes);
+        filter_colors(filt_colors, mol.atom.count, &rep->atom_mask);
+        if (mask_changed || upload_all) {
+            state->representation.atom_visibility_mask_dirty = true;
+        }
+        upload_representation_colors(rep, filt_colors, mol.atom.count, upload_all);
+        colors = filt_colors;
 
 #if EXPERIMENTAL_GFX_API
         md_gfx_rep_attr_t attributes = {};
@@ -8229,6 +11485,12 @@ static void init_representation(ApplicationState* state, Representation* rep) {
     rep->md_rep = md_gl_rep_create(state->mold.gl_mol);
     md_bitfield_init(&rep->atom_mask, persistent_alloc);
     rep->filt_is_dirty = true;
+    // A new rep has no colors uploaded, which is handled by reallocating the cached arrays
+    md_array_free(rep->colors, persistent_alloc);
+    md_array_free(rep->uploaded_colors, persistent_alloc);
+    rep->colors = 0;
+    rep->uploaded_colors = 0;
+    free_representation_property(rep);
 }
 
 static void update_representation_info(ApplicationState* state) {
@@ -8466,7 +11728,24 @@ static void handle_camera_interaction(ApplicationState* data) {
                 md_bitfield_t mask = { 0 };
                 md_bitfield_init(&mask, frame_alloc);
 
-                if (min_p != max_p) {
+                if (min_p != max_p && !data->selection.region.include_occluded) {
+                    data->selection.selecting = true;
+
+                    // The result arrives a few frames later, the highlight is updated once it is available
+                    // The region is given in G-buffer coordinates, which may be scaled relative to the framebuffer
+                    ImVec2 scl = ImGui::GetIO().DisplayFramebufferScale;
+                    if (data->app.framebuffer.width > 0 && data->app.framebuffer.height > 0) {
+                        scl.x *= (float)data->gbuffer.width  / (float)data->app.framebuffer.width;
+                        scl.y *= (float)data->gbuffer.height / (float)data->app.framebuffer.height;
+                    }
+                    const int x0 = (int)(min_p.x * scl.x);
+                    const int x1 = (int)(max_p.x * scl.x);
+                    const int y0 = (int)data->gbuffer.height - (int)(max_p.y * scl.y);
+                    const int y1 = (int)data->gbuffer.height - (int)(min_p.y * scl.y);
+                    const SelectionOperator op = (mode == RegionMode::Append) ? SelectionOperator::Or : SelectionOperator::AndNot;
+                    request_selection_region(data, x0, y0, x1 - x0, y1 - y0, op, pressed || ImGui::IsMouseReleased(0));
+                }
+                else if (min_p != max_p) {
                     md_bitfield_clear(&data->selection.highlight_mask);
                     data->selection.selecting = true;
 
@@ -8858,6 +12137,11 @@ static void handle_picking(ApplicationState* data) {
 #if MD_PLATFORM_OSX
         coord = coord * vec_cast(ImGui::GetIO().DisplayFramebufferScale);
 #endif
+        // The G-buffer may be rendered at a lower resolution than the framebuffer
+        if (data->app.framebuffer.width > 0 && data->app.framebuffer.height > 0) {
+            coord.x *= (float)data->gbuffer.width  / (float)data->app.framebuffer.width;
+            coord.y *= (float)data->gbuffer.height / (float)data->app.framebuffer.height;
+        }
         if (coord.x < 0.f || coord.x >= (float)data->gbuffer.width || coord.y < 0.f || coord.y >= (float)data->gbuffer.height) {
             data->picking.idx = INVALID_PICKING_IDX;
             data->picking.depth = 1.f;
@@ -8907,6 +12191,71 @@ static void handle_picking(ApplicationState* data) {
     }
     POP_CPU_SECTION()
 }
+
+// Requests the atoms which are visible within the region, given in G-buffer coordinates with the origin at the bottom left
+// A single query is in flight, the latest request is issued once it completes
+static void request_selection_region(ApplicationState* data, int x, int y, int width, int height, SelectionOperator op, bool commit) {
+    ASSERT(data);
+    auto& region = data->selection.region;
+    const int rect[4] = {x, y, width, height};
+    if (!commit && op == region.op && memcmp(rect, region.rect, sizeof(rect)) == 0) {
+        return;
+    }
+    MEMCPY(region.rect, rect, sizeof(rect));
+    region.op = op;
+    region.pending = true;
+    region.pending_commit |= commit;
+}
+
+// Completes the query in flight and issues the pending request, has to be called after the G-buffer has been filled
+static void update_selection_region(ApplicationState* data) {
+    ASSERT(data);
+    auto& region = data->selection.region;
+
+    if (region.query && picking::poll_region(region.query)) {
+        picking::RegionQuery* query = region.query;
+        region.latency_ms     = query->latency_ms;
+        region.latency_frames = query->latency_frames;
+
+        grow_mask_by_selection_granularity(&query->atom_mask, data->selection.granularity, data->mold.mol);
+        if (region.commit) {
+            modify_selection(data, &query->atom_mask, region.op);
+            md_bitfield_copy(&data->selection.highlight_mask, &data->selection.selection_mask);
+            // A new drag starts from an empty region
+            MEMSET(region.rect, 0, sizeof(region.rect));
+        } else if (region.op == SelectionOperator::AndNot) {
+            md_bitfield_andnot(&data->selection.highlight_mask, &data->selection.selection_mask, &query->atom_mask);
+        } else {
+            md_bitfield_or(&data->selection.highlight_mask, &data->selection.selection_mask, &query->atom_mask);
+        }
+
+        picking::free_region(query);
+        region.query  = nullptr;
+        region.commit = false;
+    }
+
+    if (!region.query && region.pending) {
+        const md_molecule_t& mol = data->mold.mol;
+        region.query = picking::query_region(&data->gbuffer, region.rect[0], region.rect[1], region.rect[2], region.rect[3], mol.atom.count, mol.bond.pairs, mol.bond.count, persistent_alloc);
+        region.commit = region.pending_commit;
+        region.pending = false;
+        region.pending_commit = false;
+    }
+}
+
+static void free_selection_region(ApplicationState* data) {
+    ASSERT(data);
+    auto& region = data->selection.region;
+    if (region.query) {
+        picking::free_region(region.query);
+        region.query = nullptr;
+    }
+    region.commit = false;
+    region.pending = false;
+    region.pending_commit = false;
+    MEMSET(region.rect, 0, sizeof(region.rect));
+}
+
 static void apply_postprocessing(const ApplicationState& data) {
     PUSH_GPU_SECTION("Postprocessing")
     postprocessing::Descriptor desc;
@@ -8917,6 +12266,7 @@ static void apply_postprocessing(const ApplicationState& data) {
     desc.ambient_occlusion.intensity = data.visuals.ssao.intensity;
     desc.ambient_occlusion.radius = data.visuals.ssao.radius;
     desc.ambient_occlusion.bias = data.visuals.ssao.bias;
+    desc.ambient_occlusion.half_res = data.visuals.dynamic_resolution.ssao_half_res;
 
     desc.tonemapping.enabled = data.visuals.tonemapping.enabled;
     desc.tonemapping.mode = data.visuals.tonemapping.tonemapper;
@@ -8947,6 +12297,9 @@ static void apply_postprocessing(const ApplicationState& data) {
     desc.input_textures.velocity = data.gbuffer.tex.velocity;
     desc.input_textures.transparency = data.gbuffer.tex.transparency;
 
+    desc.input_resolution.width  = (int)data.gbuffer.width;
+    desc.input_resolution.height = (int)data.gbuffer.height;
+
     postprocessing::shade_and_postprocess(desc, data.view.param);
     POP_GPU_SECTION()
 }
@@ -9004,7 +12357,8 @@ static void draw_representations_opaque(ApplicationState* data) {
         const size_t num_representations = md_array_size(data->representation.reps);
         if (num_representations == 0) return;
 
-        md_array(md_gl_draw_op_t) draw_ops = 0;
+        // The impostor representations are drawn for the atoms which remain after culling, the spline based representations are drawn in full
+        md_array(md_gl_draw_op_t) draw_ops[2] = {};
         for (size_t i = 0; i < num_representations; ++i) {
             const Representation& rep = data->representation.reps[i];
 
@@ -9018,26 +12372,32 @@ static void draw_representations_opaque(ApplicationState* data) {
                     .model_matrix = NULL,
                 };
                 MEMCPY(&op.args, &rep.scale, sizeof(op.args));
-                md_array_push(draw_ops, op, frame_alloc);
+                const bool culled = rep.type <= RepresentationType::BallAndStick;
+                md_array_push(draw_ops[culled ? 1 : 0], op, frame_alloc);
             }
         }
 
-        md_gl_draw_args_t args = {
-            .shaders = data->mold.gl_shaders,
-            .draw_operations = {
-                .count = (uint32_t)md_array_size(draw_ops),
-                .ops = draw_ops,
-            },
-            .view_transform = {
-                .view_matrix = &data->view.param.matrix.curr.view.elem[0][0],
-                .proj_matrix = &data->view.param.matrix.curr.proj.elem[0][0],
-                // These two are for temporal anti-aliasing reprojection (optional)
-                .prev_view_matrix = &data->view.param.matrix.prev.view.elem[0][0],
-                .prev_proj_matrix = &data->view.param.matrix.prev.proj.elem[0][0],
-            },
-        };
+        for (int i = 0; i < 2; ++i) {
+            if (md_array_size(draw_ops[i]) == 0) continue;
 
-        md_gl_draw(&args);
+            md_gl_draw_args_t args = {
+                .shaders = data->mold.gl_shaders,
+                .draw_operations = {
+                    .count = (uint32_t)md_array_size(draw_ops[i]),
+                    .ops = draw_ops[i],
+                },
+                .view_transform = {
+                    .view_matrix = &data->view.param.matrix.curr.view.elem[0][0],
+                    .proj_matrix = &data->view.param.matrix.curr.proj.elem[0][0],
+                    // These two are for temporal anti-aliasing reprojection (optional)
+                    .prev_view_matrix = &data->view.param.matrix.prev.view.elem[0][0],
+                    .prev_proj_matrix = &data->view.param.matrix.prev.proj.elem[0][0],
+                },
+                .atom_mask = (i == 1 && data->visuals.culling.enabled) ? (uint32_t)AtomBit_InView : 0U,
+            };
+
+            md_gl_draw(&args);
+        }
 #if EXPERIMENTAL_GFX_API
     }
 #endif
@@ -9065,6 +12425,7 @@ static void draw_representations_transparent(ApplicationState* state) {
             .texture = {
                 .volume = rep.orbital.vol.vol_tex,
                 .transfer_function = rep.orbital.vol.dvr.tf_tex,
+                .macro_cells = rep.orbital.vol.macro_cell_tex,
             },
             .matrix = {
                 .model = rep.orbital.vol.tex_mat,
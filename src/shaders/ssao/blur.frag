@@ -7,6 +7,7 @@ const float KERNEL_RADIUS = 3;
 uniform float u_sharpness;
 uniform float u_zmax;
 uniform vec2  u_inv_res_dir; // either set x to 1/width or y to 1/height
+uniform vec2  u_depth_tc_scl = vec2(1,1); // the linear depth texture may be larger than the ao texture
 uniform sampler2D u_tex_ao;
 uniform sampler2D u_tex_linear_depth;
 
@@ -16,7 +17,7 @@ out vec4 out_frag;
 float blur_function(vec2 uv, float r, float center_c, float center_d, inout float w_total)
 {
     float c = texture(u_tex_ao, uv).x;
-    float d = texture(u_tex_linear_depth, uv).x;
+    float d = texture(u_tex_linear_depth, uv * u_depth_tc_scl).x;
 
     const float sigma = KERNEL_RADIUS * 0.5;
     const float falloff = 1.0 / (2.0*sigma*sigma);
@@ -30,7 +31,7 @@ float blur_function(vec2 uv, float r, float center_c, float center_d, inout floa
 
 void main()
 {
-    float center_d = texture(u_tex_linear_depth, tc).x;
+    float center_d = texture(u_tex_linear_depth, tc * u_depth_tc_scl).x;
     if (center_d > u_zmax) discard;
 
     float center_c = texture(u_tex_ao, tc).x;
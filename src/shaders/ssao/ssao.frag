@@ -14,6 +14,11 @@
 #define AO_NUM_SAMPLES 16
 #endif
 
+// The AO is computed at half the resolution of the depth and normal textures
+#ifndef AO_HALF_RES
+#define AO_HALF_RES 0
+#endif
+
 struct HBAOData {
     float   radius_to_screen;
     float   neg_inv_r2;
@@ -36,6 +41,7 @@ layout(std140) uniform u_control_buffer {
 uniform sampler2D u_tex_linear_depth;
 uniform sampler2D u_tex_normal;
 uniform sampler2D u_tex_random;
+uniform vec2 u_depth_tc_scl = vec2(1,1); // the linear depth texture may be larger than the viewport
 
 in vec2 tc;
 out vec4 out_frag;
@@ -77,7 +83,7 @@ vec3 uv_to_view(vec2 uv, float eye_z) {
 }
 
 vec3 fetch_view_pos(vec2 uv, float lod) {
-    float view_depth = textureLod(u_tex_linear_depth, uv, lod).x;
+    float view_depth = textureLod(u_tex_linear_depth, uv * u_depth_tc_scl, lod).x;
     return uv_to_view(uv, view_depth);
 }
 
@@ -91,8 +97,16 @@ vec3 decode_normal(vec2 enc) {
     return n;
 }
 
+ivec2 full_res_coord() {
+#if AO_HALF_RES
+    return ivec2(gl_FragCoord.xy) * 2;
+#else
+    return ivec2(gl_FragCoord.xy);
+#endif
+}
+
 vec3 fetch_view_normal(vec2 uv) {
-    vec2 enc = texelFetch(u_tex_normal, ivec2(gl_FragCoord.xy), 0).xy;
+    vec2 enc = texelFetch(u_tex_normal, full_res_coord(), 0).xy;
     //vec2 enc = textureLod(u_tex_normal, uv, 0).xy;
     vec3 n = decode_normal(enc);
     return n * vec3(1,1,-1);
@@ -136,6 +150,10 @@ vec4 get_jitter(vec2 uv) {
 float compute_ao(vec2 full_res_uv, float radius_pixels, vec4 jitter, vec3 view_position, vec3 view_normal) {
     const float global_mip_offset = -4.3; // -4.3 is recomended in the intel ASSAO implementation
     float mip_offset = log2(radius_pixels) + global_mip_offset;
+#if AO_HALF_RES
+    // The radius is given in half resolution pixels and the depth mips start at full resolution
+    mip_offset += 1.0;
+#endif
 
     float weight_sum = 0.0;
     float ao = 0.0;
@@ -169,7 +187,7 @@ float compute_ao(vec2 full_res_uv, float radius_pixels, vec4 jitter, vec3 view_p
 
 //----------------------------------------------------------------------------------
 void main() {
-    float view_z = texelFetch(u_tex_linear_depth, ivec2(gl_FragCoord.xy), 0).x;
+    float view_z = texelFetch(u_tex_linear_depth, full_res_coord(), 0).x;
     if (view_z > control.z_max) discard;
 
     vec2 uv = tc;
@@ -47,6 +47,24 @@ uniform sampler2D u_tex_exit;
 uniform sampler3D u_tex_volume;
 uniform sampler2D u_tex_tf;
 
+#if defined(BRICKED)
+// The volume is stored as bricks within an atlas (u_tex_volume), each brick is padded with a one voxel apron to support filtering.
+// The index holds the location of each brick within the atlas (in bricks), the alpha component is zero for empty bricks.
+#define BRICK_DIM 8.0
+#define PADDED_BRICK_DIM 10.0
+uniform usampler3D u_tex_brick_index;
+uniform vec3 u_volume_dim;
+uniform vec3 u_inv_atlas_dim;
+#endif
+
+// Conservative (min, max) range of the values within each macro cell, used to skip cells which cannot contribute
+#define MACRO_CELL_DIM 8.0
+uniform sampler3D u_tex_macro_cells;
+uniform bool u_macro_cells_enabled;
+
+// The step length grows with the accumulated opacity up to this scale
+uniform float u_max_step_scale = 1.0;
+
 layout(location = 0) out vec4  out_color;
 //layout(location = 1) out vec2  out_view_normal;
 //out float gl_FragDepth;
@@ -55,15 +73,81 @@ const float REF_SAMPLING_RATE = 150.0;
 const float ERT_THRESHOLD = 0.995;
 const float samplingRate = 2.0;
 
+#if defined(BRICKED)
+vec3 volumeDim() {
+    return u_volume_dim;
+}
+
+float getVoxel(in vec3 samplePos) {
+    vec3  voxel = clamp(samplePos, 0.0, 1.0) * u_volume_dim;
+    ivec3 brick = clamp(ivec3(floor(voxel / BRICK_DIM)), ivec3(0), textureSize(u_tex_brick_index, 0) - 1);
+    uvec4 entry = texelFetch(u_tex_brick_index, brick, 0);
+    if (entry.a == 0U) return 0.0;
+    vec3 local = voxel - vec3(brick) * BRICK_DIM;
+    vec3 atlas = vec3(entry.xyz) * PADDED_BRICK_DIM + 1.0 + local;
+    return texture(u_tex_volume, atlas * u_inv_atlas_dim).r;
+}
+#else
+vec3 volumeDim() {
+    return vec3(textureSize(u_tex_volume, 0));
+}
+
 float getVoxel(in vec3 samplePos) {
     return texture(u_tex_volume, samplePos).r;
 }
+#endif
 
 vec4 classify(in float density) {
     float t = clamp((density - u_tf_min) * u_tf_inv_ext, 0.0, 1.0);
     return texture(u_tex_tf, vec2(t, 0.5));
 }
 
+ivec3 cellCoord(in vec3 samplePos, in float cellDim, in ivec3 cellCount) {
+    return clamp(ivec3(floor(samplePos * volumeDim() / cellDim)), ivec3(0), cellCount - 1);
+}
+
+// Distance along the ray to the exit of the cell
+float cellExitDistance(in vec3 samplePos, in vec3 dir, in ivec3 cell, in float cellDim) {
+    vec3 cell_min = vec3(cell) * cellDim / volumeDim();
+    vec3 cell_max = cell_min + cellDim / volumeDim();
+    vec3 safe_dir = mix(vec3(1.0e-8), dir, greaterThan(abs(dir), vec3(1.0e-8)));
+    vec3 t = (mix(cell_min, cell_max, step(0.0, safe_dir)) - samplePos) / safe_dir;
+    return max(0.0, min(t.x, min(t.y, t.z)));
+}
+
+// A range of values is empty if no value within it contributes to the result
+bool rangeIsEmpty(in vec2 range) {
+    bool empty = true;
+#if defined(INCLUDE_DVR)
+    // All values map to the lower end of the transfer function, which has to be transparent
+    empty = empty && range.y <= u_tf_min && classify(range.y).a == 0.0;
+#endif
+#if defined(INCLUDE_ISO)
+    for (int i = 0; i < u_iso.count; ++i) {
+        empty = empty && (u_iso.values[i] < range.x || range.y < u_iso.values[i]);
+    }
+#endif
+    return empty;
+}
+
+// Returns the distance along the ray which can be skipped from the sample position, zero if the sample lies within a non-empty region
+float emptySpaceDistance(in vec3 samplePos, in vec3 dir) {
+#if defined(BRICKED)
+    // Samples within empty bricks are zero
+    ivec3 brick = cellCoord(samplePos, BRICK_DIM, textureSize(u_tex_brick_index, 0));
+    if (texelFetch(u_tex_brick_index, brick, 0).a == 0U && rangeIsEmpty(vec2(0.0))) {
+        return cellExitDistance(samplePos, dir, brick, BRICK_DIM);
+    }
+#endif
+    if (u_macro_cells_enabled) {
+        ivec3 cell = cellCoord(samplePos, MACRO_CELL_DIM, textureSize(u_tex_macro_cells, 0));
+        if (rangeIsEmpty(texelFetch(u_tex_macro_cells, cell, 0).rg)) {
+            return cellExitDistance(samplePos, dir, cell, MACRO_CELL_DIM);
+        }
+    }
+    return 0.0;
+}
+
 vec4 compositing(in vec4 dstColor, in vec4 srcColor, in float tIncr) {
     srcColor.a = 1.0 - pow(1.0 - srcColor.a, tIncr * REF_SAMPLING_RATE);
     // pre-multiplied alpha
@@ -353,7 +437,7 @@ void main() {
 
     float jitter = PDnrand(gl_FragCoord.xy + vec2(u_time, u_time));
 
-    float tIncr = min(tEnd, tEnd / (samplingRate * length(dir * tEnd * textureSize(u_tex_volume, 0))));
+    float tIncr = min(tEnd, tEnd / (samplingRate * length(dir * tEnd * volumeDim())));
     float samples = ceil(tEnd / tIncr);
     float baseIncr = tEnd / samples;
 
@@ -368,6 +452,7 @@ void main() {
 
     while (t < tEnd) {
         samplePos = entryPos + t * dir;
+
         float prevDensity = density;
         density = getVoxel(samplePos);
 
@@ -386,7 +471,16 @@ void main() {
             t = tEnd;
         } else {
             // make sure that tIncr has the correct length since drawIsoSurface will modify it
-            tIncr = baseIncr;
+            // The remaining contribution is attenuated by the accumulated opacity, which allows for longer steps
+            tIncr = baseIncr * clamp(1.0 / (1.0 - result.a), 1.0, u_max_step_scale);
+
+            // Samples within empty space do not contribute, these are skipped up to the last sample before the exit of the empty region,
+            // which is sampled to detect isosurface crossings to the following sample as if no samples had been skipped
+            float skip = emptySpaceDistance(samplePos, dir);
+            if (skip > tIncr) {
+                t += (ceil(skip / tIncr) - 1.0) * tIncr;
+                density = getVoxel(entryPos + t * dir);
+            }
             t += tIncr;
         }
     }
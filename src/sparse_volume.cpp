@@ -0,0 +1,194 @@
+#include <sparse_volume.h>
+
+#include <core/md_common.h>
+#include <core/md_allocator.h>
+
+#include <math.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace viamd {
+
+static inline uint32_t popcount64(uint64_t x) {
+#if defined(_MSC_VER)
+    return (uint32_t)__popcnt64(x);
+#else
+    return (uint32_t)__builtin_popcountll(x);
+#endif
+}
+
+static inline size_t brick_count_total(const int brick_count[3]) {
+    return (size_t)brick_count[0] * brick_count[1] * brick_count[2];
+}
+
+static inline size_t linear_brick_idx(const sparse_volume_t* vol, int bx, int by, int bz) {
+    return ((size_t)bz * vol->brick_count[1] + by) * vol->brick_count[0] + bx;
+}
+
+// Calls func(voxel_idx, local_idx) for all voxels of the brick which lie within the volume
+template <typename Func>
+static inline void for_each_brick_voxel(const int dim[3], int bx, int by, int bz, Func func) {
+    const int x0 = bx * SPARSE_VOLUME_BRICK_DIM;
+    const int y0 = by * SPARSE_VOLUME_BRICK_DIM;
+    const int z0 = bz * SPARSE_VOLUME_BRICK_DIM;
+    const int x1 = MIN(x0 + SPARSE_VOLUME_BRICK_DIM, dim[0]);
+    const int y1 = MIN(y0 + SPARSE_VOLUME_BRICK_DIM, dim[1]);
+    const int z1 = MIN(z0 + SPARSE_VOLUME_BRICK_DIM, dim[2]);
+    for (int z = z0; z < z1; ++z) {
+        for (int y = y0; y < y1; ++y) {
+            const size_t src = ((size_t)z * dim[1] + y) * dim[0];
+            const size_t dst = ((size_t)(z - z0) * SPARSE_VOLUME_BRICK_DIM + (y - y0)) * SPARSE_VOLUME_BRICK_DIM;
+            for (int x = x0; x < x1; ++x) {
+                func(src + x, dst + (x - x0));
+            }
+        }
+    }
+}
+
+static bool brick_is_occupied(const float* values, const int dim[3], int bx, int by, int bz, float threshold) {
+    bool occupied = false;
+    for_each_brick_voxel(dim, bx, by, bz, [&](size_t src, size_t) {
+        occupied |= fabsf(values[src]) > threshold;
+    });
+    return occupied;
+}
+
+static void update_rank(sparse_volume_t* vol) {
+    const size_t num_words = md_array_size(vol->occupancy);
+    md_array_resize(vol->rank, num_words, vol->alloc);
+    uint32_t count = 0;
+    for (size_t i = 0; i < num_words; ++i) {
+        vol->rank[i] = count;
+        count += popcount64(vol->occupancy[i]);
+    }
+}
+
+// Allocates the bricks given by the occupancy, the contents of previously occupied bricks are preserved
+static void reallocate_bricks(sparse_volume_t* vol, const md_array(uint64_t) new_occupancy) {
+    const size_t num_bricks = brick_count_total(vol->brick_count);
+    const size_t num_words  = md_array_size(new_occupancy);
+
+    size_t num_occupied = 0;
+    for (size_t i = 0; i < num_words; ++i) {
+        num_occupied += popcount64(new_occupancy[i]);
+    }
+
+    md_array(float) bricks = md_array_create(float, num_occupied * SPARSE_VOLUME_BRICK_SIZE, vol->alloc);
+    MEMSET(bricks, 0, md_array_bytes(bricks));
+
+    size_t dst_slot = 0;
+    for (size_t i = 0; i < num_bricks; ++i) {
+        const uint64_t bit = 1ULL << (i & 63);
+        if (!(new_occupancy[i >> 6] & bit)) continue;
+        if (vol->occupancy && (vol->occupancy[i >> 6] & bit)) {
+            const size_t src_slot = vol->rank[i >> 6] + popcount64(vol->occupancy[i >> 6] & (bit - 1));
+            MEMCPY(bricks + dst_slot * SPARSE_VOLUME_BRICK_SIZE, vol->bricks + src_slot * SPARSE_VOLUME_BRICK_SIZE, SPARSE_VOLUME_BRICK_SIZE * sizeof(float));
+        }
+        dst_slot += 1;
+    }
+
+    md_array_free(vol->bricks, vol->alloc);
+    vol->bricks = bricks;
+
+    md_array_resize(vol->occupancy, num_words, vol->alloc);
+    MEMCPY(vol->occupancy, new_occupancy, num_words * sizeof(uint64_t));
+    update_rank(vol);
+}
+
+bool sparse_volume_init_from_dense(sparse_volume_t* vol, const float* values, const int dim[3], float threshold, md_allocator_i* alloc) {
+    ASSERT(vol);
+    ASSERT(alloc);
+
+    if (!values || !dim || dim[0] <= 0 || dim[1] <= 0 || dim[2] <= 0) {
+        return false;
+    }
+
+    sparse_volume_free(vol);
+    vol->alloc = alloc;
+    for (int i = 0; i < 3; ++i) {
+        vol->dim[i] = dim[i];
+        vol->brick_count[i] = (dim[i] + SPARSE_VOLUME_BRICK_DIM - 1) / SPARSE_VOLUME_BRICK_DIM;
+    }
+
+    sparse_volume_accumulate(vol, values, threshold);
+    return true;
+}
+
+void sparse_volume_free(sparse_volume_t* vol) {
+    ASSERT(vol);
+    if (vol->alloc) {
+        md_array_free(vol->occupancy, vol->alloc);
+        md_array_free(vol->rank, vol->alloc);
+        md_array_free(vol->bricks, vol->alloc);
+    }
+    MEMSET(vol, 0, sizeof(sparse_volume_t));
+}
+
+void sparse_volume_accumulate(sparse_volume_t* vol, const float* values, float threshold) {
+    ASSERT(vol);
+    ASSERT(vol->alloc);
+    ASSERT(values);
+
+    const size_t num_bricks = brick_count_total(vol->brick_count);
+    const size_t num_words  = (num_bricks + 63) / 64;
+
+    // Determine which bricks are touched by the source, these are added to the occupancy
+    md_array(uint64_t) occupancy = md_array_create(uint64_t, num_words, vol->alloc);
+    defer { md_array_free(occupancy, vol->alloc); };
+    MEMSET(occupancy, 0, num_words * sizeof(uint64_t));
+
+    bool grow = false;
+    for (int bz = 0; bz < vol->brick_count[2]; ++bz) {
+        for (int by = 0; by < vol->brick_count[1]; ++by) {
+            for (int bx = 0; bx < vol->brick_count[0]; ++bx) {
+                const size_t i = linear_brick_idx(vol, bx, by, bz);
+                const uint64_t bit = 1ULL << (i & 63);
+                const bool prev = vol->occupancy && (vol->occupancy[i >> 6] & bit);
+                if (prev || brick_is_occupied(values, vol->dim, bx, by, bz, threshold)) {
+                    occupancy[i >> 6] |= bit;
+                    grow |= !prev;
+                }
+            }
+        }
+    }
+
+    if (grow || !vol->occupancy) {
+        reallocate_bricks(vol, occupancy);
+    }
+
+    // Accumulate into the occupied bricks
+    for (int bz = 0; bz < vol->brick_count[2]; ++bz) {
+        for (int by = 0; by < vol->brick_count[1]; ++by) {
+            for (int bx = 0; bx < vol->brick_count[0]; ++bx) {
+                const uint32_t slot = sparse_volume_brick_index(vol, bx, by, bz);
+                if (slot == UINT32_MAX) continue;
+                float* brick = vol->bricks + (size_t)slot * SPARSE_VOLUME_BRICK_SIZE;
+                for_each_brick_voxel(vol->dim, bx, by, bz, [&](size_t src, size_t dst) {
+                    brick[dst] += values[src];
+                });
+            }
+        }
+    }
+}
+
+size_t sparse_volume_num_occupied_bricks(const sparse_volume_t* vol) {
+    ASSERT(vol);
+    return md_array_size(vol->bricks) / SPARSE_VOLUME_BRICK_SIZE;
+}
+
+uint32_t sparse_volume_brick_index(const sparse_volume_t* vol, int bx, int by, int bz) {
+    ASSERT(vol);
+    if (!vol->occupancy) return UINT32_MAX;
+    if (bx < 0 || by < 0 || bz < 0 || bx >= vol->brick_count[0] || by >= vol->brick_count[1] || bz >= vol->brick_count[2]) {
+        return UINT32_MAX;
+    }
+    const size_t i = linear_brick_idx(vol, bx, by, bz);
+    const uint64_t word = vol->occupancy[i >> 6];
+    const uint64_t bit  = 1ULL << (i & 63);
+    if (!(word & bit)) return UINT32_MAX;
+    return vol->rank[i >> 6] + popcount64(word & (bit - 1));
+}
+
+}  // namespace viamd
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <core/md_array.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct md_allocator_i;
+
+// Sparse volume which stores the voxels in bricks of 8x8x8, only bricks which contain values are stored.
+// The occupancy of the bricks is kept as a bitmap (one bit per brick, x fastest varying), and the storage index of an
+// occupied brick is given by the rank of its bit within the bitmap, which is accelerated by a prefix count per word.
+// Voxels which lie within unoccupied bricks are implicitly zero.
+
+#define SPARSE_VOLUME_BRICK_DIM 8
+#define SPARSE_VOLUME_BRICK_SIZE (SPARSE_VOLUME_BRICK_DIM * SPARSE_VOLUME_BRICK_DIM * SPARSE_VOLUME_BRICK_DIM)
+
+namespace viamd {
+
+struct sparse_volume_t {
+    int dim[3];
+    int brick_count[3];
+
+    md_array(uint64_t) occupancy;   // [ceil(num_bricks / 64)]
+    md_array(uint32_t) rank;        // [ceil(num_bricks / 64)] number of occupied bricks preceding each word of the bitmap
+    md_array(float)    bricks;      // [num_occupied * SPARSE_VOLUME_BRICK_SIZE] voxels of the occupied bricks, x fastest varying within the brick
+
+    md_allocator_i* alloc;
+};
+
+// Builds a sparse volume from dense values (x fastest varying).
+// Bricks where all values have an absolute value less than or equal to the threshold are considered empty and are not stored.
+// A threshold of zero is lossless.
+bool sparse_volume_init_from_dense(sparse_volume_t* vol, const float* values, const int dim[3], float threshold, md_allocator_i* alloc);
+void sparse_volume_free(sparse_volume_t* vol);
+
+// Accumulates dense values (x fastest varying) into the volume, bricks are allocated as they are touched
+// The dimensions of the source has to match those of the volume
+void sparse_volume_accumulate(sparse_volume_t* vol, const float* values, float threshold);
+
+size_t sparse_volume_num_occupied_bricks(const sparse_volume_t* vol);
+
+// Returns the storage index of the brick, or UINT32_MAX if the brick is not occupied
+uint32_t sparse_volume_brick_index(const sparse_volume_t* vol, int bx, int by, int bz);
+
+}  // namespace viamd
@@ -0,0 +1,280 @@
+#include <spatial_grid.h>
+
+#include <task_system.h>
+
+#include <core/md_common.h>
+#include <core/md_allocator.h>
+#include <core/md_bitfield.h>
+
+#include <math.h>
+#include <float.h>
+#include <new>
+
+// Grids with more cells than this along an axis get larger cells, this bounds the memory of sparse non periodic systems with distant outliers
+#define SPATIAL_GRID_MAX_DIM 1024
+
+#define SPATIAL_GRID_CHUNK_SIZE (16 * 1024)
+#define SPATIAL_GRID_QUERY_CHUNK_SIZE 256
+
+namespace viamd {
+
+static inline float wrap(float v, float ext) {
+    return ext > 0.0f ? v - floorf(v / ext) * ext : v;
+}
+
+static inline int wrap_cell(int c, int dim) {
+    c = c % dim;
+    return c < 0 ? c + dim : c;
+}
+
+static inline bool is_periodic(const spatial_grid_t* grid) {
+    return grid->pbc_ext[0] > 0.0f;
+}
+
+static inline int cell_coord(const spatial_grid_t* grid, float v, int axis) {
+    const int c = (int)((v - grid->origin[axis]) / grid->cell_ext[axis]);
+    return CLAMP(c, 0, grid->dim[axis] - 1);
+}
+
+bool spatial_grid_init(spatial_grid_t* grid, const float* x, const float* y, const float* z, size_t count, float cell_ext, const float pbc_ext[3], md_allocator_i* alloc) {
+    ASSERT(grid);
+    ASSERT(alloc);
+
+    if (!x || !y || !z || count == 0 || count > UINT32_MAX || cell_ext <= 0.0f) {
+        return false;
+    }
+
+    spatial_grid_free(grid);
+    grid->alloc = alloc;
+    grid->num_points = count;
+
+    const float* coords[3] = {x, y, z};
+    const bool periodic = pbc_ext && pbc_ext[0] > 0.0f && pbc_ext[1] > 0.0f && pbc_ext[2] > 0.0f;
+    if (periodic) {
+        for (int i = 0; i < 3; ++i) {
+            grid->dim[i] = CLAMP((int)(pbc_ext[i] / cell_ext), 1, SPATIAL_GRID_MAX_DIM);
+            grid->origin[i] = 0.0f;
+            grid->cell_ext[i] = pbc_ext[i] / grid->dim[i];
+            grid->pbc_ext[i] = pbc_ext[i];
+        }
+    } else {
+        // The bounds are reduced per chunk in parallel
+        const size_t num_chunks = (count + SPATIAL_GRID_CHUNK_SIZE - 1) / SPATIAL_GRID_CHUNK_SIZE;
+        float* chunk_bounds = (float*)md_alloc(alloc, num_chunks * 6 * sizeof(float));
+        defer { md_free(alloc, chunk_bounds, num_chunks * 6 * sizeof(float)); };
+
+        task_system::parallel_for(STR_LIT("##Spatial Grid"), num_chunks, 1, [&](size_t chunk_beg, size_t chunk_end) {
+            for (size_t c = chunk_beg; c < chunk_end; ++c) {
+                const size_t beg = c * SPATIAL_GRID_CHUNK_SIZE;
+                const size_t end = MIN(beg + SPATIAL_GRID_CHUNK_SIZE, count);
+                float* b = chunk_bounds + c * 6;
+                for (int i = 0; i < 3; ++i) {
+                    float min_val =  FLT_MAX;
+                    float max_val = -FLT_MAX;
+                    for (size_t j = beg; j < end; ++j) {
+                        min_val = MIN(min_val, coords[i][j]);
+                        max_val = MAX(max_val, coords[i][j]);
+                    }
+                    b[i] = min_val;
+                    b[i + 3] = max_val;
+                }
+            }
+        });
+
+        float min_box[3] = { FLT_MAX,  FLT_MAX,  FLT_MAX};
+        float max_box[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+        for (size_t c = 0; c < num_chunks; ++c) {
+            for (int i = 0; i < 3; ++i) {
+                min_box[i] = MIN(min_box[i], chunk_bounds[c * 6 + i]);
+                max_box[i] = MAX(max_box[i], chunk_bounds[c * 6 + i + 3]);
+            }
+        }
+
+        for (int i = 0; i < 3; ++i) {
+            const float ext = max_box[i] - min_box[i];
+            grid->dim[i] = CLAMP((int)ceilf(ext / cell_ext), 1, SPATIAL_GRID_MAX_DIM);
+            grid->origin[i] = min_box[i];
+            grid->cell_ext[i] = MAX(cell_ext, ext / grid->dim[i]);
+            grid->pbc_ext[i] = 0.0f;
+        }
+    }
+
+    const size_t num_cells = (size_t)grid->dim[0] * grid->dim[1] * grid->dim[2];
+
+    uint32_t* point_cell = (uint32_t*)md_alloc(alloc, count * sizeof(uint32_t));
+    defer { md_free(alloc, point_cell, count * sizeof(uint32_t)); };
+
+    std::atomic<uint32_t>* cell_cursor = (std::atomic<uint32_t>*)md_alloc(alloc, num_cells * sizeof(std::atomic<uint32_t>));
+    defer { md_free(alloc, cell_cursor, num_cells * sizeof(std::atomic<uint32_t>)); };
+    for (size_t i = 0; i < num_cells; ++i) {
+        new (&cell_cursor[i]) std::atomic<uint32_t>(0);
+    }
+
+    // Bin the points and count the number of points per cell
+    task_system::parallel_for(STR_LIT("##Spatial Grid"), count, SPATIAL_GRID_CHUNK_SIZE, [&](size_t beg, size_t end) {
+        for (size_t i = beg; i < end; ++i) {
+            const int cx = cell_coord(grid, wrap(x[i], grid->pbc_ext[0]), 0);
+            const int cy = cell_coord(grid, wrap(y[i], grid->pbc_ext[1]), 1);
+            const int cz = cell_coord(grid, wrap(z[i], grid->pbc_ext[2]), 2);
+            const uint32_t cell = (uint32_t)(((size_t)cz * grid->dim[1] + cy) * grid->dim[0] + cx);
+            point_cell[i] = cell;
+            cell_cursor[cell].fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    md_array_resize(grid->cell_offset, num_cells + 1, alloc);
+    uint32_t offset = 0;
+    for (size_t i = 0; i < num_cells; ++i) {
+        grid->cell_offset[i] = offset;
+        offset += cell_cursor[i].load(std::memory_order_relaxed);
+        cell_cursor[i].store(grid->cell_offset[i], std::memory_order_relaxed);
+    }
+    grid->cell_offset[num_cells] = offset;
+
+    // Scatter the points into the slots of their cells, the order within a cell is arbitrary
+    md_array_resize(grid->point_idx,  count, alloc);
+    md_array_resize(grid->point_xyz,  count * 3, alloc);
+    md_array_resize(grid->point_slot, count, alloc);
+    task_system::parallel_for(STR_LIT("##Spatial Grid"), count, SPATIAL_GRID_CHUNK_SIZE, [&](size_t beg, size_t end) {
+        for (size_t i = beg; i < end; ++i) {
+            const uint32_t slot = cell_cursor[point_cell[i]].fetch_add(1, std::memory_order_relaxed);
+            grid->point_idx[slot] = (uint32_t)i;
+            grid->point_xyz[slot * 3 + 0] = wrap(x[i], grid->pbc_ext[0]);
+            grid->point_xyz[slot * 3 + 1] = wrap(y[i], grid->pbc_ext[1]);
+            grid->point_xyz[slot * 3 + 2] = wrap(z[i], grid->pbc_ext[2]);
+            grid->point_slot[i] = slot;
+        }
+    });
+
+    return true;
+}
+
+void spatial_grid_free(spatial_grid_t* grid) {
+    ASSERT(grid);
+    if (grid->alloc) {
+        md_array_free(grid->cell_offset, grid->alloc);
+        md_array_free(grid->point_idx, grid->alloc);
+        md_array_free(grid->point_xyz, grid->alloc);
+        md_array_free(grid->point_slot, grid->alloc);
+    }
+    MEMSET(grid, 0, sizeof(spatial_grid_t));
+}
+
+// Calls func(slot, dist2) for the storage slots of all points within the radius of the position, until func returns false
+template <typename Func>
+static void for_each_slot_within(const spatial_grid_t* grid, const float pos[3], float radius, Func func) {
+    const bool periodic = is_periodic(grid);
+
+    float p[3];
+    int lo[3], hi[3];
+    for (int i = 0; i < 3; ++i) {
+        p[i] = wrap(pos[i], grid->pbc_ext[i]);
+        const int n = (int)ceilf(radius / grid->cell_ext[i]);
+        const int c = (int)floorf((p[i] - grid->origin[i]) / grid->cell_ext[i]);
+        if (periodic) {
+            // Cells are only visited once, even if the radius spans the whole box
+            if (2 * n + 1 >= grid->dim[i]) {
+                lo[i] = 0;
+                hi[i] = grid->dim[i] - 1;
+            } else {
+                lo[i] = c - n;
+                hi[i] = c + n;
+            }
+        } else {
+            lo[i] = MAX(c - n, 0);
+            hi[i] = MIN(c + n, grid->dim[i] - 1);
+            if (lo[i] > hi[i]) return;
+        }
+    }
+
+    const float r2 = radius * radius;
+    for (int z = lo[2]; z <= hi[2]; ++z) {
+        const int cz = periodic ? wrap_cell(z, grid->dim[2]) : z;
+        for (int y = lo[1]; y <= hi[1]; ++y) {
+            const int cy = periodic ? wrap_cell(y, grid->dim[1]) : y;
+            for (int x = lo[0]; x <= hi[0]; ++x) {
+                const int cx = periodic ? wrap_cell(x, grid->dim[0]) : x;
+                const size_t cell = ((size_t)cz * grid->dim[1] + cy) * grid->dim[0] + cx;
+                const uint32_t beg = grid->cell_offset[cell];
+                const uint32_t end = grid->cell_offset[cell + 1];
+                for (uint32_t slot = beg; slot < end; ++slot) {
+                    float d[3] = {
+                        grid->point_xyz[slot * 3 + 0] - p[0],
+                        grid->point_xyz[slot * 3 + 1] - p[1],
+                        grid->point_xyz[slot * 3 + 2] - p[2],
+                    };
+                    if (periodic) {
+                        for (int i = 0; i < 3; ++i) {
+                            d[i] -= grid->pbc_ext[i] * roundf(d[i] / grid->pbc_ext[i]);
+                        }
+                    }
+                    const float d2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+                    if (d2 <= r2) {
+                        if (!func(slot, d2)) return;
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool spatial_grid_grow_mask_by_radius(md_bitfield_t* mask, const spatial_grid_t* grid, float radius, const md_bitfield_t* viable_mask, const std::atomic_bool* interrupt) {
+    ASSERT(mask);
+    ASSERT(grid);
+
+    const size_t num_src = md_bitfield_popcount(mask);
+    if (num_src == 0 || radius <= 0.0f || grid->num_points == 0) {
+        return true;
+    }
+
+    md_allocator_i* alloc = md_get_heap_allocator();
+    int32_t* src = (int32_t*)md_alloc(alloc, num_src * sizeof(int32_t));
+    defer { md_free(alloc, src, num_src * sizeof(int32_t)); };
+    md_bitfield_iter_extract_indices(src, num_src, md_bitfield_iter_create(mask));
+
+    // Points are marked with relaxed byte stores, threads which mark the same point store the same value
+    const size_t num_points = grid->num_points;
+    std::atomic<uint8_t>* hit = (std::atomic<uint8_t>*)md_alloc(alloc, num_points * sizeof(std::atomic<uint8_t>));
+    defer { md_free(alloc, hit, num_points * sizeof(std::atomic<uint8_t>)); };
+    for (size_t i = 0; i < num_points; ++i) {
+        new (&hit[i]) std::atomic<uint8_t>(0);
+    }
+
+    task_system::parallel_for(STR_LIT("##Spatial Grid"), num_src, SPATIAL_GRID_QUERY_CHUNK_SIZE, [&](size_t beg, size_t end) {
+        for (size_t i = beg; i < end; ++i) {
+            if (interrupt && interrupt->load(std::memory_order_relaxed)) return;
+            if (src[i] < 0 || (size_t)src[i] >= num_points) continue;
+            const uint32_t slot = grid->point_slot[src[i]];
+            for_each_slot_within(grid, grid->point_xyz + slot * 3, radius, [&](uint32_t s, float) {
+                hit[grid->point_idx[s]].store(1, std::memory_order_relaxed);
+                return true;
+            });
+        }
+    });
+
+    if (interrupt && interrupt->load()) {
+        return false;
+    }
+
+    // Runs of marked points are added as ranges
+    md_bitfield_t grown = md_bitfield_create(alloc);
+    defer { md_bitfield_free(&grown); };
+    size_t i = 0;
+    while (i < num_points) {
+        if (!hit[i].load(std::memory_order_relaxed)) {
+            ++i;
+            continue;
+        }
+        const size_t beg = i;
+        while (i < num_points && hit[i].load(std::memory_order_relaxed)) ++i;
+        md_bitfield_set_range(&grown, beg, i);
+    }
+    if (viable_mask) {
+        md_bitfield_and_inplace(&grown, viable_mask);
+    }
+    md_bitfield_or_inplace(mask, &grown);
+
+    return true;
+}
+
+}  // namespace viamd
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <core/md_array.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+struct md_allocator_i;
+struct md_bitfield_t;
+
+// Uniform grid of cells (cell list) over a set of points, used to accelerate radial queries over large systems.
+// The points are sorted by cell (x fastest varying), such that the points of a cell are stored contiguously along with their coordinates.
+// With periodic boundaries (orthorhombic box), the points are wrapped into the box and the queries use the minimum image convention.
+// The grid is built in parallel on the task pool.
+
+#define SPATIAL_GRID_DEFAULT_CELL_EXT 4.0f
+
+namespace viamd {
+
+struct spatial_grid_t {
+    int   dim[3];
+    float origin[3];
+    float cell_ext[3];
+    float pbc_ext[3];           // Extent of the periodic box, zero if the grid is not periodic
+
+    md_array(uint32_t) cell_offset; // [num_cells + 1] offset of the first point of each cell
+    md_array(uint32_t) point_idx;   // [num_points] original indices of the points, sorted by cell
+    md_array(float)    point_xyz;   // [num_points * 3] coordinates of the points, sorted by cell
+    md_array(uint32_t) point_slot;  // [num_points] storage slot of each point
+
+    size_t num_points;
+    md_allocator_i* alloc;
+};
+
+// Builds the grid from point coordinates, pbc_ext (optional) gives the extent of an orthorhombic periodic box with its origin at zero
+bool spatial_grid_init(spatial_grid_t* grid, const float* x, const float* y, const float* z, size_t count, float cell_ext, const float pbc_ext[3], md_allocator_i* alloc);
+void spatial_grid_free(spatial_grid_t* grid);
+
+// Adds the points which are within the radius of any point within the mask to the mask, restricted to the points within viable_mask (optional)
+// The work is distributed over the task pool, the evaluation is aborted if the interrupt flag is set, in which case the mask is left unmodified and false is returned
+bool spatial_grid_grow_mask_by_radius(md_bitfield_t* mask, const spatial_grid_t* grid, float radius, const md_bitfield_t* viable_mask, const std::atomic_bool* interrupt = NULL);
+
+}  // namespace viamd
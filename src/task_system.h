@@ -63,5 +63,32 @@ void task_wait_for(ID);
 void task_interrupt(ID);
 void task_interrupt_and_wait_for(ID);
 
+// Calls func(beg, end) over chunks of [0, count) in parallel on the task pool and waits for the completion.
+// The call is performed on the calling thread if the count does not exceed the chunk size or the serial threshold, or if there is no pool.
+template <typename Func>
+void parallel_for(str_t label, size_t count, size_t chunk_size, Func func, size_t serial_threshold = 0) {
+    if (count <= chunk_size || count <= serial_threshold || pool_num_threads() == 0) {
+        func((size_t)0, count);
+        return;
+    }
+
+    struct Payload {
+        Func* func;
+        size_t count;
+        size_t chunk_size;
+    } payload = {&func, count, chunk_size};
+
+    const uint32_t num_chunks = (uint32_t)((count + chunk_size - 1) / chunk_size);
+    ID id = create_pool_task(label, 0, num_chunks, [](uint32_t range_beg, uint32_t range_end, void* user_data, uint32_t thread_num) {
+        (void)thread_num;
+        Payload* p = (Payload*)user_data;
+        const size_t beg = (size_t)range_beg * p->chunk_size;
+        const size_t end = (size_t)range_end * p->chunk_size;
+        (*p->func)(beg, end < p->count ? end : p->count);
+    }, &payload);
+    enqueue_task(id);
+    task_wait_for(id);
+}
+
 
 }  // namespace task_system
\ No newline at end of file
@@ -0,0 +1,345 @@
+#include "trajectory_sweep.h"
+
+#include <core/md_common.h>
+#include <core/md_log.h>
+#include <core/md_allocator.h>
+#include <core/md_os.h>
+#include <md_trajectory.h>
+
+#include <atomic>
+#include <thread>
+#include <stdio.h>
+#include <string.h>
+
+namespace sweep {
+
+#define MAX_CONSUMERS 64
+#define MAX_SWEEPS 16
+#define MAX_CONSUMERS_PER_SWEEP 16
+#define LABEL_SIZE 64
+
+enum State {
+    State_Free,
+    State_Pending,
+    State_Running,
+    State_Done,
+};
+
+struct Consumer {
+    ID id = INVALID_ID;
+    State state = State_Free;
+
+    uint32_t frame_beg = 0;
+    uint32_t frame_end = 0;
+    ConsumerFlags flags = ConsumerFlag_None;
+    FrameFunc    frame_func = 0;
+    CompleteFunc complete_func = 0;
+    void* user_data = 0;
+
+    // Task of the sweep which executes the consumer
+    // The consumer does not reference the sweep by its slot, as the slot may be reused by a later sweep while the consumer is still around
+    task_system::ID sweep_task = task_system::INVALID_ID;
+
+    std::atomic_uint32_t frames_complete = 0;
+    std::atomic_uint32_t active_calls = 0;
+    std::atomic_bool interrupt = false;
+
+    char buf[LABEL_SIZE] = "";
+    str_t label = {};
+};
+
+struct Sweep {
+    task_system::ID task = task_system::INVALID_ID;
+    md_trajectory_i* traj = 0;
+    size_t num_atoms = 0;
+    uint32_t frame_beg = 0;
+    uint32_t frame_count = 0;
+    bool progressive = false;
+
+    // The workers pull frames from this cursor rather than from their assigned partition.
+    // This keeps the frames (roughly) in the order of visitation regardless of how the task is partitioned.
+    std::atomic_uint32_t cursor = 0;
+
+    uint32_t num_consumers = 0;
+    uint32_t consumer_idx[MAX_CONSUMERS_PER_SWEEP] = {};
+
+    char buf[LABEL_SIZE] = "";
+};
+
+static Consumer consumers[MAX_CONSUMERS];
+static Sweep    sweeps[MAX_SWEEPS];
+static uint32_t id_counter = 0;
+
+static inline uint32_t get_slot_idx(ID id) {
+    return (uint32_t)(id & (MAX_CONSUMERS - 1));
+}
+
+static inline Consumer* get_consumer(ID id) {
+    if (id == INVALID_ID) return NULL;
+    Consumer* c = &consumers[get_slot_idx(id)];
+    return c->id == id ? c : NULL;
+}
+
+// Maps a linear index i in [0, count) onto a coarse to fine order of frames
+// First all multiples of the largest power of two (2^k) less than count, then the odd multiples of 2^(k-1) and so on until 2^0
+static inline uint32_t progressive_index(uint32_t i, uint32_t count) {
+    if (count < 3) return i;
+
+    const uint32_t last = count - 1;
+    uint32_t level = 0;
+    while (((uint64_t)2 << level) <= last) {
+        level += 1;
+    }
+
+    uint32_t n = (last >> level) + 1;
+    if (i < n) return i << level;
+    i -= n;
+
+    while (level > 0) {
+        level -= 1;
+        n = ((last >> level) + 1) / 2;
+        if (i < n) return (2 * i + 1) << level;
+        i -= n;
+    }
+
+    ASSERT(false);
+    return 0;
+}
+
+static void sweep_frame_range(uint32_t range_beg, uint32_t range_end, void* user_data, uint32_t thread_num) {
+    (void)thread_num;
+    Sweep* sweep = (Sweep*)user_data;
+
+    const size_t stride = ALIGN_TO(sweep->num_atoms, 8);
+    const size_t bytes = stride * sizeof(float) * 3;
+    float* coords = (float*)md_alloc(md_get_heap_allocator(), bytes);
+    defer { md_free(md_get_heap_allocator(), coords, bytes); };
+
+    float* x = coords + stride * 0;
+    float* y = coords + stride * 1;
+    float* z = coords + stride * 2;
+
+    // We consume as many frames as we were assigned, but in the order given by the cursor
+    for (uint32_t n = range_beg; n < range_end; ++n) {
+        const uint32_t i = sweep->cursor++;
+        if (i >= sweep->frame_count) break;
+        const uint32_t frame_idx = sweep->frame_beg + (sweep->progressive ? progressive_index(i, sweep->frame_count) : i);
+
+        // Only load the frame if any (non-interrupted) consumer is interested in it
+        bool needed = false;
+        for (uint32_t i = 0; i < sweep->num_consumers; ++i) {
+            const Consumer& c = consumers[sweep->consumer_idx[i]];
+            if (!c.interrupt && c.frame_beg <= frame_idx && frame_idx < c.frame_end) {
+                needed = true;
+                break;
+            }
+        }
+        if (!needed) continue;
+
+        md_trajectory_frame_header_t header;
+        if (!md_trajectory_load_frame(sweep->traj, frame_idx, &header, x, y, z)) {
+            MD_LOG_ERROR("Trajectory sweep: failed to load frame %u", frame_idx);
+            continue;
+        }
+
+        for (uint32_t i = 0; i < sweep->num_consumers; ++i) {
+            Consumer& c = consumers[sweep->consumer_idx[i]];
+            if (frame_idx < c.frame_beg || c.frame_end <= frame_idx) continue;
+
+            // @NOTE: The order is important here, active_calls has to be incremented before the interrupt is checked.
+            // Otherwise consumer_interrupt_and_wait_for may return while a call is still in flight.
+            c.active_calls += 1;
+            if (!c.interrupt) {
+                c.frame_func(frame_idx, &header, x, y, z, c.user_data);
+                c.frames_complete += 1;
+            }
+            c.active_calls -= 1;
+        }
+    }
+}
+
+ID submit(str_t label, uint32_t frame_beg, uint32_t frame_end, FrameFunc frame_func, void* user_data, CompleteFunc complete_func, ConsumerFlags flags) {
+    ASSERT(frame_func);
+
+    // Find a free slot, finished consumers are recycled
+    // A consumer may be done while its sweep is still running for the other consumers. The sweep references the consumer by its slot,
+    // so the slot is not recycled until the sweep has finished, otherwise the new consumer would receive the frames of the old sweep.
+    for (uint32_t i = 0; i < MAX_CONSUMERS; ++i) {
+        Consumer& c = consumers[i];
+        if (c.state == State_Free || (c.state == State_Done && !task_system::task_is_running(c.sweep_task))) {
+            id_counter += 1;
+            c.id = ((uint64_t)id_counter << 8) | i;
+            c.state = State_Pending;
+            c.frame_beg = frame_beg;
+            c.frame_end = MAX(frame_beg, frame_end);
+            c.flags = flags;
+            c.frame_func = frame_func;
+            c.complete_func = complete_func;
+            c.user_data = user_data;
+            c.sweep_task = task_system::INVALID_ID;
+            c.frames_complete = 0;
+            c.active_calls = 0;
+            c.interrupt = false;
+            size_t len = str_copy_to_char_buf(c.buf, sizeof(c.buf), label);
+            c.label = {c.buf, len};
+            return c.id;
+        }
+    }
+
+    MD_LOG_ERROR("Trajectory sweep: max number of consumers reached");
+    return INVALID_ID;
+}
+
+static void finalize_consumer(Consumer& c) {
+    const bool completed = !c.interrupt && c.frames_complete == (c.frame_end - c.frame_beg);
+    c.state = State_Done;
+    if (completed && c.complete_func) {
+        c.complete_func(c.user_data);
+    }
+}
+
+void update(md_trajectory_i* traj, size_t num_atoms) {
+    // Finalize consumers which are done
+    for (uint32_t i = 0; i < MAX_CONSUMERS; ++i) {
+        Consumer& c = consumers[i];
+        if (c.state != State_Running) continue;
+        if (c.frames_complete == (c.frame_end - c.frame_beg) || !task_system::task_is_running(c.sweep_task)) {
+            if (c.active_calls == 0) {
+                finalize_consumer(c);
+            }
+        }
+    }
+
+    // Gather pending consumers
+    uint32_t pending[MAX_CONSUMERS_PER_SWEEP];
+    uint32_t num_pending = 0;
+    for (uint32_t i = 0; i < MAX_CONSUMERS && num_pending < MAX_CONSUMERS_PER_SWEEP; ++i) {
+        Consumer& c = consumers[i];
+        if (c.state != State_Pending) continue;
+        if (c.interrupt || !traj || c.frame_beg == c.frame_end) {
+            finalize_consumer(c);
+            continue;
+        }
+        pending[num_pending++] = i;
+    }
+
+    if (num_pending == 0) return;
+
+    uint32_t sweep_idx = UINT32_MAX;
+    for (uint32_t i = 0; i < MAX_SWEEPS; ++i) {
+        if (!task_system::task_is_running(sweeps[i].task)) {
+            sweep_idx = i;
+            break;
+        }
+    }
+    if (sweep_idx == UINT32_MAX) {
+        // All sweeps are occupied, try again next update
+        return;
+    }
+
+    Sweep& sweep = sweeps[sweep_idx];
+    sweep.traj = traj;
+    sweep.num_atoms = num_atoms;
+    sweep.num_consumers = num_pending;
+
+    uint32_t frame_beg = UINT32_MAX;
+    uint32_t frame_end = 0;
+    bool progressive = false;
+    int len = 0;
+    for (uint32_t i = 0; i < num_pending; ++i) {
+        Consumer& c = consumers[pending[i]];
+        c.state = State_Running;
+        sweep.consumer_idx[i] = pending[i];
+        frame_beg = MIN(frame_beg, c.frame_beg);
+        frame_end = MAX(frame_end, c.frame_end);
+        progressive |= (c.flags & ConsumerFlag_Progressive) != 0;
+        if (len < (int)sizeof(sweep.buf)) {
+            len += snprintf(sweep.buf + len, sizeof(sweep.buf) - len, "%s%.*s", i > 0 ? " + " : "", (int)c.label.len, c.label.ptr);
+        }
+    }
+    sweep.frame_beg = frame_beg;
+    sweep.frame_count = frame_end - frame_beg;
+    sweep.progressive = progressive;
+    sweep.cursor = 0;
+    len = CLAMP(len, 0, (int)sizeof(sweep.buf) - 1);
+
+    sweep.task = task_system::create_pool_task({sweep.buf, (size_t)len}, 0, sweep.frame_count, sweep_frame_range, &sweep);
+    for (uint32_t i = 0; i < num_pending; ++i) {
+        consumers[pending[i]].sweep_task = sweep.task;
+    }
+    task_system::enqueue_task(sweep.task);
+}
+
+bool consumer_is_running(ID id) {
+    Consumer* c = get_consumer(id);
+    if (!c) return false;
+    switch (c->state) {
+    case State_Pending:
+        return !c->interrupt;
+    case State_Running:
+        if (c->active_calls > 0) return true;
+        if (c->interrupt) return false;
+        return c->frames_complete < (c->frame_end - c->frame_beg) && task_system::task_is_running(c->sweep_task);
+    default:
+        return false;
+    }
+}
+
+float consumer_fraction_complete(ID id) {
+    Consumer* c = get_consumer(id);
+    if (!c) return 0.0f;
+    if (c->state == State_Done) return 1.0f;
+    const uint32_t count = c->frame_end - c->frame_beg;
+    return count > 0 ? (float)c->frames_complete / (float)count : 0.0f;
+}
+
+str_t consumer_label(ID id) {
+    Consumer* c = get_consumer(id);
+    return c ? c->label : str_t{};
+}
+
+size_t running_consumers(ID* out, size_t cap) {
+    size_t count = 0;
+    for (uint32_t i = 0; i < MAX_CONSUMERS && count < cap; ++i) {
+        if (consumer_is_running(consumers[i].id)) {
+            out[count++] = consumers[i].id;
+        }
+    }
+    return count;
+}
+
+bool is_sweep_task(task_system::ID task) {
+    if (task == task_system::INVALID_ID) return false;
+    for (uint32_t i = 0; i < MAX_SWEEPS; ++i) {
+        if (sweeps[i].task == task) return true;
+    }
+    return false;
+}
+
+void consumer_interrupt(ID id) {
+    Consumer* c = get_consumer(id);
+    if (c) {
+        c->interrupt = true;
+    }
+}
+
+void consumer_interrupt_and_wait_for(ID id) {
+    Consumer* c = get_consumer(id);
+    if (c) {
+        c->interrupt = true;
+        while (c->active_calls > 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void interrupt_all() {
+    for (uint32_t i = 0; i < MAX_CONSUMERS; ++i) {
+        Consumer& c = consumers[i];
+        if (c.state == State_Pending || c.state == State_Running) {
+            c.interrupt = true;
+        }
+    }
+}
+
+}  // namespace sweep
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <core/md_str.h>
+#include <task_system.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct md_trajectory_i;
+struct md_trajectory_frame_header_t;
+
+// A trajectory sweep walks the frames of a trajectory once and dispatches each loaded frame to all consumers
+// that were submitted together. This means that concurrent whole-trajectory analyses (script evaluation, backbone
+// computations, shape space, etc.) only pay for a single load/decode pass instead of one per analysis.
+
+namespace sweep {
+
+typedef uint64_t ID;
+constexpr ID INVALID_ID = 0;
+
+// Executed on a worker thread for each frame within the consumers frame range.
+// The coordinates are only valid for the duration of the call and are shared between consumers, do not modify them.
+// The frame is guaranteed to have been loaded through the trajectory (and thus its frame cache) prior to the call,
+// so consumers which need to go through the trajectory interface themselves will hit the cache.
+using FrameFunc    = void (*)(uint32_t frame_idx, const md_trajectory_frame_header_t* header, const float* x, const float* y, const float* z, void* user_data);
+
+// Executed on the main thread (within update) once the consumer has received all of its frames.
+// It is not called if the consumer was interrupted.
+using CompleteFunc = void (*)(void* user_data);
+
+enum ConsumerFlag_ {
+    ConsumerFlag_None        = 0,
+    // Visit the frames in a coarse to fine order: every 2^k-th frame first, then the frames in between with stride 2^(k-1) and so on.
+    // This gives a sparse but global coverage of the trajectory early on, which is then refined.
+    // If any consumer within a sweep requests this, the whole sweep is performed in this order.
+    ConsumerFlag_Progressive = 1,
+};
+
+typedef uint32_t ConsumerFlags;
+
+// Submits a consumer for the frame range [frame_beg, frame_end).
+// The consumer is pending until the next call to update, where all pending consumers are launched together within one sweep.
+ID submit(str_t label, uint32_t frame_beg, uint32_t frame_end, FrameFunc frame_func, void* user_data = 0, CompleteFunc complete_func = 0, ConsumerFlags flags = ConsumerFlag_None);
+
+// Call once per frame from the main thread.
+// Launches a sweep for all pending consumers and executes completion callbacks for finished consumers.
+void update(md_trajectory_i* traj, size_t num_atoms);
+
+// These are safe to call with an invalid id, in such case, they will just return some default value
+bool  consumer_is_running(ID);
+float consumer_fraction_complete(ID);
+str_t consumer_label(ID);
+
+// Writes the ids of all pending and running consumers to out and returns the number written
+size_t running_consumers(ID* out, size_t cap);
+
+// Is the task one which executes a sweep (and thus shared between multiple consumers)
+bool is_sweep_task(task_system::ID);
+
+// These are safe to call with an invalid id, and in such case, they do nothing
+// Interrupting a consumer does not interrupt the sweep, other consumers within the same sweep proceed as normal
+void consumer_interrupt(ID);
+void consumer_interrupt_and_wait_for(ID);
+
+// Interrupts all pending and running consumers
+void interrupt_all();
+
+}  // namespace sweep
@@ -12,7 +12,14 @@
 #include <gfx/camera_utils.h>
 #include <gfx/view_param.h>
 #include <gfx/postprocessing_utils.h>
+#include <gfx/ensemble_utils.h>
+#include <gfx/culling_utils.h>
+#include <gfx/picking_utils.h>
+#include <gfx/profiler.h>
+#include <gfx/volumerender_utils.h>
 #include <task_system.h>
+#include <trajectory_sweep.h>
+#include <spatial_grid.h>
 
 #include <implot.h>
 
@@ -21,14 +28,6 @@
 
 #define JITTER_SEQUENCE_SIZE 8
 
-// For cpu profiling
-#define PUSH_CPU_SECTION(lbl) {};
-#define POP_CPU_SECTION() {};
-
-// For gpu profiling
-#define PUSH_GPU_SECTION(lbl) { if (glPushDebugGroup) glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, GL_KHR_debug, -1, lbl); }
-#define POP_GPU_SECTION()     { if (glPopDebugGroup) glPopDebugGroup(); }
-
 enum class PlaybackMode { Stopped, Playing };
 enum class InterpolationMode { Nearest, Linear, CubicSpline };
 enum class SelectionLevel { Atom, Residue, Chain };
@@ -36,6 +35,7 @@ enum class SelectionOperator { Or, And, AndNot, Set, Clear };
 enum class SelectionGrowth { CovalentBond, Radial };
 enum class TrackingMode { Absolute, Relative };
 enum class CameraMode { Perspective, Orthographic };
+enum class MovieOutput { Images, Pipe };
 
 enum class RepresentationType {
     SpaceFill = MD_GL_REP_SPACE_FILL,
@@ -105,7 +105,15 @@ enum MolBit_ {
     MolBit_ClearVelocity            = 0x20,
 };
 
+enum RepBit_ {
+    RepBit_DirtyColor               = 0x01,     // The data which the color mapping is based on has changed
+    RepBit_DirtyFilter              = 0x02,     // The data which the filter is evaluated on has changed
+    RepBit_DirtyAll                 = 0x03,
+};
+
 struct DisplayProperty;
+struct DensityRepJob;
+struct VolumeUpload;
 
 struct LoadDatasetWindowState {
     char path_buf[1024] = "";
@@ -180,7 +188,9 @@ struct DatasetItem {
     char label[32] = "";
     char query[32] = "";
     uint32_t count = 0;
-    float fraction = 0;
+    float fraction = 0;         // Fraction of atoms
+    float mass_fraction = 0;
+    uint32_t residue_count = 0; // Only for chains
 };
 
 struct DipoleMoment {
@@ -218,10 +228,12 @@ struct ComputeOrbital {
     mat4_t tex_mat = {};
     vec3_t voxel_spacing = {};
     uint32_t *dst_texture = 0;
+    uint32_t *dst_macro_cell_texture = 0;
 };
 
 struct RepresentationVolume {
-    uint32_t vol_tex = 0;    
+    uint32_t vol_tex = 0;
+    uint32_t macro_cell_tex = 0;
     mat4_t   tex_mat = mat4_ident();
     vec3_t   voxel_spacing = {};
 
@@ -241,6 +253,11 @@ struct RepresentationVolume {
     } dvr;
 };
 
+struct PropertyColorJob;
+struct SelectionGrowJob;
+struct ScreenshotJob;
+struct MovieExport;
+
 struct Representation {
     char name[64] = "rep";
     char filt[256] = "all";
@@ -260,6 +277,14 @@ struct Representation {
     bool filt_is_valid = false;
     bool filt_is_dynamic = false;
     bool dynamic_evaluation = false;
+    bool color_is_dirty = true;
+
+    // Cached colors of the atoms before filtering, and the filtered colors which were last uploaded
+    // Only the parts which differ from the last upload are uploaded
+    md_array(uint32_t) colors = 0;
+    md_array(uint32_t) uploaded_colors = 0;
+    uint64_t color_hash = 0;    // Hash of the color mapping parameters of the cached colors
+    uint64_t mask_hash = 0;     // Hash of the atom mask of the uploaded colors
 
     // User defined color used in uniform mode
     vec4_t uniform_color = {1.0f, 1.0f, 1.0f, 1.0f};
@@ -283,7 +308,16 @@ struct Representation {
         float map_end = 1.0f;
         float map_min = 0.0f;
         float map_max = 1.0f;
-        char ident[64] = "";
+        char ident[64] = "";    // Label of the temporal display property
+
+        // Index of the structure (population entry) of the property which each atom belongs to, -1 if none
+        md_array(int32_t) atom_structure = 0;
+        uint64_t structure_hash = 0;
+
+        // Quantized colormap coordinate of each atom, which is evaluated for the current frame on the task pool
+        md_array(uint8_t) atom_scalar = 0;
+        uint64_t scalar_hash = 0;
+        PropertyColorJob* job = 0;
     } prop;
 };
 
@@ -334,8 +368,32 @@ struct ApplicationState {
     struct {
         bool  hide_gui = true;
         str_t path_to_file = {};
+
+        // Resolution of offscreen renders
+        int width  = 3840;
+        int height = 2160;
+
+        md_array(ScreenshotJob*) jobs = 0;
     } screenshot;
 
+    // Export of frame sequences
+    struct {
+        bool show_window = false;
+
+        double beg_frame = 0;
+        double end_frame = 0;
+        double stride = 1;
+        MovieOutput output = MovieOutput::Images;
+
+        // The frame index and the extension are appended to the file name, e.g. frame.png -> frame_00042.png
+        char path[1024] = "frame.png";
+        // Raw RGBA frames are written to stdin of the command, {width} and {height} are replaced by the dimensions of the frames
+        char command[1024] = "ffmpeg -y -f rawvideo -pixel_format rgba -video_size {width}x{height} -framerate 30 -i - -c:v libx264 -pix_fmt yuv420p movie.mp4";
+
+        bool exit_on_completion = false;
+        MovieExport* job = 0;
+    } movie;
+
     // --- MDLIB DATA ---
     struct {
         md_allocator_i*     mol_alloc = nullptr;
@@ -352,6 +410,28 @@ struct ApplicationState {
         vec3_t              mol_aabb_max = {};
 
         uint32_t dirty_buffers = 0;
+        uint64_t position_generation = 0;  // Incremented whenever the positions are modified (along with MolBit_DirtyPosition)
+
+        // Atom flags of the last upload and the masks they were generated from (highlight, selection, visibility, in view)
+        // Only the blocks of atoms where the masks differ are regenerated and uploaded, masks are only compared if their hash has changed
+        struct {
+            md_array(uint8_t) flags = 0;
+            md_bitfield_t masks[4] = {};
+            uint64_t hashes[4] = {};
+        } atom_flags;
+
+        // Chunks of atoms which are culled against the view for the impostor representations
+        struct {
+            culling::Culler culler = {};
+            md_bitfield_t mask = {};        // Atoms which are drawn
+            uint64_t hash = 0;
+            float radius_scale = 0.0f;      // Radius scale which the bounds were computed with
+            uint64_t scene_key = 0;         // Key of the view and the scene of the current frame, which the captured depth is tagged with
+        } culling;
+
+        // Spatial grid over the atom positions used for radial queries, rebuilt by the selection grow job when the positions change
+        viamd::spatial_grid_t grid = {};
+        uint64_t grid_hash = 0;     // Hash of the position generation and unit cell which the grid was built from
     } mold;
 
     DisplayProperty* display_properties = nullptr;
@@ -360,10 +440,10 @@ struct ApplicationState {
 
     // --- ASYNC TASKS HANDLES ---
     struct {
-        task_system::ID backbone_computations = task_system::INVALID_ID;
+        sweep::ID       backbone_computations = sweep::INVALID_ID;
         task_system::ID prefetch_frames = task_system::INVALID_ID;
-        task_system::ID evaluate_full = task_system::INVALID_ID;
-        task_system::ID evaluate_filt = task_system::INVALID_ID;
+        sweep::ID       evaluate_full = sweep::INVALID_ID;
+        sweep::ID       evaluate_filt = sweep::INVALID_ID;
     } tasks;
 
     // --- ATOM SELECTION ---
@@ -384,6 +464,8 @@ struct ApplicationState {
 
         md_bitfield_t selection_mask{};
         md_bitfield_t highlight_mask{};
+        uint64_t selection_mask_hash = 0;   // Hashes of the masks, updated once per frame
+        uint64_t highlight_mask_hash = 0;
         Selection* stored_selections = NULL;
 
         struct {
@@ -402,6 +484,21 @@ struct ApplicationState {
 
         bool selecting = false;
 
+        // Box selection, the atoms within the region are read back from the picking ids of the G-buffer
+        struct {
+            picking::RegionQuery* query = nullptr;
+            SelectionOperator op = SelectionOperator::Or;
+            bool commit = false;            // The result of the query in flight is applied to the selection
+            bool pending = false;           // The region is requested once the query in flight is complete
+            bool pending_commit = false;
+            int  rect[4] = {};              // Last requested region in framebuffer coordinates (x, y, width, height)
+
+            bool include_occluded = false;  // Select all atoms which project into the region, rather than the visible ones
+
+            double   latency_ms = 0;
+            uint32_t latency_frames = 0;
+        } region;
+
         struct {
             char buf[256] = "";
             char error[256] = "";
@@ -417,6 +514,7 @@ struct ApplicationState {
             float extent = 1;
             bool mask_invalid = true;
             bool show_window = false;
+            SelectionGrowJob* job = nullptr;
         } grow;
     } selection;
 
@@ -484,6 +582,7 @@ struct ApplicationState {
                 float min_val = 0.0f;
                 float max_val = 1.0f;
             } tf;
+            float max_step_scale = 1.0f;
         } dvr;
 
         struct {
@@ -494,10 +593,19 @@ struct ApplicationState {
         } iso;
 
         struct {
-            uint32_t id = 0;
+            uint32_t id = 0;        // Front texture, which is rendered
+            uint32_t back_id = 0;   // Back texture, which receives uploads and is swapped to the front once complete
+            uint32_t pbo = 0;       // Pixel unpack buffer which the uploads are streamed through
+            uint32_t macro_cells = 0;   // (min, max) macro cells of the front texture
+            VolumeUpload* upload = nullptr;
             bool dirty = false;
             int  dim[3] = {0};
             float max_value = 1.f;
+
+            // Sparse representation, where only the bricks which contain density are stored on the GPU
+            bool bricked = false;               // Requested representation
+            bool use_bricked = false;           // Representation of the current contents, the dense textures are released while bricked
+            volume::BrickedVolume bricked_volume = {};
         } volume_texture;
 
         GBuffer fbo = {0};
@@ -528,6 +636,8 @@ struct ApplicationState {
         bool dirty_rep = false;
         bool dirty_vol = false;
 
+        DensityRepJob* rep_job = nullptr;
+
         struct {
             RepresentationType type = RepresentationType::BallAndStick;
             ColorMapping colormap = ColorMapping::Cpk;
@@ -537,6 +647,7 @@ struct ApplicationState {
 
         md_array(md_gl_rep_t) gl_reps = nullptr;
         md_array(mat4_t) rep_model_mats = nullptr;
+        ensemble::Ensemble ensemble = {};
         mat4_t model_mat = {0};        
 
         Camera camera = {};
@@ -605,6 +716,25 @@ struct ApplicationState {
             bool draw_control_points = false;
             bool draw_spline = false;
         } spline;
+
+        struct {
+            bool enabled = true;
+            bool occlusion = false;
+            float lod_pixel_size = 2.0f;
+        } culling;
+
+        // Scales the resolution of the G-buffer to hold a target GPU frame time, the result is upsampled to the framebuffer
+        struct {
+            bool enabled = false;
+            float target_ms = 14.0f;
+            float min_scale = 0.5f;
+
+            float scale = 1.0f;             // Current scale of the render resolution
+            bool  ssao_half_res = false;    // SSAO is reduced before the resolution
+            float gpu_ms = 0.0f;            // Smoothed GPU frame time
+            uint64_t measured_frame = 0;    // Last profiler frame which was accounted for
+            uint32_t frames_since_change = 0;
+        } dynamic_resolution;
     } visuals;
 
     struct {